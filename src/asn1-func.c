@@ -34,6 +34,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
@@ -55,12 +56,158 @@
 static AsnNode resolve_identifier (AsnNode root, AsnNode node, int nestlevel);
 
 
+/* The nodes of an expanded tree are not allocated one by one but
+   taken from an arena made up of a few larger blocks.  The size of
+   the blocks grows from ARENA_MIN_BLOCKSIZE to ARENA_MAX_BLOCKSIZE;
+   larger objects get a block of their own.  */
+#define ARENA_MIN_BLOCKSIZE  4096
+#define ARENA_MAX_BLOCKSIZE  65536
+
+union arena_align_u
+{
+  void *p;
+  long l;
+  double d;
+};
+#define ARENA_ALIGN (sizeof (union arena_align_u))
+
+struct arena_block_s
+{
+  struct arena_block_s *next;
+  size_t size;    /* Usable size of DATA.  */
+  size_t used;    /* Number of bytes of DATA already handed out.  */
+  union arena_align_u data[1];
+};
+
+struct asn_arena_s
+{
+  struct arena_block_s *blocks;  /* The block used for allocation first.  */
+  size_t blocksize;              /* Size of the next block.  */
+  AsnNode link_tail;             /* Last node on the link_next list.  */
+};
+
+
+static asn_arena_t
+new_arena (void)
+{
+  asn_arena_t arena;
+
+  arena = xmalloc (sizeof *arena);
+  arena->blocks = NULL;
+  arena->blocksize = ARENA_MIN_BLOCKSIZE;
+  arena->link_tail = NULL;
+  return arena;
+}
+
+
+/* Release ARENA and thus all nodes, names and values allocated from
+   it.  */
+void
+_ksba_asn_release_arena (asn_arena_t arena)
+{
+  struct arena_block_s *b, *b2;
+
+  if (!arena)
+    return;
+  for (b = arena->blocks; b; b = b2)
+    {
+      b2 = b->next;
+      xfree (b);
+    }
+  xfree (arena);
+}
+
+
+static struct arena_block_s *
+new_arena_block (size_t size)
+{
+  struct arena_block_s *b;
+
+  b = xmalloc (offsetof (struct arena_block_s, data) + size);
+  b->next = NULL;
+  b->size = size;
+  b->used = 0;
+  return b;
+}
+
+
+/* Return N bytes from ARENA.  Like xmalloc this function does not
+   return on error.  */
+static void *
+arena_alloc (asn_arena_t arena, size_t n)
+{
+  struct arena_block_s *b;
+  void *p;
+
+  n = (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (n > ARENA_MAX_BLOCKSIZE / 4)
+    {
+      /* Put large objects into a block of their own behind the
+         current one so that the space left in the current block is
+         not wasted.  */
+      b = new_arena_block (n);
+      b->used = n;
+      if (arena->blocks)
+        {
+          b->next = arena->blocks->next;
+          arena->blocks->next = b;
+        }
+      else
+        arena->blocks = b;
+      return b->data;
+    }
+
+  b = arena->blocks;
+  if (!b || b->size - b->used < n)
+    {
+      b = new_arena_block (arena->blocksize);
+      b->next = arena->blocks;
+      arena->blocks = b;
+      if (arena->blocksize < ARENA_MAX_BLOCKSIZE)
+        arena->blocksize *= 2;
+    }
+  p = (char*)b->data + b->used;
+  b->used += n;
+  return p;
+}
+
+
+/* Allocate N bytes to be used by NODE.  */
+static void *
+node_alloc (AsnNode node, size_t n)
+{
+  return node->arena? arena_alloc (node->arena, n) : xmalloc (n);
+}
+
+/* Free P which has been allocated by node_alloc for NODE.  */
+static void
+node_free (AsnNode node, void *p)
+{
+  if (!node->arena)
+    xfree (p);
+}
+
+static char *
+node_strdup (AsnNode node, const char *string)
+{
+  char *p;
+
+  if (!node->arena)
+    return xstrdup (string);
+  p = arena_alloc (node->arena, strlen (string) + 1);
+  strcpy (p, string);
+  return p;
+}
+
+
+/* Create a new node of TYPE.  If ARENA is not NULL the node and all
+   its data are allocated from it.  */
 static AsnNode
-add_node (node_type_t type)
+add_node (node_type_t type, asn_arena_t arena)
 {
   AsnNode punt;
 
-  punt = xmalloc (sizeof *punt);
+  punt = arena? arena_alloc (arena, sizeof *punt) : xmalloc (sizeof *punt);
 
   punt->left = NULL;
   punt->name = NULL;
@@ -73,13 +220,14 @@ add_node (node_type_t type)
   punt->down = NULL;
   punt->right = NULL;
   punt->link_next = NULL;
+  punt->arena = arena;
   return punt;
 }
 
 AsnNode
 _ksba_asn_new_node (node_type_t type)
 {
-  return add_node (type);
+  return add_node (type, NULL);
 }
 
 
@@ -132,9 +280,9 @@ _ksba_asn_set_value (AsnNode node,
   if (node->valuetype)
     {
       if (node->valuetype == VALTYPE_CSTR)
-        xfree (node->value.v_cstr);
+        node_free (node, node->value.v_cstr);
       else if (node->valuetype == VALTYPE_MEM)
-        xfree (node->value.v_mem.buf);
+        node_free (node, node->value.v_mem.buf);
       node->valuetype = 0;
     }
 
@@ -147,13 +295,13 @@ _ksba_asn_set_value (AsnNode node,
       node->value.v_bool = !!(const unsigned *)value;
       break;
     case VALTYPE_CSTR:
-      node->value.v_cstr = xstrdup (value);
+      node->value.v_cstr = node_strdup (node, value);
       break;
     case VALTYPE_MEM:
       node->value.v_mem.len = len;
       if (len)
         {
-          node->value.v_mem.buf = xmalloc (len);
+          node->value.v_mem.buf = node_alloc (node, len);
           memcpy (node->value.v_mem.buf, value, len);
         }
       else
@@ -219,12 +367,12 @@ copy_value (AsnNode d, const AsnNode s)
 }
 
 static AsnNode
-copy_node (const AsnNode s)
+copy_node (const AsnNode s, asn_arena_t arena)
 {
-  AsnNode d = add_node (s->type);
+  AsnNode d = add_node (s->type, arena);
 
   if (s->name)
-    d->name = xstrdup (s->name);
+    d->name = node_strdup (d, s->name);
   d->flags = s->flags;
   copy_value (d, s);
   return d;
@@ -242,12 +390,12 @@ _ksba_asn_set_name (AsnNode node, const char *name)
 
   if (node->name)
     {
-      xfree (node->name);
+      node_free (node, node->name);
       node->name = NULL;
     }
 
   if (name && *name)
-      node->name = xstrdup (name);
+      node->name = node_strdup (node, name);
 }
 
 
@@ -282,6 +430,8 @@ _ksba_asn_remove_node (AsnNode  node)
 {
   if (node == NULL)
     return;
+  if (node->arena)
+    return; /* Released along with its arena.  */
 
   xfree (node->name);
   if (node->valuetype == VALTYPE_CSTR)
@@ -921,7 +1071,7 @@ _ksba_asn_expand_object_id (AsnNode node)
                     {
                       if (p4->type == TYPE_CONSTANT)
                         {
-                          p5 = add_node (TYPE_CONSTANT);
+                          p5 = add_node (TYPE_CONSTANT, NULL);
                           _ksba_asn_set_name (p5, p4->name);
                           _ksba_asn_set_value (p5, VALTYPE_CSTR,
                                                p4->value.v_cstr, 0);
@@ -1021,21 +1171,30 @@ _ksba_asn_type_set_config (AsnNode node)
     }
 }
 
+/* Append NODE to the link_next list whose last node is stored at
+   TAIL.  */
+static void
+link_node (AsnNode *tail, AsnNode node)
+{
+  if (*tail)
+    (*tail)->link_next = node;
+  *tail = node;
+}
+
+
 /* Create a copy the tree at SRC_ROOT. s is a helper which should be
-   set to SRC_ROOT by the caller */
+   set to SRC_ROOT by the caller.  The new nodes are allocated from
+   ARENA and appended to the link_next list ending at TAIL.  */
 static AsnNode
-copy_tree (AsnNode src_root, AsnNode s)
+copy_tree (AsnNode src_root, AsnNode s, asn_arena_t arena, AsnNode *tail)
 {
   AsnNode first=NULL, dprev=NULL, d, down, tmp;
-  AsnNode *link_nextp = NULL;
 
   for (; s; s=s->right )
     {
       down = s->down;
-      d = copy_node (s);
-      if (link_nextp)
-	*link_nextp = d;
-      link_nextp = &d->link_next;
+      d = copy_node (s, arena);
+      link_node (tail, d);
 
       if (!first)
         first = d;
@@ -1047,15 +1206,7 @@ copy_tree (AsnNode src_root, AsnNode s)
       dprev = d;
       if (down)
         {
-          tmp = copy_tree (src_root, down);
-	  if (tmp)
-	    {
-	      if (link_nextp)
-		*link_nextp = tmp;
-	      link_nextp = &tmp->link_next;
-	      while (*link_nextp)
-		link_nextp = &(*link_nextp)->link_next;
-	    }
+          tmp = copy_tree (src_root, down, arena, tail);
 
           if (d->down && tmp)
             { /* Need to merge it with the existing down */
@@ -1116,10 +1267,10 @@ resolve_identifier (AsnNode root, AsnNode node, int nestlevel)
 
 
 static AsnNode
-do_expand_tree (AsnNode src_root, AsnNode s, int depth)
+do_expand_tree (AsnNode src_root, AsnNode s, int depth, asn_arena_t arena,
+                AsnNode *tail)
 {
   AsnNode first=NULL, dprev=NULL, d, down, tmp;
-  AsnNode *link_nextp = NULL;
 
   /* On the very first level we do not follow the right pointer so that
      we can break out a valid subtree. */
@@ -1141,10 +1292,8 @@ do_expand_tree (AsnNode src_root, AsnNode s, int depth)
               continue;
             }
           down = d->down;
-          d = copy_node (d);
-	  if (link_nextp)
-	    *link_nextp = d;
-	  link_nextp = &d->link_next;
+          d = copy_node (d, arena);
+          link_node (tail, d);
           if (s->flags.is_optional)
             d->flags.is_optional = 1;
           if (s->flags.in_choice)
@@ -1164,10 +1313,8 @@ do_expand_tree (AsnNode src_root, AsnNode s, int depth)
             {
               AsnNode x;
 
-              x = copy_node (s2);
-	      if (link_nextp)
-		*link_nextp = x;
-	      link_nextp = &x->link_next;
+              x = copy_node (s2, arena);
+              link_node (tail, x);
               x->left = *dp? *dp : d;
               *dp = x;
               dp = &(*dp)->right;
@@ -1181,10 +1328,8 @@ do_expand_tree (AsnNode src_root, AsnNode s, int depth)
         }
       else
         {
-	  d = copy_node (s);
-	  if (link_nextp)
-	    *link_nextp = d;
-	  link_nextp = &d->link_next;
+	  d = copy_node (s, arena);
+          link_node (tail, d);
 	}
 
       if (!first)
@@ -1204,15 +1349,7 @@ do_expand_tree (AsnNode src_root, AsnNode s, int depth)
             }
           else
             {
-	      tmp = do_expand_tree (src_root, down, depth+1);
-	      if (tmp)
-		{
-		  if (link_nextp)
-		    *link_nextp = tmp;
-		  link_nextp = &tmp->link_next;
-		  while (*link_nextp)
-		    link_nextp = &(*link_nextp)->link_next;
-		}
+	      tmp = do_expand_tree (src_root, down, depth+1, arena, tail);
 	    }
           if (d->down && tmp)
             { /* Need to merge it with the existing down */
@@ -1241,38 +1378,50 @@ do_expand_tree (AsnNode src_root, AsnNode s, int depth)
    of).  This expanded tree is also an requirement for doing the DER
    decoding as the resolving of identifiers leads to a lot of
    problems.  We use more memory of course, but this is negligible
-   because the entire code will be simpler and faster */
+   because the entire code will be simpler and faster.  All nodes of
+   the expanded tree are allocated from one arena; they are released
+   by calling _ksba_asn_release_nodes with the returned root.  */
 AsnNode
 _ksba_asn_expand_tree (AsnNode parse_tree, const char *name)
 {
   AsnNode root;
+  asn_arena_t arena;
 
   root = name? find_node (parse_tree, name, 1) : parse_tree;
-  return do_expand_tree (parse_tree, root, 0);
+  arena = new_arena ();
+  root = do_expand_tree (parse_tree, root, 0, arena, &arena->link_tail);
+  if (!root)
+    _ksba_asn_release_arena (arena);
+  return root;
 }
 
 
 /* Insert a copy of the entire tree at NODE as the sibling of itself
-   and return the copy */
+   and return the copy.  For a node of an expanded tree this takes
+   time proportional to the size of the copy; thus the elements of a
+   SEQUENCE OF are added in linear time.  */
 AsnNode
 _ksba_asn_insert_copy (AsnNode node)
 {
-  AsnNode n;
-  AsnNode *link_nextp;
+  AsnNode n, tail;
 
-  n = copy_tree (node, node);
+  /* The new nodes are appended to the list of all nodes.  The arena
+     of an expanded tree knows the end of that list.  */
+  if (node->arena)
+    tail = node->arena->link_tail;
+  else
+    for (tail = node; tail->link_next; tail = tail->link_next)
+      ;
+
+  n = copy_tree (node, node, node->arena, &tail);
   if (!n)
     return NULL; /* out of core */
+  if (node->arena)
+    node->arena->link_tail = tail;
   return_null_if_fail (n->right == node->right);
   node->right = n;
   n->left = node;
 
-  /* FIXME: Consider tail pointer for faster insertion.  */
-  link_nextp = &node->link_next;
-  while (*link_nextp)
-    link_nextp = &(*link_nextp)->link_next;
-  *link_nextp = n;
-
   return n;
 }
 
@@ -1314,3 +1463,137 @@ _ksba_asn_find_type_value (const unsigned char *image, AsnNode root, int idx,
     }
   return NULL;
 }
+
+
+/* The index created by _ksba_asn_new_tv_index.  The entries are
+   stored in tree order; each bucket of the hash table links its
+   entries in that order too.  */
+struct asn_tv_index_s
+{
+  const unsigned char *image;
+  unsigned int nbuckets;    /* A power of 2.  */
+  int *buckets;             /* Index of the first entry or -1.  */
+  struct
+  {
+    AsnNode noid;           /* The OBJECT IDENTIFIER node.  */
+    unsigned int hash;
+    int next;               /* Next entry of the bucket or -1.  */
+  } *entries;
+};
+
+
+static unsigned int
+hash_oid (const unsigned char *oid, size_t oidlen)
+{
+  unsigned int h = 2166136261u;  /* FNV-1a */
+
+  for (; oidlen; oidlen--)
+    h = (h ^ *oid++) * 16777619u;
+  return h;
+}
+
+
+/* Return true if NODE is the start of a type value sequence as
+   looked for by _ksba_asn_find_type_value.  */
+static int
+is_type_value (AsnNode n)
+{
+  return (n->type == TYPE_SEQUENCE
+          && n->down && n->down->type == TYPE_OBJECT_ID
+          && n->down->off != -1 && n->down->right);
+}
+
+
+/* Create an index of all type value sequences below ROOT so that
+   _ksba_asn_lookup_type_value does not need to walk the tree.  IMAGE
+   is the image of the value tree.  The tree may not be changed as
+   long as the index is in use.  Returns 0 or an error code.  */
+int
+_ksba_asn_new_tv_index (const unsigned char *image, AsnNode root,
+                        asn_tv_index_t *r_index)
+{
+  asn_tv_index_t index;
+  AsnNode n;
+  int count, i;
+  unsigned int nbuckets, b;
+
+  *r_index = NULL;
+  if (!image || !root)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  count = 0;
+  for (n = root; n; n = _ksba_asn_walk_tree (root, n))
+    if (is_type_value (n))
+      count++;
+
+  for (nbuckets = 8; nbuckets < count; nbuckets <<= 1)
+    ;
+  index = xtrymalloc (sizeof *index
+                      + nbuckets * sizeof *index->buckets
+                      + (count? count : 1) * sizeof *index->entries);
+  if (!index)
+    return gpg_error_from_syserror ();
+  index->image = image;
+  index->nbuckets = nbuckets;
+  index->entries = (void*)(index + 1);
+  index->buckets = (void*)(index->entries + (count? count : 1));
+
+  i = 0;
+  for (n = root; n; n = _ksba_asn_walk_tree (root, n))
+    if (is_type_value (n))
+      {
+        index->entries[i].noid = n->down;
+        index->entries[i].hash = hash_oid (image + n->down->off
+                                           + n->down->nhdr, n->down->len);
+        i++;
+      }
+
+  /* Prepend the entries in reverse order so that the buckets keep
+     the tree order.  */
+  for (b = 0; b < nbuckets; b++)
+    index->buckets[b] = -1;
+  for (i = count - 1; i >= 0; i--)
+    {
+      b = index->entries[i].hash & (nbuckets - 1);
+      index->entries[i].next = index->buckets[b];
+      index->buckets[b] = i;
+    }
+
+  *r_index = index;
+  return 0;
+}
+
+
+void
+_ksba_asn_release_tv_index (asn_tv_index_t index)
+{
+  xfree (index);
+}
+
+
+/* Same as _ksba_asn_find_type_value but use the prepared INDEX.  */
+AsnNode
+_ksba_asn_lookup_type_value (asn_tv_index_t index, int idx,
+                             const void *oidbuf, size_t oidlen)
+{
+  unsigned int hash;
+  AsnNode noid;
+  int i;
+
+  if (!index)
+    return NULL;
+
+  hash = hash_oid (oidbuf, oidlen);
+  for (i = index->buckets[hash & (index->nbuckets - 1)]; i != -1;
+       i = index->entries[i].next)
+    {
+      if (index->entries[i].hash != hash)
+        continue;
+      noid = index->entries[i].noid;
+      if (noid->len == oidlen
+          && !memcmp (index->image + noid->off + noid->nhdr, oidbuf, oidlen)
+          && !idx--)
+        return noid->right;
+    }
+  return NULL;
+}
@@ -86,6 +86,18 @@ union asn_value_u {
 };
 
 
+/* An allocation arena used for all nodes, names and values of an
+   expanded tree.  The arena is released in one go along with the
+   tree.  */
+struct asn_arena_s;
+typedef struct asn_arena_s *asn_arena_t;
+
+/* An index of the type/value sequences below a node of a value tree;
+   see _ksba_asn_new_tv_index.  */
+struct asn_tv_index_s;
+typedef struct asn_tv_index_s *asn_tv_index_t;
+
+
 /*
  * Structure definition used for the node of the tree that represents
  * an ASN.1 DEFINITION.
@@ -111,12 +123,23 @@ struct asn_node_struct {
   AsnNode right;                 /* Pointer to the brother node */
   AsnNode left;                  /* Pointer to the next list element */
   AsnNode link_next;             /* to keep track of all nodes in a tree */
+  asn_arena_t arena;             /* NULL or the arena owning this node */
 };
 
+/* Type of the decoders generated by asn1-gentables.  They are called
+   with the expanded tree ROOT of their type and the IMAGELEN bytes of
+   the object at IMAGE and return 0 on success or one of the GENDEC_
+   codes from ber-gendec.h.  */
+typedef int (*gendec_fnc_t) (AsnNode root, const unsigned char *image,
+                             size_t imagelen);
+
 /* Structure to keep an entire ASN.1 parse tree and associated information */
 struct ksba_asn_tree_s {
   AsnNode parse_tree;
   AsnNode node_list;  /* for easier release of all nodes */
+  /* For the built-in modules a function to look up the generated
+     decoder for a type; NULL for parsed modules.  */
+  gendec_fnc_t (*lookup_gendec) (const char *start_name);
   char filename[1];
 };
 
@@ -129,11 +152,21 @@ typedef struct static_struct_asn {
 } static_asn;
 
 
+/* Handles for the precompiled node paths listed in asn1-paths.h.  */
+enum asn_path_id {
+#define ASN_PATH(id, start, path) ASNPATH_ ## id,
+#include "asn1-paths.h"
+#undef ASN_PATH
+  ASNPATH_DIM_
+};
+
+
 /*-- asn1-parse.y --*/
 void _ksba_asn_release_nodes (AsnNode node);
 
 
 /*-- asn1-func.c --*/
+void _ksba_asn_release_arena (asn_arena_t arena);
 void _ksba_asn_set_value (AsnNode node, enum asn_value_type vtype,
                           const void *value, size_t len);
 void _ksba_asn_set_name (AsnNode node, const char *name);
@@ -157,16 +190,27 @@ void _ksba_asn_node_dump_all (AsnNode root, FILE *fp);
 AsnNode _ksba_asn_find_type_value (const unsigned char *image,
                                    AsnNode root, int idx,
                                    const void *oidbuf, size_t oidlen);
+int _ksba_asn_new_tv_index (const unsigned char *image, AsnNode root,
+                            asn_tv_index_t *r_index);
+void _ksba_asn_release_tv_index (asn_tv_index_t index);
+AsnNode _ksba_asn_lookup_type_value (asn_tv_index_t index, int idx,
+                                     const void *oidbuf, size_t oidlen);
 
 
 int _ksba_asn_delete_structure (AsnNode root);
 
-/*-- asn2-func.c --*/
-/*(functions are all declared in ksba.h)*/
+/*-- asn1-func2.c --*/
+#ifndef BUILD_GENTOOLS
+gpg_error_t _ksba_asn_get_module (const char *mod_name,
+                                  ksba_asn_tree_t *r_tree);
+#endif
+AsnNode _ksba_asn_find_node_by_handle (AsnNode root, enum asn_path_id id);
 
 /*-- asn1-tables.c (generated) --*/
 const static_asn *_ksba_asn_lookup_table (const char *name,
                                           const char **stringtbl);
+/* For each path the number of steps followed by the child indices.  */
+extern const unsigned short *const _ksba_asn_path_table[ASNPATH_DIM_];
 
 
 
@@ -46,6 +46,7 @@
 #include "util.h"
 #include "ksba.h"
 #include "asn1-func.h"
+#include "ber-gendec.h"
 
 
 static AsnNode
@@ -210,6 +211,7 @@ ksba_asn_create_tree (const char *mod_name, ksba_asn_tree_t *result)
         {
           tree->parse_tree = pointer;
           tree->node_list = p;
+          tree->lookup_gendec = _ksba_asn_lookup_gendec;
           strcpy (tree->filename, mod_name);
           *result = tree;
           rc = 0;
@@ -223,3 +225,74 @@ ksba_asn_create_tree (const char *mod_name, ksba_asn_tree_t *result)
 
   return rc;
 }
+
+
+/* The parse trees of the built-in modules.  They are created on first
+   use and never modified or released afterwards; thus all objects of
+   the process may share them.  */
+static struct
+{
+  const char *name;
+  ksba_asn_tree_t tree;
+} module_cache[] =
+  {
+    { "tmttv2" },
+    { "cms" }
+  };
+GPGRT_LOCK_DEFINE (module_cache_lock);
+
+
+/* Return the shared parse tree for the built-in module MOD_NAME at
+   R_TREE.  The tree is read-only and owned by the library; the
+   caller must not release or modify it.  */
+gpg_error_t
+_ksba_asn_get_module (const char *mod_name, ksba_asn_tree_t *r_tree)
+{
+  gpg_error_t err = 0;
+  int i;
+
+  if (!r_tree)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_tree = NULL;
+  if (!mod_name)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  for (i=0; i < DIM (module_cache); i++)
+    if (!strcmp (module_cache[i].name, mod_name))
+      break;
+  if (!(i < DIM (module_cache)))
+    return gpg_error (GPG_ERR_MODULE_NOT_FOUND);
+
+  gpgrt_lock_lock (&module_cache_lock);
+  if (!module_cache[i].tree)
+    err = ksba_asn_create_tree (mod_name, &module_cache[i].tree);
+  *r_tree = module_cache[i].tree;
+  gpgrt_lock_unlock (&module_cache_lock);
+
+  return err;
+}
+
+
+/* Return the node at the precompiled path ID below ROOT or NULL if
+   there is no such node.  ROOT must be the root of a value tree
+   created for the start type of that path; see asn1-paths.h.  This
+   is the same as calling _ksba_asn_find_node with the path's name but
+   does not need any string compares.  */
+AsnNode
+_ksba_asn_find_node_by_handle (AsnNode root, enum asn_path_id id)
+{
+  const unsigned short *path;
+  unsigned int nsteps, idx;
+
+  if (!root || id < 0 || id >= ASNPATH_DIM_)
+    return NULL;
+
+  path = _ksba_asn_path_table[id];
+  for (nsteps = *path++; root && nsteps; nsteps--)
+    {
+      root = root->down;
+      for (idx = *path++; root && idx; idx--)
+        root = root->right;
+    }
+  return root;
+}
@@ -57,7 +57,62 @@ struct name_list_s {
 static struct name_list_s *string_table, **string_table_tail;
 static size_t string_table_offset;
 
+/* The modules we parsed; used to compile the node paths.  */
+struct module_list_s {
+  struct module_list_s *next;
+  ksba_asn_tree_t tree;
+};
+static struct module_list_s *module_list;
+
+/* The paths to compile; see asn1-paths.h.  */
+static const struct {
+  const char *id;
+  const char *start;
+  const char *path;
+} path_list[] = {
+#define ASN_PATH(id, start, path) { #id, start, path },
+#include "asn1-paths.h"
+#undef ASN_PATH
+  { NULL }
+};
+
+#define MAX_PATH_STEPS 32
+
+/* The types for which a decoder is generated; see ber-gendec.h.  */
+static const char *gendec_list[] = {
+  "TMTTv2.Certificate",
+  "CryptographicMessageSyntax.SignerInfo",
+  "TMTTv2.CertificateList.tbsCertList.issuer",
+  NULL
+};
+
+/* The functions written for the elements of a SEQUENCE OF or SET
+   OF.  */
+struct gendec_fnc_s {
+  struct gendec_fnc_s *next;
+  AsnNode node;
+  char *code;     /* Used to detect identical functions.  */
+  int id;
+};
+static struct gendec_fnc_s *gendec_fncs;
+static int gendec_nfncs;
+
+/* State while generating one decoder function.  The code is first
+   collected in a buffer because the required local variables are
+   only known at the end.  */
+static struct {
+  char *buf;
+  size_t len;
+  size_t size;
+  int nnodes;     /* Number of entries used in n[].  */
+  int depth;      /* Current index into e[].  */
+  int maxdepth;
+  int need_elem;  /* The local variable ELEM is used.  */
+  int need_rc;    /* The local variable RC is used.  */
+} gd;
+
 static void print_error (const char *fmt, ... )  ATTR_PRINTF(1,2);
+static void gd_line (int indent, const char *fmt, ... )  ATTR_PRINTF(2,3);
 
 
 static void
@@ -281,8 +336,729 @@ create_static_structure (AsnNode pointer, const char *file_name, FILE *fp)
 
 
 
+/* Translate the path PATH into the child indices used by
+   _ksba_asn_find_node_by_handle starting at the value tree ROOT.
+   Stores the indices at STEPS and returns their number or -1 on
+   error.  */
+static int
+compile_path (AsnNode root, const char *path, unsigned int *steps)
+{
+  AsnNode p;
+  const char *s;
+  size_t n;
+  int nsteps = 0;
+  unsigned int idx;
+
+  s = strchr (path, '.');
+  n = s? s - path : strlen (path);
+  if (!root->name || strlen (root->name) != n || strncmp (root->name, path, n))
+    return -1;  /* The first part must name the root.  */
+
+  for (p = root; s; )
+    {
+      s++; /* Skip the dot.  */
+      path = s;
+      s = strchr (path, '.');
+      n = s? s - path : strlen (path);
+
+      if (nsteps >= MAX_PATH_STEPS)
+        return -1;
+      if ((n == 5 && !strncmp (path, "?LAST", 5))
+          || (n == 1 && *path == '+'))
+        return -1;  /* Depends on the actual values.  */
+
+      p = p->down;
+      idx = 0;
+      if (n)
+        for (; p; p = p->right, idx++)
+          if (p->name && strlen (p->name) == n && !strncmp (p->name, path, n))
+            break;
+      if (!p)
+        return -1;
+      steps[nsteps++] = idx;
+    }
+
+  return nsteps;
+}
+
+
+/* Write the table with the compiled node paths.  */
+static void
+write_path_table (FILE *fp)
+{
+  struct module_list_s *m;
+  AsnNode root;
+  unsigned int steps[MAX_PATH_STEPS];
+  int i, j, nsteps;
+
+  for (i=0; path_list[i].id; i++)
+    {
+      root = NULL;
+      for (m = module_list; m && !root; m = m->next)
+        root = _ksba_asn_expand_tree (m->tree->parse_tree,
+                                      path_list[i].start);
+      if (!root)
+        {
+          print_error ("start type `%s' of path %s not found\n",
+                       path_list[i].start, path_list[i].id);
+          continue;
+        }
+
+      nsteps = compile_path (root, path_list[i].path, steps);
+      if (nsteps < 0)
+        {
+          print_error ("invalid path %s `%s'\n",
+                       path_list[i].id, path_list[i].path);
+          continue;
+        }
+
+      fprintf (fp, "static const unsigned short path_%s[] = { %d",
+               path_list[i].id, nsteps);
+      for (j=0; j < nsteps; j++)
+        fprintf (fp, ", %u", steps[j]);
+      fputs (" };\n", fp);
+    }
+
+  fputs ("\nconst unsigned short *const _ksba_asn_path_table[] = {\n", fp);
+  for (i=0; path_list[i].id; i++)
+    fprintf (fp, "  path_%s,\n", path_list[i].id);
+  fputs ("};\n", fp);
+}
+
+
+
+/*
+ * Generation of the DER decoders
+ */
+
+/* Append a line of code indented by INDENT blanks to the buffer.  */
+static void
+gd_line (int indent, const char *fmt, ... )
+{
+  va_list arg_ptr;
+  char line[256];
+  size_t n;
+
+  va_start (arg_ptr, fmt);
+  vsnprintf (line, sizeof line, fmt, arg_ptr);
+  va_end (arg_ptr);
+
+  n = strlen (line);
+  if (gd.len + indent + n + 2 > gd.size)
+    {
+      gd.size = gd.len + indent + n + 4096;
+      gd.buf = xrealloc (gd.buf, gd.size);
+    }
+  memset (gd.buf + gd.len, ' ', indent);
+  memcpy (gd.buf + gd.len + indent, line, n);
+  gd.len += indent + n;
+  gd.buf[gd.len++] = '\n';
+  gd.buf[gd.len] = 0;
+}
+
+
+/* Return true if NODE describes a value and is not just a helper
+   node for its parent.  */
+static int
+gd_is_field (AsnNode node)
+{
+  return !(node->type == TYPE_SIZE || node->type == TYPE_DEFAULT
+           || node->type == TYPE_CONSTANT);
+}
+
+
+static int
+gd_is_constructed (AsnNode node)
+{
+  return (node->type == TYPE_SEQUENCE || node->type == TYPE_SEQUENCE_OF
+          || node->type == TYPE_SET_OF);
+}
+
+
+/* Return the first field below NODE and store its position among all
+   children at R_POS.  */
+static AsnNode
+gd_child (AsnNode node, int *r_pos)
+{
+  AsnNode p;
+  int pos = 0;
+
+  for (p = node->down; p && !gd_is_field (p); p = p->right)
+    pos++;
+  *r_pos = pos;
+  return p;
+}
+
+
+/* Return a string with COUNT times "->right".  */
+static const char *
+gd_rights (int count)
+{
+  static char buf[200];
+  size_t n = 0;
+
+  for (; count > 0 && n + 8 < sizeof buf; count--, n += 7)
+    memcpy (buf + n, "->right", 7);
+  buf[n] = 0;
+  return buf;
+}
+
+
+/* Write code to store the child at position POS of n[PARENT] in the
+   next free entry of n[] and return the index of that entry.  */
+static int
+gd_nav (int parent, int pos, int indent)
+{
+  int idx = gd.nnodes++;
+
+  gd_line (indent, "n[%d] = n[%d]->down%s;", idx, parent, gd_rights (pos));
+  return idx;
+}
+
+
+/* Return the condition for the tag T to match NODE or NULL if every
+   tag matches.  The result is valid until the next call.  */
+static const char *
+gd_cond (AsnNode node)
+{
+  static char buf[80];
+
+  switch (node->type)
+    {
+    case TYPE_ANY:
+      return NULL;
+    case TYPE_TAG:
+      if (node->valuetype != VALTYPE_ULONG)
+        {
+          print_error ("tag of node `%s' has no value\n",
+                       node->name? node->name:"");
+          return "0";
+        }
+      snprintf (buf, sizeof buf, "t.class == %d && t.tag == %lu",
+                node->flags.class, node->value.v_ulong);
+      return buf;
+    case TYPE_SEQUENCE:
+    case TYPE_SEQUENCE_OF:
+      return "t.class == CLASS_UNIVERSAL && t.tag == TYPE_SEQUENCE";
+    case TYPE_SET_OF:
+      return "t.class == CLASS_UNIVERSAL && t.tag == TYPE_SET";
+    default:
+      snprintf (buf, sizeof buf, "t.class == CLASS_UNIVERSAL && t.tag == %d",
+                node->type);
+      return buf;
+    }
+}
+
+
+/* Return the id of the function written for the element NODE or -1
+   if there is none yet.  */
+static int
+gd_fnc_id (AsnNode node)
+{
+  struct gendec_fnc_s *f;
+
+  for (f = gendec_fncs; f; f = f->next)
+    if (f->node == node)
+      return f->id;
+  return -1;
+}
+
+static void gd_field (AsnNode node, int idx, const char *end, int indent,
+                      int required);
+static void gd_body (AsnNode node, int idx, const char *end, int indent,
+                     int is_root);
+
+
+/* Write code for the values inside of the constructed NODE at n[IDX],
+   which end at END.  */
+static void
+gd_content (AsnNode node, int idx, const char *end, int indent)
+{
+  AsnNode p;
+  int pos, last, lastpos, cidx, id;
+
+  switch (node->type)
+    {
+    case TYPE_SEQUENCE:
+      last = -1;
+      lastpos = 0;
+      for (p = node->down, pos = 0; p; p = p->right, pos++)
+        {
+          if (!gd_is_field (p))
+            continue;
+          gd_line (indent, "/* %s */", p->name? p->name : "");
+          if (last == -1)
+            cidx = gd_nav (idx, pos, indent);
+          else
+            {
+              cidx = gd.nnodes++;
+              gd_line (indent, "n[%d] = n[%d]%s;",
+                       cidx, last, gd_rights (pos - lastpos));
+            }
+          last = cidx;
+          lastpos = pos;
+          gd_field (p, cidx, end, indent,
+                    !(p->flags.is_optional || p->flags.has_default));
+        }
+      break;
+
+    case TYPE_SEQUENCE_OF:
+    case TYPE_SET_OF:
+      p = gd_child (node, &pos);
+      id = p? gd_fnc_id (p) : -1;
+      if (id == -1)
+        {
+          print_error ("no element function for `%s'\n",
+                       node->name? node->name:"");
+          break;
+        }
+      gd.need_elem = gd.need_rc = 1;
+      gd_line (indent, "elem = n[%d]->down%s;", idx, gd_rights (pos));
+      if (gd_is_constructed (p))
+        {
+          gd_line (indent, "while (pos < %s)", end);
+          gd_line (indent, "  {");
+          gd_line (indent, "    if ((rc = gendec_%d (elem, image, &pos, %s)))",
+                   id, end);
+          gd_line (indent, "      return rc;");
+          gd_line (indent, "    if (pos < %s", end);
+          gd_line (indent, "        && !(elem = _ksba_gendec_insert_copy (elem)))");
+          gd_line (indent, "      return GENDEC_ENOMEM;");
+          gd_line (indent, "  }");
+        }
+      else
+        {
+          /* The interpreter stops after the first value of a
+             primitive type.  */
+          gd_line (indent, "if (pos < %s)", end);
+          gd_line (indent, "  {");
+          gd_line (indent, "    if ((rc = gendec_%d (elem, image, &pos, %s)))",
+                   id, end);
+          gd_line (indent, "      return rc;");
+          gd_line (indent, "    if (pos != %s)", end);
+          gd_line (indent, "      return GENDEC_FALLBACK;");
+          gd_line (indent, "  }");
+        }
+      break;
+
+    default:
+      print_error ("unsupported constructed type %d of `%s'\n",
+                   node->type, node->name? node->name:"");
+      break;
+    }
+}
+
+
+/* Write code for the constructed value T at POS.  The node for the
+   TLV is n[IDX]; the content is described by CNODE at n[CIDX].  An
+   empty value is only accepted at the END of the enclosing value
+   because the interpreter otherwise tries to match the next value
+   against the content.  */
+static void
+gd_constructed (AsnNode cnode, int idx, int cidx, const char *end,
+                int indent, int is_root)
+{
+  char e[20];
+
+  if (is_root)
+    gd_line (indent, "if (!t.cons)");
+  else
+    gd_line (indent, "if (!t.cons || (!t.len && pos + t.nhdr != %s))", end);
+  gd_line (indent, "  return GENDEC_FALLBACK;");
+  gd_line (indent, "_ksba_gendec_set (n[%d], pos, &t);", idx);
+  snprintf (e, sizeof e, "e[%d]", gd.depth);
+  gd_line (indent, "%s = pos + t.nhdr + t.len;", e);
+  gd_line (indent, "pos += t.nhdr;");
+  if (++gd.depth > gd.maxdepth)
+    gd.maxdepth = gd.depth;
+  gd_content (cnode, cidx, e, indent);
+  gd.depth--;
+  gd_line (indent, "if (pos != %s)", e);
+  gd_line (indent, "  return GENDEC_FALLBACK;");
+}
+
+
+/* Write code to decode one of the alternatives of the CHOICE NODE at
+   n[IDX] from the tag T at POS.  With MARK set, the other
+   alternatives are flagged like the interpreter does.  */
+static void
+gd_choice (AsnNode node, int idx, const char *end, int indent,
+           int mark, int is_root)
+{
+  AsnNode p;
+  int aidx[32];
+  int pos, n, i, k;
+
+  for (p = node->down, pos = n = 0; p; p = p->right, pos++)
+    {
+      if (!gd_is_field (p))
+        continue;
+      if (n == DIM (aidx) || p->type == TYPE_CHOICE || p->type == TYPE_ANY)
+        {
+          print_error ("unsupported alternative `%s' of CHOICE `%s'\n",
+                       p->name? p->name:"", node->name? node->name:"");
+          return;
+        }
+      aidx[n++] = gd_nav (idx, pos, indent);
+    }
+
+  for (p = node->down, k = 0; p; p = p->right)
+    {
+      if (!gd_is_field (p))
+        continue;
+      gd_line (indent, k? "else if (%s)" : "if (%s)", gd_cond (p));
+      gd_line (indent, "  { /* %s */", p->name? p->name : "");
+      if (mark)
+        for (i=0; i < n; i++)
+          if (i != k)
+            gd_line (indent + 4, "n[%d]->flags.skip_this = 1;", aidx[i]);
+      gd_body (p, aidx[k], end, indent + 4, is_root);
+      gd_line (indent, "  }");
+      k++;
+    }
+  gd_line (indent, "else");
+  gd_line (indent, "  return GENDEC_FALLBACK;");
+}
+
+
+/* Write code to decode the tag T at POS into NODE at n[IDX].  */
+static void
+gd_body (AsnNode node, int idx, const char *end, int indent, int is_root)
+{
+  AsnNode child;
+  int pos, cidx;
+  char e[20];
+
+  if (node->type == TYPE_TAG)
+    {
+      child = gd_child (node, &pos);
+      if (!child)
+        {
+          print_error ("tag `%s' without type\n", node->name? node->name:"");
+          return;
+        }
+      cidx = gd_nav (idx, pos, indent);
+      if (!child->flags.is_implicit)
+        {
+          gd_line (indent, "if (!t.cons)");
+          gd_line (indent, "  return GENDEC_FALLBACK;");
+          gd_line (indent, "_ksba_gendec_set (n[%d], pos, &t);", idx);
+          snprintf (e, sizeof e, "e[%d]", gd.depth);
+          gd_line (indent, "%s = pos + t.nhdr + t.len;", e);
+          gd_line (indent, "pos += t.nhdr;");
+          if (++gd.depth > gd.maxdepth)
+            gd.maxdepth = gd.depth;
+          gd_field (child, cidx, e, indent, 1);
+          gd.depth--;
+          gd_line (indent, "if (pos != %s)", e);
+          gd_line (indent, "  return GENDEC_FALLBACK;");
+        }
+      else if (gd_is_constructed (child))
+        gd_constructed (child, idx, cidx, end, indent, is_root);
+      else if (_ksba_asn_is_primitive (child->type))
+        {
+          gd_line (indent, "if (t.cons)");
+          gd_line (indent, "  return GENDEC_FALLBACK;");
+          gd_line (indent, "_ksba_gendec_set (n[%d], pos, &t);", idx);
+          gd_line (indent, "pos += t.nhdr + t.len;");
+          if (node->flags.in_choice)
+            {
+              /* The interpreter does not find the end of the CHOICE
+                 after an implicitly tagged primitive.  */
+              gd_line (indent, "if (pos != %s)", end);
+              gd_line (indent, "  return GENDEC_FALLBACK;");
+            }
+        }
+      else
+        print_error ("unsupported implicit type %d of `%s'\n",
+                     child->type, node->name? node->name:"");
+    }
+  else if (gd_is_constructed (node))
+    gd_constructed (node, idx, idx, end, indent, is_root);
+  else if (node->type == TYPE_ANY)
+    {
+      gd.need_rc = 1;
+      gd_line (indent, "rc = _ksba_gendec_set_any (n[%d], image, pos, &t);", idx);
+      gd_line (indent, "pos += t.nhdr + t.len;");
+      gd_line (indent, "if (rc < 0 || (rc && pos != %s))", end);
+      gd_line (indent, "  return GENDEC_FALLBACK;");
+    }
+  else if (_ksba_asn_is_primitive (node->type))
+    {
+      gd_line (indent, "if (t.cons)");
+      gd_line (indent, "  return GENDEC_FALLBACK;");
+      gd_line (indent, "_ksba_gendec_set (n[%d], pos, &t);", idx);
+      gd_line (indent, "pos += t.nhdr + t.len;");
+    }
+  else
+    print_error ("unsupported type %d of `%s'\n",
+                 node->type, node->name? node->name:"");
+}
+
+
+/* Write code to decode the value at POS into NODE at n[IDX].  The
+   value must end not later than END.  */
+static void
+gd_field (AsnNode node, int idx, const char *end, int indent, int required)
+{
+  const char *cond;
+
+  if (node->type == TYPE_CHOICE)
+    {
+      if (!required)
+        {
+          print_error ("optional CHOICE `%s' not supported\n",
+                       node->name? node->name:"");
+          return;
+        }
+      gd_line (indent, "if (_ksba_gendec_read_tl (image, pos, %s, &t))", end);
+      gd_line (indent, "  return GENDEC_FALLBACK;");
+      gd_choice (node, idx, end, indent, 1, 0);
+      return;
+    }
+
+  cond = gd_cond (node);
+  if (required)
+    {
+      if (cond)
+        {
+          gd_line (indent, "if (_ksba_gendec_read_tl (image, pos, %s, &t)",
+                   end);
+          gd_line (indent, "    || !(%s))", cond);
+        }
+      else
+        gd_line (indent, "if (_ksba_gendec_read_tl (image, pos, %s, &t))",
+                 end);
+      gd_line (indent, "  return GENDEC_FALLBACK;");
+      gd_body (node, idx, end, indent, 0);
+    }
+  else
+    {
+      gd.need_rc = 1;
+      gd_line (indent, "if ((rc = _ksba_gendec_read_tl (image, pos, %s, &t)) < 0)",
+               end);
+      gd_line (indent, "  return GENDEC_FALLBACK;");
+      if (cond)
+        gd_line (indent, "if (!rc && %s)", cond);
+      else
+        gd_line (indent, "if (!rc)");
+      gd_line (indent, "  {");
+      gd_body (node, idx, end, indent + 4, 0);
+      gd_line (indent, "  }");
+    }
+}
+
+
+static void
+gd_reset (void)
+{
+  gd.len = 0;
+  if (gd.buf)
+    *gd.buf = 0;
+  gd.nnodes = 1;
+  gd.depth = 0;
+  gd.maxdepth = 0;
+  gd.need_elem = 0;
+  gd.need_rc = 0;
+}
+
+
+/* Return the local variables, the lines INIT and the code collected
+   in the buffer as a malloced string.  */
+static char *
+gd_finish (const char *init)
+{
+  char head[200];
+  char *result;
+
+  snprintf (head, sizeof head, "  struct gendec_tl t;\n  AsnNode n[%d];\n",
+            gd.nnodes);
+  if (gd.maxdepth)
+    snprintf (head + strlen (head), sizeof head - strlen (head),
+              "  size_t e[%d];\n", gd.maxdepth);
+  if (gd.need_elem)
+    strcat (head, "  AsnNode elem;\n");
+  strcat (head, "  size_t pos;\n");
+  if (gd.need_rc)
+    strcat (head, "  int rc;\n");
+  strcat (head, "\n");
+
+  result = xmalloc (strlen (head) + strlen (init) + gd.len + 1);
+  strcpy (result, head);
+  strcat (result, init);
+  strcat (result, gd.buf? gd.buf : "");
+  return result;
+}
+
+
+/* Return the name of the closest named ancestor of NODE.  */
+static const char *
+gd_parent_name (AsnNode node)
+{
+  do
+    {
+      while (node->left && node->left->right == node)
+        node = node->left;
+      node = node->left;
+    }
+  while (node && !node->name);
+  return node? node->name : "?";
+}
+
+
+static void gd_prepare (FILE *fp, AsnNode node, const char *start);
+
+
+/* Write the function for the element NODE of a SEQUENCE OF or SET OF
+   in the type START.  Identical functions are written only once.  */
+static void
+gd_write_fnc (FILE *fp, AsnNode node, const char *start)
+{
+  struct gendec_fnc_s *f, *f2;
+  const char *cond;
+
+  gd_prepare (fp, node, start);
+
+  gd_reset ();
+  cond = gd_cond (node);
+  if (cond)
+    {
+      gd_line (2, "if (_ksba_gendec_read_tl (image, pos, end, &t)");
+      gd_line (2, "    || !(%s))", cond);
+    }
+  else
+    gd_line (2, "if (_ksba_gendec_read_tl (image, pos, end, &t))");
+  gd_line (2, "  return GENDEC_FALLBACK;");
+  gd_body (node, 0, "end", 2, 0);
+
+  f = xmalloc (sizeof *f);
+  f->node = node;
+  f->code = gd_finish ("  pos = *r_pos;\n"
+                        "  n[0] = node;\n");
+  f->next = gendec_fncs;
+  gendec_fncs = f;
+
+  for (f2 = f->next; f2; f2 = f2->next)
+    if (!strcmp (f2->code, f->code))
+      break;
+  if (f2)
+    {
+      f->id = f2->id;
+      return;
+    }
+
+  f->id = gendec_nfncs++;
+  fprintf (fp, "\n/* Element of `%s' in %s.  */\n"
+           "static int\n"
+           "gendec_%d (AsnNode node, const unsigned char *image,\n"
+           "           size_t *r_pos, size_t end)\n"
+           "{\n"
+           "%s"
+           "  *r_pos = pos;\n"
+           "  return 0;\n"
+           "}\n",
+           gd_parent_name (node), start, f->id, f->code);
+}
+
+
+/* Write the functions for all elements of a SEQUENCE OF or SET OF
+   which are decoded by the code for NODE.  */
+static void
+gd_prepare (FILE *fp, AsnNode node, const char *start)
+{
+  AsnNode p;
+  int pos;
+
+  switch (node->type)
+    {
+    case TYPE_SEQUENCE:
+    case TYPE_CHOICE:
+      for (p = node->down; p; p = p->right)
+        if (gd_is_field (p))
+          gd_prepare (fp, p, start);
+      break;
+    case TYPE_TAG:
+      p = gd_child (node, &pos);
+      if (p)
+        gd_prepare (fp, p, start);
+      break;
+    case TYPE_SEQUENCE_OF:
+    case TYPE_SET_OF:
+      p = gd_child (node, &pos);
+      if (p && gd_fnc_id (p) == -1)
+        gd_write_fnc (fp, p, start);
+      break;
+    default:
+      break;
+    }
+}
+
+
+/* Write the decoders for the types in gendec_list and the function
+   to look them up.  */
+static void
+write_gendec_table (FILE *fp)
+{
+  struct module_list_s *m;
+  AsnNode root;
+  const char *cond;
+  char *code;
+  int i;
+
+  for (i=0; gendec_list[i]; i++)
+    {
+      root = NULL;
+      for (m = module_list; m && !root; m = m->next)
+        root = _ksba_asn_expand_tree (m->tree->parse_tree, gendec_list[i]);
+      if (!root)
+        {
+          print_error ("type `%s' for decoder not found\n", gendec_list[i]);
+          continue;
+        }
+
+      gd_prepare (fp, root, gendec_list[i]);
+
+      gd_reset ();
+      gd_line (2, "if (_ksba_gendec_read_tl (image, 0, imagelen, &t) || !t.len)");
+      gd_line (2, "  return GENDEC_FALLBACK;");
+      if (root->type == TYPE_CHOICE)
+        gd_choice (root, 0, "imagelen", 2, 0, 1);
+      else
+        {
+          cond = gd_cond (root);
+          if (cond)
+            {
+              gd_line (2, "if (!(%s))", cond);
+              gd_line (2, "  return GENDEC_FALLBACK;");
+            }
+          gd_body (root, 0, "imagelen", 2, 1);
+        }
+      code = gd_finish ("  pos = 0;\n"
+                        "  n[0] = root;\n");
+
+      fprintf (fp, "\n/* Decoder for %s.  */\n"
+               "static int\n"
+               "gendec_type_%d (AsnNode root, const unsigned char *image,"
+               " size_t imagelen)\n"
+               "{\n"
+               "%s"
+               "  return pos == imagelen? 0 : GENDEC_FALLBACK;\n"
+               "}\n",
+               gendec_list[i], i, code);
+      xfree (code);
+    }
+
+  fputs ("\n\ngendec_fnc_t\n"
+         "_ksba_asn_lookup_gendec (const char *start_name)\n"
+         "{\n", fp);
+  for (i=0; gendec_list[i]; i++)
+    fprintf (fp, "  if (!strcmp (start_name, \"%s\"))\n"
+             "    return gendec_type_%d;\n", gendec_list[i], i);
+  fputs ("  return NULL;\n}\n", fp);
+}
+
 static struct name_list_s *
-one_file (const char *fname, int *count, FILE *fp)
+one_file (const char *fname, int *count, FILE *fp, int keep)
 {
   ksba_asn_tree_t tree;
   int rc;
@@ -303,8 +1079,17 @@ one_file (const char *fname, int *count, FILE *fp)
                      "#include <string.h>\n"
                      "#include \"ksba.h\"\n"
                      "#include \"asn1-func.h\"\n"
+                     "#include \"ber-gendec.h\"\n"
                      "\n");
           ++*count;
+          if (keep)
+            {
+              struct module_list_s *m = xmalloc (sizeof *m);
+
+              m->tree = tree;
+              m->next = module_list;
+              module_list = m;
+            }
           return create_static_structure (tree->parse_tree, fname, fp);
         }
     }
@@ -346,7 +1131,7 @@ main (int argc, char **argv)
 
 
   if (!argc)
-    all_names = one_file ("-", &count, stdout);
+    all_names = one_file ("-", &count, stdout, 1);
   else
     {
       FILE *nullfp;
@@ -359,7 +1144,7 @@ main (int argc, char **argv)
           exit (2);
         }
       for (i=0; i < argc; i++)
-        one_file (argv[i], &count, nullfp);
+        one_file (argv[i], &count, nullfp, 0);
       fclose (nullfp);
 
       sort_string_table ();
@@ -367,7 +1152,7 @@ main (int argc, char **argv)
       count = 0;
       for (; argc; argc--, argv++)
         {
-          nl = one_file (*argv, &count, stdout);
+          nl = one_file (*argv, &count, stdout, 1);
           if (nl)
             {
               nl->next = all_names;
@@ -392,6 +1177,14 @@ main (int argc, char **argv)
         printf ("  if (!strcmp (name, \"%s\"))\n"
                 "    return %s_asn1_tab;\n", nl->name, nl->name);
       printf ("\n  return NULL;\n}\n");
+
+      /* Write the precompiled node paths.  */
+      putchar ('\n');
+      write_path_table (stdout);
+
+      /* Write the generated decoders.  */
+      putchar ('\n');
+      write_gendec_table (stdout);
     }
 
   return error_counter? 1:0;
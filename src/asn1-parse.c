@@ -2850,6 +2850,7 @@ ksba_asn_parse_file (const char *file_name, ksba_asn_tree_t *result, int debug)
       tree = xmalloc ( sizeof *tree + (file_name? strlen (file_name):1) );
       tree->parse_tree = parsectl.parse_tree;
       tree->node_list = parsectl.all_nodes;
+      tree->lookup_gendec = NULL;
       strcpy (tree->filename, file_name? file_name:"-");
       *result = tree;
     }
@@ -2873,7 +2874,9 @@ ksba_asn_tree_release (ksba_asn_tree_t tree)
 void
 _ksba_asn_release_nodes (AsnNode node)
 {
-  /* FIXME: it does not work yet because the allocation function in
-     asn1-func.c does not link all nodes together */
-  release_all_nodes (node);
+  /* The nodes of expanded trees are allocated from an arena.  */
+  if (node && node->arena)
+    _ksba_asn_release_arena (node->arena);
+  else
+    release_all_nodes (node);
 }
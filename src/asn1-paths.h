@@ -0,0 +1,71 @@
+/* asn1-paths.h - Node paths precompiled by asn1-gentables
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file is included several times with different definitions of
+   ASN_PATH and thus has no include guard.  Each entry is
+
+     ASN_PATH (ID, START, PATH)
+
+   where START is the "Module.Type" name used to create the value
+   tree and PATH is a name as used with _ksba_asn_find_node on the
+   root of that tree.  The special parts "?LAST" and "+" may not be
+   used.  asn1-gentables translates PATH into a sequence of child
+   indices which is used by _ksba_asn_find_node_by_handle with the
+   handle ASNPATH_ID.  */
+
+/* Certificates.  */
+ASN_PATH (CERT,               "TMTTv2.Certificate",
+          "Certificate")
+ASN_PATH (CERT_TBS,           "TMTTv2.Certificate",
+          "Certificate.tbsCertificate")
+ASN_PATH (CERT_SERIAL,        "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.serialNumber")
+ASN_PATH (CERT_ISSUER,        "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.issuer")
+ASN_PATH (CERT_SUBJECT,       "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.subject")
+ASN_PATH (CERT_NOTBEFORE,     "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.validity.notBefore")
+ASN_PATH (CERT_NOTAFTER,      "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.validity.notAfter")
+ASN_PATH (CERT_PUBKEYINFO,    "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.subjectPublicKeyInfo")
+ASN_PATH (CERT_EXTENSIONS,    "TMTTv2.Certificate",
+          "Certificate.tbsCertificate.extensions..")
+ASN_PATH (CERT_SIGALGO,       "TMTTv2.Certificate",
+          "Certificate.signatureAlgorithm")
+
+/* CMS signer infos.  */
+ASN_PATH (SI_DIGESTALGO,      "CryptographicMessageSyntax.SignerInfo",
+          "SignerInfo.digestAlgorithm.algorithm")
+ASN_PATH (SI_SIGNEDATTRS,     "CryptographicMessageSyntax.SignerInfo",
+          "SignerInfo.signedAttrs")
+ASN_PATH (SI_SIGALGO,         "CryptographicMessageSyntax.SignerInfo",
+          "SignerInfo.signatureAlgorithm")
@@ -39,6 +39,8 @@
 #include "ksba.h"
 #include "asn1-func.h"
 #include "ber-decoder.h"
+#include "ber-gendec.h"
+#include "reader.h"
 #include "ber-help.h"
 
 
@@ -73,6 +75,7 @@ typedef struct decoder_state_s *DECODER_STATE;
 struct ber_decoder_s
 {
   AsnNode module;    /* the ASN.1 structure */
+  gendec_fnc_t (*lookup_gendec) (const char *); /* from the module */
   ksba_reader_t reader;
   const char *last_errdesc; /* string with the error description */
   int non_der;    /* set if the encoding is not DER conform */
@@ -101,6 +104,9 @@ struct ber_decoder_s
     unsigned char *buf;
     size_t used;
     size_t length;
+    int borrowed;  /* BUF points into the reader's memory.  */
+    const unsigned char *base;  /* Start of the borrowed memory.  */
+    size_t avail;               /* Bytes available at BASE.  */
   } image;
   struct
   {
@@ -140,6 +146,13 @@ new_decoder_state (void)
 
   ds = xmalloc (sizeof (*ds) + 99*sizeof(DECODER_STATE_ITEM));
   ds->stacksize = 100;
+  return ds;
+}
+
+/* Prepare DS for a new decoder run.  */
+static void
+reset_decoder_state (DECODER_STATE ds)
+{
   ds->idx = 0;
   ds->cur.node = NULL;
   ds->cur.went_up = 0;
@@ -150,7 +163,6 @@ new_decoder_state (void)
   ds->cur.length = 0;
   ds->cur.ndef_length = 1;
   ds->cur.nread = 0;
-  return ds;
 }
 
 static void
@@ -339,11 +351,44 @@ fixup_type_any (AsnNode node)
 }
 
 
+/* Append a copy of the array element NODE for the generated decoders
+   exactly like match_der does when reiterating a SEQUENCE OF.  */
+AsnNode
+_ksba_gendec_insert_copy (AsnNode node)
+{
+  node = _ksba_asn_insert_copy (node);
+  if (node)
+    prepare_copied_tree (node);
+  return node;
+}
+
+
 
+/* Released decoders are kept here along with their state stack so
+   that parsing many objects does not need to allocate them again.  */
+#define DECODER_POOL_SIZE 8
+static BerDecoder decoder_pool[DECODER_POOL_SIZE];
+static int decoder_pool_used;
+GPGRT_LOCK_DEFINE (decoder_pool_lock);
+
+
 BerDecoder
 _ksba_ber_decoder_new (void)
 {
-  BerDecoder d;
+  BerDecoder d = NULL;
+  DECODER_STATE ds;
+
+  gpgrt_lock_lock (&decoder_pool_lock);
+  if (decoder_pool_used)
+    d = decoder_pool[--decoder_pool_used];
+  gpgrt_lock_unlock (&decoder_pool_lock);
+  if (d)
+    {
+      ds = d->ds;
+      memset (d, 0, sizeof *d);
+      d->ds = ds;
+      return d;
+    }
 
   d = xtrycalloc (1, sizeof *d);
   if (!d)
@@ -355,7 +400,21 @@ _ksba_ber_decoder_new (void)
 void
 _ksba_ber_decoder_release (BerDecoder d)
 {
-  xfree (d);
+  if (!d)
+    return;
+
+  gpgrt_lock_lock (&decoder_pool_lock);
+  if (decoder_pool_used < DECODER_POOL_SIZE)
+    {
+      decoder_pool[decoder_pool_used++] = d;
+      d = NULL;
+    }
+  gpgrt_lock_unlock (&decoder_pool_lock);
+  if (d)
+    {
+      release_decoder_state (d->ds);
+      xfree (d);
+    }
 }
 
 /**
@@ -378,6 +437,7 @@ _ksba_ber_decoder_set_module (BerDecoder d, ksba_asn_tree_t module)
     return gpg_error (GPG_ERR_CONFLICT); /* module already set */
 
   d->module = module->parse_tree;
+  d->lookup_gendec = module->lookup_gendec;
   return 0;
 }
 
@@ -403,14 +463,7 @@ _ksba_ber_decoder_set_reader (BerDecoder d, ksba_reader_t r)
 static int
 read_byte (ksba_reader_t reader)
 {
-  unsigned char buf;
-  size_t nread;
-  int rc;
-
-  do
-    rc = ksba_reader_read (reader, &buf, 1, &nread);
-  while (!rc && !nread);
-  return rc? -1: buf;
+  return _ksba_reader_read_byte (reader);
 }
 
 /* Read COUNT bytes into buffer.  BUFFER may be NULL to skip over
@@ -430,19 +483,8 @@ read_buffer (ksba_reader_t reader, char *buffer, size_t count)
           count -= nread;
         }
     }
-  else
-    {
-      char dummy[256];
-      size_t n;
-
-      while (count)
-        {
-          n = count > DIM(dummy) ? DIM(dummy): count;
-          if (ksba_reader_read (reader, dummy, n, &nread))
-            return -1;
-          count -= nread;
-        }
-    }
+  else if (_ksba_reader_skip (reader, count))
+    return -1;
   return 0;
 }
 
@@ -792,7 +834,10 @@ match_der (AsnNode root, const struct tag_info *ti,
 static gpg_error_t
 decoder_init (BerDecoder d, const char *start_name)
 {
-  d->ds = new_decoder_state ();
+  /* The state stack is kept with the decoder for the next run.  */
+  if (!d->ds)
+    d->ds = new_decoder_state ();
+  reset_decoder_state (d->ds);
 
   d->root = _ksba_asn_expand_tree (d->module, start_name);
   clear_help_flags (d->root);
@@ -805,8 +850,6 @@ decoder_init (BerDecoder d, const char *start_name)
 static void
 decoder_deinit (BerDecoder d)
 {
-  release_decoder_state (d->ds);
-  d->ds = NULL;
   d->val.node = NULL;
   if (d->debug)
     fprintf (stderr, "DECODER_DEINIT\n");
@@ -891,15 +934,37 @@ decoder_next (BerDecoder d)
             return gpg_error (GPG_ERR_BAD_BER);
           if (d->image.length > MAX_IMAGE_LENGTH)
             return gpg_error (GPG_ERR_TOO_LARGE);
-          d->image.buf = xtrycalloc (1, d->image.length);
-          if (!d->image.buf)
-            return gpg_error (GPG_ERR_ENOMEM);
+          if (d->image.borrowed)
+            {
+              /* The image is the caller's memory; limit it to what is
+               * actually there so that all range checks against the
+               * image length also keep us inside that memory.  */
+              if (d->image.length > d->image.avail)
+                d->image.length = d->image.avail;
+              d->image.buf = (unsigned char *)d->image.base;
+            }
+          else
+            {
+              d->image.buf = xtrycalloc (1, d->image.length);
+              if (!d->image.buf)
+                return gpg_error (GPG_ERR_ENOMEM);
+            }
         }
 
-      if (sum_a1_a2_ge_b (ti.nhdr, d->image.used, d->image.length))
-        return set_error (d, NULL, "image buffer too short to store the tag");
-
-      memcpy (d->image.buf + d->image.used, ti.buf, ti.nhdr);
+      if (d->image.borrowed)
+        {
+          /* The tag is already in place.  */
+          if (sum_a1_a2_gt_b (ti.nhdr, d->image.used, d->image.length))
+            return set_error (d, NULL,
+                              "image buffer too short to store the tag");
+        }
+      else
+        {
+          if (sum_a1_a2_ge_b (ti.nhdr, d->image.used, d->image.length))
+            return set_error (d, NULL,
+                              "image buffer too short to store the tag");
+          memcpy (d->image.buf + d->image.used, ti.buf, ti.nhdr);
+        }
       d->image.used += ti.nhdr;
     }
 
@@ -1108,6 +1173,7 @@ _ksba_ber_decoder_dump (BerDecoder d, FILE *fp)
 #endif
   d->use_image = 0;
   d->image.buf = NULL;
+  d->image.borrowed = 0;
   err = decoder_init (d, NULL);
   if (err)
     return err;
@@ -1199,6 +1265,188 @@ _ksba_ber_decoder_dump (BerDecoder d, FILE *fp)
 
 
 
+/* Read the next TLV from the reader of D into a newly allocated
+   buffer.  On success the buffer is stored at R_IMAGE and the length
+   of the TLV at R_LEN.  If the TLV is not of a form the generated
+   decoders can handle or is not completely available, all read bytes
+   are pushed back and GPG_ERR_NO_DATA is returned.  */
+static gpg_error_t
+gendec_read_image (BerDecoder d, unsigned char **r_image, size_t *r_len)
+{
+  ksba_reader_t r = d->reader;
+  unsigned char hdr[5];
+  unsigned char *image;
+  struct gendec_tl t;
+  size_t nhdr, len, need, got, nread;
+  int c;
+
+  *r_image = NULL;
+  *r_len = 0;
+
+  for (nhdr=0, need=2; nhdr < need; nhdr++)
+    {
+      if ((c = read_byte (r)) == -1)
+        goto leave;
+      hdr[nhdr] = c;
+      if (nhdr == 1 && (c & 0x80))
+        {
+          need += c & 0x7f;
+          if (need > DIM (hdr))
+            {
+              nhdr++;
+              goto leave;
+            }
+        }
+    }
+  /* Pass the largest length we are able to handle as end so that
+     only the encoding of the header is checked.  */
+  if (_ksba_gendec_read_tl (hdr, 0, nhdr + MAX_IMAGE_LENGTH, &t) || !t.len)
+    goto leave;
+
+  len = nhdr + t.len;
+  image = xtrymalloc (len);
+  if (!image)
+    {
+      ksba_reader_unread (r, hdr, nhdr);
+      return gpg_error_from_syserror ();
+    }
+  memcpy (image, hdr, nhdr);
+  for (got = nhdr; got < len; got += nread)
+    if (ksba_reader_read (r, (char*)image + got, len - got, &nread))
+      {
+        /* Premature EOF or read error; let the interpreter report
+           it.  */
+        ksba_reader_unread (r, image, got);
+        xfree (image);
+        return gpg_error (GPG_ERR_NO_DATA);
+      }
+  *r_image = image;
+  *r_len = len;
+  return 0;
+
+ leave:
+  if (nhdr)
+    ksba_reader_unread (r, hdr, nhdr);
+  return gpg_error (GPG_ERR_NO_DATA);
+}
+
+
+/* Try to decode the object at the current position of D's reader
+   using the generated decoder FNC for START_NAME.  On success the
+   root of the value tree, the image and its length are stored at the
+   provided addresses.  Returns GPG_ERR_NO_DATA with nothing consumed
+   from the reader if the interpreter needs to be used.  */
+static gpg_error_t
+gendec_decode (BerDecoder d, gendec_fnc_t fnc, const char *start_name,
+               unsigned int flags, AsnNode *r_root,
+               unsigned char **r_image, size_t *r_imagelen)
+{
+  gpg_error_t err;
+  int borrowed = !!(flags & BER_DECODER_FLAG_BORROW_IMAGE);
+  const unsigned char *base;
+  unsigned char *image;
+  struct gendec_tl t;
+  struct tag_info ti;
+  unsigned char tail[32];  /* End tags read after the object.  */
+  size_t ntail = 0;
+  size_t avail, len;
+  AsnNode root;
+  int rc, is_endtag;
+
+  if (borrowed)
+    {
+      base = _ksba_reader_borrow_mem (d->reader, &avail);
+      if (!base || _ksba_gendec_read_tl (base, 0, avail, &t) || !t.len)
+        return gpg_error (GPG_ERR_NO_DATA);
+      image = (unsigned char *)base;
+      len = t.nhdr + t.len;
+    }
+  else
+    {
+      err = gendec_read_image (d, &image, &len);
+      if (err)
+        return err;
+    }
+
+  root = _ksba_asn_expand_tree (d->module, start_name);
+  if (!root)
+    rc = GENDEC_FALLBACK;
+  else
+    {
+      clear_help_flags (root);
+      rc = fnc (root, image, len);
+    }
+  if (rc)
+    {
+      _ksba_asn_release_nodes (root);
+      if (rc == GENDEC_ENOMEM)
+        err = gpg_error (GPG_ERR_ENOMEM);
+      else if (borrowed)
+        return gpg_error (GPG_ERR_NO_DATA);
+      else
+        err = ksba_reader_unread (d->reader, image, len);
+      xfree (image);
+      return err? err : gpg_error (GPG_ERR_NO_DATA);
+    }
+  if (borrowed)
+    _ksba_reader_skip (d->reader, len);
+
+  /* Unless asked to stop, the interpreter reads the header following
+     the object before it notices that it is done.  On the way it
+     swallows end tags and some trailing garbage.  Do the same but
+     leave everything else to the interpreter.  */
+  if (!(flags & BER_DECODER_FLAG_FAST_STOP))
+    {
+      for (;;)
+        {
+          err = _ksba_ber_read_tl (d->reader, &ti);
+          if (gpg_err_code (err) == GPG_ERR_EOF
+              || (gpg_err_code (err) == GPG_ERR_BAD_BER
+                  && ti.err_string && !strcmp (ti.err_string, "premature EOF")))
+            {
+              err = 0;
+              break;
+            }
+          if (err)
+            break;
+          is_endtag = (ti.class == CLASS_UNIVERSAL && !ti.tag);
+          if (!is_endtag && !ntail)
+            {
+              err = ksba_reader_unread (d->reader, ti.buf, ti.nhdr);
+              break;
+            }
+          if (!is_endtag || ntail + ti.nhdr > sizeof tail)
+            {
+              _ksba_asn_release_nodes (root);
+              err = ksba_reader_unread (d->reader, ti.buf, ti.nhdr);
+              if (!err)
+                err = ksba_reader_unread (d->reader, tail, ntail);
+              if (!err)
+                err = ksba_reader_unread (d->reader, image, len);
+              if (!borrowed)
+                xfree (image);
+              return err? err : gpg_error (GPG_ERR_NO_DATA);
+            }
+          memcpy (tail + ntail, ti.buf, ti.nhdr);
+          ntail += ti.nhdr;
+        }
+      if (err)
+        {
+          _ksba_asn_release_nodes (root);
+          if (!borrowed)
+            xfree (image);
+          return err;
+        }
+    }
+
+  fixup_type_any (root);
+  *r_root = root;
+  *r_image = image;
+  *r_imagelen = len;
+  return 0;
+}
+
+
 gpg_error_t
 _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
                           unsigned int flags,
@@ -1210,6 +1458,11 @@ _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
   unsigned char *buf = NULL;
   size_t buflen = 0;
   unsigned long startoff;
+  gendec_fnc_t fnc;
+  int no_gendec;
+#ifdef HAVE_GETENV
+  const char *s;
+#endif
 
   if (!d)
     return gpg_error (GPG_ERR_INV_VALUE);
@@ -1219,14 +1472,37 @@ _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
 
 #ifdef HAVE_GETENV
   d->debug = !!getenv("KSBA_DEBUG_BER_DECODER");
+  s = getenv ("KSBA_NO_GENERATED_DECODER");
+  no_gendec = s && *s;
 #else
   d->debug = 0;
+  no_gendec = 0;
 #endif
+
+  /* For some types we have generated decoders which are much faster
+     than the interpreter below.  They are not used for debugging and
+     can be disabled with an envvar to compare the results.  */
+  if (r_root && !d->debug && !no_gendec && d->lookup_gendec
+      && (fnc = d->lookup_gendec (start_name)))
+    {
+      err = gendec_decode (d, fnc, start_name, flags,
+                           r_root, r_image, r_imagelen);
+      if (gpg_err_code (err) != GPG_ERR_NO_DATA)
+        return err;
+    }
   d->honor_module_end = 1;
   d->use_image = 1;
   d->image.buf = NULL;
+  d->image.borrowed = !!(flags & BER_DECODER_FLAG_BORROW_IMAGE);
   d->fast_stop = !!(flags & BER_DECODER_FLAG_FAST_STOP);
 
+  if (d->image.borrowed)
+    {
+      d->image.base = _ksba_reader_borrow_mem (d->reader, &d->image.avail);
+      if (!d->image.base)
+        return gpg_error (GPG_ERR_INV_STATE);
+    }
+
   startoff = ksba_reader_tell (d->reader);
 
   err = decoder_init (d, start_name);
@@ -1252,6 +1528,14 @@ _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
             }
           if (sum_a1_a2_gt_b (d->image.used, d->val.length, d->image.length))
             err = set_error(d, NULL, "TLV length too large");
+          else if (d->val.primitive && d->image.borrowed)
+            {
+              /* The value is already in place; just advance.  */
+              if (_ksba_reader_skip (d->reader, d->val.length))
+                err = eof_or_error (d, 1);
+              else
+                d->image.used += d->val.length;
+            }
           else if (d->val.primitive)
             {
               if( read_buffer (d->reader,
@@ -1315,7 +1599,7 @@ _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
   if (gpg_err_code (err) == GPG_ERR_EOF)
     err = 0;
 
-  if (err)
+  if (err && !d->image.borrowed)
     xfree (d->image.buf);
 
   if (r_root && !err)
@@ -1339,6 +1623,12 @@ _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
           _ksba_asn_node_dump_all (*r_root, stderr);
         }
     }
+  else if (err)
+    {
+      /* Don't leak the partly filled tree of a broken object.  */
+      _ksba_asn_release_nodes (d->root);
+      d->root = NULL;
+    }
 
   decoder_deinit (d);
   xfree (buf);
@@ -50,6 +50,9 @@ gpg_error_t _ksba_ber_decoder_decode (BerDecoder d, const char *start_name,
                                       size_t *r_imagelen);
 
 #define BER_DECODER_FLAG_FAST_STOP 1
+/* Do not copy the image but return a pointer into the memory of the
+   reader, which must have been set up with ksba_reader_set_mem_nocopy.  */
+#define BER_DECODER_FLAG_BORROW_IMAGE 2
 
 
 #endif /*BER_DECODER_H*/
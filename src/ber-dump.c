@@ -27,6 +27,7 @@
 #include "visibility.h"
 #include "ksba.h"
 #include "ber-decoder.h"
+#include "der-scan.h"
 
 #define PGMNAME "ber-dump"
 
@@ -108,10 +109,54 @@ one_file (FILE *fp, const char *fname, ksba_asn_tree_t asn_tree)
 }
 
 
+/* Check the tag/length framing of the objects in FP.  */
+static void
+check_file (FILE *fp, const char *fname, int strict)
+{
+  gpg_error_t err;
+  unsigned char *buffer = NULL;
+  size_t buflen = 0, bufsize = 0, n;
+  size_t erroff;
+
+  do
+    {
+      if (buflen == bufsize)
+        {
+          bufsize += 65536;
+          buffer = realloc (buffer, bufsize);
+          if (!buffer)
+            fatal ("out of core\n");
+        }
+      n = fread (buffer + buflen, 1, bufsize - buflen, fp);
+      buflen += n;
+    }
+  while (n);
+  if (ferror (fp))
+    {
+      print_error ("error reading `%s': %s\n", fname, strerror (errno));
+      free (buffer);
+      return;
+    }
+
+  err = _ksba_der_validate (buffer, buflen, strict? DER_SCAN_STRICT : 0,
+                            &erroff);
+  if (err)
+    {
+      print_error ("`%s' at offset %lu: %s\n",
+                   fname, (unsigned long)erroff, gpg_strerror (err));
+      free (buffer);
+      return;
+    }
+  printf ("`%s': okay\n", fname);
+  free (buffer);
+}
+
+
 static void
 usage (int exitcode)
 {
-  fputs ("usage: ber-dump [--module asnfile] [files]\n", stderr);
+  fputs ("usage: ber-dump [--module asnfile] [files]\n"
+         "       ber-dump --check [--strict] [files]\n", stderr);
   exit (exitcode);
 }
 
@@ -120,6 +165,7 @@ main (int argc, char **argv)
 {
   const char *asnfile = NULL;
   ksba_asn_tree_t asn_tree = NULL;
+  int check = 0, strict = 0;
   int rc;
 
   if (!argc || (argc > 1 &&
@@ -127,7 +173,17 @@ main (int argc, char **argv)
     usage (0);
 
   argc--; argv++;
-  if (argc && !strcmp (*argv,"--module"))
+  if (argc && !strcmp (*argv,"--check"))
+    {
+      argc--; argv++;
+      check = 1;
+      if (argc && !strcmp (*argv,"--strict"))
+        {
+          argc--; argv++;
+          strict = 1;
+        }
+    }
+  else if (argc && !strcmp (*argv,"--module"))
     {
       argc--; argv++;
       if (!argc)
@@ -147,7 +203,9 @@ main (int argc, char **argv)
     }
 
 
-  if (!argc)
+  if (!argc && check)
+    check_file (stdin, "-", strict);
+  else if (!argc)
     one_file (stdin, "-", asn_tree);
   else
     {
@@ -160,7 +218,10 @@ main (int argc, char **argv)
               print_error ("can't open `%s': %s\n", *argv, strerror (errno));
           else
             {
-              one_file (fp, *argv, asn_tree);
+              if (check)
+                check_file (fp, *argv, strict);
+              else
+                one_file (fp, *argv, asn_tree);
               fclose (fp);
             }
         }
@@ -0,0 +1,172 @@
+/* ber-gendec.h - Support for the generated DER decoders
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For a few often used types asn1-gentables writes a decoder to
+   asn1-tables.c which walks the expanded tree of the type in lockstep
+   with a complete DER encoded image and fills in the nodes exactly
+   like the interpreter in ber-decoder.c does.  These decoders accept
+   only a strict subset of DER; for everything else, including the
+   odd cases where the interpreter would not consume the entire
+   object, they return GENDEC_FALLBACK and the interpreter is used.  */
+
+#ifndef BER_GENDEC_H
+#define BER_GENDEC_H 1
+
+#include "asn1-func.h"
+
+#define GENDEC_FALLBACK  (-1)  /* Use the interpreter.  */
+#define GENDEC_ENOMEM    (-2)  /* Out of core.  */
+
+/* A parsed tag and length.  */
+struct gendec_tl
+{
+  int class;
+  int cons;            /* Constructed encoding.  */
+  unsigned long tag;
+  size_t nhdr;
+  size_t len;
+};
+
+
+/* Parse the tag and length at offset POS of IMAGE into T; the TLV
+   must end not later than END.  Returns 0 on success, 1 if POS is
+   END, and GENDEC_FALLBACK for anything but a minimal DER encoding
+   with a low tag number and a definite length.  End tags are also
+   left to the interpreter.  */
+static inline int
+_ksba_gendec_read_tl (const unsigned char *image, size_t pos, size_t end,
+                      struct gendec_tl *t)
+{
+  const unsigned char *p = image + pos;
+  size_t avail = end - pos;
+  size_t len;
+  int c, n;
+
+  if (!avail)
+    return 1;
+
+  c = *p;
+  t->class = (c & 0xc0) >> 6;
+  t->cons = !!(c & 0x20);
+  t->tag = c & 0x1f;
+  if (t->tag == 0x1f || (t->class == CLASS_UNIVERSAL && !t->tag))
+    return GENDEC_FALLBACK;
+
+  if (avail < 2)
+    return GENDEC_FALLBACK;
+  c = p[1];
+  if (!(c & 0x80))
+    {
+      len = c;
+      t->nhdr = 2;
+    }
+  else
+    {
+      n = c & 0x7f;
+      if (!n || n > 3 || avail < 2 + n || !p[2])
+        return GENDEC_FALLBACK;
+      for (len = 0, c = 0; c < n; c++)
+        len = (len << 8) | p[2+c];
+      if (len < 128)
+        return GENDEC_FALLBACK;
+      t->nhdr = 2 + n;
+    }
+  if (len > avail - t->nhdr)
+    return GENDEC_FALLBACK;
+  t->len = len;
+  return 0;
+}
+
+
+/* Store the TLV T at offset POS in NODE.  */
+static inline void
+_ksba_gendec_set (AsnNode node, size_t pos, const struct gendec_tl *t)
+{
+  node->off = pos;
+  node->nhdr = t->nhdr;
+  node->len = t->len;
+}
+
+
+/* Check that the LEN bytes at IMAGE are a sequence of TLVs as
+   accepted by _ksba_gendec_read_tl.  Constructed values are checked
+   recursively and may not be empty.  Returns 0 or GENDEC_FALLBACK.  */
+static inline int
+_ksba_gendec_check_nested (const unsigned char *image, size_t len, int depth)
+{
+  struct gendec_tl t;
+  size_t pos;
+
+  if (depth > 20)
+    return GENDEC_FALLBACK;
+  for (pos = 0; pos < len; pos += t.nhdr + t.len)
+    {
+      if (_ksba_gendec_read_tl (image, pos, len, &t))
+        return GENDEC_FALLBACK;
+      if (t.cons
+          && (!t.len || _ksba_gendec_check_nested (image + pos + t.nhdr,
+                                                   t.len, depth + 1)))
+        return GENDEC_FALLBACK;
+    }
+  return 0;
+}
+
+
+/* Store the TLV T at offset POS of IMAGE in the ANY node NODE.
+   Returns 0 if the value may be followed by other values, 1 if the
+   interpreter would ignore all following values of the same
+   constructed type and GENDEC_FALLBACK if the value is not DER.  The
+   interpreter parses the content of a constructed value; thus it
+   needs to be checked as well.  */
+static inline int
+_ksba_gendec_set_any (AsnNode node, const unsigned char *image, size_t pos,
+                      const struct gendec_tl *t)
+{
+  _ksba_gendec_set (node, pos, t);
+  node->actual_type = t->tag;
+  if (t->class == CLASS_UNIVERSAL && _ksba_asn_is_primitive (t->tag))
+    return t->cons? GENDEC_FALLBACK : 0;
+  if (!t->cons)
+    return t->class == CLASS_UNIVERSAL;
+  if (!t->len
+      || _ksba_gendec_check_nested (image + pos + t->nhdr, t->len, 0))
+    return GENDEC_FALLBACK;
+  return 1;
+}
+
+
+/*-- ber-decoder.c --*/
+AsnNode _ksba_gendec_insert_copy (AsnNode node);
+
+/*-- asn1-tables.c --*/
+gendec_fnc_t _ksba_asn_lookup_gendec (const char *start_name);
+
+
+#endif /*BER_GENDEC_H*/
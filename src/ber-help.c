@@ -38,6 +38,7 @@
 #include "asn1-func.h" /* need some constants */
 #include "convert.h"
 #include "ber-help.h"
+#include "reader.h"
 
 /* Fixme: The parser functions should check that primitive types don't
    have the constructed bit set (which is not allowed).  This saves us
@@ -46,14 +47,7 @@
 static int
 read_byte (ksba_reader_t reader)
 {
-  unsigned char buf;
-  size_t nread;
-  int rc;
-
-  do
-    rc = ksba_reader_read (reader, &buf, 1, &nread);
-  while (!rc && !nread);
-  return rc? -1: buf;
+  return _ksba_reader_read_byte (reader);
 }
 
 
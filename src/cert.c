@@ -42,19 +42,27 @@
 #include "keyinfo.h"
 #include "sexp-parse.h"
 #include "cert.h"
+#include "reader.h"
+#include "workpool.h"
 
 
-static const char oidstr_subjectKeyIdentifier[] = "2.5.29.14";
-static const char oidstr_keyUsage[]         = "2.5.29.15";
-static const char oidstr_subjectAltName[]   = "2.5.29.17";
-static const char oidstr_issuerAltName[]    = "2.5.29.18";
-static const char oidstr_basicConstraints[] = "2.5.29.19";
-static const char oidstr_crlDistributionPoints[] = "2.5.29.31";
-static const char oidstr_certificatePolicies[] = "2.5.29.32";
-static const char oidstr_authorityKeyIdentifier[] = "2.5.29.35";
-static const char oidstr_extKeyUsage[] = "2.5.29.37";
-static const char oidstr_authorityInfoAccess[] = "1.3.6.1.5.5.7.1.1";
-static const char oidstr_subjectInfoAccess[]   = "1.3.6.1.5.5.7.1.11";
+static gpg_error_t get_extensions (ksba_cert_t cert);
+
+
+/* Certificates may be shared between threads.  The caches below are
+   filled on first use by the thread holding the lock selected by the
+   address of the certificate and published with an atomic store of a
+   pointer or a valid flag; readers check that with an atomic load and
+   don't need to take the lock.  */
+static gpgrt_lock_t cache_locks[8] =
+  {
+    GPGRT_LOCK_INITIALIZER, GPGRT_LOCK_INITIALIZER,
+    GPGRT_LOCK_INITIALIZER, GPGRT_LOCK_INITIALIZER,
+    GPGRT_LOCK_INITIALIZER, GPGRT_LOCK_INITIALIZER,
+    GPGRT_LOCK_INITIALIZER, GPGRT_LOCK_INITIALIZER
+  };
+#define cache_lock(c) \
+  (cache_locks + ((size_t)(c) / sizeof (struct ksba_cert_s)) % DIM (cache_locks))
 
 
 /**
@@ -83,30 +91,15 @@ ksba_cert_ref (ksba_cert_t cert)
   if (!cert)
     fprintf (stderr, "BUG: ksba_cert_ref for NULL\n");
   else
-    ++cert->ref_count;
+    atomic_inc_int (&cert->ref_count);
 }
 
-/**
- * ksba_cert_release:
- * @cert: A certificate object
- *
- * Release a certificate object.
- **/
-void
-ksba_cert_release (ksba_cert_t cert)
+/* Release everything CERT has learned about its certificate.  */
+static void
+release_content (ksba_cert_t cert)
 {
   int i;
 
-  if (!cert)
-    return;
-  if (cert->ref_count < 1)
-    {
-      fprintf (stderr, "BUG: trying to release an already released cert\n");
-      return;
-    }
-  if (--cert->ref_count)
-    return;
-
   if (cert->udata)
     {
       struct cert_user_data *ud = cert->udata;
@@ -123,6 +116,14 @@ ksba_cert_release (ksba_cert_t cert)
     }
 
   xfree (cert->cache.digest_algo);
+  xfree (cert->cache.issuer_dn);
+  xfree (cert->cache.subject_dn);
+  while (cert->cache.digests)
+    {
+      struct cert_digest_s *dg = cert->cache.digests->next;
+      xfree (cert->cache.digests);
+      cert->cache.digests = dg;
+    }
   if (cert->cache.extns_valid)
     {
       for (i=0; i < cert->cache.n_extns; i++)
@@ -131,14 +132,69 @@ ksba_cert_release (ksba_cert_t cert)
     }
 
   _ksba_asn_release_nodes (cert->root);
-  ksba_asn_tree_release (cert->asn_tree);
 
-  xfree (cert->image);
+  if (!cert->image_borrowed)
+    xfree (cert->image);
+}
+
 
+/**
+ * ksba_cert_release:
+ * @cert: A certificate object
+ *
+ * Release a certificate object.
+ **/
+void
+ksba_cert_release (ksba_cert_t cert)
+{
+  if (!cert)
+    return;
+  if (atomic_load_int (&cert->ref_count) < 1)
+    {
+      fprintf (stderr, "BUG: trying to release an already released cert\n");
+      return;
+    }
+  if (atomic_dec_int (&cert->ref_count))
+    return;
+
+  release_content (cert);
+  ksba_reader_release (cert->mem_reader);
   xfree (cert);
 }
 
 
+/**
+ * ksba_cert_reset:
+ * @cert: A certificate object
+ *
+ * Put the certificate object back into the state it had after
+ * ksba_cert_new so that another certificate can be read into it.
+ * This also removes all user data.  Helper objects are kept for
+ * reuse; thus a loop which resets and refills the same object does
+ * not allocate them again.  The object may not be shared with
+ * ksba_cert_ref.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_cert_reset (ksba_cert_t cert)
+{
+  ksba_reader_t mem_reader;
+
+  if (!cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (atomic_load_int (&cert->ref_count) != 1)
+    return gpg_error (GPG_ERR_CONFLICT);
+
+  release_content (cert);
+  mem_reader = cert->mem_reader;
+  memset (cert, 0, sizeof *cert);
+  cert->ref_count = 1;
+  cert->mem_reader = mem_reader;
+  return 0;
+}
+
+
 /* Store arbitrary data along with a certificate.  The DATA of length
    DATALEN will be stored under the string KEY.  If some data is
    already stored under this key it will be replaced by the new data.
@@ -252,20 +308,10 @@ ksba_cert_get_user_data (ksba_cert_t cert, const char *key,
 }
 
 
-/**
- * ksba_cert_read_der:
- * @cert: An unitialized certificate object
- * @reader: A KSBA Reader object
- *
- * Read the next certificate from the reader and store it in the
- * certificate object for future access.  The certificate is parsed
- * and rejected if it has any syntactical or semantical error
- * (i.e. does not match the ASN.1 description).
- *
- * Return value: 0 on success or an error value
- **/
-gpg_error_t
-ksba_cert_read_der (ksba_cert_t cert, ksba_reader_t reader)
+/* Worker for ksba_cert_read_der.  If BORROW is set the image is not
+   copied but taken directly from READER's memory.  */
+static gpg_error_t
+read_der (ksba_cert_t cert, ksba_reader_t reader, int borrow)
 {
   gpg_error_t err = 0;
   BerDecoder decoder = NULL;
@@ -276,11 +322,10 @@ ksba_cert_read_der (ksba_cert_t cert, ksba_reader_t reader)
     return gpg_error (GPG_ERR_CONFLICT); /* Fixme: should remove the old one */
 
   _ksba_asn_release_nodes (cert->root);
-  ksba_asn_tree_release (cert->asn_tree);
   cert->root = NULL;
   cert->asn_tree = NULL;
 
-  err = ksba_asn_create_tree ("tmttv2", &cert->asn_tree);
+  err = _ksba_asn_get_module ("tmttv2", &cert->asn_tree);
   if (err)
     goto leave;
 
@@ -299,10 +344,14 @@ ksba_cert_read_der (ksba_cert_t cert, ksba_reader_t reader)
   if (err)
      goto leave;
 
-  err = _ksba_ber_decoder_decode (decoder, "TMTTv2.Certificate", 0,
+  err = _ksba_ber_decoder_decode (decoder, "TMTTv2.Certificate",
+                                  borrow? BER_DECODER_FLAG_BORROW_IMAGE : 0,
                                   &cert->root, &cert->image, &cert->imagelen);
   if (!err)
+    {
+      cert->image_borrowed = borrow;
       cert->initialized = 1;
+    }
 
  leave:
   _ksba_ber_decoder_release (decoder);
@@ -311,23 +360,136 @@ ksba_cert_read_der (ksba_cert_t cert, ksba_reader_t reader)
 }
 
 
+/**
+ * ksba_cert_read_der:
+ * @cert: An unitialized certificate object
+ * @reader: A KSBA Reader object
+ *
+ * Read the next certificate from the reader and store it in the
+ * certificate object for future access.  The certificate is parsed
+ * and rejected if it has any syntactical or semantical error
+ * (i.e. does not match the ASN.1 description).
+ *
+ * If the reader has been set up with ksba_reader_set_mem_nocopy, the
+ * certificate does not copy its DER encoding but keeps a pointer into
+ * the caller's buffer; that buffer must then stay valid and unchanged
+ * until the certificate has been released.
+ *
+ * Return value: 0 on success or an error value
+ **/
+gpg_error_t
+ksba_cert_read_der (ksba_cert_t cert, ksba_reader_t reader)
+{
+  if (!reader)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  return read_der (cert, reader, !!_ksba_reader_borrow_mem (reader, NULL));
+}
+
+
 gpg_error_t
 ksba_cert_init_from_mem (ksba_cert_t cert, const void *buffer, size_t length)
 {
   gpg_error_t err;
-  ksba_reader_t reader;
 
-  err = ksba_reader_new (&reader);
-  if (err)
-    return err;
-  err = ksba_reader_set_mem (reader, buffer, length);
-  if (err)
+  if (!cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  /* The reader is kept with the object so that it can be reused
+     after ksba_cert_reset.  */
+  if (!cert->mem_reader)
     {
-      ksba_reader_release (reader);
-      return err;
+      err = ksba_reader_new (&cert->mem_reader);
+      if (err)
+        return err;
     }
-  err = ksba_cert_read_der (cert, reader);
-  ksba_reader_release (reader);
+  /* There is no need to copy BUFFER into the reader; the image is
+     copied by the decoder anyway.  */
+  err = ksba_reader_set_mem_nocopy (cert->mem_reader, buffer, length);
+  if (!err)
+    err = read_der (cert, cert->mem_reader, 0);
+  ksba_reader_reset (cert->mem_reader);
+  return err;
+}
+
+
+/* The arguments of ksba_cert_parse_batch for the workers.  */
+struct parse_batch_parm_s
+{
+  const void **bufs;
+  const size_t *lens;
+  ksba_cert_t *out;
+  gpg_error_t *errs;
+};
+
+static void
+parse_batch_item (void *opaque, size_t idx)
+{
+  struct parse_batch_parm_s *parm = opaque;
+  gpg_error_t err;
+  ksba_cert_t cert;
+
+  err = ksba_cert_new (&cert);
+  if (!err)
+    {
+      err = ksba_cert_init_from_mem (cert, parm->bufs[idx], parm->lens[idx]);
+      if (err)
+        {
+          ksba_cert_release (cert);
+          cert = NULL;
+        }
+    }
+  parm->out[idx] = cert;
+  parm->errs[idx] = err;
+}
+
+
+/**
+ * ksba_cert_parse_batch:
+ * @bufs: Array with the DER encoded certificates
+ * @lens: Array with the lengths of the certificates
+ * @n: Number of certificates
+ * @out: Array to receive the certificate objects
+ * @errs: Array to receive the error codes or NULL
+ * @nthreads: Number of threads to use
+ *
+ * Parse the @n certificates given by @bufs and @lens into new
+ * certificate objects which are stored at the same index of @out.  If
+ * a certificate can't be parsed NULL is stored at @out and the error
+ * code is stored at the same index of @errs.  The work is spread over
+ * @nthreads threads including the calling one; with 0 the number of
+ * processors is used.  The input buffers are not referenced after
+ * the function returns.
+ *
+ * Return value: 0 if all certificates have been parsed, the error of
+ * the first failed certificate or an error code for bad arguments.
+ **/
+gpg_error_t
+ksba_cert_parse_batch (const void **bufs, const size_t *lens, size_t n,
+                       ksba_cert_t *out, gpg_error_t *errs,
+                       unsigned int nthreads)
+{
+  struct parse_batch_parm_s parm;
+  gpg_error_t err;
+  size_t idx;
+
+  if (!n)
+    return 0;
+  if (!bufs || !lens || !out)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  parm.bufs = bufs;
+  parm.lens = lens;
+  parm.out = out;
+  parm.errs = errs? errs : xtrycalloc (n, sizeof *errs);
+  if (!parm.errs)
+    return gpg_error_from_syserror ();
+
+  err = _ksba_workpool_run (n, nthreads, parse_batch_item, &parm);
+  for (idx=0; !err && idx < n; idx++)
+    err = parm.errs[idx];
+
+  if (!errs)
+    xfree (parm.errs);
   return err;
 }
 
@@ -343,7 +505,7 @@ ksba_cert_get_image (ksba_cert_t cert, size_t *r_length )
   if (!cert->initialized)
     return NULL;
 
-  n = _ksba_asn_find_node (cert->root, "Certificate");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT);
   if (!n)
     return NULL;
 
@@ -402,9 +564,9 @@ ksba_cert_hash (ksba_cert_t cert, int what,
   if (!cert->initialized)
     return gpg_error (GPG_ERR_NO_DATA);
 
-  n = _ksba_asn_find_node (cert->root,
-                           what == 1? "Certificate.tbsCertificate"
-                                    : "Certificate");
+  n = _ksba_asn_find_node_by_handle (cert->root,
+                                     what == 1? ASNPATH_CERT_TBS
+                                              : ASNPATH_CERT);
   if (!n)
     return gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
   if (n->off == -1)
@@ -421,6 +583,93 @@ ksba_cert_hash (ksba_cert_t cert, int what,
 }
 
 
+/**
+ * ksba_cert_get_digest:
+ * @cert: Initialized certificate object
+ * @what: 0 to hash the entire certificate, 1 for only the
+ *        to-be-signed part.
+ * @oid: The OID of the hash algorithm or NULL for SHA-1
+ * @r_digest: Receives a pointer to the digest
+ * @r_length: Receives the length of the digest
+ *
+ * Return the digest of the certificate as computed by the function
+ * registered with ksba_set_hash_buffer_function.  The digest is
+ * computed only on the first call for a given @what and @oid; later
+ * calls return the stored value.  This is useful to get the
+ * fingerprint of a certificate over and over.  The returned pointer
+ * is valid as long as @cert is.
+ *
+ * Return value: 0 on success or an error code; GPG_ERR_CONFIGURATION
+ * is returned if no hash function has been registered.
+ **/
+gpg_error_t
+ksba_cert_get_digest (ksba_cert_t cert, int what, const char *oid,
+                      const unsigned char **r_digest, size_t *r_length)
+{
+  gpg_error_t err;
+  struct cert_digest_s *dg, *dg2;
+  AsnNode n;
+
+  if (!cert || !r_digest || !r_length || (what != 0 && what != 1))
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_digest = NULL;
+  *r_length = 0;
+  if (!cert->initialized)
+    return gpg_error (GPG_ERR_NO_DATA);
+  if (!oid)
+    oid = "";
+
+  for (dg = atomic_load_ptr (&cert->cache.digests); dg; dg = dg->next)
+    if (dg->what == what && !strcmp (dg->oid, oid))
+      {
+        *r_digest = dg->digest;
+        *r_length = dg->len;
+        return 0;
+      }
+
+  n = _ksba_asn_find_node_by_handle (cert->root,
+                                     what == 1? ASNPATH_CERT_TBS
+                                              : ASNPATH_CERT);
+  if (!n || n->off == -1)
+    return gpg_error (GPG_ERR_NO_VALUE);
+
+  dg = xtrymalloc (sizeof *dg + strlen (oid));
+  if (!dg)
+    return gpg_error_from_errno (errno);
+  strcpy (dg->oid, oid);
+  dg->what = what;
+  err = _ksba_hash_buffer (*oid? oid : NULL,
+                           cert->image + n->off, n->nhdr + n->len,
+                           sizeof dg->digest, dg->digest, &dg->len);
+  if (err)
+    {
+      xfree (dg);
+      return err;
+    }
+
+  /* Another thread may have computed the same digest meanwhile.  */
+  gpgrt_lock_lock (cache_lock (cert));
+  for (dg2 = cert->cache.digests; dg2; dg2 = dg2->next)
+    if (dg2->what == what && !strcmp (dg2->oid, oid))
+      break;
+  if (dg2)
+    {
+      xfree (dg);
+      dg = dg2;
+    }
+  else
+    {
+      dg->next = cert->cache.digests;
+      atomic_store_ptr (&cert->cache.digests, dg);
+    }
+  gpgrt_lock_unlock (cache_lock (cert));
+
+  *r_digest = dg->digest;
+  *r_length = dg->len;
+  return 0;
+}
+
+
 
 /**
  * ksba_cert_get_digest_algo:
@@ -454,8 +703,9 @@ ksba_cert_get_digest_algo (ksba_cert_t cert)
        return NULL;
     }
 
-  if (cert->cache.digest_algo)
-    return cert->cache.digest_algo;
+  algo = atomic_load_ptr (&cert->cache.digest_algo);
+  if (algo)
+    return algo;
 
 /*   n = _ksba_asn_find_node (cert->root, */
 /*                            "Certificate.signatureAlgorithm.algorithm"); */
@@ -465,19 +715,23 @@ ksba_cert_get_digest_algo (ksba_cert_t cert)
 /*   else  */
 /*     cert->cache.digest_algo = algo; */
 
-  n = _ksba_asn_find_node (cert->root, "Certificate.signatureAlgorithm");
-  if (!n || n->off == -1)
+  gpgrt_lock_lock (cache_lock (cert));
+  algo = cert->cache.digest_algo;
+  if (!algo)
     {
-      algo = NULL;
-      err = gpg_error (GPG_ERR_UNKNOWN_ALGORITHM);
+      n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SIGALGO);
+      if (!n || n->off == -1)
+        err = gpg_error (GPG_ERR_UNKNOWN_ALGORITHM);
+      else
+        err = _ksba_parse_algorithm_identifier (cert->image + n->off,
+                                                n->nhdr + n->len,
+                                                &nread, &algo);
+      if (err)
+        cert->last_error = err;
+      else
+        atomic_store_ptr (&cert->cache.digest_algo, algo);
     }
-  else
-    err = _ksba_parse_algorithm_identifier (cert->image + n->off,
-                                            n->nhdr + n->len, &nread, &algo);
-  if (err)
-    cert->last_error = err;
-  else
-    cert->cache.digest_algo = algo;
+  gpgrt_lock_unlock (cache_lock (cert));
 
   return algo;
 }
@@ -506,8 +760,7 @@ ksba_cert_get_serial (ksba_cert_t cert)
   if (!cert || !cert->initialized)
     return NULL;
 
-  n = _ksba_asn_find_node (cert->root,
-                           "Certificate.tbsCertificate.serialNumber");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SERIAL);
   if (!n)
     return NULL; /* oops - should be there */
 
@@ -541,8 +794,7 @@ _ksba_cert_get_serial_ptr (ksba_cert_t cert,
 
   if (!cert || !cert->initialized || !ptr || !length)
     return gpg_error (GPG_ERR_INV_VALUE);
-  n = _ksba_asn_find_node (cert->root,
-                           "Certificate.tbsCertificate.serialNumber");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SERIAL);
   if (!n || n->off == -1)
     return gpg_error (GPG_ERR_NO_VALUE);
 
@@ -564,7 +816,7 @@ _ksba_cert_get_issuer_dn_ptr (ksba_cert_t cert,
   if (!cert || !cert->initialized || !ptr || !length)
     return gpg_error (GPG_ERR_INV_VALUE);
 
-  n = _ksba_asn_find_node (cert->root, "Certificate.tbsCertificate.issuer");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_ISSUER);
   if (!n || !n->down)
     return gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
   n = n->down; /* dereference the choice node */
@@ -588,7 +840,7 @@ _ksba_cert_get_subject_dn_ptr (ksba_cert_t cert,
   if (!cert || !cert->initialized || !ptr || !length)
     return gpg_error (GPG_ERR_INV_VALUE);
 
-  n = _ksba_asn_find_node (cert->root, "Certificate.tbsCertificate.subject");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SUBJECT);
   if (!n || !n->down)
     return gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
   n = n->down; /* dereference the choice node */
@@ -608,10 +860,9 @@ get_name (ksba_cert_t cert, int idx, int use_subject, char **result)
   gpg_error_t err;
   char *p;
   int i;
-  const char *oid;
   struct tag_info ti;
   const unsigned char *der;
-  size_t off, derlen, seqlen;
+  size_t derlen, seqlen;
 
   if (!cert || !cert->initialized || !result)
     return gpg_error (GPG_ERR_INV_VALUE);
@@ -621,37 +872,29 @@ get_name (ksba_cert_t cert, int idx, int use_subject, char **result)
   *result = NULL;
   if (!idx)
     { /* Get the required DN */
-      AsnNode n;
+      const char *dn;
 
-      n = _ksba_asn_find_node (cert->root,
-                               (use_subject?
-                                "Certificate.tbsCertificate.subject":
-                                "Certificate.tbsCertificate.issuer") );
-      if (!n || !n->down)
-        return gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
-      n = n->down; /* dereference the choice node */
-      if (n->off == -1)
-        return gpg_error (GPG_ERR_NO_VALUE);
-
-      err = _ksba_dn_to_str (cert->image, n, &p);
+      err = ksba_cert_get_dn (cert, use_subject, &dn);
       if (err)
         return err;
+      p = xtrystrdup (dn);
+      if (!p)
+        return gpg_error_from_syserror ();
       *result = p;
       return 0;
     }
 
   /* get {issuer,subject}AltName */
-  for (i=0; !(err=ksba_cert_get_extension (cert, i, &oid, NULL,
-                                           &off, &derlen)); i++)
-    {
-      if (!strcmp (oid, (use_subject?
-                         oidstr_subjectAltName:oidstr_issuerAltName)))
-        break;
-    }
+  err = get_extensions (cert);
   if (err)
-      return err; /* no alt name or error*/
+    return err;
+  i = cert->cache.extn_first[use_subject? CERT_EXTN_SUBJECT_ALT_NAME
+                                        : CERT_EXTN_ISSUER_ALT_NAME];
+  if (i == -1)
+    return gpg_error (GPG_ERR_EOF); /* no alt name */
 
-  der = cert->image + off;
+  der = cert->image + cert->cache.extns[i].off;
+  derlen = cert->cache.extns[i].len;
 
 
   /* FIXME: We should use _ksba_name_new_from_der and ksba_name_enum here */
@@ -794,6 +1037,65 @@ ksba_cert_get_subject (ksba_cert_t cert, int idx)
 }
 
 
+/**
+ * ksba_cert_get_dn:
+ * @cert: Initialized certificate object
+ * @what: 0 for the issuer, 1 for the subject
+ * @r_dn: Receives a pointer to the name
+ *
+ * Return the issuer or subject name of the certificate as an RFC-2253
+ * encoded string like ksba_cert_get_issuer and ksba_cert_get_subject
+ * with an index of 0.  The string is rendered only on the first call
+ * and owned by @cert; it is valid as long as @cert is.  Use this
+ * function instead of the other two if the name is needed often and
+ * only for a short time.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_cert_get_dn (ksba_cert_t cert, int what, const char **r_dn)
+{
+  gpg_error_t err = 0;
+  char **cached, *dn;
+  AsnNode n;
+
+  if (!cert || !r_dn || (what != 0 && what != 1))
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_dn = NULL;
+  if (!cert->initialized)
+    return gpg_error (GPG_ERR_NO_DATA);
+
+  cached = what? &cert->cache.subject_dn : &cert->cache.issuer_dn;
+  dn = atomic_load_ptr (cached);
+  if (dn)
+    {
+      *r_dn = dn;
+      return 0;
+    }
+
+  gpgrt_lock_lock (cache_lock (cert));
+  dn = *cached;
+  if (!dn)
+    {
+      n = _ksba_asn_find_node_by_handle (cert->root,
+                                         what? ASNPATH_CERT_SUBJECT
+                                             : ASNPATH_CERT_ISSUER);
+      if (!n || !n->down)
+        err = gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
+      else if (n->down->off == -1) /* dereference the choice node */
+        err = gpg_error (GPG_ERR_NO_VALUE);
+      else
+        err = _ksba_dn_to_str (cert->image, n->down, &dn);
+      if (!err)
+        atomic_store_ptr (cached, dn);
+    }
+  gpgrt_lock_unlock (cache_lock (cert));
+
+  *r_dn = dn;
+  return err;
+}
+
+
 
 /**
  * ksba_cert_get_valididy:
@@ -818,9 +1120,9 @@ ksba_cert_get_validity (ksba_cert_t cert, int what, ksba_isotime_t timebuf)
   if (!cert->initialized)
     return gpg_error (GPG_ERR_NO_DATA);
 
-  n = _ksba_asn_find_node (cert->root,
-        what == 0? "Certificate.tbsCertificate.validity.notBefore"
-                 : "Certificate.tbsCertificate.validity.notAfter");
+  n = _ksba_asn_find_node_by_handle (cert->root,
+                                     what == 0? ASNPATH_CERT_NOTBEFORE
+                                              : ASNPATH_CERT_NOTAFTER);
   if (!n)
     return 0; /* no value available */
 
@@ -855,9 +1157,7 @@ ksba_cert_get_public_key (ksba_cert_t cert)
   if (!cert->initialized)
     return NULL;
 
-  n = _ksba_asn_find_node (cert->root,
-                           "Certificate"
-                           ".tbsCertificate.subjectPublicKeyInfo");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_PUBKEYINFO);
   if (!n)
     {
       cert->last_error = gpg_error (GPG_ERR_NO_VALUE);
@@ -887,8 +1187,7 @@ _ksba_cert_get_public_key_ptr (ksba_cert_t cert,
   if (!cert || !cert->initialized || !ptr || !length)
     return gpg_error (GPG_ERR_INV_VALUE);
 
-  n = _ksba_asn_find_node (cert->root,
-                           "Certificate.tbsCertificate.subjectPublicKeyInfo");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_PUBKEYINFO);
   if (!n || !n->down || !n->down->right)
     return gpg_error (GPG_ERR_NO_VALUE); /* oops - should be there */
   n = n->down->right;
@@ -921,8 +1220,7 @@ ksba_cert_get_sig_val (ksba_cert_t cert)
   if (!cert->initialized)
     return NULL;
 
-  n = _ksba_asn_find_node (cert->root,
-                           "Certificate.signatureAlgorithm");
+  n = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SIGALGO);
   if (!n)
     {
       cert->last_error = gpg_error (GPG_ERR_NO_VALUE);
@@ -951,24 +1249,94 @@ ksba_cert_get_sig_val (ksba_cert_t cert)
 }
 
 
-/* Read all extensions into the cache */
+/* The OIDs of the extensions in enum cert_extn_kind.  */
+static const char *const extn_oidstr[CERT_EXTN_N] =
+  {
+    NULL,
+    "2.5.29.14",
+    "2.5.29.15",
+    "2.5.29.17",
+    "2.5.29.18",
+    "2.5.29.19",
+    "2.5.29.31",
+    "2.5.29.32",
+    "2.5.29.35",
+    "2.5.29.37",
+    "1.3.6.1.5.5.7.1.1",
+    "1.3.6.1.5.5.7.1.11"
+  };
+
+
+/* Return the kind of the extension with the DER encoded OID at DER
+   of length LEN; OIDSTR is the same OID in dotted form.  The bytes
+   are only used if they are a minimal encoding of the OID; in all
+   other cases the string is compared so that we find the same
+   extensions as ksba_cert_get_extension reports.  */
+static enum cert_extn_kind
+classify_extension (const unsigned char *der, size_t len, const char *oidstr)
+{
+  int kind;
+
+  if (len == 3 && der[0] == 0x55 && der[1] == 0x1d && der[2] < 0x80)
+    {
+      /* 2.5.29.x */
+      switch (der[2])
+        {
+        case 14: return CERT_EXTN_SUBJECT_KEY_ID;
+        case 15: return CERT_EXTN_KEY_USAGE;
+        case 17: return CERT_EXTN_SUBJECT_ALT_NAME;
+        case 18: return CERT_EXTN_ISSUER_ALT_NAME;
+        case 19: return CERT_EXTN_BASIC_CONSTRAINTS;
+        case 31: return CERT_EXTN_CRL_DIST_POINTS;
+        case 32: return CERT_EXTN_CERT_POLICIES;
+        case 35: return CERT_EXTN_AUTH_KEY_ID;
+        case 37: return CERT_EXTN_EXT_KEY_USAGE;
+        default: return CERT_EXTN_OTHER;
+        }
+    }
+  else if (len == 8 && !memcmp (der, "\x2b\x06\x01\x05\x05\x07\x01", 7)
+           && der[7] < 0x80)
+    {
+      /* 1.3.6.1.5.5.7.1.x */
+      if (der[7] == 1)
+        return CERT_EXTN_AUTH_INFO_ACCESS;
+      if (der[7] == 11)
+        return CERT_EXTN_SUBJECT_INFO_ACCESS;
+      return CERT_EXTN_OTHER;
+    }
+
+  for (kind=CERT_EXTN_OTHER+1; kind < CERT_EXTN_N; kind++)
+    if (!strcmp (oidstr, extn_oidstr[kind]))
+      return kind;
+  return CERT_EXTN_OTHER;
+}
+
+
+/* Read all extensions into the cache.  The well-known extensions are
+   identified here so that the functions below don't need to compare
+   the OIDs again.  */
 static gpg_error_t
 read_extensions (ksba_cert_t cert)
 {
   AsnNode start, n;
   int count;
+  enum cert_extn_kind kind;
 
   assert (!cert->cache.extns_valid);
   assert (!cert->cache.extns);
 
-  start = _ksba_asn_find_node (cert->root,
-                               "Certificate.tbsCertificate.extensions..");
+  for (kind=0; kind < CERT_EXTN_N; kind++)
+    cert->cache.extn_first[kind] = -1;
+  cert->cache.extn_dups = 0;
+
+  start = _ksba_asn_find_node_by_handle (cert->root,
+                                         ASNPATH_CERT_EXTENSIONS);
   for (count=0, n=start; n; n = n->right)
     count++;
   if (!count)
     {
       cert->cache.n_extns = 0;
-      cert->cache.extns_valid = 1;
+      atomic_store_int (&cert->cache.extns_valid, 1);
       return 0; /* no extensions at all */
     }
   cert->cache.extns = xtrycalloc (count, sizeof *cert->cache.extns);
@@ -986,6 +1354,15 @@ read_extensions (ksba_cert_t cert)
         cert->cache.extns[count].oid = _ksba_oid_node_to_str (cert->image, n);
         if (!cert->cache.extns[count].oid)
           goto no_value;
+        kind = classify_extension (cert->image + n->off + n->nhdr, n->len,
+                                   cert->cache.extns[count].oid);
+        cert->cache.extns[count].kind = kind;
+        if (kind == CERT_EXTN_OTHER)
+          ;
+        else if (cert->cache.extn_first[kind] == -1)
+          cert->cache.extn_first[kind] = count;
+        else
+          cert->cache.extn_dups |= (1u << kind);
 
         n = n->right;
         if (n && n->type == TYPE_BOOLEAN)
@@ -1003,7 +1380,7 @@ read_extensions (ksba_cert_t cert)
       }
 
     assert (count == cert->cache.n_extns);
-    cert->cache.extns_valid = 1;
+    atomic_store_int (&cert->cache.extns_valid, 1);
     return 0;
 
   no_value:
@@ -1016,11 +1393,9 @@ read_extensions (ksba_cert_t cert)
 }
 
 
-/* Return information about the IDX nth extension */
-gpg_error_t
-ksba_cert_get_extension (ksba_cert_t cert, int idx,
-                         char const **r_oid, int *r_crit,
-                         size_t *r_deroff, size_t *r_derlen)
+/* Make sure that the extensions of CERT are in the cache.  */
+static gpg_error_t
+get_extensions (ksba_cert_t cert)
 {
   gpg_error_t err;
 
@@ -1029,13 +1404,50 @@ ksba_cert_get_extension (ksba_cert_t cert, int idx,
   if (!cert->initialized)
     return gpg_error (GPG_ERR_NO_DATA);
 
-  if (!cert->cache.extns_valid)
+  if (!atomic_load_int (&cert->cache.extns_valid))
     {
-      err = read_extensions (cert);
+      gpgrt_lock_lock (cache_lock (cert));
+      err = cert->cache.extns_valid? 0 : read_extensions (cert);
+      gpgrt_lock_unlock (cache_lock (cert));
       if (err)
         return err;
       assert (cert->cache.extns_valid);
     }
+  return 0;
+}
+
+
+/* Return the index of the extension of KIND at R_IDX.  Returns
+   GPG_ERR_EOF if there is no such extension and GPG_ERR_DUP_VALUE if
+   there is more than one.  */
+static gpg_error_t
+find_extension (ksba_cert_t cert, enum cert_extn_kind kind, int *r_idx)
+{
+  gpg_error_t err;
+
+  err = get_extensions (cert);
+  if (err)
+    return err;
+  *r_idx = cert->cache.extn_first[kind];
+  if (*r_idx == -1)
+    return gpg_error (GPG_ERR_EOF);
+  if ((cert->cache.extn_dups & (1u << kind)))
+    return gpg_error (GPG_ERR_DUP_VALUE);
+  return 0;
+}
+
+
+/* Return information about the IDX nth extension */
+gpg_error_t
+ksba_cert_get_extension (ksba_cert_t cert, int idx,
+                         char const **r_oid, int *r_crit,
+                         size_t *r_deroff, size_t *r_derlen)
+{
+  gpg_error_t err;
+
+  err = get_extensions (cert);
+  if (err)
+    return err;
 
   if (idx == cert->cache.n_extns)
     return gpg_error (GPG_ERR_EOF); /* No more extensions. */
@@ -1056,46 +1468,27 @@ ksba_cert_get_extension (ksba_cert_t cert, int idx,
 
 
 
-/* Return information on the basicConstraint (2.5.19.19) of CERT.
-   R_CA receives true if this is a CA and only in that case R_PATHLEN
-   is set to the maximim certification path length or -1 if there is
-   nosuch limitation */
-gpg_error_t
-ksba_cert_is_ca (ksba_cert_t cert, int *r_ca, int *r_pathlen)
+/* Decode the basicConstraints of CERT for ksba_cert_is_ca.  R_CA
+   and R_PATHLEN must have been set to the default values.  */
+static gpg_error_t
+decode_basic_constraints (ksba_cert_t cert, int *r_ca, int *r_pathlen)
 {
   gpg_error_t err;
-  const char *oid;
   int idx, crit;
-  size_t off, derlen, seqlen;
+  size_t derlen, seqlen;
   const unsigned char *der;
   struct tag_info ti;
   unsigned long value;
 
-  /* set default values */
-  if (r_ca)
-    *r_ca = 0;
-  if (r_pathlen)
-    *r_pathlen = -1;
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, &crit,
-                                             &off, &derlen)); idx++)
-    {
-      if (!strcmp (oid, oidstr_basicConstraints))
-        break;
-    }
+  err = find_extension (cert, CERT_EXTN_BASIC_CONSTRAINTS, &idx);
   if (gpg_err_code (err) == GPG_ERR_EOF)
       return 0; /* no such constraint */
   if (err)
     return err;
 
-  /* check that there is only one */
-  for (idx++; !(err=ksba_cert_get_extension (cert, idx, &oid, NULL,
-                                             NULL, NULL)); idx++)
-    {
-      if (!strcmp (oid, oidstr_basicConstraints))
-        return gpg_error (GPG_ERR_DUP_VALUE);
-    }
-
-  der = cert->image + off;
+  crit = cert->cache.extns[idx].crit;
+  der = cert->image + cert->cache.extns[idx].off;
+  derlen = cert->cache.extns[idx].len;
 
   err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
@@ -1164,45 +1557,70 @@ ksba_cert_is_ca (ksba_cert_t cert, int *r_ca, int *r_pathlen)
 }
 
 
-
-/* Get the key usage flags. The function returns Ksba_No_Data if no
-   key usage is specified. */
+/* Return information on the basicConstraint (2.5.19.19) of CERT.
+   R_CA receives true if this is a CA and only in that case R_PATHLEN
+   is set to the maximim certification path length or -1 if there is
+   nosuch limitation.  The constraints are decoded only once.  */
 gpg_error_t
-ksba_cert_get_key_usage (ksba_cert_t cert, unsigned int *r_flags)
+ksba_cert_is_ca (ksba_cert_t cert, int *r_ca, int *r_pathlen)
 {
   gpg_error_t err;
-  const char *oid;
-  int idx, crit;
-  size_t off, derlen;
+
+  /* set default values */
+  if (r_ca)
+    *r_ca = 0;
+  if (r_pathlen)
+    *r_pathlen = -1;
+
+  err = get_extensions (cert);
+  if (err)
+    return err;
+  if (!atomic_load_int (&cert->cache.basic_constraints.valid))
+    {
+      gpgrt_lock_lock (cache_lock (cert));
+      if (!cert->cache.basic_constraints.valid)
+        {
+          cert->cache.basic_constraints.ca = 0;
+          cert->cache.basic_constraints.pathlen = -1;
+          cert->cache.basic_constraints.err
+            = decode_basic_constraints (cert,
+                                        &cert->cache.basic_constraints.ca,
+                                        &cert->cache.basic_constraints.pathlen);
+          atomic_store_int (&cert->cache.basic_constraints.valid, 1);
+        }
+      gpgrt_lock_unlock (cache_lock (cert));
+    }
+
+  if (r_ca)
+    *r_ca = cert->cache.basic_constraints.ca;
+  if (r_pathlen)
+    *r_pathlen = cert->cache.basic_constraints.pathlen;
+  return cert->cache.basic_constraints.err;
+}
+
+
+
+/* Decode the keyUsage of CERT for ksba_cert_get_key_usage.  R_FLAGS
+   must have been cleared.  */
+static gpg_error_t
+decode_key_usage (ksba_cert_t cert, unsigned int *r_flags)
+{
+  gpg_error_t err;
+  int idx;
+  size_t derlen;
   const unsigned char *der;
   struct tag_info ti;
   unsigned int bits, mask;
   int i, unused, full;
 
-  if (!r_flags)
-    return gpg_error (GPG_ERR_INV_VALUE);
-  *r_flags = 0;
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, &crit,
-                                             &off, &derlen)); idx++)
-    {
-      if (!strcmp (oid, oidstr_keyUsage))
-        break;
-    }
-  if (gpg_err_code (err) == GPG_ERR_EOF
-      || gpg_err_code (err) == GPG_ERR_NO_VALUE)
+  err = find_extension (cert, CERT_EXTN_KEY_USAGE, &idx);
+  if (gpg_err_code (err) == GPG_ERR_EOF)
       return gpg_error (GPG_ERR_NO_DATA); /* no key usage */
   if (err)
     return err;
 
-  /* check that there is only one */
-  for (idx++; !(err=ksba_cert_get_extension (cert, idx, &oid, NULL,
-                                             NULL, NULL)); idx++)
-    {
-      if (!strcmp (oid, oidstr_keyUsage))
-        return gpg_error (GPG_ERR_DUP_VALUE);
-    }
-
-  der = cert->image + off;
+  der = cert->image + cert->cache.extns[idx].off;
+  derlen = cert->cache.extns[idx].len;
 
   err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
@@ -1269,6 +1687,40 @@ ksba_cert_get_key_usage (ksba_cert_t cert, unsigned int *r_flags)
 }
 
 
+/* Get the key usage flags. The function returns Ksba_No_Data if no
+   key usage is specified.  The flags are decoded only once.  */
+gpg_error_t
+ksba_cert_get_key_usage (ksba_cert_t cert, unsigned int *r_flags)
+{
+  gpg_error_t err;
+
+  if (!r_flags)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_flags = 0;
+
+  err = get_extensions (cert);
+  if (gpg_err_code (err) == GPG_ERR_NO_VALUE)
+    return gpg_error (GPG_ERR_NO_DATA);
+  if (err)
+    return err;
+  if (!atomic_load_int (&cert->cache.key_usage.valid))
+    {
+      gpgrt_lock_lock (cache_lock (cert));
+      if (!cert->cache.key_usage.valid)
+        {
+          cert->cache.key_usage.flags = 0;
+          cert->cache.key_usage.err
+            = decode_key_usage (cert, &cert->cache.key_usage.flags);
+          atomic_store_int (&cert->cache.key_usage.valid, 1);
+        }
+      gpgrt_lock_unlock (cache_lock (cert));
+    }
+
+  *r_flags = cert->cache.key_usage.flags;
+  return cert->cache.key_usage.err;
+}
+
+
 
 /* Note, that this helper is also used for ext_key_usage. */
 static gpg_error_t
@@ -1308,7 +1760,6 @@ gpg_error_t
 ksba_cert_get_cert_policies (ksba_cert_t cert, char **r_policies)
 {
   gpg_error_t err;
-  const char *oid;
   int idx, crit;
   size_t off, derlen, seqlen;
   const unsigned char *der;
@@ -1318,10 +1769,10 @@ ksba_cert_get_cert_policies (ksba_cert_t cert, char **r_policies)
     return gpg_error (GPG_ERR_INV_VALUE);
   *r_policies = NULL;
 
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, &crit,
+  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, NULL, &crit,
                                              &off, &derlen)); idx++)
     {
-      if (!strcmp (oid, oidstr_certificatePolicies))
+      if (cert->cache.extns[idx].kind == CERT_EXTN_CERT_POLICIES)
         {
           char *suboid;
 
@@ -1451,7 +1902,6 @@ gpg_error_t
 ksba_cert_get_ext_key_usages (ksba_cert_t cert, char **result)
 {
   gpg_error_t err;
-  const char *oid;
   int idx, crit;
   size_t off, derlen;
   const unsigned char *der;
@@ -1461,10 +1911,10 @@ ksba_cert_get_ext_key_usages (ksba_cert_t cert, char **result)
     return gpg_error (GPG_ERR_INV_VALUE);
   *result = NULL;
 
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, &crit,
+  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, NULL, &crit,
                                              &off, &derlen)); idx++)
     {
-      if (!strcmp (oid, oidstr_extKeyUsage))
+      if (cert->cache.extns[idx].kind == CERT_EXTN_EXT_KEY_USAGE)
         {
           char *suboid;
 
@@ -1712,7 +2162,6 @@ ksba_cert_get_crl_dist_point (ksba_cert_t cert, int idx,
                               ksba_crl_reason_t *r_reason)
 {
   gpg_error_t err;
-  const char *oid;
   size_t off, derlen;
   int myidx, crit;
 
@@ -1723,10 +2172,10 @@ ksba_cert_get_crl_dist_point (ksba_cert_t cert, int idx,
   if (r_reason)
     *r_reason = 0;
 
-  for (myidx=0; !(err=ksba_cert_get_extension (cert, myidx, &oid, &crit,
+  for (myidx=0; !(err=ksba_cert_get_extension (cert, myidx, NULL, &crit,
                                                &off, &derlen)); myidx++)
     {
-      if (!strcmp (oid, oidstr_crlDistributionPoints))
+      if (cert->cache.extns[myidx].kind == CERT_EXTN_CRL_DIST_POINTS)
         {
           const unsigned char *der;
           struct tag_info ti;
@@ -1812,12 +2261,11 @@ ksba_cert_get_auth_key_id (ksba_cert_t cert,
                            ksba_sexp_t *r_serial)
 {
   gpg_error_t err;
-  const char *oid;
-  size_t off, derlen;
+  size_t derlen;
   const unsigned char *der;
   const unsigned char *keyid_der = NULL;
   size_t keyid_derlen = 0;
-  int idx, crit;
+  int idx;
   struct tag_info ti;
   char numbuf[30];
   size_t numbuflen;
@@ -1829,27 +2277,15 @@ ksba_cert_get_auth_key_id (ksba_cert_t cert,
   *r_name = NULL;
   *r_serial = NULL;
 
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, &crit,
-                                             &off, &derlen)); idx++)
-    {
-      if (!strcmp (oid, oidstr_authorityKeyIdentifier))
-        break;
-    }
+  err = find_extension (cert, CERT_EXTN_AUTH_KEY_ID, &idx);
   if (gpg_err_code (err) == GPG_ERR_EOF
       || gpg_err_code (err) == GPG_ERR_NO_VALUE)
     return gpg_error (GPG_ERR_NO_DATA); /* not available */
   if (err)
     return err;
 
-  /* check that there is only one */
-  for (idx++; !(err=ksba_cert_get_extension (cert, idx, &oid, NULL,
-                                             NULL, NULL)); idx++)
-    {
-      if (!strcmp (oid, oidstr_authorityKeyIdentifier))
-        return gpg_error (GPG_ERR_DUP_VALUE);
-    }
-
-  der = cert->image + off;
+  der = cert->image + cert->cache.extns[idx].off;
+  derlen = cert->cache.extns[idx].len;
 
   err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
@@ -1947,20 +2383,19 @@ ksba_cert_get_auth_key_id (ksba_cert_t cert,
 }
 
 
-/* Return a simple octet string extension at the object identifier OID
-   from certificate CERT.  The data is return as a simple S-expression
+/* Return a simple octet string extension of KIND from certificate
+   CERT.  The data is return as a simple S-expression
    and stored at R_DATA.  Returns 0 on success or an error code.
    common error codes are: GPG_ERR_NO_DATA if no such extension is
    available, GPG_ERR_DUP_VALUE if more than one is available.  If
    R_CRIT is not NULL, the critical extension flag will be stored at
    that address. */
 static gpg_error_t
-get_simple_octet_string_ext (ksba_cert_t cert, const char *oid,
+get_simple_octet_string_ext (ksba_cert_t cert, enum cert_extn_kind kind,
                              int *r_crit, ksba_sexp_t *r_data)
 {
   gpg_error_t err;
-  const char *tmpoid;
-  size_t off, derlen;
+  size_t derlen;
   const unsigned char *der;
   int idx, crit;
   struct tag_info ti;
@@ -1971,12 +2406,7 @@ get_simple_octet_string_ext (ksba_cert_t cert, const char *oid,
     return gpg_error (GPG_ERR_INV_VALUE);
   *r_data = NULL;
 
-  for (idx=0; !(err=ksba_cert_get_extension (cert, idx, &tmpoid, &crit,
-                                             &off, &derlen)); idx++)
-    {
-      if (!strcmp (tmpoid, oid))
-        break;
-    }
+  err = find_extension (cert, kind, &idx);
   if (err)
     {
       if (gpg_err_code (err) == GPG_ERR_EOF
@@ -1985,15 +2415,9 @@ get_simple_octet_string_ext (ksba_cert_t cert, const char *oid,
       return err;
     }
 
-  /* Check that there is only one */
-  for (idx++; !(err=ksba_cert_get_extension (cert, idx, &tmpoid, NULL,
-                                             NULL, NULL)); idx++)
-    {
-      if (!strcmp (tmpoid, oid))
-        return gpg_error (GPG_ERR_DUP_VALUE);
-    }
-
-  der = cert->image + off;
+  crit = cert->cache.extns[idx].crit;
+  der = cert->image + cert->cache.extns[idx].off;
+  derlen = cert->cache.extns[idx].len;
 
   err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
@@ -2031,7 +2455,7 @@ get_simple_octet_string_ext (ksba_cert_t cert, const char *oid,
 gpg_error_t
 ksba_cert_get_subj_key_id (ksba_cert_t cert, int *r_crit, ksba_sexp_t *r_keyid)
 {
-  return get_simple_octet_string_ext (cert, oidstr_subjectKeyIdentifier,
+  return get_simple_octet_string_ext (cert, CERT_EXTN_SUBJECT_KEY_ID,
                                       r_crit, r_keyid);
 }
 
@@ -2048,7 +2472,6 @@ get_info_access (ksba_cert_t cert, int idx, int mode,
                  char **method, ksba_name_t *location)
 {
   gpg_error_t err;
-  const char *oid;
   size_t off, derlen;
   int myidx, crit;
 
@@ -2060,11 +2483,12 @@ get_info_access (ksba_cert_t cert, int idx, int mode,
   if (idx < 0)
     return gpg_error (GPG_ERR_INV_INDEX);
 
-  for (myidx=0; !(err=ksba_cert_get_extension (cert, myidx, &oid, &crit,
+  for (myidx=0; !(err=ksba_cert_get_extension (cert, myidx, NULL, &crit,
                                                &off, &derlen)); myidx++)
     {
-      if (!strcmp (oid,(mode == 0)? oidstr_authorityInfoAccess
-                                  : oidstr_subjectInfoAccess) )
+      if (cert->cache.extns[myidx].kind == (mode == 0?
+                                             CERT_EXTN_AUTH_INFO_ACCESS
+                                           : CERT_EXTN_SUBJECT_INFO_ACCESS))
         {
           const unsigned char *der;
           struct tag_info ti;
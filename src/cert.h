@@ -34,11 +34,31 @@
 #include "asn1-func.h"
 
 /* An object to keep parsed information about an extension. */
+/* The extensions which are looked up by the certificate functions.
+   They are identified once when the extensions are read.  */
+enum cert_extn_kind
+  {
+    CERT_EXTN_OTHER = 0,
+    CERT_EXTN_SUBJECT_KEY_ID,       /* 2.5.29.14 */
+    CERT_EXTN_KEY_USAGE,            /* 2.5.29.15 */
+    CERT_EXTN_SUBJECT_ALT_NAME,     /* 2.5.29.17 */
+    CERT_EXTN_ISSUER_ALT_NAME,      /* 2.5.29.18 */
+    CERT_EXTN_BASIC_CONSTRAINTS,    /* 2.5.29.19 */
+    CERT_EXTN_CRL_DIST_POINTS,      /* 2.5.29.31 */
+    CERT_EXTN_CERT_POLICIES,        /* 2.5.29.32 */
+    CERT_EXTN_AUTH_KEY_ID,          /* 2.5.29.35 */
+    CERT_EXTN_EXT_KEY_USAGE,        /* 2.5.29.37 */
+    CERT_EXTN_AUTH_INFO_ACCESS,     /* 1.3.6.1.5.5.7.1.1 */
+    CERT_EXTN_SUBJECT_INFO_ACCESS,  /* 1.3.6.1.5.5.7.1.11 */
+    CERT_EXTN_N
+  };
+
 struct cert_extn_info
 {
   char *oid;
   int crit;
   int off, len;
+  enum cert_extn_kind kind;
 };
 
 
@@ -67,6 +87,18 @@ struct cert_user_data
 };
 
 
+/* A digest of the certificate as returned by ksba_cert_get_digest.
+   The digests are computed on first use and kept in a list.  */
+struct cert_digest_s
+{
+  struct cert_digest_s *next;
+  int what;                  /* 0 = certificate, 1 = to-be-signed part.  */
+  size_t len;                /* Used length of DIGEST.  */
+  unsigned char digest[64];  /* Large enough for SHA-512.  */
+  char oid[1];               /* The hash algorithm; empty for SHA-1.  */
+};
+
+
 /* The internal certificate object. */
 struct ksba_cert_s
 {
@@ -85,21 +117,47 @@ struct ksba_cert_s
   /* Because we often need to pass certificate objects to other
      functions, we use reference counting to keep resource overhead
      low.  Note, that this object usually gets only read and not
-     modified. */
+     modified.  The counter is changed atomically so that a
+     certificate can be shared between threads.  */
   int ref_count;
 
-  ksba_asn_tree_t asn_tree;
+  ksba_asn_tree_t asn_tree;  /* Shared module; see _ksba_asn_get_module.  */
   AsnNode root;              /* Root of the tree with the values */
 
   unsigned char *image;
   size_t imagelen;
+  int image_borrowed;  /* IMAGE is owned by the caller; don't free it.  */
 
   gpg_error_t last_error;
+
+  /* A reader used by ksba_cert_init_from_mem.  It is not released by
+     ksba_cert_reset.  */
+  ksba_reader_t mem_reader;
+
+  /* Values computed on first use.  See cache_locks in cert.c.  */
   struct {
     char *digest_algo;
     int  extns_valid;
     int  n_extns;
     struct cert_extn_info *extns;
+    int  extn_first[CERT_EXTN_N]; /* Index of the first extension of a
+                                     kind or -1; valid with EXTNS_VALID. */
+    unsigned int extn_dups;       /* Bit N is set if there is more than
+                                     one extension of kind N.  */
+    struct {
+      int valid;
+      gpg_error_t err;
+      int ca;
+      int pathlen;
+    } basic_constraints;          /* Decoded by ksba_cert_is_ca.  */
+    struct {
+      int valid;
+      gpg_error_t err;
+      unsigned int flags;
+    } key_usage;                  /* Decoded by ksba_cert_get_key_usage. */
+    struct cert_digest_s *digests;
+    char *issuer_dn;              /* The issuer and subject names as */
+    char *subject_dn;             /* returned by ksba_cert_get_dn.   */
   } cache;
 };
 
@@ -0,0 +1,840 @@
+/* certstore.c - An in-memory store of certificates
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A certificate store keeps references to certificates and a hash
+   index for each of the ways a certificate is usually looked up: by
+   the DER encoded subject name, by the subjectKeyIdentifier, by the
+   serial number and by the fingerprint.  Another index on the entire
+   image is used to reject duplicates.  All keys point into the
+   certificates or their caches; thus the certificates must not be
+   reset while they are in a store.
+
+   The store also builds certification paths.  For each certificate
+   the paths to a root are computed on demand and kept with the item,
+   so that the intermediate certificates shared by many leaves are
+   processed only once.  The paths are kept separately for each
+   maximum length; they depend on nothing else and thus loops of
+   cross-certified CAs don't keep them from being memoized.  Adding a
+   certificate invalidates all those memoized paths.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "util.h"
+#include "cert.h"
+#include "ber-help.h"
+#include "sexp-parse.h"
+#include "certstore.h"
+
+
+/* Initial number of buckets of each index; must be a power of 2.  */
+#define INITIAL_SIZE 16
+
+/* The maximum number of paths kept for each certificate and the
+   maximum number of path computations done by one call of
+   ksba_certstore_build_chain.  */
+#define MAX_PATHS 16
+#define MAX_EXPANSIONS 10000
+
+
+/* Return a hash value for the LENGTH bytes at KEY (FNV-1a).  */
+static unsigned int
+hash_key (const unsigned char *key, size_t length)
+{
+  unsigned int h = 2166136261u;
+
+  while (length--)
+    {
+      h ^= *key++;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+
+/* Return the value part of the canonical S-expression "(n:value)" at
+   SEXP and store its length at R_LENGTH.  Returns NULL for an invalid
+   S-expression.  */
+static const unsigned char *
+sexp_value (ksba_const_sexp_t sexp, size_t *r_length)
+{
+  const unsigned char *s = sexp;
+  size_t n;
+
+  if (!s || *s != '(')
+    return NULL;
+  s++;
+  n = snext (&s);
+  if (!n || s[n] != ')')
+    return NULL;
+  *r_length = n;
+  return s;
+}
+
+
+/* Insert ITEM into the index WHICH of STORE.  */
+static void
+insert_item (ksba_certstore_t store, int which, struct certstore_item_s *item)
+{
+  unsigned int b;
+
+  if (!item->idx[which].key)
+    return;
+  b = item->idx[which].hash & (store->size - 1);
+  item->idx[which].next = store->buckets[which][b];
+  store->buckets[which][b] = item;
+}
+
+
+/* Double the number of buckets of STORE.  */
+static gpg_error_t
+grow_store (ksba_certstore_t store)
+{
+  struct certstore_item_s **old_image, *item, *next;
+  struct certstore_item_s **buckets[CERTSTORE_N_INDEXES];
+  unsigned int oldsize, newsize, b;
+  int which;
+
+  oldsize = store->size;
+  newsize = oldsize * 2;
+  if (newsize < oldsize)
+    return gpg_error (GPG_ERR_ENOMEM);
+  for (which=0; which < CERTSTORE_N_INDEXES; which++)
+    {
+      buckets[which] = xtrycalloc (newsize, sizeof *buckets[which]);
+      if (!buckets[which])
+        {
+          gpg_error_t err = gpg_error_from_syserror ();
+          while (which--)
+            xfree (buckets[which]);
+          return err;
+        }
+    }
+
+  /* Every item is in the image index; use it to visit all items.  */
+  old_image = store->buckets[CERTSTORE_IDX_IMAGE];
+  for (which=0; which < CERTSTORE_N_INDEXES; which++)
+    {
+      if (which != CERTSTORE_IDX_IMAGE)
+        xfree (store->buckets[which]);
+      store->buckets[which] = buckets[which];
+    }
+  store->size = newsize;
+  for (b=0; b < oldsize; b++)
+    for (item = old_image[b]; item; item = next)
+      {
+        next = item->idx[CERTSTORE_IDX_IMAGE].next;
+        for (which=0; which < CERTSTORE_N_INDEXES; which++)
+          insert_item (store, which, item);
+      }
+  xfree (old_image);
+  return 0;
+}
+
+
+/* Return the IDX-th item of the index WHICH of STORE whose key is
+   KEY of length KEYLEN or NULL.  */
+static struct certstore_item_s *
+lookup (ksba_certstore_t store, int which,
+        const unsigned char *key, size_t keylen, int idx)
+{
+  struct certstore_item_s *item;
+  unsigned int h;
+
+  h = hash_key (key, keylen);
+  for (item = store->buckets[which][h & (store->size - 1)];
+       item; item = item->idx[which].next)
+    if (item->idx[which].hash == h
+        && item->idx[which].keylen == keylen
+        && !memcmp (item->idx[which].key, key, keylen)
+        && !idx--)
+      return item;
+  return NULL;
+}
+
+
+/* Release the list of paths PATHS.  */
+static void
+release_paths (struct certstore_path_s *paths)
+{
+  struct certstore_path_s *next;
+
+  for (; paths; paths = next)
+    {
+      next = paths->next;
+      xfree (paths);
+    }
+}
+
+
+/* Store a new reference to the certificate of ITEM at R_CERT.  */
+static gpg_error_t
+return_cert (struct certstore_item_s *item, ksba_cert_t *r_cert)
+{
+  if (!item)
+    return gpg_error (GPG_ERR_NOT_FOUND);
+  ksba_cert_ref (item->cert);
+  *r_cert = item->cert;
+  return 0;
+}
+
+
+
+/**
+ * ksba_certstore_new:
+ * @r_store: Returns the new store
+ *
+ * Create a new and empty certificate store.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_certstore_new (ksba_certstore_t *r_store)
+{
+  ksba_certstore_t store;
+  int which;
+
+  if (!r_store)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_store = NULL;
+  store = xtrycalloc (1, sizeof *store);
+  if (!store)
+    return gpg_error_from_syserror ();
+  store->size = INITIAL_SIZE;
+  store->generation = 1;
+  for (which=0; which < CERTSTORE_N_INDEXES; which++)
+    {
+      store->buckets[which] = xtrycalloc (store->size,
+                                          sizeof *store->buckets[which]);
+      if (!store->buckets[which])
+        {
+          gpg_error_t err = gpg_error_from_syserror ();
+          ksba_certstore_release (store);
+          return err;
+        }
+    }
+  *r_store = store;
+  return 0;
+}
+
+
+/**
+ * ksba_certstore_release:
+ * @store: A certificate store or NULL
+ *
+ * Release the store and the references to all of its certificates.
+ **/
+void
+ksba_certstore_release (ksba_certstore_t store)
+{
+  struct certstore_item_s *item, *next;
+  unsigned int b;
+  int which, i;
+
+  if (!store)
+    return;
+  if (store->buckets[CERTSTORE_IDX_IMAGE])
+    for (b=0; b < store->size; b++)
+      for (item = store->buckets[CERTSTORE_IDX_IMAGE][b]; item; item = next)
+        {
+          next = item->idx[CERTSTORE_IDX_IMAGE].next;
+          ksba_cert_release (item->cert);
+          xfree (item->keyid);
+          for (i=0; i < CERTSTORE_MAX_PATH_LENGTH; i++)
+            release_paths (item->paths[i]);
+          xfree (item);
+        }
+  for (which=0; which < CERTSTORE_N_INDEXES; which++)
+    xfree (store->buckets[which]);
+  xfree (store);
+}
+
+
+/**
+ * ksba_certstore_add:
+ * @store: A certificate store
+ * @cert: An initialized certificate
+ *
+ * Add a reference to @cert to @store.  The certificate must not be
+ * reset while it is in the store.  If a hash function has been
+ * registered with ksba_set_hash_buffer_function the certificate is
+ * also indexed by its SHA-1 fingerprint.
+ *
+ * Return value: 0 on success, GPG_ERR_DUP_VALUE if the same
+ * certificate is already in the store or another error code.
+ **/
+gpg_error_t
+ksba_certstore_add (ksba_certstore_t store, ksba_cert_t cert)
+{
+  gpg_error_t err;
+  struct certstore_item_s *item;
+  const unsigned char *image;
+  size_t imagelen;
+  const unsigned char *key;
+  size_t keylen;
+  struct tag_info ti;
+  int which;
+
+  if (!store || !cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  image = ksba_cert_get_image (cert, &imagelen);
+  if (!image)
+    return gpg_error (GPG_ERR_NO_DATA);
+  if (lookup (store, CERTSTORE_IDX_IMAGE, image, imagelen, 0))
+    return gpg_error (GPG_ERR_DUP_VALUE);
+
+  if (store->nitems >= store->size)
+    {
+      err = grow_store (store);
+      if (err)
+        return err;
+    }
+
+  item = xtrycalloc (1, sizeof *item);
+  if (!item)
+    return gpg_error_from_syserror ();
+  item->idx[CERTSTORE_IDX_IMAGE].key = image;
+  item->idx[CERTSTORE_IDX_IMAGE].keylen = imagelen;
+
+  err = _ksba_cert_get_subject_dn_ptr (cert, &key, &keylen);
+  if (err)
+    goto leave;
+  item->idx[CERTSTORE_IDX_SUBJECT].key = key;
+  item->idx[CERTSTORE_IDX_SUBJECT].keylen = keylen;
+
+  /* We index the value of the serial number.  */
+  err = _ksba_cert_get_serial_ptr (cert, &key, &keylen);
+  if (!err)
+    err = _ksba_ber_parse_tl (&key, &keylen, &ti);
+  if (err)
+    goto leave;
+  item->idx[CERTSTORE_IDX_SERIAL].key = key;
+  item->idx[CERTSTORE_IDX_SERIAL].keylen = ti.length;
+
+  err = ksba_cert_get_subj_key_id (cert, NULL, &item->keyid);
+  if (!err)
+    {
+      key = sexp_value (item->keyid, &keylen);
+      if (key)
+        {
+          item->idx[CERTSTORE_IDX_KEYID].key = key;
+          item->idx[CERTSTORE_IDX_KEYID].keylen = keylen;
+        }
+    }
+  else if (gpg_err_code (err) != GPG_ERR_NO_DATA)
+    goto leave;
+
+  err = ksba_cert_get_digest (cert, 0, NULL, &key, &keylen);
+  if (!err)
+    {
+      item->idx[CERTSTORE_IDX_FPR].key = key;
+      item->idx[CERTSTORE_IDX_FPR].keylen = keylen;
+    }
+  else if (gpg_err_code (err) != GPG_ERR_CONFIGURATION)
+    goto leave;
+  err = 0;
+
+  ksba_cert_ref (cert);
+  item->cert = cert;
+  for (which=0; which < CERTSTORE_N_INDEXES; which++)
+    if (item->idx[which].key)
+      {
+        item->idx[which].hash = hash_key (item->idx[which].key,
+                                          item->idx[which].keylen);
+        insert_item (store, which, item);
+      }
+  store->nitems++;
+  /* The new certificate may be the issuer of any other.  */
+  if (!++store->generation)
+    store->generation = 1;
+
+ leave:
+  if (err)
+    {
+      xfree (item->keyid);
+      xfree (item);
+    }
+  return err;
+}
+
+
+/**
+ * ksba_certstore_find_issuer:
+ * @store: A certificate store
+ * @cert: The certificate whose issuer is requested
+ * @idx: Number of candidates to skip
+ * @r_issuer: Receives the issuer certificate
+ *
+ * Find a certificate in @store whose subject name is the issuer name
+ * of @cert.  Several certificates may have the same subject; use @idx
+ * to enumerate them.  They are returned in no specific order.  The
+ * caller must release the returned certificate.
+ *
+ * Return value: 0 on success or GPG_ERR_NOT_FOUND if there is no
+ * (more) such certificate.
+ **/
+gpg_error_t
+ksba_certstore_find_issuer (ksba_certstore_t store, ksba_cert_t cert,
+                            int idx, ksba_cert_t *r_issuer)
+{
+  gpg_error_t err;
+  const unsigned char *dn;
+  size_t dnlen;
+
+  if (!store || !cert || idx < 0 || !r_issuer)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_issuer = NULL;
+  err = _ksba_cert_get_issuer_dn_ptr (cert, &dn, &dnlen);
+  if (err)
+    return err;
+  return return_cert (lookup (store, CERTSTORE_IDX_SUBJECT, dn, dnlen, idx),
+                      r_issuer);
+}
+
+
+/**
+ * ksba_certstore_find_keyid:
+ * @store: A certificate store
+ * @keyid: A subjectKeyIdentifier as S-expression
+ * @idx: Number of candidates to skip
+ * @r_cert: Receives the certificate
+ *
+ * Find a certificate in @store by its subjectKeyIdentifier as
+ * returned by ksba_cert_get_subj_key_id or, for the issuer of a
+ * certificate, by ksba_cert_get_auth_key_id.  Use @idx to enumerate
+ * several certificates with the same key identifier.  The caller
+ * must release the returned certificate.
+ *
+ * Return value: 0 on success or GPG_ERR_NOT_FOUND if there is no
+ * (more) such certificate.
+ **/
+gpg_error_t
+ksba_certstore_find_keyid (ksba_certstore_t store, ksba_const_sexp_t keyid,
+                           int idx, ksba_cert_t *r_cert)
+{
+  const unsigned char *key;
+  size_t keylen;
+
+  if (!store || idx < 0 || !r_cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_cert = NULL;
+  key = sexp_value (keyid, &keylen);
+  if (!key)
+    return gpg_error (GPG_ERR_INV_SEXP);
+  return return_cert (lookup (store, CERTSTORE_IDX_KEYID, key, keylen, idx),
+                      r_cert);
+}
+
+
+/**
+ * ksba_certstore_find_serial:
+ * @store: A certificate store
+ * @issuer: The issuer name as returned by ksba_cert_get_issuer or NULL
+ * @serial: The serial number as S-expression
+ * @r_cert: Receives the certificate
+ *
+ * Find a certificate in @store by its issuer and serial number, for
+ * example those returned by ksba_cms_get_issuer_serial.  If @issuer is
+ * NULL the first certificate with that serial number is returned.
+ * The caller must release the returned certificate.
+ *
+ * Return value: 0 on success or GPG_ERR_NOT_FOUND if there is no such
+ * certificate.
+ **/
+gpg_error_t
+ksba_certstore_find_serial (ksba_certstore_t store, const char *issuer,
+                            ksba_const_sexp_t serial, ksba_cert_t *r_cert)
+{
+  gpg_error_t err;
+  struct certstore_item_s *item;
+  const unsigned char *key;
+  size_t keylen;
+  const char *name;
+  int idx;
+
+  if (!store || !r_cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_cert = NULL;
+  key = sexp_value (serial, &keylen);
+  if (!key)
+    return gpg_error (GPG_ERR_INV_SEXP);
+
+  /* The index is on the serial number; the serial numbers of
+     different issuers rarely collide and thus comparing the issuer
+     names is cheap.  */
+  for (idx=0; (item = lookup (store, CERTSTORE_IDX_SERIAL, key, keylen, idx));
+       idx++)
+    {
+      if (!issuer)
+        break;
+      err = ksba_cert_get_dn (item->cert, 0, &name);
+      if (err)
+        return err;
+      if (!strcmp (name, issuer))
+        break;
+    }
+  return return_cert (item, r_cert);
+}
+
+
+/**
+ * ksba_certstore_find_fpr:
+ * @store: A certificate store
+ * @fpr: The SHA-1 fingerprint of the certificate
+ * @fprlen: The length of @fpr
+ * @r_cert: Receives the certificate
+ *
+ * Find a certificate in @store by its SHA-1 fingerprint.  Only
+ * certificates added while a hash function was registered with
+ * ksba_set_hash_buffer_function can be found this way.  The caller
+ * must release the returned certificate.
+ *
+ * Return value: 0 on success or GPG_ERR_NOT_FOUND if there is no such
+ * certificate.
+ **/
+gpg_error_t
+ksba_certstore_find_fpr (ksba_certstore_t store,
+                         const unsigned char *fpr, size_t fprlen,
+                         ksba_cert_t *r_cert)
+{
+  if (!store || !fpr || !r_cert)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_cert = NULL;
+  return return_cert (lookup (store, CERTSTORE_IDX_FPR, fpr, fprlen, 0),
+                      r_cert);
+}
+
+
+
+/* Return true if CERT has the same issuer and subject name.  */
+static int
+is_self_issued (ksba_cert_t cert)
+{
+  const unsigned char *issuer, *subject;
+  size_t issuerlen, subjectlen;
+
+  if (_ksba_cert_get_issuer_dn_ptr (cert, &issuer, &issuerlen)
+      || _ksba_cert_get_subject_dn_ptr (cert, &subject, &subjectlen))
+    return 0;
+  return issuerlen == subjectlen && !memcmp (issuer, subject, issuerlen);
+}
+
+
+/* Return true if CERT may issue certificates and store the number of
+   intermediate certificates it allows below it at R_SLACK.  A
+   self-issued certificate without basicConstraints is an old style
+   root certificate and taken as a CA.  */
+static int
+is_ca_cert (ksba_cert_t cert, int *r_slack)
+{
+  int ca, pathlen;
+
+  *r_slack = INT_MAX;
+  if (ksba_cert_is_ca (cert, &ca, &pathlen))
+    return 0;
+  if (!ca)
+    return (cert->cache.extn_first[CERT_EXTN_BASIC_CONSTRAINTS] == -1
+            && is_self_issued (cert));
+  if (pathlen >= 0)
+    *r_slack = pathlen;
+  return 1;
+}
+
+
+/* Return true if CANDIDATE, an item with the subject name matching
+   the issuer name of CERT, may have issued CERT.  AKID is the
+   keyIdentifier of the authorityKeyIdentifier of CERT or NULL.  */
+static int
+check_issuer (struct certstore_item_s *candidate, ksba_cert_t cert,
+              ksba_const_sexp_t akid)
+{
+  const unsigned char *image, *a, *b;
+  size_t imagelen, alen, blen;
+  int slack;
+
+  image = ksba_cert_get_image (cert, &imagelen);
+  if (candidate->cert == cert
+      || (candidate->idx[CERTSTORE_IDX_IMAGE].keylen == imagelen
+          && !memcmp (candidate->idx[CERTSTORE_IDX_IMAGE].key,
+                      image, imagelen)))
+    return 0;
+  if (akid && candidate->keyid)
+    {
+      a = sexp_value (akid, &alen);
+      b = sexp_value (candidate->keyid, &blen);
+      if (a && b && (alen != blen || memcmp (a, b, alen)))
+        return 0;
+    }
+  return is_ca_cert (candidate->cert, &slack);
+}
+
+
+static gpg_error_t compute_paths (ksba_certstore_t store,
+                                  struct certstore_item_s *item, int maxlen,
+                                  int *r_budget);
+
+/* Return true if ITEM is part of PATH.  */
+static int
+path_has_item (struct certstore_path_s *path, struct certstore_item_s *item)
+{
+  int i;
+
+  for (i=0; i < path->length; i++)
+    if (path->items[i] == item)
+      return 1;
+  return 0;
+}
+
+
+/* Build the list of paths from CERT to a root with at most MAXLEN
+   certificates.  If SELF is not NULL it is the item of CERT, which is
+   then a CA certificate and the first element of each path.
+   Otherwise CERT itself is not part of the paths.  Paths which run
+   through CERT again are skipped.  R_BUDGET is the number of path
+   computations still allowed.  */
+static gpg_error_t
+build_paths (ksba_certstore_t store, ksba_cert_t cert,
+             struct certstore_item_s *self, int maxlen,
+             struct certstore_path_s **r_paths, int *r_budget)
+{
+  gpg_error_t err;
+  struct certstore_path_s *paths = NULL, **tail = &paths;
+  struct certstore_path_s *p, *newp;
+  struct certstore_item_s *candidate, *loop;
+  const unsigned char *dn, *image;
+  size_t dnlen, imagelen;
+  ksba_sexp_t akid = NULL;
+  ksba_name_t name;
+  ksba_sexp_t serial;
+  int idx, off, slack, npaths;
+
+  *r_paths = NULL;
+  slack = INT_MAX;
+  if (self && !is_ca_cert (cert, &slack))
+    return 0;
+  off = !!self;
+  if (maxlen - off < 1)
+    return 0;  /* No room for the issuer.  */
+
+  loop = self;
+  if (!loop && (image = ksba_cert_get_image (cert, &imagelen)))
+    loop = lookup (store, CERTSTORE_IDX_IMAGE, image, imagelen, 0);
+
+  err = _ksba_cert_get_issuer_dn_ptr (cert, &dn, &dnlen);
+  if (err)
+    return err;
+  err = ksba_cert_get_auth_key_id (cert, &akid, &name, &serial);
+  if (!err)
+    {
+      ksba_name_release (name);
+      ksba_free (serial);
+    }
+  else if (gpg_err_code (err) == GPG_ERR_NO_DATA)
+    err = 0;
+  else
+    return err;
+
+  npaths = 0;
+  for (idx=0; npaths < MAX_PATHS
+         && (candidate = lookup (store, CERTSTORE_IDX_SUBJECT,
+                                 dn, dnlen, idx)); idx++)
+    {
+      if (!check_issuer (candidate, cert, akid))
+        continue;
+      err = compute_paths (store, candidate, maxlen - off, r_budget);
+      if (err)
+        goto leave;
+      for (p = candidate->paths[maxlen - off - 1];
+           p && npaths < MAX_PATHS; p = p->next)
+        {
+          /* A CA certificate takes up one of the intermediate
+             certificates allowed by its issuers.  */
+          if (self && p->slack < 1)
+            continue;
+          if (loop && path_has_item (p, loop))
+            continue;
+          newp = xtrymalloc (sizeof *newp
+                             + (p->length + off - 1) * sizeof *newp->items);
+          if (!newp)
+            {
+              err = gpg_error_from_syserror ();
+              goto leave;
+            }
+          newp->next = NULL;
+          newp->length = p->length + off;
+          newp->slack = p->slack;
+          if (self)
+            {
+              newp->items[0] = self;
+              if (--newp->slack > slack)
+                newp->slack = slack;
+            }
+          memcpy (newp->items + off, p->items, p->length * sizeof *p->items);
+          *tail = newp;
+          tail = &newp->next;
+          npaths++;
+        }
+    }
+
+ leave:
+  xfree (akid);
+  if (err)
+    release_paths (paths);
+  else
+    *r_paths = paths;
+  return err;
+}
+
+
+/* Compute the paths with at most MAXLEN certificates from the
+   certificate of ITEM to a root unless they are already known.
+   Returns GPG_ERR_LIMIT_REACHED if R_BUDGET is exhausted.  */
+static gpg_error_t
+compute_paths (ksba_certstore_t store, struct certstore_item_s *item,
+               int maxlen, int *r_budget)
+{
+  gpg_error_t err;
+  struct certstore_path_s *paths;
+  int slack;
+  int n = maxlen - 1;
+
+  if (item->paths_gen[n] == store->generation)
+    return 0;
+  if (*r_budget <= 0)
+    return gpg_error (GPG_ERR_LIMIT_REACHED);
+  --*r_budget;
+  release_paths (item->paths[n]);
+  item->paths[n] = NULL;
+  item->paths_gen[n] = 0;
+
+  if (is_self_issued (item->cert))
+    {
+      if (!is_ca_cert (item->cert, &slack))
+        paths = NULL;
+      else
+        {
+          paths = xtrymalloc (sizeof *paths);
+          if (!paths)
+            return gpg_error_from_syserror ();
+          paths->next = NULL;
+          paths->slack = slack;
+          paths->length = 1;
+          paths->items[0] = item;
+        }
+    }
+  else
+    {
+      err = build_paths (store, item->cert, item, maxlen, &paths, r_budget);
+      if (err)
+        return err;
+    }
+
+  item->paths[n] = paths;
+  item->paths_gen[n] = store->generation;
+  return 0;
+}
+
+
+/**
+ * ksba_certstore_build_chain:
+ * @store: A certificate store
+ * @cert: The certificate to build a chain for
+ * @idx: Number of chains to skip
+ * @r_chain: Receives an array with the certificates of the chain
+ * @r_length: Receives the number of certificates in @r_chain
+ *
+ * Build a certification path from @cert to a self-issued root
+ * certificate using the certificates of @store.  The first element
+ * of @r_chain is the issuer of @cert and the last one the root;
+ * @cert itself is not included.  The issuer names must match the
+ * subject names; if the authorityKeyIdentifier of a certificate and
+ * the subjectKeyIdentifier of a candidate issuer are both present
+ * they must match too.  All certificates but @cert must be CA
+ * certificates and the pathLenConstraints must be satisfied.  Use
+ * @idx to enumerate alternative paths.  Signatures and validity
+ * periods are not checked.
+ *
+ * The paths of the intermediate certificates are memoized in the
+ * store and reused for all leaves until another certificate is added.
+ * The caller must release the certificates and free the array with
+ * ksba_free.
+ *
+ * Return value: 0 on success, GPG_ERR_NOT_FOUND if there is no
+ * (more) path or GPG_ERR_LIMIT_REACHED if too many certificates had
+ * to be looked at.  In the latter case the work done so far is kept
+ * and the next call continues from there.
+ **/
+gpg_error_t
+ksba_certstore_build_chain (ksba_certstore_t store, ksba_cert_t cert,
+                            int idx, ksba_cert_t **r_chain, int *r_length)
+{
+  gpg_error_t err;
+  struct certstore_path_s *paths, *p;
+  ksba_cert_t *chain;
+  int budget = MAX_EXPANSIONS;
+  int i;
+
+  if (!store || !cert || idx < 0 || !r_chain || !r_length)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_chain = NULL;
+  *r_length = 0;
+
+  err = build_paths (store, cert, NULL, CERTSTORE_MAX_PATH_LENGTH,
+                     &paths, &budget);
+  if (err)
+    return err;
+  for (p = paths; p && idx; p = p->next)
+    idx--;
+  if (!p)
+    err = gpg_error (GPG_ERR_NOT_FOUND);
+  else
+    {
+      chain = xtrymalloc (p->length * sizeof *chain);
+      if (!chain)
+        err = gpg_error_from_syserror ();
+      else
+        {
+          for (i=0; i < p->length; i++)
+            {
+              ksba_cert_ref (p->items[i]->cert);
+              chain[i] = p->items[i]->cert;
+            }
+          *r_chain = chain;
+          *r_length = p->length;
+        }
+    }
+  release_paths (paths);
+  return err;
+}
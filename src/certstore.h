@@ -0,0 +1,95 @@
+/* certstore.h - Internal definitions for the certificate store
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CERTSTORE_H
+#define CERTSTORE_H 1
+
+#include "ksba.h"
+
+/* The indexes of a store.  */
+enum
+  {
+    CERTSTORE_IDX_SUBJECT = 0,  /* DER encoded subject name.  */
+    CERTSTORE_IDX_KEYID,        /* Value of the subjectKeyIdentifier.  */
+    CERTSTORE_IDX_SERIAL,       /* Value of the serial number.  */
+    CERTSTORE_IDX_IMAGE,        /* The entire certificate.  */
+    CERTSTORE_IDX_FPR,          /* The SHA-1 fingerprint.  */
+    CERTSTORE_N_INDEXES
+  };
+
+
+/* The maximum number of certificates in a certification path.  */
+#define CERTSTORE_MAX_PATH_LENGTH 10
+
+
+struct certstore_item_s;
+
+/* A path from a certificate to a root certificate as computed by
+   ksba_certstore_build_chain.  */
+struct certstore_path_s
+{
+  struct certstore_path_s *next;
+  int slack;     /* Number of intermediate certificates allowed below
+                    the first certificate or INT_MAX.  */
+  int length;    /* Number of certificates in ITEMS.  */
+  struct certstore_item_s *items[1];
+};
+
+
+/* A certificate in a store.  */
+struct certstore_item_s
+{
+  ksba_cert_t cert;
+  struct {
+    struct certstore_item_s *next;  /* Next item in the same bucket.  */
+    unsigned int hash;
+    const unsigned char *key;       /* NULL if not in this index.  */
+    size_t keylen;
+  } idx[CERTSTORE_N_INDEXES];
+  ksba_sexp_t keyid;   /* The malloced subjectKeyIdentifier or NULL.  */
+
+  /* The memoized paths from this certificate to a root.  PATHS[N]
+     has the paths with up to N+1 certificates; it is valid if
+     PATHS_GEN[N] matches the generation of the store.  */
+  struct certstore_path_s *paths[CERTSTORE_MAX_PATH_LENGTH];
+  unsigned int paths_gen[CERTSTORE_MAX_PATH_LENGTH];
+};
+
+
+struct ksba_certstore_s
+{
+  size_t nitems;
+  unsigned int generation;  /* Incremented for each added certificate.  */
+  unsigned int size;   /* Number of buckets of each index.  */
+  struct certstore_item_s **buckets[CERTSTORE_N_INDEXES];
+};
+
+
+#endif /*CERTSTORE_H*/
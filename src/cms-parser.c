@@ -49,18 +49,12 @@
 #include "ber-decoder.h"
 #include "ber-help.h"
 #include "keyinfo.h"
+#include "reader.h"
 
 static int
 read_byte (ksba_reader_t reader)
 {
-  unsigned char buf;
-  size_t nread;
-  int rc;
-
-  do
-    rc = ksba_reader_read (reader, &buf, 1, &nread);
-  while (!rc && !nread);
-  return rc? -1: buf;
+  return _ksba_reader_read_byte (reader);
 }
 
 /* read COUNT bytes into buffer.  Return 0 on success */
@@ -90,21 +84,17 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   ksba_asn_tree_t cms_tree;
   BerDecoder decoder;
 
-  err = ksba_asn_create_tree ("cms", &cms_tree);
+  err = _ksba_asn_get_module ("cms", &cms_tree);
   if (err)
     return err;
 
   decoder = _ksba_ber_decoder_new ();
   if (!decoder)
-    {
-      ksba_asn_tree_release (cms_tree);
-      return gpg_error (GPG_ERR_ENOMEM);
-    }
+    return gpg_error (GPG_ERR_ENOMEM);
 
   err = _ksba_ber_decoder_set_reader (decoder, reader);
   if (err)
     {
-      ksba_asn_tree_release (cms_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -112,7 +102,6 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   err = _ksba_ber_decoder_set_module (decoder, cms_tree);
   if (err)
     {
-      ksba_asn_tree_release (cms_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -121,7 +110,6 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
                                   r_root, r_image, r_imagelen);
 
   _ksba_ber_decoder_release (decoder);
-  ksba_asn_tree_release (cms_tree);
   return err;
 }
 
@@ -52,6 +52,7 @@
 #include "sexp-parse.h"
 #include "cert.h"
 #include "der-builder.h"
+#include "hashpipe.h"
 
 
 static gpg_error_t ct_parse_data (ksba_cms_t cms);
@@ -179,8 +180,26 @@ read_hash_block (ksba_cms_t cms, unsigned long nleft)
 {
   gpg_error_t err;
   char buffer[4096];
+  unsigned char *p;
   size_t n, nread;
 
+  /* With a hashing thread read directly into its buffer.  */
+  while (nleft && cms->hashpipe)
+    {
+      p = _ksba_hashpipe_buffer (cms->hashpipe, &n);
+      if (n > nleft)
+        n = nleft;
+      err = ksba_reader_read (cms->reader, (char *)p, n, &nread);
+      if (err)
+        return err;
+      nleft -= nread;
+      if (cms->writer)
+        err = ksba_writer_write (cms->writer, p, nread);
+      _ksba_hashpipe_commit (cms->hashpipe, nread);
+      if (err)
+        return err;
+    }
+
   while (nleft)
     {
       n = nleft < sizeof (buffer)? nleft : sizeof (buffer);
@@ -199,11 +218,9 @@ read_hash_block (ksba_cms_t cms, unsigned long nleft)
 }
 
 
-/* Copy all the bytes from the reader to the writer and hash them if a
-   a hash function has been set.  The writer may be NULL to just do
-   the hashing */
+/* Helper for read_and_hash_cont().  */
 static gpg_error_t
-read_and_hash_cont (ksba_cms_t cms)
+do_read_and_hash_cont (ksba_cms_t cms)
 {
   gpg_error_t err = 0;
   unsigned long nleft;
@@ -313,6 +330,33 @@ read_and_hash_cont (ksba_cms_t cms)
 }
 
 
+/* Copy all the bytes from the reader to the writer and hash them if a
+   a hash function has been set.  The writer may be NULL to just do
+   the hashing */
+static gpg_error_t
+read_and_hash_cont (ksba_cms_t cms)
+{
+  gpg_error_t err;
+
+  if (cms->use_hashpipe && cms->hash_fnc)
+    {
+      err = _ksba_hashpipe_new (&cms->hashpipe, cms->hashpipe_size,
+                                cms->hash_fnc, cms->hash_fnc_arg);
+      if (err)
+        return err;
+    }
+  err = do_read_and_hash_cont (cms);
+  if (cms->hashpipe)
+    {
+      /* The caller finalizes the hash after we return.  */
+      _ksba_hashpipe_flush (cms->hashpipe);
+      _ksba_hashpipe_release (cms->hashpipe);
+      cms->hashpipe = NULL;
+    }
+  return err;
+}
+
+
 
 /* Copy all the encrypted bytes from the reader to the writer.
    Handles indefinite length encoding */
@@ -610,6 +654,7 @@ ksba_cms_release (ksba_cms_t cms)
       _ksba_asn_release_nodes (cms->signer_info->root);
       xfree (cms->signer_info->image);
       xfree (cms->signer_info->cache.digest_algo);
+      _ksba_asn_release_tv_index (cms->signer_info->cache.sigattrs);
       xfree (cms->signer_info);
       cms->signer_info = tmp;
     }
@@ -990,7 +1035,7 @@ ksba_cms_get_digest_algo (ksba_cms_t cms, int idx)
   if (si->cache.digest_algo)
     return si->cache.digest_algo;
 
-  n = _ksba_asn_find_node (si->root, "SignerInfo.digestAlgorithm.algorithm");
+  n = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_DIGESTALGO);
   algo = _ksba_oid_node_to_str (si->image, n);
   if (algo)
     {
@@ -1029,6 +1074,22 @@ ksba_cms_get_cert (ksba_cms_t cms, int idx)
 }
 
 
+/* Return the value of the signed attribute OID of SI or NULL.  IDX is
+   the number of such attributes to skip.  NSIGINFO is the node with
+   the signed attributes.  An index of the attributes is created on
+   first use so that the tree needs to be walked only once.  */
+static AsnNode
+find_signed_attr (struct signer_info_s *si, AsnNode nsiginfo, int idx,
+                  const void *oid, size_t oidlen)
+{
+  if (!si->cache.sigattrs
+      && _ksba_asn_new_tv_index (si->image, nsiginfo, &si->cache.sigattrs))
+    return _ksba_asn_find_type_value (si->image, nsiginfo, idx, oid, oidlen);
+
+  return _ksba_asn_lookup_type_value (si->cache.sigattrs, idx, oid, oidlen);
+}
+
+
 /*
    Return the extension attribute messageDigest
 */
@@ -1054,18 +1115,18 @@ ksba_cms_get_message_digest (ksba_cms_t cms, int idx,
 
   *r_digest = NULL;
   *r_digest_len = 0;
-  nsiginfo = _ksba_asn_find_node (si->root, "SignerInfo.signedAttrs");
+  nsiginfo = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGNEDATTRS);
   if (!nsiginfo)
     return gpg_error (GPG_ERR_BUG);
 
-  n = _ksba_asn_find_type_value (si->image, nsiginfo, 0,
-                                 oid_messageDigest, DIM(oid_messageDigest));
+  n = find_signed_attr (si, nsiginfo, 0,
+                        oid_messageDigest, DIM(oid_messageDigest));
   if (!n)
     return 0; /* this is okay, because the element is optional */
 
   /* check that there is only one */
-  if (_ksba_asn_find_type_value (si->image, nsiginfo, 1,
-                                 oid_messageDigest, DIM(oid_messageDigest)))
+  if (find_signed_attr (si, nsiginfo, 1,
+                        oid_messageDigest, DIM(oid_messageDigest)))
     return gpg_error (GPG_ERR_DUP_VALUE);
 
   /* the value is is a SET OF OCTECT STRING but the set must have
@@ -1108,18 +1169,18 @@ ksba_cms_get_signing_time (ksba_cms_t cms, int idx, ksba_isotime_t r_sigtime)
     return -1;
 
   *r_sigtime = 0;
-  nsiginfo = _ksba_asn_find_node (si->root, "SignerInfo.signedAttrs");
+  nsiginfo = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGNEDATTRS);
   if (!nsiginfo)
     return 0; /* This is okay because signedAttribs are optional. */
 
-  n = _ksba_asn_find_type_value (si->image, nsiginfo, 0,
-                                 oid_signingTime, DIM(oid_signingTime));
+  n = find_signed_attr (si, nsiginfo, 0,
+                        oid_signingTime, DIM(oid_signingTime));
   if (!n)
     return 0; /* This is okay because signing time is optional. */
 
   /* check that there is only one */
-  if (_ksba_asn_find_type_value (si->image, nsiginfo, 1,
-                                 oid_signingTime, DIM(oid_signingTime)))
+  if (find_signed_attr (si, nsiginfo, 1,
+                        oid_signingTime, DIM(oid_signingTime)))
     return gpg_error (GPG_ERR_DUP_VALUE);
 
   /* the value is is a SET OF CHOICE but the set must have
@@ -1169,7 +1230,7 @@ ksba_cms_get_sigattr_oids (ksba_cms_t cms, int idx,
   if (!si)
     return -1; /* no more signers */
 
-  nsiginfo = _ksba_asn_find_node (si->root, "SignerInfo.signedAttrs");
+  nsiginfo = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGNEDATTRS);
   if (!nsiginfo)
     return -1; /* this is okay, because signedAttribs are optional */
 
@@ -1177,8 +1238,8 @@ ksba_cms_get_sigattr_oids (ksba_cms_t cms, int idx,
   if(err)
     return err;
 
-  for (i=0; (n = _ksba_asn_find_type_value (si->image, nsiginfo,
-                                            i, reqoidbuf, reqoidlen)); i++)
+  for (i=0; (n = find_signed_attr (si, nsiginfo, i, reqoidbuf, reqoidlen));
+       i++)
     {
       char *line, *p;
 
@@ -1270,7 +1331,7 @@ ksba_cms_get_sig_val (ksba_cms_t cms, int idx)
   if (!si)
     return NULL;
 
-  n = _ksba_asn_find_node (si->root, "SignerInfo.signatureAlgorithm");
+  n = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGALGO);
   if (!n)
       return NULL;
   if (n->off == -1)
@@ -1518,6 +1579,21 @@ ksba_cms_set_hash_function (ksba_cms_t cms,
 }
 
 
+/* Let the hash function run in a separate thread while reading the
+   content.  It is passed blocks of up to BUFSIZE bytes; with 0 a
+   default size is used.  All data has been hashed when ksba_cms_parse
+   returns KSBA_SR_END_DATA.  */
+gpg_error_t
+ksba_cms_set_hash_pipeline (ksba_cms_t cms, size_t bufsize)
+{
+  if (!cms)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  cms->use_hashpipe = 1;
+  cms->hashpipe_size = bufsize;
+  return 0;
+}
+
+
 /* hash the signed attributes of the given signer */
 gpg_error_t
 ksba_cms_hash_signed_attrs (ksba_cms_t cms, int idx)
@@ -1537,7 +1613,7 @@ ksba_cms_hash_signed_attrs (ksba_cms_t cms, int idx)
   if (!si)
     return -1;
 
-  n = _ksba_asn_find_node (si->root, "SignerInfo.signedAttrs");
+  n = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGNEDATTRS);
   if (!n || n->off == -1)
     return gpg_error (GPG_ERR_NO_VALUE);
 
@@ -2604,8 +2680,7 @@ set_issuer_serial (AsnNode info, ksba_cert_t cert, int mode)
   if (!info || !cert)
     return gpg_error (GPG_ERR_INV_VALUE);
 
-  src = _ksba_asn_find_node (cert->root,
-                             "Certificate.tbsCertificate.serialNumber");
+  src = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_SERIAL);
   dst = _ksba_asn_find_node (info,
                              mode?
                              "rid.issuerAndSerialNumber.serialNumber":
@@ -2614,8 +2689,7 @@ set_issuer_serial (AsnNode info, ksba_cert_t cert, int mode)
   if (err)
     return err;
 
-  src = _ksba_asn_find_node (cert->root,
-                             "Certificate.tbsCertificate.issuer");
+  src = _ksba_asn_find_node_by_handle (cert->root, ASNPATH_CERT_ISSUER);
   dst = _ksba_asn_find_node (info,
                              mode?
                              "rid.issuerAndSerialNumber.issuer":
@@ -2781,7 +2855,7 @@ build_signed_data_attributes (ksba_cms_t cms)
 
   /* Now we have to prepare the signer info.  For now we will just build the
      signedAttributes, so that the user can do the signature calculation */
-  err = ksba_asn_create_tree ("cms", &cms_tree);
+  err = _ksba_asn_get_module ("cms", &cms_tree);
   if (err)
     return err;
 
@@ -3034,7 +3108,6 @@ build_signed_data_attributes (ksba_cms_t cms)
 
  leave:
   _ksba_asn_release_nodes (root);
-  ksba_asn_tree_release (cms_tree);
   for (i = 0; i < attridx; i++)
     {
       _ksba_asn_release_nodes (attrarray[i].root);
@@ -3064,7 +3137,7 @@ build_signed_data_rest (ksba_cms_t cms)
   ksba_der_t dbld = NULL;
 
   /* Now we can really write the signer info */
-  err = ksba_asn_create_tree ("cms", &cms_tree);
+  err = _ksba_asn_get_module ("cms", &cms_tree);
   if (err)
     return err;
 
@@ -3165,7 +3238,7 @@ build_signed_data_rest (ksba_cms_t cms)
 	}
       assert (si->root);
       assert (si->image);
-      n2 = _ksba_asn_find_node (si->root, "SignerInfo.signedAttrs");
+      n2 = _ksba_asn_find_node_by_handle (si->root, ASNPATH_SI_SIGNEDATTRS);
       if (!n2 || !n2->down)
         {
 	  err = gpg_error (GPG_ERR_ELEMENT_NOT_FOUND);
@@ -3306,7 +3379,6 @@ build_signed_data_rest (ksba_cms_t cms)
     err = _ksba_ber_write_tl (cms->writer, 0, 0, 0, 0);
 
  leave:
-  ksba_asn_tree_release (cms_tree);
   _ksba_asn_release_nodes (root);
   ksba_writer_release (tmpwrt);
   _ksba_der_release (dbld);
@@ -96,6 +96,7 @@ struct signer_info_s {
   size_t imagelen;
   struct {
     char *digest_algo;
+    struct asn_tv_index_s *sigattrs;  /* Index of the signed attributes.  */
   } cache;
 };
 
@@ -120,6 +121,12 @@ struct ksba_cms_s {
   void (*hash_fnc)(void *, const void *, size_t);
   void *hash_fnc_arg;
 
+  /* The hashing thread requested by ksba_cms_set_hash_pipeline.  It
+     only exists while the content is read.  */
+  int use_hashpipe;
+  size_t hashpipe_size;
+  struct hashpipe_s *hashpipe;
+
   ksba_stop_reason_t stop_reason;
 
   struct {
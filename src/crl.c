@@ -34,6 +34,7 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "util.h"
 
@@ -44,6 +45,10 @@
 #include "ber-decoder.h"
 #include "crl.h"
 #include "stringbuf.h"
+#include "reader.h"
+#include "sexp-parse.h"
+#include "workpool.h"
+#include "hashpipe.h"
 
 
 static const char oidstr_crlNumber[] = "2.5.29.20";
@@ -54,10 +59,87 @@ static const char oidstr_issuingDistributionPoint[] = "2.5.29.28";
 static const char oidstr_certificateIssuer[] = "2.5.29.29";
 static const char oidstr_authorityKeyIdentifier[] = "2.5.29.35";
 
+/* The DER encodings of the entry extension OIDs.  */
+static const unsigned char oid_crlReason[] =
+  { 0x55, 0x1d, 0x15 };  /* 2.5.29.21 */
+static const unsigned char oid_certificateIssuer[] =
+  { 0x55, 0x1d, 0x1d };  /* 2.5.29.29 */
+
+static gpg_error_t parse_crl_entry (ksba_crl_t crl, int *got_entry);
+
+
+/* Pass BUFFER of LENGTH to the hash function, possibly by means of
+   the hashing thread.  */
+static void
+call_hash (ksba_crl_t crl, const void *buffer, size_t length)
+{
+  if (crl->hashpipe)
+    _ksba_hashpipe_write (crl->hashpipe, buffer, length);
+  else
+    crl->hash_fnc (crl->hash_fnc_arg, buffer, length);
+}
+
+
+/* Pass all data still buffered for hashing to the hash function.  */
+static void
+flush_hash (ksba_crl_t crl)
+{
+  if (crl->hash_fnc && crl->hashbuf.used)
+    call_hash (crl, crl->hashbuf.buffer, crl->hashbuf.used);
+  crl->hashbuf.used = 0;
+  if (crl->hash_fnc && crl->hashmem.len)
+    call_hash (crl, crl->hashmem.ptr, crl->hashmem.len);
+  crl->hashmem.len = 0;
+}
+
+
+/* Called at the end of the signed data to make sure that all of it
+   has been hashed.  */
+static void
+finish_hash (ksba_crl_t crl)
+{
+  flush_hash (crl);
+  if (crl->hashpipe)
+    {
+      _ksba_hashpipe_flush (crl->hashpipe);
+      _ksba_hashpipe_release (crl->hashpipe);
+      crl->hashpipe = NULL;
+    }
+}
+
+
+/* Schedule the LENGTH bytes at BUFFER, which is part of the reader's
+   memory, for hashing.  Adjacent regions are merged so that the
+   entries of a CRL in memory are hashed by one call of the hash
+   function.  */
+static void
+hash_mem (ksba_crl_t crl, const unsigned char *buffer, size_t length)
+{
+  if (!crl->hash_fnc)
+    return;
+  if (crl->hashmem.len && crl->hashmem.ptr + crl->hashmem.len == buffer)
+    {
+      crl->hashmem.len += length;
+      return;
+    }
+  flush_hash (crl);
+  crl->hashmem.ptr = buffer;
+  crl->hashmem.len = length;
+}
+
+
 /* We better buffer the hashing. */
 static inline void
 do_hash (ksba_crl_t crl, const void *buffer, size_t length)
 {
+  if (crl->hashmem.len)
+    flush_hash (crl);
+  if (crl->hashpipe)
+    {
+      /* The pipe does its own buffering.  */
+      _ksba_hashpipe_write (crl->hashpipe, buffer, length);
+      return;
+    }
   while (length)
     {
       size_t n = length;
@@ -117,8 +199,13 @@ ksba_crl_release (ksba_crl_t crl)
   xfree (crl->issuer.image);
 
   xfree (crl->item.serial);
+  xfree (crl->items.slab);
 
   xfree (crl->sigval);
+  _ksba_hashpipe_release (crl->hashpipe);
+  xfree (crl->serials.slab);
+  xfree (crl->serials.entries);
+  xfree (crl->serials.table);
   while (crl->extension_list)
     {
       crl_extn_t tmp = crl->extension_list->next;
@@ -155,6 +242,33 @@ ksba_crl_set_hash_function (ksba_crl_t crl,
 }
 
 
+/**
+ * ksba_crl_set_hash_pipeline:
+ * @crl: CRL object
+ * @bufsize: Size of the blocks passed to the hash function
+ *
+ * Call the hash function from a separate thread so that hashing
+ * overlaps with parsing.  The data is passed to the hash function in
+ * blocks of up to @bufsize bytes; with 0 a default size is used.  The
+ * hash function must thus not depend on the calling thread.  All data
+ * has been hashed when ksba_crl_parse returns %KSBA_SR_READY.  This
+ * must be called before the first call of ksba_crl_parse.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_crl_set_hash_pipeline (ksba_crl_t crl, size_t bufsize)
+{
+  if (!crl)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (crl->any_parse_done)
+    return gpg_error (GPG_ERR_CONFLICT);
+  crl->use_hashpipe = 1;
+  crl->hashpipe_size = bufsize;
+  return 0;
+}
+
+
 
 /*
    access functions
@@ -523,6 +637,7 @@ ksba_crl_get_item (ksba_crl_t crl, ksba_sexp_t *r_serial,
         return gpg_error (GPG_ERR_NO_DATA);
       *r_serial = crl->item.serial;
       crl->item.serial = NULL;
+      crl->item.serialsize = 0;
     }
    if (r_revocation_date)
     _ksba_copy_time (r_revocation_date, crl->item.revocation_date);
@@ -532,6 +647,352 @@ ksba_crl_get_item (ksba_crl_t crl, ksba_sexp_t *r_serial,
 }
 
 
+/**
+ * ksba_crl_get_items:
+ * @crl: CRL object
+ * @entries: An array to receive the entries
+ * @nentries: The number of elements of @entries
+ * @r_count: Returns the number of entries stored in @entries
+ *
+ * Parse up to @nentries entries of the CRL and store them in
+ * @entries.  This may be used instead of ksba_crl_get_item after the
+ * parse function came back with %KSBA_SR_BEGIN_ITEMS or
+ * %KSBA_SR_GOT_ITEM.  The serial numbers point into a buffer owned by
+ * @crl which is valid until the next call of this function,
+ * ksba_crl_parse or ksba_crl_release.  If less than @nentries entries
+ * are returned all entries have been parsed and the next call of
+ * ksba_crl_parse returns %KSBA_SR_END_ITEMS.  The entries are hashed
+ * and indexed as if they had been returned by ksba_crl_parse.
+ *
+ * Return value: 0 on success or an error code.  In case of an error
+ * the first @r_count entries are still valid.
+ **/
+gpg_error_t
+ksba_crl_get_items (ksba_crl_t crl, struct ksba_crl_entry_s *entries,
+                    size_t nentries, size_t *r_count)
+{
+  gpg_error_t err = 0;
+  struct ksba_crl_entry_s *e;
+  size_t count, used, i;
+  int got_entry;
+
+  if (r_count)
+    *r_count = 0;
+  if (!crl || (!entries && nentries) || !r_count)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (!crl->state.in_items)
+    return gpg_error (GPG_ERR_INV_STATE);
+
+  for (used=count=0; count < nentries; count++)
+    {
+      got_entry = 0;
+      err = parse_crl_entry (crl, &got_entry);
+      if (err || !got_entry)
+        break;
+
+      if (used + crl->item.serial_len > crl->items.size)
+        {
+          size_t n = 2 * crl->items.size + crl->item.serial_len + 1024;
+          unsigned char *p = xtryrealloc (crl->items.slab, n);
+          if (!p)
+            {
+              err = gpg_error_from_syserror ();
+              break;
+            }
+          crl->items.slab = p;
+          crl->items.size = n;
+        }
+      memcpy (crl->items.slab + used,
+              crl->item.serial + crl->item.serial_off, crl->item.serial_len);
+      used += crl->item.serial_len;
+
+      e = entries + count;
+      e->serial_len = crl->item.serial_len;
+      _ksba_copy_time (e->revocation_date, crl->item.revocation_date);
+      e->reason = crl->item.reason;
+      e->has_cert_issuer = crl->item.cert_issuer;
+    }
+
+  /* The slab may have been moved; thus set the pointers only now.  */
+  for (used=i=0; i < count; i++)
+    {
+      entries[i].serial = crl->items.slab + used;
+      used += entries[i].serial_len;
+    }
+  *r_count = count;
+  return err;
+}
+
+
+
+/* Return a hash value for the serial number S of length N (FNV-1a).  */
+static unsigned int
+hash_serial (const unsigned char *s, size_t n)
+{
+  unsigned int h = 2166136261u;
+
+  while (n--)
+    {
+      h ^= *s++;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+
+/* Insert the entry IDX of the serial index of CRL into its table.  */
+static void
+insert_serial (ksba_crl_t crl, unsigned int idx)
+{
+  struct crl_serial_s *e = crl->serials.entries + idx;
+  unsigned int mask = crl->serials.tablesize - 1;
+  unsigned int i;
+
+  i = hash_serial (crl->serials.slab + e->off, e->len) & mask;
+  while (crl->serials.table[i])
+    i = (i + 1) & mask;
+  crl->serials.table[i] = idx + 1;
+}
+
+
+/* Make room for N more entries with NBYTES bytes of serial numbers in
+   the serial index of CRL.  */
+static gpg_error_t
+reserve_serials (ksba_crl_t crl, size_t n, size_t nbytes)
+{
+  unsigned int i, size;
+
+  if (nbytes > UINT_MAX - crl->serials.slablen
+      || n > UINT_MAX / 4 - crl->serials.nentries)
+    return gpg_error (GPG_ERR_TOO_LARGE);
+  n += crl->serials.nentries;
+
+  if (crl->serials.slablen + nbytes > crl->serials.slabsize)
+    {
+      size_t newsize = 2 * crl->serials.slabsize + nbytes + 4096;
+      unsigned char *p = xtryrealloc (crl->serials.slab, newsize);
+      if (!p)
+        return gpg_error_from_syserror ();
+      crl->serials.slab = p;
+      crl->serials.slabsize = newsize;
+    }
+  if (n > crl->serials.entriessize)
+    {
+      struct crl_serial_s *p;
+
+      size = crl->serials.entriessize? 2*crl->serials.entriessize : 256;
+      if (size < n)
+        size = n;
+      p = _ksba_reallocarray (crl->serials.entries, crl->serials.entriessize,
+                              size, sizeof *p);
+      if (!p)
+        return gpg_error_from_syserror ();
+      crl->serials.entries = p;
+      crl->serials.entriessize = size;
+    }
+  /* Keep the table at most half full.  */
+  if (2 * n > crl->serials.tablesize)
+    {
+      unsigned int *p;
+
+      size = crl->serials.tablesize? 2*crl->serials.tablesize : 512;
+      while (size < 2 * n)
+        size *= 2;
+      p = xtrycalloc (size, sizeof *p);
+      if (!p)
+        return gpg_error_from_syserror ();
+      xfree (crl->serials.table);
+      crl->serials.table = p;
+      crl->serials.tablesize = size;
+      for (i=0; i < crl->serials.nentries; i++)
+        insert_serial (crl, i);
+    }
+  return 0;
+}
+
+
+/* Store the ISO time DATE in the index entry E.  */
+static void
+pack_serial_date (struct crl_serial_s *e, const char *date)
+{
+  if (*date)
+    {
+      e->year   = atoi_4 (date);
+      e->month  = atoi_2 (date+4);
+      e->day    = atoi_2 (date+6);
+      e->hour   = atoi_2 (date+9);
+      e->minute = atoi_2 (date+11);
+      e->second = atoi_2 (date+13);
+    }
+  else
+    e->year = e->month = e->day = e->hour = e->minute = e->second = 0;
+}
+
+
+/* Add the serial number SERIAL with the values of the entry TMPL to
+   the serial index of CRL.  The caller must have reserved the room
+   for it.  */
+static void
+add_serial (ksba_crl_t crl, const unsigned char *serial,
+            const struct crl_serial_s *tmpl)
+{
+  struct crl_serial_s *e;
+
+  e = crl->serials.entries + crl->serials.nentries;
+  *e = *tmpl;
+  e->off = crl->serials.slablen;
+  memcpy (crl->serials.slab + crl->serials.slablen, serial, e->len);
+  crl->serials.slablen += e->len;
+  insert_serial (crl, crl->serials.nentries++);
+}
+
+
+/* Add the serial number SERIAL of length LEN with its revocation
+   DATE and REASON to the serial index of CRL.  */
+static gpg_error_t
+index_serial (ksba_crl_t crl, const unsigned char *serial, size_t len,
+              const ksba_isotime_t date, ksba_crl_reason_t reason)
+{
+  gpg_error_t err;
+  struct crl_serial_s e;
+
+  if (len > USHRT_MAX)
+    return gpg_error (GPG_ERR_TOO_LARGE);
+  err = reserve_serials (crl, 1, len);
+  if (err)
+    return err;
+
+  memset (&e, 0, sizeof e);
+  e.len = len;
+  e.reason = reason;
+  pack_serial_date (&e, date);
+  add_serial (crl, serial, &e);
+  return 0;
+}
+
+
+/**
+ * ksba_crl_set_serial_index:
+ * @crl: CRL object
+ * @enable: True to build the index
+ *
+ * Make the parser build an index of the revoked serial numbers which
+ * can be queried with ksba_crl_lookup_serial.  This must be called
+ * before the first call of ksba_crl_parse.  The entries are still
+ * returned by ksba_crl_parse and ksba_crl_get_item.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_crl_set_serial_index (ksba_crl_t crl, int enable)
+{
+  if (!crl)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (crl->any_parse_done)
+    return gpg_error (GPG_ERR_CONFLICT);
+  crl->serials.enabled = !!enable;
+  return 0;
+}
+
+
+/**
+ * ksba_crl_set_parallel:
+ * @crl: CRL object
+ * @nthreads: Number of threads to use
+ *
+ * Make the parser build the index of the revoked serial numbers as
+ * with ksba_crl_set_serial_index but without returning the entries.
+ * After %KSBA_SR_BEGIN_ITEMS the next call of ksba_crl_parse parses
+ * all entries and returns with %KSBA_SR_END_ITEMS.  If the reader's
+ * data is in memory the entries are decoded by @nthreads threads
+ * including the calling one; with 0 the number of processors is used.
+ * The entries are still hashed in order.  This must be called before
+ * the first call of ksba_crl_parse.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_crl_set_parallel (ksba_crl_t crl, unsigned int nthreads)
+{
+  if (!crl)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (crl->any_parse_done)
+    return gpg_error (GPG_ERR_CONFLICT);
+  crl->serials.enabled = 1;
+  crl->serials.parallel = 1;
+  crl->serials.nthreads = nthreads;
+  return 0;
+}
+
+
+/**
+ * ksba_crl_lookup_serial:
+ * @crl: CRL object
+ * @serial: The serial number as S-expression
+ * @r_revocation_date: Returns the revocation date or NULL
+ * @r_reason: Returns the reason for revocation or NULL
+ *
+ * Look up the serial number @serial, as for example returned by
+ * ksba_cert_get_serial, in the index built if ksba_crl_set_serial_index
+ * has been used.  The index is complete after ksba_crl_parse returned
+ * with %KSBA_SR_END_ITEMS.  If the CRL lists a serial number more than
+ * once the first entry is returned.  The certificateIssuer entry
+ * extension of indirect CRLs is not taken into account.
+ *
+ * Return value: 0 if the serial number has been revoked,
+ * GPG_ERR_NOT_FOUND if not, GPG_ERR_NO_DATA if there is no index or
+ * another error code.
+ **/
+gpg_error_t
+ksba_crl_lookup_serial (ksba_crl_t crl, ksba_const_sexp_t serial,
+                        ksba_isotime_t r_revocation_date,
+                        ksba_crl_reason_t *r_reason)
+{
+  const unsigned char *s;
+  size_t n;
+  unsigned int i, idx, mask;
+  struct crl_serial_s *e;
+
+  if (r_revocation_date)
+    *r_revocation_date = 0;
+  if (r_reason)
+    *r_reason = 0;
+  if (!crl || !serial)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (!crl->serials.enabled)
+    return gpg_error (GPG_ERR_NO_DATA);
+
+  s = serial;
+  if (*s != '(')
+    return gpg_error (GPG_ERR_INV_SEXP);
+  s++;
+  n = snext (&s);
+  if (!n || s[n] != ')')
+    return gpg_error (GPG_ERR_INV_SEXP);
+
+  if (!crl->serials.tablesize)
+    return gpg_error (GPG_ERR_NOT_FOUND);
+  mask = crl->serials.tablesize - 1;
+  for (i = hash_serial (s, n) & mask; (idx = crl->serials.table[i]);
+       i = (i + 1) & mask)
+    {
+      e = crl->serials.entries + idx - 1;
+      if (e->len == n && !memcmp (crl->serials.slab + e->off, s, n))
+        {
+          if (r_revocation_date && e->year)
+            snprintf (r_revocation_date, sizeof (ksba_isotime_t),
+                      "%04u%02u%02uT%02u%02u%02u",
+                      e->year % 10000, e->month % 100, e->day % 100,
+                      e->hour % 100, e->minute % 100, e->second % 100);
+          if (r_reason)
+            *r_reason = e->reason;
+          return 0;
+        }
+    }
+  return gpg_error (GPG_ERR_NOT_FOUND);
+}
+
+
 
 /**
  * ksba_crl_get_sig_val:
@@ -601,14 +1062,7 @@ ksba_crl_get_sig_val (ksba_crl_t crl)
 static int
 read_byte (ksba_reader_t reader)
 {
-  unsigned char buf;
-  size_t nread;
-  int rc;
-
-  do
-    rc = ksba_reader_read (reader, &buf, 1, &nread);
-  while (!rc && !nread);
-  return rc? -1: buf;
+  return _ksba_reader_read_byte (reader);
 }
 
 /* read COUNT bytes into buffer.  Return 0 on success */
@@ -638,21 +1092,17 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   ksba_asn_tree_t crl_tree;
   BerDecoder decoder;
 
-  err = ksba_asn_create_tree ("tmttv2", &crl_tree);
+  err = _ksba_asn_get_module ("tmttv2", &crl_tree);
   if (err)
     return err;
 
   decoder = _ksba_ber_decoder_new ();
   if (!decoder)
-    {
-      ksba_asn_tree_release (crl_tree);
-      return gpg_error (GPG_ERR_ENOMEM);
-    }
+    return gpg_error (GPG_ERR_ENOMEM);
 
   err = _ksba_ber_decoder_set_reader (decoder, reader);
   if (err)
     {
-      ksba_asn_tree_release (crl_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -660,7 +1110,6 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   err = _ksba_ber_decoder_set_module (decoder, crl_tree);
   if (err)
     {
-      ksba_asn_tree_release (crl_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -669,22 +1118,24 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
                                   r_root, r_image, r_imagelen);
 
   _ksba_ber_decoder_release (decoder);
-  ksba_asn_tree_release (crl_tree);
   return err;
 }
 
 
 /* Parse the extension in the buffer DER or length DERLEN and return
-   the result in OID, CRITICAL, OFF and LEN. */
+   the result in OID, CRITICAL, OFF and LEN.  OID and OIDLEN describe
+   the DER encoded value of the OID in DER. */
 static gpg_error_t
-parse_one_extension (const unsigned char *der, size_t derlen,
-                     char **oid, int *critical, size_t *off, size_t *len)
+parse_one_extension_raw (const unsigned char *der, size_t derlen,
+                         const unsigned char **oid, size_t *oidlen,
+                         int *critical, size_t *off, size_t *len)
 {
   gpg_error_t err;
   struct tag_info ti;
   const unsigned char *start = der;
 
   *oid = NULL;
+  *oidlen = 0;
   *critical = 0;
   *off = *len = 0;
 
@@ -696,22 +1147,32 @@ parse_one_extension (const unsigned char *der, size_t derlen,
   */
   err = parse_sequence (&der, &derlen, &ti);
   if (err)
-    goto failure;
+    return err;
 
-  err = parse_object_id_into_str (&der, &derlen, oid);
+  err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
-    goto failure;
+    return err;
+  if (!(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_OBJECT_ID
+        && !ti.is_constructed))
+    return gpg_error (GPG_ERR_INV_OBJ);
+  if (!ti.length)
+    return gpg_error (GPG_ERR_TOO_SHORT);
+  if (ti.length > derlen)
+    return gpg_error (GPG_ERR_BAD_BER);
+  *oid = der;
+  *oidlen = ti.length;
+  parse_skip (&der, &derlen, &ti);
 
   err = _ksba_ber_parse_tl (&der, &derlen, &ti);
   if (err)
-    goto failure;
+    return err;
   if (ti.length > derlen)
     return gpg_error (GPG_ERR_BAD_BER);
   if (ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_BOOLEAN
            && !ti.is_constructed)
     {
       if (ti.length != 1)
-        goto bad_ber;
+        return gpg_error (GPG_ERR_BAD_BER);
       *critical = !!*der;
       parse_skip (&der, &derlen, &ti);
     }
@@ -723,18 +1184,33 @@ parse_one_extension (const unsigned char *der, size_t derlen,
 
   err = parse_octet_string (&der, &derlen, &ti);
   if (err)
-    goto failure;
+    return err;
   *off = der - start;
   *len = ti.length;
 
   return 0;
+}
+
+
+/* Parse the extension in the buffer DER or length DERLEN and return
+   the result in OID, CRITICAL, OFF and LEN. */
+static gpg_error_t
+parse_one_extension (const unsigned char *der, size_t derlen,
+                     char **oid, int *critical, size_t *off, size_t *len)
+{
+  gpg_error_t err;
+  const unsigned char *oidder;
+  size_t oidlen;
 
- bad_ber:
-  err = gpg_error (GPG_ERR_BAD_BER);
- failure:
-  xfree (*oid);
   *oid = NULL;
-  return err;
+  err = parse_one_extension_raw (der, derlen, &oidder, &oidlen,
+                                 critical, off, len);
+  if (err)
+    return err;
+  *oid = ksba_oid_to_str (oidder, oidlen);
+  if (!*oid)
+    return gpg_error_from_syserror ();
+  return 0;
 }
 
 
@@ -1018,20 +1494,56 @@ parse_to_next_update (ksba_crl_t crl)
 
 
 
-/* Store an entry extension into the current item. */
+/* Return true if the encoded OID at OID of length OIDLEN is the OID
+   with the DER encoding DEROID of length DERLEN or, in dotted form,
+   OIDSTR.  A minimal encoding is compared directly; only other
+   encodings need to be converted to a string.  This way malformed
+   OIDs are matched the same way ksba_oid_to_str sees them.  */
+static int
+entry_extension_oid_is (const unsigned char *oid, size_t oidlen,
+                        const unsigned char *deroid, size_t derlen,
+                        const char *oidstr)
+{
+  char *string;
+  size_t n;
+  int result;
+
+  if (oidlen == derlen && !memcmp (oid, deroid, derlen))
+    return 1;
+
+  for (n=0; n < oidlen; n++)
+    if (oid[n] == 0x80 && (!n || !(oid[n-1] & 0x80)))
+      break; /* Leading zero bits in a subidentifier.  */
+  if (n == oidlen && oidlen && !(oid[oidlen-1] & 0x80))
+    return 0; /* Minimal encoding of another OID.  */
+
+  string = ksba_oid_to_str (oid, oidlen);
+  result = string && !strcmp (string, oidstr);
+  xfree (string);
+  return result;
+}
+
+
+/* Parse an entry extension and update the REASON and CERT_ISSUER of
+   the entry accordingly. */
 static gpg_error_t
-store_one_entry_extension (ksba_crl_t crl,
-                           const unsigned char *der, size_t derlen)
+store_one_entry_extension (const unsigned char *der, size_t derlen,
+                           ksba_crl_reason_t *reason, int *cert_issuer)
 {
   gpg_error_t err;
-  char *oid;
+  const unsigned char *oid;
+  size_t oidlen;
   int critical;
   size_t off, len;
 
-  err = parse_one_extension (der, derlen, &oid, &critical, &off, &len);
+  /* This is called for each entry; thus we compare the DER encoded
+     OIDs instead of converting them to strings whenever possible.  */
+  err = parse_one_extension_raw (der, derlen, &oid, &oidlen,
+                                 &critical, &off, &len);
   if (err)
     return err;
-  if (!strcmp (oid, oidstr_crlReason))
+  if (entry_extension_oid_is (oid, oidlen, oid_crlReason,
+                              sizeof oid_crlReason, oidstr_crlReason))
     {
       struct tag_info ti;
       const unsigned char *buf = der+off;
@@ -1044,32 +1556,154 @@ store_one_entry_extension (ksba_crl_t crl,
          repeated we can track all reason codes. */
       switch (*buf)
         {
-        case  0: crl->item.reason |= KSBA_CRLREASON_UNSPECIFIED; break;
-        case  1: crl->item.reason |= KSBA_CRLREASON_KEY_COMPROMISE; break;
-        case  2: crl->item.reason |= KSBA_CRLREASON_CA_COMPROMISE; break;
-        case  3: crl->item.reason |= KSBA_CRLREASON_AFFILIATION_CHANGED; break;
-        case  4: crl->item.reason |= KSBA_CRLREASON_SUPERSEDED; break;
-        case  5: crl->item.reason |= KSBA_CRLREASON_CESSATION_OF_OPERATION;
+        case  0: *reason |= KSBA_CRLREASON_UNSPECIFIED; break;
+        case  1: *reason |= KSBA_CRLREASON_KEY_COMPROMISE; break;
+        case  2: *reason |= KSBA_CRLREASON_CA_COMPROMISE; break;
+        case  3: *reason |= KSBA_CRLREASON_AFFILIATION_CHANGED; break;
+        case  4: *reason |= KSBA_CRLREASON_SUPERSEDED; break;
+        case  5: *reason |= KSBA_CRLREASON_CESSATION_OF_OPERATION;
           break;
-        case  6: crl->item.reason |= KSBA_CRLREASON_CERTIFICATE_HOLD; break;
-        case  8: crl->item.reason |= KSBA_CRLREASON_REMOVE_FROM_CRL; break;
-        case  9: crl->item.reason |= KSBA_CRLREASON_PRIVILEGE_WITHDRAWN; break;
-        case 10: crl->item.reason |= KSBA_CRLREASON_AA_COMPROMISE; break;
-        default: crl->item.reason |= KSBA_CRLREASON_OTHER; break;
+        case  6: *reason |= KSBA_CRLREASON_CERTIFICATE_HOLD; break;
+        case  8: *reason |= KSBA_CRLREASON_REMOVE_FROM_CRL; break;
+        case  9: *reason |= KSBA_CRLREASON_PRIVILEGE_WITHDRAWN; break;
+        case 10: *reason |= KSBA_CRLREASON_AA_COMPROMISE; break;
+        default: *reason |= KSBA_CRLREASON_OTHER; break;
         }
     }
-  if (!strcmp (oid, oidstr_certificateIssuer))
+  if (entry_extension_oid_is (oid, oidlen, oid_certificateIssuer,
+                              sizeof oid_certificateIssuer,
+                              oidstr_certificateIssuer))
     {
       /* FIXME: We need to implement this. */
+      *cert_issuer = 1;
     }
   else if (critical)
     err = gpg_error (GPG_ERR_UNKNOWN_CRIT_EXTN);
 
-  xfree (oid);
-
   return err;
 }
 
+/* Store the serial number VALUE of length LENGTH as the serial
+   number of the current item and clear the other values.  */
+static gpg_error_t
+set_item_serial (ksba_crl_t crl, const unsigned char *value, size_t length)
+{
+  char numbuf[22];
+  int numbuflen;
+
+  sprintf (numbuf,"(%u:", (unsigned int)length);
+  numbuflen = strlen (numbuf);
+  /* The buffer is reused unless the caller took it with
+     ksba_crl_get_item.  */
+  if (crl->item.serialsize < numbuflen + length + 2)
+    {
+      xfree (crl->item.serial);
+      crl->item.serialsize = 0;
+      crl->item.serial = xtrymalloc (numbuflen + length + 2);
+      if (!crl->item.serial)
+        return gpg_error (GPG_ERR_ENOMEM);
+      crl->item.serialsize = numbuflen + length + 2;
+    }
+  strcpy (crl->item.serial, numbuf);
+  memcpy (crl->item.serial+numbuflen, value, length);
+  crl->item.serial[numbuflen + length] = ')';
+  crl->item.serial[numbuflen + length + 1] = 0;
+  crl->item.serial_off = numbuflen;
+  crl->item.serial_len = length;
+  crl->item.reason = 0;
+  crl->item.cert_issuer = 0;
+  return 0;
+}
+
+
+/* The values of an entry as parsed by parse_crl_entry_mem.  */
+struct entry_info_s
+{
+  const unsigned char *serial;  /* Points into the parsed buffer.  */
+  size_t serial_len;
+  ksba_isotime_t revocation_date;
+  ksba_crl_reason_t reason;
+  int cert_issuer;
+};
+
+
+/* Parse the content of an entry directly from the buffer DER of
+   length DERLEN and store the values at INFO.  This is the fast path
+   of parse_crl_entry for CRLs in memory; it does not change any state
+   and may thus also be used by several threads.  On error the caller
+   falls back to the regular path which also takes care of returning
+   the same error code as before.  The size limits of the regular path
+   are checked as well.  */
+static gpg_error_t
+parse_crl_entry_mem (const unsigned char *der, size_t derlen,
+                     struct entry_info_s *info)
+{
+  gpg_error_t err;
+  struct tag_info ti;
+
+  /* The serial number.  */
+  err = _ksba_ber_parse_tl (&der, &derlen, &ti);
+  if (err)
+    return err;
+  if ( !(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_INTEGER
+         && !ti.is_constructed && !ti.ndef) )
+    return gpg_error (GPG_ERR_INV_CRL_OBJ);
+  if (ti.length > derlen || ti.nhdr + ti.length >= 4096)
+    return gpg_error (GPG_ERR_BAD_BER);
+  info->serial = der;
+  info->serial_len = ti.length;
+  info->reason = 0;
+  info->cert_issuer = 0;
+  parse_skip (&der, &derlen, &ti);
+
+  /* The revocation time.  */
+  err = _ksba_ber_parse_tl (&der, &derlen, &ti);
+  if (err)
+    return err;
+  if ( !(ti.class == CLASS_UNIVERSAL
+         && (ti.tag == TYPE_UTC_TIME || ti.tag == TYPE_GENERALIZED_TIME)
+         && !ti.is_constructed && !ti.ndef) )
+    return gpg_error (GPG_ERR_INV_CRL_OBJ);
+  if (ti.length > derlen || ti.nhdr + ti.length >= 4096)
+    return gpg_error (GPG_ERR_BAD_BER);
+  _ksba_asntime_to_iso (der, ti.length,
+                        ti.tag == TYPE_UTC_TIME, info->revocation_date);
+  parse_skip (&der, &derlen, &ti);
+
+  if (!derlen)
+    return 0;
+
+  /* The entry extensions.  Like the regular path we loop over the
+     rest of the entry and not just the outer sequence.  */
+  err = _ksba_ber_parse_tl (&der, &derlen, &ti);
+  if (err)
+    return err;
+  if ( !(ti.class == CLASS_UNIVERSAL
+         && ti.tag == TYPE_SEQUENCE && ti.is_constructed && !ti.ndef) )
+    return gpg_error (GPG_ERR_INV_CRL_OBJ);
+  if (ti.length > derlen)
+    return gpg_error (GPG_ERR_BAD_BER);
+  while (derlen)
+    {
+      err = _ksba_ber_parse_tl (&der, &derlen, &ti);
+      if (err)
+        return err;
+      if ( !(ti.class == CLASS_UNIVERSAL
+             && ti.tag == TYPE_SEQUENCE && ti.is_constructed && !ti.ndef) )
+        return gpg_error (GPG_ERR_INV_CRL_OBJ);
+      if (ti.length > derlen || ti.nhdr + ti.length >= 4096)
+        return gpg_error (GPG_ERR_BAD_BER);
+      err = store_one_entry_extension (der - ti.nhdr, ti.nhdr + ti.length,
+                                       &info->reason, &info->cert_issuer);
+      if (err)
+        return err;
+      parse_skip (&der, &derlen, &ti);
+    }
+
+  return 0;
+}
+
+
 /* Parse the revokedCertificates SEQUENCE of SEQUENCE using a custom
    parser for efficiency and return after each entry */
 static gpg_error_t
@@ -1082,8 +1716,9 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
   unsigned long len;
   int ndef;
   unsigned char tmpbuf[4096]; /* for time, serial number and extensions */
-  char numbuf[22];
-  int numbuflen;
+  const unsigned char *mem;
+  size_t avail;
+  struct entry_info_s info;
 
   /* Check the length to see whether we are at the end of the seq but do
      this only when we know that we have this optional seq of seq. */
@@ -1097,7 +1732,6 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
   if ( !(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_SEQUENCE
          && ti.is_constructed) )
     return gpg_error (GPG_ERR_INV_CRL_OBJ);
-  HASH (ti.buf, ti.nhdr);
   if (!seqseq_ndef)
     {
       if (seqseq_len < ti.nhdr)
@@ -1110,6 +1744,30 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
   ndef = ti.ndef;
   len  = ti.length;
 
+  /* If the entry is available in the memory of the reader, directly
+     parse it from there.  The header has already been read.  */
+  if (!ndef
+      && (mem = _ksba_reader_peek_mem (crl->reader, ti.nhdr, &avail))
+      && avail - ti.nhdr >= len
+      && !memcmp (mem, ti.buf, ti.nhdr)
+      && !parse_crl_entry_mem (mem + ti.nhdr, len, &info))
+    {
+      err = set_item_serial (crl, info.serial, info.serial_len);
+      if (err)
+        return err;
+      memcpy (crl->item.revocation_date, info.revocation_date,
+              sizeof crl->item.revocation_date);
+      crl->item.reason = info.reason;
+      crl->item.cert_issuer = info.cert_issuer;
+      err = _ksba_reader_skip (crl->reader, len);
+      if (err)
+        return err;
+      hash_mem (crl, mem, ti.nhdr + len);
+      goto entry_done;
+    }
+
+  HASH (ti.buf, ti.nhdr);
+
   /* get the serial number */
   err = _ksba_ber_read_tl (crl->reader, &ti);
   if (err)
@@ -1133,18 +1791,9 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
   if (err)
     return err;
   HASH (tmpbuf, ti.nhdr+ti.length);
-
-  xfree (crl->item.serial);
-  sprintf (numbuf,"(%u:", (unsigned int)ti.length);
-  numbuflen = strlen (numbuf);
-  crl->item.serial = xtrymalloc (numbuflen + ti.length + 2);
-  if (!crl->item.serial)
-    return gpg_error (GPG_ERR_ENOMEM);
-  strcpy (crl->item.serial, numbuf);
-  memcpy (crl->item.serial+numbuflen, tmpbuf+ti.nhdr, ti.length);
-  crl->item.serial[numbuflen + ti.length] = ')';
-  crl->item.serial[numbuflen + ti.length + 1] = 0;
-  crl->item.reason = 0;
+  err = set_item_serial (crl, tmpbuf+ti.nhdr, ti.length);
+  if (err)
+    return err;
 
   /* get the revocation time */
   err = _ksba_ber_read_tl (crl->reader, &ti);
@@ -1219,12 +1868,24 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
           if (err)
             return err;
           HASH (tmpbuf, ti.nhdr+ti.length);
-          err = store_one_entry_extension (crl, tmpbuf, ti.nhdr+ti.length);
+          err = store_one_entry_extension (tmpbuf, ti.nhdr+ti.length,
+                                           &crl->item.reason,
+                                           &crl->item.cert_issuer);
           if (err)
             return err;
         }
     }
 
+ entry_done:
+  if (crl->serials.enabled)
+    {
+      err = index_serial (crl, crl->item.serial + crl->item.serial_off,
+                          crl->item.serial_len,
+                          crl->item.revocation_date, crl->item.reason);
+      if (err)
+        return err;
+    }
+
   /* read ahead */
   err = _ksba_ber_read_tl (crl->reader, &ti);
   if (err)
@@ -1241,6 +1902,177 @@ parse_crl_entry (ksba_crl_t crl, int *got_entry)
 }
 
 
+/* The arguments of parse_entries_parallel for the workers.  */
+struct parallel_parm_s
+{
+  const unsigned char *base;     /* The first entry.  */
+  size_t *chunks;                /* Offset of each chunk and the end.  */
+  struct crl_serial_s *entries;  /* The parsed entries; OFF is the
+                                    offset of the serial from BASE.  */
+  gpg_error_t *errs;             /* The error code of each chunk.  */
+};
+
+/* Number of entries in a chunk.  */
+#define PARALLEL_CHUNK 256
+
+
+static void
+parse_entries_chunk (void *opaque, size_t idx)
+{
+  struct parallel_parm_s *parm = opaque;
+  const unsigned char *der = parm->base + parm->chunks[idx];
+  size_t derlen = parm->chunks[idx+1] - parm->chunks[idx];
+  struct crl_serial_s *e = parm->entries + idx * PARALLEL_CHUNK;
+  struct entry_info_s info;
+  struct tag_info ti;
+  gpg_error_t err = 0;
+
+  while (derlen)
+    {
+      err = _ksba_ber_parse_tl (&der, &derlen, &ti);
+      if (err)
+        break;
+      err = parse_crl_entry_mem (der, ti.length, &info);
+      if (err)
+        break;
+      memset (e, 0, sizeof *e);
+      e->off = info.serial - parm->base;
+      e->len = info.serial_len;
+      e->reason = info.reason;
+      pack_serial_date (e, info.revocation_date);
+      e++;
+      parse_skip (&der, &derlen, &ti);
+    }
+  parm->errs[idx] = err;
+}
+
+
+/* Parse all entries of the CRL with several threads and add them to
+   the serial index.  This requires that the entries are in the memory
+   of the reader.  The entries are first located by walking over their
+   headers; then chunks of entries are decoded in parallel and finally
+   added to the index in their original order.  Returns false if this
+   is not possible or if an entry can't be parsed; nothing has been
+   changed then and the regular parser needs to be used.  Errors which
+   happen after the entries have been parsed are returned at R_ERR.  */
+static int
+parse_entries_parallel (ksba_crl_t crl, gpg_error_t *r_err)
+{
+  gpg_error_t err;
+  struct tag_info ti = crl->state.ti;
+  struct parallel_parm_s parm;
+  const unsigned char *mem, *der;
+  size_t avail, total, derlen, nentries, nchunks, chunkssize, nbytes, i;
+  int okay = 0;
+
+  *r_err = 0;
+  if (!crl->state.have_seqseq || crl->state.seqseq_ndef
+      || crl->state.seqseq_len < ti.nhdr)
+    return 0;
+  total = crl->state.seqseq_len;
+  mem = _ksba_reader_peek_mem (crl->reader, ti.nhdr, &avail);
+  if (!mem || avail < total || total > UINT_MAX
+      || memcmp (mem, ti.buf, ti.nhdr))
+    return 0;
+
+  memset (&parm, 0, sizeof parm);
+  parm.base = mem;
+
+  /* Locate the entries and split them into chunks.  */
+  der = mem;
+  derlen = total;
+  nentries = nchunks = chunkssize = 0;
+  while (derlen)
+    {
+      if (_ksba_ber_parse_tl (&der, &derlen, &ti)
+          || !(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_SEQUENCE
+               && ti.is_constructed && !ti.ndef)
+          || ti.length > derlen)
+        goto leave;
+      if (!(nentries % PARALLEL_CHUNK))
+        {
+          if (nchunks + 2 > chunkssize)
+            {
+              size_t n = chunkssize? 2 * chunkssize : 64;
+              size_t *p = _ksba_reallocarray (parm.chunks, chunkssize,
+                                              n, sizeof *p);
+              if (!p)
+                goto leave;
+              parm.chunks = p;
+              chunkssize = n;
+            }
+          parm.chunks[nchunks++] = der - ti.nhdr - mem;
+        }
+      nentries++;
+      parse_skip (&der, &derlen, &ti);
+    }
+  if (!nchunks)
+    goto leave;
+  parm.chunks[nchunks] = total;
+
+  parm.entries = xtrycalloc (nentries, sizeof *parm.entries);
+  parm.errs = xtrycalloc (nchunks, sizeof *parm.errs);
+  if (!parm.entries || !parm.errs)
+    goto leave;
+  if (_ksba_workpool_run (nchunks, crl->serials.nthreads,
+                          parse_entries_chunk, &parm))
+    goto leave;
+  for (i=0; i < nchunks; i++)
+    if (parm.errs[i])
+      goto leave;
+
+  /* From here on the entries count as parsed.  */
+  okay = 1;
+  for (nbytes=i=0; i < nentries; i++)
+    nbytes += parm.entries[i].len;
+  err = reserve_serials (crl, nentries, nbytes);
+  if (err)
+    goto leave;
+  for (i=0; i < nentries; i++)
+    add_serial (crl, mem + parm.entries[i].off, parm.entries + i);
+
+  /* Skip the entries; the header of the first one has already been
+     read.  Then read ahead as parse_crl_entry does.  */
+  err = _ksba_reader_skip (crl->reader, total - crl->state.ti.nhdr);
+  if (err)
+    goto leave;
+  hash_mem (crl, mem, total);
+  err = _ksba_ber_read_tl (crl->reader, &ti);
+  if (err)
+    goto leave;
+  crl->state.ti = ti;
+  crl->state.seqseq_len = 0;
+
+ leave:
+  xfree (parm.chunks);
+  xfree (parm.entries);
+  xfree (parm.errs);
+  if (okay)
+    *r_err = err;
+  return okay;
+}
+
+
+/* Parse all entries of the CRL and add them to the serial index.  */
+static gpg_error_t
+parse_all_entries (ksba_crl_t crl)
+{
+  gpg_error_t err;
+  int got_entry;
+
+  if (parse_entries_parallel (crl, &err))
+    return err;
+
+  do
+    {
+      got_entry = 0;
+      err = parse_crl_entry (crl, &got_entry);
+    }
+  while (!err && got_entry);
+  return err;
+}
+
+
 /* This function is used when a [0] tag was encountered to read the
    crlExtensions */
 static gpg_error_t
@@ -1415,19 +2247,24 @@ ksba_crl_parse (ksba_crl_t crl, ksba_stop_reason_t *r_stopreason)
   switch (state)
     {
     case sSTART:
-      err = parse_to_next_update (crl);
+      if (crl->use_hashpipe && crl->hash_fnc && !crl->hashpipe)
+        err = _ksba_hashpipe_new (&crl->hashpipe, crl->hashpipe_size,
+                                  crl->hash_fnc, crl->hash_fnc_arg);
+      if (!err)
+        err = parse_to_next_update (crl);
       break;
     case sCRLENTRY:
-      err = parse_crl_entry (crl, &got_entry);
+      if (crl->serials.parallel)
+        err = parse_all_entries (crl);
+      else
+        err = parse_crl_entry (crl, &got_entry);
       break;
     case sCRLEXT:
+      crl->state.in_items = 0;
       err = parse_crl_extensions (crl);
       if (!err)
         {
-          if (crl->hash_fnc && crl->hashbuf.used)
-            crl->hash_fnc (crl->hash_fnc_arg,
-                           crl->hashbuf.buffer, crl->hashbuf.used);
-          crl->hashbuf.used = 0;
+          finish_hash (crl);
           err = parse_signature (crl);
         }
       break;
@@ -1443,6 +2280,7 @@ ksba_crl_parse (ksba_crl_t crl, ksba_stop_reason_t *r_stopreason)
     {
     case sSTART:
       stop_reason = KSBA_SR_BEGIN_ITEMS;
+      crl->state.in_items = 1;
       break;
     case sCRLENTRY:
       stop_reason = got_entry? KSBA_SR_GOT_ITEM : KSBA_SR_END_ITEMS;
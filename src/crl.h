@@ -48,6 +48,16 @@ struct crl_extn_s {
 };
 typedef struct crl_extn_s *crl_extn_t;
 
+/* An entry of the index of revoked serial numbers.  */
+struct crl_serial_s
+{
+  unsigned int off;         /* Offset of the serial number in the slab.  */
+  unsigned short len;       /* Length of the serial number.  */
+  unsigned short reason;    /* The ksba_crl_reason_t flags.  */
+  unsigned short year;      /* The revocation date.  */
+  unsigned char month, day, hour, minute, second;
+};
+
 struct ksba_crl_s {
   gpg_error_t last_error;
 
@@ -62,6 +72,7 @@ struct ksba_crl_s {
     unsigned long outer_len, tbs_len, seqseq_len;
     int outer_ndef, tbs_ndef, seqseq_ndef;
     int have_seqseq;
+    int in_items;      /* Between BEGIN_ITEMS and END_ITEMS.  */
   } state;
 
   int crl_version;
@@ -80,10 +91,20 @@ struct ksba_crl_s {
 
   struct {
     ksba_sexp_t serial;
+    size_t serialsize;        /* Allocated size of SERIAL.  */
+    size_t serial_off;        /* Offset of the raw value in SERIAL.  */
+    size_t serial_len;        /* Length of the raw value.  */
     ksba_crl_reason_t reason;
     ksba_isotime_t revocation_date;
+    int cert_issuer;          /* The certificateIssuer extension is used.  */
   } item;
 
+  /* The serial numbers of the entries returned by ksba_crl_get_items.  */
+  struct {
+    unsigned char *slab;
+    size_t size;
+  } items;
+
   crl_extn_t extension_list;
   ksba_sexp_t sigval;
 
@@ -92,6 +113,35 @@ struct ksba_crl_s {
     char buffer[8192];
   } hashbuf;
 
+  /* A region of the reader's buffer which still needs to be hashed.
+     It is used instead of HASHBUF when parsing entries directly from
+     the memory of the reader.  */
+  struct {
+    const unsigned char *ptr;
+    size_t len;
+  } hashmem;
+
+  /* The hashing thread requested by ksba_crl_set_hash_pipeline.  It
+     replaces HASHBUF while the signed part is parsed.  */
+  int use_hashpipe;
+  size_t hashpipe_size;
+  struct hashpipe_s *hashpipe;
+
+  /* The index of revoked serial numbers enabled with
+     ksba_crl_set_serial_index.  */
+  struct {
+    int enabled;
+    int parallel;                /* Set by ksba_crl_set_parallel.  */
+    unsigned int nthreads;
+    unsigned char *slab;         /* The raw serial numbers.  */
+    size_t slablen, slabsize;
+    struct crl_serial_s *entries;
+    unsigned int nentries, entriessize;
+    unsigned int *table;         /* Open addressing hash table with the
+                                    index of an entry plus one.  */
+    unsigned int tablesize;      /* A power of 2 or 0.  */
+  } serials;
+
 };
 
 
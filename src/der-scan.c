@@ -0,0 +1,353 @@
+/* der-scan.c - Scan the tag/length framing of DER objects
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The functions here only look at the tags and lengths of a buffer
+   with BER or DER encoded objects; the values are never interpreted.
+   This is a lot cheaper than running the decoder and may be used to
+   reject broken input early or to locate objects in a buffer without
+   parsing the headers again and again.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "util.h"
+#include "asn1-func.h"
+#include "der-scan.h"
+
+
+/* A parsed tag and length.  */
+struct header_s
+{
+  int class;
+  int cons;
+  int ndef;
+  unsigned long tag;
+  size_t nhdr;
+  size_t len;
+};
+
+
+/* Parse the tag and length at BUF which has AVAIL bytes into H.  The
+   value must fit into AVAIL as well.  */
+static gpg_error_t
+parse_header (const unsigned char *buf, size_t avail, unsigned int flags,
+              struct header_s *h)
+{
+  const int strict = (flags & DER_SCAN_STRICT);
+  size_t n = 0;
+  size_t len;
+  int c, count;
+
+  if (!avail)
+    return gpg_error (GPG_ERR_BAD_BER);
+  c = buf[n++];
+  h->class = (c & 0xc0) >> 6;
+  h->cons = !!(c & 0x20);
+  h->tag = c & 0x1f;
+  if (h->tag == 0x1f)
+    {
+      h->tag = 0;
+      count = 0;
+      do
+        {
+          if (n == avail || ++count > 4)
+            return gpg_error (GPG_ERR_BAD_BER);
+          c = buf[n++];
+          if (strict && count == 1 && c == 0x80)
+            return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+          h->tag = (h->tag << 7) | (c & 0x7f);
+        }
+      while (c & 0x80);
+      if (strict && h->tag < 0x1f)
+        return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+    }
+
+  if (n == avail)
+    return gpg_error (GPG_ERR_BAD_BER);
+  c = buf[n++];
+  h->ndef = 0;
+  if (!(c & 0x80))
+    len = c;
+  else if (c == 0x80)
+    {
+      if (strict)
+        return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+      if (!h->cons)
+        return gpg_error (GPG_ERR_BAD_BER);
+      h->ndef = 1;
+      len = 0;
+    }
+  else if (c == 0xff)
+    return gpg_error (GPG_ERR_BAD_BER);
+  else
+    {
+      count = c & 0x7f;
+      if (count > sizeof (size_t) || count > avail - n)
+        return gpg_error (GPG_ERR_BAD_BER);
+      if (strict && !buf[n])
+        return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+      for (len = 0; count; count--)
+        len = (len << 8) | buf[n++];
+      if (strict && len < 0x80)
+        return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+      /* Same limit as in _ksba_ber_parse_tl.  */
+      if (len > (1 << 30))
+        return gpg_error (GPG_ERR_BAD_BER);
+    }
+
+  if (h->class == CLASS_UNIVERSAL)
+    {
+      if (!h->tag)
+        {
+          /* An end tag is handled by the caller; anywhere else we
+             do the same as _ksba_ber_parse_tl.  */
+          if (strict)
+            return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+          len = 0;
+        }
+      else if (strict && h->cons && _ksba_asn_is_primitive (h->tag))
+        return gpg_error (GPG_ERR_NOT_DER_ENCODED);
+    }
+
+  if (len > avail - n)
+    return gpg_error (GPG_ERR_BAD_BER);
+  h->nhdr = n;
+  h->len = len;
+  return 0;
+}
+
+
+/* Make sure that there is space for one more item in *SCANP.  */
+static gpg_error_t
+reserve_item (der_scan_t *scanp)
+{
+  der_scan_t scan = *scanp;
+  int newsize;
+
+  if (scan->nitems < scan->size)
+    return 0;
+  if (scan->size > INT_MAX / 2)
+    return gpg_error (GPG_ERR_ENOMEM);
+  newsize = scan->size * 2;
+  scan = xtryrealloc (scan, sizeof *scan
+                      + (newsize - 1) * sizeof *scan->items);
+  if (!scan)
+    return gpg_error_from_syserror ();
+  scan->size = newsize;
+  *scanp = scan;
+  return 0;
+}
+
+
+/* Walk over all TLVs in BUFFER of LENGTH.  If SCANP is not NULL the
+   TLVs up to a depth of MAX_DEPTH are stored at *SCANP; a negative
+   MAX_DEPTH stores all of them.  On error the offset of the bad
+   header is stored at R_ERROFF.  */
+static gpg_error_t
+walk (const unsigned char *buffer, size_t length, int max_depth,
+      unsigned int flags, der_scan_t *scanp, size_t *r_erroff)
+{
+  gpg_error_t err = 0;
+  struct
+  {
+    size_t end;   /* End of the value or of the enclosing value.  */
+    int ndef;
+    int item;     /* Index of the item or -1.  */
+  } stack[DER_SCAN_MAX_DEPTH];
+  struct header_s h;
+  struct der_scan_item_s *item;
+  size_t pos = 0;
+  size_t end;
+  int depth = 0;
+  int idx;
+
+  if (!length)
+    return gpg_error (GPG_ERR_NO_DATA);
+
+  for (;;)
+    {
+      end = depth? stack[depth-1].end : length;
+      if (depth && stack[depth-1].ndef
+          && end - pos >= 2 && !buffer[pos] && !buffer[pos+1])
+        {
+          /* End tag of a constructed value with an indefinite
+             length.  */
+          idx = stack[--depth].item;
+          if (idx != -1)
+            {
+              item = (*scanp)->items + idx;
+              item->len = pos - item->off - item->nhdr;
+              item->next = (*scanp)->nitems;
+            }
+          pos += 2;
+          continue;
+        }
+      if (pos == end)
+        {
+          if (!depth)
+            break;
+          if (stack[depth-1].ndef)
+            {
+              err = gpg_error (GPG_ERR_BAD_BER); /* Missing end tag.  */
+              break;
+            }
+          idx = stack[--depth].item;
+          if (idx != -1)
+            (*scanp)->items[idx].next = (*scanp)->nitems;
+          continue;
+        }
+
+      err = parse_header (buffer + pos, end - pos, flags, &h);
+      if (err)
+        break;
+
+      idx = -1;
+      if (scanp && (max_depth < 0 || depth <= max_depth))
+        {
+          err = reserve_item (scanp);
+          if (err)
+            break;
+          idx = (*scanp)->nitems++;
+          item = (*scanp)->items + idx;
+          item->off = pos;
+          item->len = h.len;
+          item->tag = h.tag;
+          item->next = idx + 1;
+          item->depth = depth;
+          item->nhdr = h.nhdr;
+          item->class = h.class;
+          item->cons = h.cons;
+          item->ndef = h.ndef;
+        }
+
+      if (h.cons)
+        {
+          if (depth == DER_SCAN_MAX_DEPTH)
+            {
+              err = gpg_error (GPG_ERR_BAD_BER);
+              break;
+            }
+          stack[depth].end = h.ndef? end : pos + h.nhdr + h.len;
+          stack[depth].ndef = h.ndef;
+          stack[depth].item = idx;
+          depth++;
+          pos += h.nhdr;
+        }
+      else
+        pos += h.nhdr + h.len;
+    }
+
+  if (err && r_erroff)
+    *r_erroff = pos;
+  return err;
+}
+
+
+/* Check that BUFFER of LENGTH holds one or more complete BER encoded
+   objects.  With DER_SCAN_STRICT in FLAGS the headers must also
+   follow the DER rules; i.e. only definite and minimal lengths are
+   allowed.  The values themselves are not checked.  If R_ERROFF is
+   not NULL the offset of the first bad header is stored there on
+   error.  */
+gpg_error_t
+_ksba_der_validate (const unsigned char *buffer, size_t length,
+                    unsigned int flags, size_t *r_erroff)
+{
+  if (!buffer)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  return walk (buffer, length, -1, flags, NULL, r_erroff);
+}
+
+
+/* Same as _ksba_der_validate but also return an index of all TLVs at
+   R_SCAN.  Only the objects up to a nesting level of MAX_DEPTH are
+   stored; use 0 to get just the top level objects and -1 to get all.
+   The caller must release the index with _ksba_der_scan_release.  */
+gpg_error_t
+_ksba_der_scan (const unsigned char *buffer, size_t length,
+                int max_depth, unsigned int flags, der_scan_t *r_scan)
+{
+  gpg_error_t err;
+  der_scan_t scan;
+  int size;
+
+  if (!r_scan)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_scan = NULL;
+  if (!buffer)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  /* Most objects have short headers and values; start with a guess
+     which is good enough for certificates.  */
+  size = length / 16 + 8;
+  if (size > 1024)
+    size = 1024;
+  scan = xtrymalloc (sizeof *scan + (size - 1) * sizeof *scan->items);
+  if (!scan)
+    return gpg_error_from_syserror ();
+  scan->nitems = 0;
+  scan->size = size;
+
+  err = walk (buffer, length, max_depth, flags, &scan, NULL);
+  if (err)
+    {
+      xfree (scan);
+      return err;
+    }
+  *r_scan = scan;
+  return 0;
+}
+
+
+void
+_ksba_der_scan_release (der_scan_t scan)
+{
+  xfree (scan);
+}
+
+
+/* Return the index of the N-th child of the item IDX of SCAN or -1
+   if there is no such child.  */
+int
+_ksba_der_scan_child (der_scan_t scan, int idx, int n)
+{
+  int i;
+
+  if (!scan || idx < 0 || idx >= scan->nitems || n < 0)
+    return -1;
+
+  for (i = idx + 1; i < scan->items[idx].next; i = scan->items[i].next)
+    if (!n--)
+      return i;
+  return -1;
+}
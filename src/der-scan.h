@@ -0,0 +1,75 @@
+/* der-scan.h - Scan the tag/length framing of DER objects
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DER_SCAN_H
+#define DER_SCAN_H 1
+
+/* Flags for the scan functions.  */
+#define DER_SCAN_STRICT  1   /* Reject everything which is not DER.  */
+
+/* The maximum nesting level of constructed values.  */
+#define DER_SCAN_MAX_DEPTH  100
+
+
+/* One TLV of a scanned buffer.  The items are stored in the order of
+   their tags; thus the children of an item directly follow it.  */
+struct der_scan_item_s
+{
+  size_t off;          /* Offset of the tag.  */
+  size_t len;          /* Length of the value without an end tag.  */
+  unsigned long tag;
+  int next;            /* Index of the first item after the subtree.  */
+  unsigned short depth;
+  unsigned char nhdr;  /* Length of tag and length.  */
+  unsigned int class:2;
+  unsigned int cons:1; /* Constructed encoding.  */
+  unsigned int ndef:1; /* Indefinite length; an end tag follows.  */
+};
+
+struct der_scan_s
+{
+  int nitems;
+  int size;            /* Allocated number of items.  */
+  struct der_scan_item_s items[1];
+};
+typedef struct der_scan_s *der_scan_t;
+
+
+/*-- der-scan.c --*/
+gpg_error_t _ksba_der_validate (const unsigned char *buffer, size_t length,
+                                unsigned int flags, size_t *r_erroff);
+gpg_error_t _ksba_der_scan (const unsigned char *buffer, size_t length,
+                            int max_depth, unsigned int flags,
+                            der_scan_t *r_scan);
+void _ksba_der_scan_release (der_scan_t scan);
+int _ksba_der_scan_child (der_scan_t scan, int idx, int n);
+
+
+#endif /*DER_SCAN_H*/
@@ -582,21 +582,17 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   ksba_asn_tree_t crl_tree;
   BerDecoder decoder;
 
-  err = ksba_asn_create_tree ("tmttv2", &crl_tree);
+  err = _ksba_asn_get_module ("tmttv2", &crl_tree);
   if (err)
     return err;
 
   decoder = _ksba_ber_decoder_new ();
   if (!decoder)
-    {
-      ksba_asn_tree_release (crl_tree);
-      return gpg_error (GPG_ERR_ENOMEM);
-    }
+    return gpg_error (GPG_ERR_ENOMEM);
 
   err = _ksba_ber_decoder_set_reader (decoder, reader);
   if (err)
     {
-      ksba_asn_tree_release (crl_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -604,7 +600,6 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
   err = _ksba_ber_decoder_set_module (decoder, crl_tree);
   if (err)
     {
-      ksba_asn_tree_release (crl_tree);
       _ksba_ber_decoder_release (decoder);
       return err;
     }
@@ -613,7 +608,6 @@ create_and_run_decoder (ksba_reader_t reader, const char *elem_name,
                                   r_root, r_image, r_imagelen);
 
   _ksba_ber_decoder_release (decoder);
-  ksba_asn_tree_release (crl_tree);
   return err;
 }
 
@@ -0,0 +1,335 @@
+/* hashpipe.c - Hashing in a separate thread
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A hash pipe passes the data to be hashed in large blocks to a
+   thread which calls the hash function while the caller goes on
+   parsing.  There are two buffers: the caller fills one while the
+   thread hashes the other.  The caller waits only if it has filled
+   its buffer before the thread is done with the other one.  Without
+   support for threads, or if the thread can't be started, the hash
+   function is called directly for each full buffer.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#elif defined(HAVE_PTHREAD)
+# include <pthread.h>
+#endif
+
+#include "util.h"
+#include "hashpipe.h"
+
+#if defined(HAVE_W32_SYSTEM) || defined(HAVE_PTHREAD)
+# define USE_THREADS 1
+#endif
+
+
+struct hashpipe_s
+{
+  hashpipe_fnc_t fnc;
+  void *fnc_arg;
+  size_t bufsize;
+  unsigned char *buffer[2];
+  size_t used[2];
+  int cur;          /* The buffer filled by the caller.  */
+  int busy;         /* The other buffer is waiting for or being hashed.  */
+  int stop;         /* The thread shall terminate.  */
+  int running;      /* A thread has been started.  */
+#ifdef HAVE_W32_SYSTEM
+  CRITICAL_SECTION lock;
+  CONDITION_VARIABLE cond;
+  HANDLE thread;
+#elif defined(HAVE_PTHREAD)
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+#endif
+};
+
+
+#ifdef USE_THREADS
+static void
+lock_pipe (hashpipe_t pipe)
+{
+#ifdef HAVE_W32_SYSTEM
+  EnterCriticalSection (&pipe->lock);
+#else
+  pthread_mutex_lock (&pipe->lock);
+#endif
+}
+
+static void
+unlock_pipe (hashpipe_t pipe)
+{
+#ifdef HAVE_W32_SYSTEM
+  LeaveCriticalSection (&pipe->lock);
+#else
+  pthread_mutex_unlock (&pipe->lock);
+#endif
+}
+
+/* Wait for a change of the state; the lock must be held.  */
+static void
+wait_pipe (hashpipe_t pipe)
+{
+#ifdef HAVE_W32_SYSTEM
+  SleepConditionVariableCS (&pipe->cond, &pipe->lock, INFINITE);
+#else
+  pthread_cond_wait (&pipe->cond, &pipe->lock);
+#endif
+}
+
+/* Tell the other side about a change of the state.  */
+static void
+wake_pipe (hashpipe_t pipe)
+{
+#ifdef HAVE_W32_SYSTEM
+  WakeAllConditionVariable (&pipe->cond);
+#else
+  pthread_cond_broadcast (&pipe->cond);
+#endif
+}
+
+
+static void
+pipe_main (hashpipe_t pipe)
+{
+  int idx;
+
+  lock_pipe (pipe);
+  for (;;)
+    {
+      while (!pipe->busy && !pipe->stop)
+        wait_pipe (pipe);
+      if (pipe->stop)
+        break;
+      /* The caller does not touch the busy buffer.  */
+      idx = !pipe->cur;
+      unlock_pipe (pipe);
+      pipe->fnc (pipe->fnc_arg, pipe->buffer[idx], pipe->used[idx]);
+      lock_pipe (pipe);
+      pipe->busy = 0;
+      wake_pipe (pipe);
+    }
+  unlock_pipe (pipe);
+}
+
+
+#ifdef HAVE_W32_SYSTEM
+static DWORD WINAPI
+thread_main (void *arg)
+{
+  pipe_main (arg);
+  return 0;
+}
+#else
+static void *
+thread_main (void *arg)
+{
+  pipe_main (arg);
+  return NULL;
+}
+#endif
+#endif /*USE_THREADS*/
+
+
+/* Create a new hash pipe which calls FNC with FNC_ARG from its own
+   thread for blocks of up to BUFSIZE bytes.  With BUFSIZE 0 a
+   default size is used.  */
+gpg_error_t
+_ksba_hashpipe_new (hashpipe_t *r_pipe, size_t bufsize,
+                    hashpipe_fnc_t fnc, void *fnc_arg)
+{
+  hashpipe_t pipe;
+
+  *r_pipe = NULL;
+  if (!fnc)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (!bufsize)
+    bufsize = HASHPIPE_DEFAULT_BUFSIZE;
+  else if (bufsize < HASHPIPE_MIN_BUFSIZE)
+    bufsize = HASHPIPE_MIN_BUFSIZE;
+
+  pipe = xtrycalloc (1, sizeof *pipe);
+  if (!pipe)
+    return gpg_error_from_syserror ();
+  pipe->fnc = fnc;
+  pipe->fnc_arg = fnc_arg;
+  pipe->bufsize = bufsize;
+  pipe->buffer[0] = xtrymalloc (bufsize);
+  pipe->buffer[1] = pipe->buffer[0]? xtrymalloc (bufsize) : NULL;
+  if (!pipe->buffer[1])
+    {
+      gpg_error_t err = gpg_error_from_syserror ();
+      xfree (pipe->buffer[0]);
+      xfree (pipe);
+      return err;
+    }
+
+#ifdef HAVE_W32_SYSTEM
+  InitializeCriticalSection (&pipe->lock);
+  InitializeConditionVariable (&pipe->cond);
+  pipe->thread = CreateThread (NULL, 0, thread_main, pipe, 0, NULL);
+  pipe->running = !!pipe->thread;
+#elif defined(HAVE_PTHREAD)
+  pthread_mutex_init (&pipe->lock, NULL);
+  pthread_cond_init (&pipe->cond, NULL);
+  pipe->running = !pthread_create (&pipe->thread, NULL, thread_main, pipe);
+#endif
+
+  *r_pipe = pipe;
+  return 0;
+}
+
+
+/* Stop the thread of PIPE and release PIPE.  Data not yet hashed is
+   discarded; use _ksba_hashpipe_flush first to hash all data.  */
+void
+_ksba_hashpipe_release (hashpipe_t pipe)
+{
+  if (!pipe)
+    return;
+#ifdef USE_THREADS
+  if (pipe->running)
+    {
+      lock_pipe (pipe);
+      pipe->stop = 1;
+      wake_pipe (pipe);
+      unlock_pipe (pipe);
+# ifdef HAVE_W32_SYSTEM
+      WaitForSingleObject (pipe->thread, INFINITE);
+      CloseHandle (pipe->thread);
+# else
+      pthread_join (pipe->thread, NULL);
+# endif
+    }
+# ifdef HAVE_W32_SYSTEM
+  DeleteCriticalSection (&pipe->lock);
+# else
+  pthread_cond_destroy (&pipe->cond);
+  pthread_mutex_destroy (&pipe->lock);
+# endif
+#endif /*USE_THREADS*/
+  xfree (pipe->buffer[0]);
+  xfree (pipe->buffer[1]);
+  xfree (pipe);
+}
+
+
+/* Pass the current buffer of PIPE to the thread and switch to the
+   other buffer once the thread is done with it.  */
+static void
+hand_off (hashpipe_t pipe)
+{
+  if (!pipe->used[pipe->cur])
+    return;
+#ifdef USE_THREADS
+  if (pipe->running)
+    {
+      lock_pipe (pipe);
+      while (pipe->busy)
+        wait_pipe (pipe);
+      pipe->cur = !pipe->cur;
+      pipe->busy = 1;
+      wake_pipe (pipe);
+      unlock_pipe (pipe);
+      pipe->used[pipe->cur] = 0;
+      return;
+    }
+#endif
+  pipe->fnc (pipe->fnc_arg, pipe->buffer[pipe->cur], pipe->used[pipe->cur]);
+  pipe->used[pipe->cur] = 0;
+}
+
+
+/* Return the free space of the current buffer of PIPE and store its
+   length at R_AVAIL.  This allows reading data directly into the
+   buffer; _ksba_hashpipe_commit must then be called with the number
+   of bytes stored.  */
+unsigned char *
+_ksba_hashpipe_buffer (hashpipe_t pipe, size_t *r_avail)
+{
+  if (pipe->used[pipe->cur] == pipe->bufsize)
+    hand_off (pipe);
+  *r_avail = pipe->bufsize - pipe->used[pipe->cur];
+  return pipe->buffer[pipe->cur] + pipe->used[pipe->cur];
+}
+
+
+/* Add LENGTH bytes stored at the space returned by
+   _ksba_hashpipe_buffer to the data to be hashed.  */
+void
+_ksba_hashpipe_commit (hashpipe_t pipe, size_t length)
+{
+  pipe->used[pipe->cur] += length;
+  if (pipe->used[pipe->cur] == pipe->bufsize)
+    hand_off (pipe);
+}
+
+
+/* Add LENGTH bytes from BUFFER to the data to be hashed.  */
+void
+_ksba_hashpipe_write (hashpipe_t pipe, const void *buffer, size_t length)
+{
+  const unsigned char *p = buffer;
+  unsigned char *dst;
+  size_t n;
+
+  while (length)
+    {
+      dst = _ksba_hashpipe_buffer (pipe, &n);
+      if (n > length)
+        n = length;
+      memcpy (dst, p, n);
+      _ksba_hashpipe_commit (pipe, n);
+      p += n;
+      length -= n;
+    }
+}
+
+
+/* Return after all data written to PIPE has been hashed.  */
+void
+_ksba_hashpipe_flush (hashpipe_t pipe)
+{
+  hand_off (pipe);
+#ifdef USE_THREADS
+  if (pipe->running)
+    {
+      lock_pipe (pipe);
+      while (pipe->busy)
+        wait_pipe (pipe);
+      unlock_pipe (pipe);
+    }
+#endif
+}
@@ -0,0 +1,58 @@
+/* hashpipe.h - Hashing in a separate thread
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASHPIPE_H
+#define HASHPIPE_H 1
+
+/* The size of each of the two buffers if none is given.  */
+#define HASHPIPE_DEFAULT_BUFSIZE  (256*1024)
+
+/* The smallest allowed size of a buffer.  */
+#define HASHPIPE_MIN_BUFSIZE      64
+
+/* The function called by the thread for each block of data.  */
+typedef void (*hashpipe_fnc_t) (void *arg, const void *buffer, size_t length);
+
+struct hashpipe_s;
+typedef struct hashpipe_s *hashpipe_t;
+
+
+/*-- hashpipe.c --*/
+gpg_error_t _ksba_hashpipe_new (hashpipe_t *r_pipe, size_t bufsize,
+                                hashpipe_fnc_t fnc, void *fnc_arg);
+void _ksba_hashpipe_release (hashpipe_t pipe);
+unsigned char *_ksba_hashpipe_buffer (hashpipe_t pipe, size_t *r_avail);
+void _ksba_hashpipe_commit (hashpipe_t pipe, size_t length);
+void _ksba_hashpipe_write (hashpipe_t pipe,
+                           const void *buffer, size_t length);
+void _ksba_hashpipe_flush (hashpipe_t pipe);
+
+
+#endif /*HASHPIPE_H*/
@@ -41,6 +41,7 @@
 #include "keyinfo.h"
 #include "der-encoder.h"
 #include "ber-help.h"
+#include "der-scan.h"
 #include "ocsp.h"
 
 
@@ -120,6 +121,7 @@ ksba_ocsp_release (ksba_ocsp_t ocsp)
       ksba_cert_release (ri->issuer_cert);
       release_ocsp_extensions (ri->single_extensions);
       xfree (ri->serialno);
+      xfree (ri);
     }
   xfree (ocsp->sigval);
   xfree (ocsp->responder_id.name);
@@ -1302,6 +1304,17 @@ parse_response (ksba_ocsp_t ocsp, const unsigned char *msg, size_t msglen)
       return 0;
     }
 
+  /* If requested, reject a broken framing before we start to parse
+     the response.  */
+  if (ocsp->response_check)
+    {
+      err = _ksba_der_validate (msg, msglen,
+                                ((ocsp->response_check & KSBA_OCSP_CHECK_DER)
+                                 ? DER_SCAN_STRICT : 0), NULL);
+      if (err)
+        return err;
+    }
+
   /* Now that we are sure that it is a BasicOCSPResponse, we can parse
      the really important things:
 
@@ -1354,45 +1367,63 @@ parse_response (ksba_ocsp_t ocsp, const unsigned char *msg, size_t msglen)
   err = parse_context_tag (&msg, &msglen, &ti, 0);
   if (gpg_err_code (err) == GPG_ERR_INV_OBJ)
     return 0; /* Not the right tag. Stop here. */
-  if (err)
-    return err;
-  err = parse_sequence (&msg, &msglen, &ti);
   if (err)
     return err;
   if (ti.ndef)
     return gpg_error (GPG_ERR_UNSUPPORTED_ENCODING);
 
+  /* Locate the certificates using an index of the headers of the
+     sequence and its elements.  */
   {
+    der_scan_t scan;
+    struct der_scan_item_s *item;
     ksba_cert_t cert;
     struct ocsp_certlist_s *cl, **cl_tail;
+    int idx;
+
+    err = _ksba_der_scan (msg, ti.length, 1, 0, &scan);
+    if (err)
+      return err;
+    item = scan->items;
+    if (!(item->class == CLASS_UNIVERSAL && item->tag == TYPE_SEQUENCE
+          && item->cons))
+      err = gpg_error (GPG_ERR_INV_OBJ);
+    else if (item->ndef)
+      err = gpg_error (GPG_ERR_UNSUPPORTED_ENCODING);
 
     assert (!ocsp->received_certs);
     cl_tail = &ocsp->received_certs;
-    endptr = msg + ti.length;
-    while (msg < endptr)
+    for (idx = 1; !err && idx < scan->items[0].next;
+         idx = scan->items[idx].next)
       {
-        /* Find the length of the certificate. */
-        s = msg;
-        err = parse_sequence (&msg, &msglen, &ti);
-        if (err)
-          return err;
+        item = scan->items + idx;
+        if (!(item->class == CLASS_UNIVERSAL && item->tag == TYPE_SEQUENCE
+              && item->cons))
+          {
+            err = gpg_error (GPG_ERR_INV_OBJ);
+            break;
+          }
+        if (item->ndef)
+          {
+            err = gpg_error (GPG_ERR_UNSUPPORTED_ENCODING);
+            break;
+          }
         err = ksba_cert_new (&cert);
         if (err)
-          return err;
-        err = ksba_cert_init_from_mem (cert, msg - ti.nhdr,
-                                       ti.nhdr + ti.length);
+          break;
+        err = ksba_cert_init_from_mem (cert, msg + item->off,
+                                       item->nhdr + item->len);
         if (err)
           {
             ksba_cert_release (cert);
-            return err;
+            break;
           }
-        parse_skip (&msg, &msglen, &ti);
         cl = xtrycalloc (1, sizeof *cl);
         if (!cl)
           {
             err = gpg_error_from_syserror ();
             ksba_cert_release (cert);
-            return err;
+            break;
           }
 
         cl->cert = cert;
@@ -1400,8 +1431,27 @@ parse_response (ksba_ocsp_t ocsp, const unsigned char *msg, size_t msglen)
         *cl_tail = cl;
         cl_tail = &cl->next;
       }
+    _ksba_der_scan_release (scan);
   }
 
+  return err;
+}
+
+
+/* Set the checks done by ksba_ocsp_parse_response before a
+   BasicOCSPResponse is parsed.  FLAGS are the KSBA_OCSP_CHECK_*
+   constants; with KSBA_OCSP_CHECK_FRAMING the tags and lengths of
+   the entire response are checked first, KSBA_OCSP_CHECK_DER
+   additionally rejects everything which is not DER.  The default is
+   not to check anything in advance.  */
+gpg_error_t
+ksba_ocsp_set_response_check (ksba_ocsp_t ocsp, unsigned int flags)
+{
+  if (!ocsp || (flags & ~(KSBA_OCSP_CHECK_FRAMING | KSBA_OCSP_CHECK_DER)))
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if ((flags & KSBA_OCSP_CHECK_DER))
+    flags |= KSBA_OCSP_CHECK_FRAMING;
+  ocsp->response_check = flags;
   return 0;
 }
 
@@ -101,6 +101,7 @@ struct ksba_ocsp_s {
   struct ocsp_certlist_s *received_certs; /* Certificates received in
                                              the response. */
   struct ocsp_extension_s *response_extensions; /* List of extensions. */
+  unsigned int response_check; /* KSBA_OCSP_CHECK_* flags.  */
   int bad_nonce;            /* The nonce does not match the request. */
   int good_nonce;           /* The nonce does match the request. */
   struct {
@@ -35,11 +35,157 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define USE_MMAP 1
+#endif
 #include "util.h"
 
 #include "ksba.h"
+#include "asn1-func.h"
+#include "ber-help.h"
 #include "reader.h"
 
+/* Size of the input buffer of the armor filter and of the read-ahead
+   buffer it sets up.  */
+#define ARMOR_RAW_SIZE 4096
+
+/* Release a buffer created by map_file.  */
+static void
+unmap_file (unsigned char *buffer, size_t length)
+{
+  if (!buffer)
+    return;
+#ifdef USE_MMAP
+  munmap (buffer, length);
+#else
+  (void)length;
+  xfree (buffer);
+#endif
+}
+
+
+/* Make the content of the file FNAME available in memory.  On
+   success the address is stored at R_BUFFER and the length at
+   R_LENGTH; for an empty file NULL is stored.  If the system does
+   not support mmap the file is read into an allocated buffer.  */
+static gpg_error_t
+map_file (const char *fname, unsigned char **r_buffer, size_t *r_length)
+{
+  gpg_error_t err = 0;
+  struct stat st;
+  unsigned char *buffer = NULL;
+  size_t length;
+  int fd;
+
+  *r_buffer = NULL;
+  *r_length = 0;
+
+#ifdef O_BINARY
+  fd = open (fname, O_RDONLY | O_BINARY);
+#else
+  fd = open (fname, O_RDONLY);
+#endif
+  if (fd == -1)
+    return gpg_error_from_errno (errno);
+
+  if (fstat (fd, &st))
+    {
+      err = gpg_error_from_errno (errno);
+      goto leave;
+    }
+#ifdef S_ISREG
+  if (!S_ISREG (st.st_mode))
+    {
+      err = gpg_error (GPG_ERR_INV_ARG);
+      goto leave;
+    }
+#endif
+  length = st.st_size;
+  if (length != st.st_size)
+    {
+      err = gpg_error (GPG_ERR_TOO_LARGE);
+      goto leave;
+    }
+  if (!length)
+    goto leave;
+
+#ifdef USE_MMAP
+  buffer = mmap (NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (buffer == MAP_FAILED)
+    {
+      err = gpg_error_from_errno (errno);
+      goto leave;
+    }
+# if defined(HAVE_MADVISE) && defined(MADV_SEQUENTIAL)
+  /* All our parsers read strictly front to back.  */
+  madvise (buffer, length, MADV_SEQUENTIAL);
+# endif
+#else /*!USE_MMAP*/
+  {
+    size_t n = 0;
+    ssize_t nread;
+
+    buffer = xtrymalloc (length);
+    if (!buffer)
+      {
+        err = gpg_error_from_errno (errno);
+        goto leave;
+      }
+    while (n < length)
+      {
+        nread = read (fd, buffer + n, length - n);
+        if (nread < 0 && errno == EINTR)
+          continue;
+        if (nread <= 0)
+          {
+            err = nread? gpg_error_from_errno (errno)
+                       : gpg_error (GPG_ERR_EOF);
+            xfree (buffer);
+            goto leave;
+          }
+        n += nread;
+      }
+  }
+#endif /*!USE_MMAP*/
+
+  *r_buffer = buffer;
+  *r_length = length;
+
+ leave:
+  close (fd);
+  return err;
+}
+
+
+/* Release the resources owned by the data source of R.  */
+static void
+release_source (ksba_reader_t r)
+{
+  if (r->type == READER_TYPE_MEM && !r->u.mem.borrowed)
+    xfree (r->u.mem.buffer);
+  else if (r->type == READER_TYPE_MMAP)
+    unmap_file (r->u.mem.buffer, r->u.mem.size);
+}
+
+
+/* Put the armor filter of R into STATE and drop all of its pending
+   data.  */
+static void
+reset_armor (ksba_reader_t r, enum armor_state state)
+{
+  r->armor.state = state;
+  r->armor.lpos = 0;
+  r->armor.quad = 0;
+  r->armor.nquad = 0;
+  r->armor.npend = 0;
+  r->armor.error = 0;
+}
+
+
 /**
  * ksba_reader_new:
  *
@@ -76,13 +222,48 @@ ksba_reader_release (ksba_reader_t r)
       r->notify_cb = NULL;
       notify_fnc (r->notify_cb_value, r);
     }
-  if (r->type == READER_TYPE_MEM)
-    xfree (r->u.mem.buffer);
+  release_source (r);
   xfree (r->unread.buf);
+  xfree (r->ahead.buf);
+  xfree (r->armor.raw);
   xfree (r);
 }
 
 
+/**
+ * ksba_reader_reset:
+ * @r: Reader object
+ *
+ * Put the reader back into the state it had after ksba_reader_new so
+ * that it can be initialized again by one of the ksba_reader_set
+ * functions.  Unread and read-ahead data is discarded but the buffers
+ * are kept for reuse, as are the read-ahead size, the armor mode and
+ * the release notification.  Reusing a reader this way avoids allocating a new
+ * one for each object to be parsed.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_reader_reset (ksba_reader_t r)
+{
+  if (!r)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  release_source (r);
+  memset (&r->u, 0, sizeof r->u);
+  r->type = READER_TYPE_NONE;
+  r->eof = 0;
+  r->error = 0;
+  r->nread = 0;
+  r->unread.length = r->unread.readpos = 0;
+  r->ahead.start = r->ahead.end = 0;
+  if (r->armor.state)
+    reset_armor (r, ARMOR_DETECT);
+  r->armor.rawstart = r->armor.rawend = 0;
+  return 0;
+}
+
+
 /* Set NOTIFY as function to be called by ksba_reader_release before
    resources are actually deallocated.  NOTIFY_VALUE is passed to the
    called function as its first argument.  Note that only the last
@@ -102,39 +283,51 @@ ksba_reader_set_release_notify (ksba_reader_t r,
 
 
 /* Clear the error and eof indicators for READER, so that it can be
-   continued to use.  Also discards any unread bytes.  This is usually
-   required if the upper layer wants to send an EOF to indicate
-   the logical end of one part of a file.  If BUFFER and BUFLEN are
-   not NULL, possible unread data is copied to a newly allocated
-   buffer and this buffer is assigned to BUFFER, BUFLEN will be set to
-   the length of the unread bytes.  */
+   continued to use.  Also discards any unread bytes and data held in
+   the read-ahead buffer.  This is usually required if the upper
+   layer wants to send an EOF to indicate the logical end of one part
+   of a file.  If BUFFER and BUFLEN are not NULL, possible unread and
+   read-ahead data is copied to a newly allocated buffer and this
+   buffer is assigned to BUFFER, BUFLEN will be set to the length of
+   the returned bytes.  If the armor filter reached the end of an
+   object, the filter continues with the next BEGIN line.  */
 gpg_error_t
 ksba_reader_clear (ksba_reader_t r, unsigned char **buffer, size_t *buflen)
 {
-  size_t n;
+  size_t n, nahead;
 
   if (!r)
     return gpg_error (GPG_ERR_INV_VALUE);
 
   r->eof = 0;
   r->error = 0;
+  r->armor.error = 0;
   r->nread = 0;
   n = r->unread.length;
   r->unread.length = 0;
+  nahead = r->ahead.end - r->ahead.start;
 
   if (buffer && buflen)
     {
       *buffer = NULL;
       *buflen = 0;
-      if (n)
+      if (n + nahead)
         {
-          *buffer = xtrymalloc (n);
+          *buffer = xtrymalloc (n + nahead);
           if (!*buffer)
             return gpg_error_from_errno (errno);
-          memcpy (*buffer, r->unread.buf, n);
-          *buflen = n;
+          if (n)
+            memcpy (*buffer, r->unread.buf, n);
+          if (nahead)
+            memcpy (*buffer + n, r->ahead.buf + r->ahead.start, nahead);
+          *buflen = n + nahead;
         }
     }
+  r->ahead.start = r->ahead.end = 0;
+
+  /* Continue with the next armored object.  */
+  if (r->armor.state == ARMOR_END)
+    reset_armor (r, ARMOR_HEADER);
 
   return 0;
 }
@@ -143,7 +336,11 @@ ksba_reader_clear (ksba_reader_t r, unsigned char **buffer, size_t *buflen)
 gpg_error_t
 ksba_reader_error (ksba_reader_t r)
 {
-  return r? gpg_error_from_errno (r->error) : gpg_error (GPG_ERR_INV_VALUE);
+  if (!r)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (r->armor.error)
+    return r->armor.error;
+  return gpg_error_from_errno (r->error);
 }
 
 unsigned long
@@ -173,7 +370,8 @@ ksba_reader_set_mem (ksba_reader_t r, const void *buffer, size_t length)
     return gpg_error (GPG_ERR_INV_VALUE);
   if (r->type == READER_TYPE_MEM)
     { /* Reuse this reader */
-      xfree (r->u.mem.buffer);
+      if (!r->u.mem.borrowed)
+        xfree (r->u.mem.buffer);
       r->type = 0;
     }
   if (r->type)
@@ -185,6 +383,46 @@ ksba_reader_set_mem (ksba_reader_t r, const void *buffer, size_t length)
   memcpy (r->u.mem.buffer, buffer, length);
   r->u.mem.size = length;
   r->u.mem.readpos = 0;
+  r->u.mem.borrowed = 0;
+  r->type = READER_TYPE_MEM;
+  r->eof = 0;
+
+  return 0;
+}
+
+
+/**
+ * ksba_reader_set_mem_nocopy:
+ * @r: Reader object
+ * @buffer: Data
+ * @length: Length of Data (bytes)
+ *
+ * Same as ksba_reader_set_mem but the data is not copied.  Instead
+ * the reader and all objects parsed from it may keep references into
+ * @buffer; thus the caller must not modify or release @buffer before
+ * the reader and all certificates read with ksba_cert_read_der from
+ * this reader have been released.
+ *
+ * Return value: 0 on success or an error code.
+ **/
+gpg_error_t
+ksba_reader_set_mem_nocopy (ksba_reader_t r, const void *buffer, size_t length)
+{
+  if (!r || !buffer)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (r->type == READER_TYPE_MEM)
+    { /* Reuse this reader */
+      if (!r->u.mem.borrowed)
+        xfree (r->u.mem.buffer);
+      r->type = 0;
+    }
+  if (r->type)
+    return gpg_error (GPG_ERR_CONFLICT);
+
+  r->u.mem.buffer = (unsigned char *)buffer;
+  r->u.mem.size = length;
+  r->u.mem.readpos = 0;
+  r->u.mem.borrowed = 1;
   r->type = READER_TYPE_MEM;
   r->eof = 0;
 
@@ -243,6 +481,142 @@ ksba_reader_set_file (ksba_reader_t r, FILE *fp)
 
 
 
+/**
+ * ksba_reader_set_path:
+ * @r: Reader object
+ * @fname: Name of a file
+ *
+ * Initialize the reader object with the content of the regular file
+ * @fname.  The file is mapped into memory if the system supports this;
+ * reads are then served from the mapping and passing %NULL for the
+ * buffer to ksba_reader_read returns the number of bytes left.  The
+ * mapping is released by ksba_reader_release; the file should not be
+ * modified while the reader is in use.
+ *
+ * Return value: 0 on success or an error code
+ **/
+gpg_error_t
+ksba_reader_set_path (ksba_reader_t r, const char *fname)
+{
+  gpg_error_t err;
+  unsigned char *buffer;
+  size_t length;
+
+  if (!r || !fname)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (r->type)
+    return gpg_error (GPG_ERR_CONFLICT);
+
+  err = map_file (fname, &buffer, &length);
+  if (err)
+    return err;
+
+  r->eof = 0;
+  r->type = READER_TYPE_MMAP;
+  r->u.mem.buffer = buffer;
+  r->u.mem.size = length;
+  r->u.mem.readpos = 0;
+  r->u.mem.borrowed = 0;
+
+  return 0;
+}
+
+
+/**
+ * ksba_reader_set_readahead:
+ * @r: Reader object
+ * @size: Size of the read-ahead buffer in bytes or 0 to disable it.
+ *
+ * Let the reader fetch data from a file descriptor, file pointer or
+ * callback in chunks of @size bytes and serve smaller reads from an
+ * internal buffer.  This avoids a system call or callback invocation
+ * for each tag and length byte.  The position returned by
+ * ksba_reader_tell, ksba_reader_unread and the EOF indication are not
+ * affected; however, the reader may consume more bytes from the
+ * underlying source than it has returned.  Those bytes can be
+ * retrieved using ksba_reader_clear.  The buffer may only be changed
+ * while it is empty.  Memory based readers ignore this setting unless
+ * the armor filter is used.
+ *
+ * Return value: 0 on success or an error code
+ **/
+gpg_error_t
+ksba_reader_set_readahead (ksba_reader_t r, size_t size)
+{
+  unsigned char *buf;
+
+  if (!r)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (r->ahead.start != r->ahead.end)
+    return gpg_error (GPG_ERR_CONFLICT);
+
+  if (size == r->ahead.size)
+    return 0;
+
+  if (size)
+    {
+      buf = xtrymalloc (size);
+      if (!buf)
+        return gpg_error_from_errno (errno);
+    }
+  else
+    buf = NULL;
+  xfree (r->ahead.buf);
+  r->ahead.buf = buf;
+  r->ahead.size = size;
+  r->ahead.start = r->ahead.end = 0;
+
+  return 0;
+}
+
+
+/**
+ * ksba_reader_set_armor:
+ * @r: Reader object
+ * @mode: 1 to enable the armor filter or 0 to disable it.
+ *
+ * Let the reader decode PEM armored data on the fly.  Everything up
+ * to and including the first line starting with "-----BEGIN " is
+ * skipped, the following base64 data is decoded and the reader
+ * returns EOF at the next line starting with a dash.  After that
+ * ksba_reader_clear may be called to continue with the next object of
+ * a bundle.  If the data starts with the tag of a DER encoded
+ * SEQUENCE it is returned unchanged; thus the same reader can be used
+ * for both formats.  The filter uses a read-ahead buffer; if none has
+ * been set up with ksba_reader_set_readahead a default one is
+ * allocated.  The mode may only be changed before reading.
+ *
+ * Return value: 0 on success or an error code
+ **/
+gpg_error_t
+ksba_reader_set_armor (ksba_reader_t r, int mode)
+{
+  gpg_error_t err;
+
+  if (!r)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  if (r->nread || r->unread.length || r->ahead.start != r->ahead.end)
+    return gpg_error (GPG_ERR_CONFLICT);
+
+  if (!mode)
+    {
+      reset_armor (r, ARMOR_OFF);
+      r->armor.rawstart = r->armor.rawend = 0;
+      return 0;
+    }
+
+  if (!r->ahead.size)
+    {
+      err = ksba_reader_set_readahead (r, ARMOR_RAW_SIZE);
+      if (err)
+        return err;
+    }
+  reset_armor (r, ARMOR_DETECT);
+  r->armor.rawstart = r->armor.rawend = 0;
+  return 0;
+}
+
+
 /**
  * ksba_reader_set_cb:
  * @r: Reader object
@@ -285,71 +659,23 @@ ksba_reader_set_cb (ksba_reader_t r,
 }
 
 
-/**
- * ksba_reader_read:
- * @r: Readder object
- * @buffer: A buffer for returning the data
- * @length: The length of this buffer
- * @nread:  Number of bytes actually read.
- *
- * Read data from the current read position to the supplied @buffer,
- * max. @length bytes are read and the actual number of bytes read are
- * returned in @nread.  If there are no more bytes available %GPG_ERR_EOF is
- * returned and @nread is set to 0.
- *
- * If a @buffer of NULL is specified, the function does only return
- * the number of bytes available and does not move the read pointer.
- * This does only work for objects initialized from memory; if the
- * object is not capable of this it will return the error
- * GPG_ERR_NOT_IMPLEMENTED
- *
- * Return value: 0 on success, GPG_ERR_EOF or another error code
- **/
-gpg_error_t
-ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
+/* Read up to LENGTH bytes from the actual source of R into BUFFER and
+   store the number of bytes read at NREAD.  This does neither take
+   care of unread nor of read-ahead data and does not update the read
+   counter.  */
+static gpg_error_t
+read_source (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
 {
   size_t nbytes;
 
-  if (!r || !nread)
-    return gpg_error (GPG_ERR_INV_VALUE);
-
-
-  if (!buffer)
-    {
-      if (r->type != READER_TYPE_MEM)
-        return gpg_error (GPG_ERR_NOT_IMPLEMENTED);
-      *nread = r->u.mem.size - r->u.mem.readpos;
-      if (r->unread.buf)
-        *nread += r->unread.length - r->unread.readpos;
-      return *nread? 0 : gpg_error (GPG_ERR_EOF);
-    }
-
   *nread = 0;
 
-  if (r->unread.buf && r->unread.length)
-    {
-      nbytes = r->unread.length - r->unread.readpos;
-      if (!nbytes)
-        return gpg_error (GPG_ERR_BUG);
-
-      if (nbytes > length)
-        nbytes = length;
-      memcpy (buffer, r->unread.buf + r->unread.readpos, nbytes);
-      r->unread.readpos += nbytes;
-      if (r->unread.readpos == r->unread.length)
-        r->unread.readpos = r->unread.length = 0;
-      *nread = nbytes;
-      r->nread += nbytes;
-      return 0;
-    }
-
-
   if (!r->type)
     {
       r->eof = 1;
       return gpg_error (GPG_ERR_EOF);
     }
-  else if (r->type == READER_TYPE_MEM)
+  else if (READER_SOURCE_IS_MEM (r))
     {
       nbytes = r->u.mem.size - r->u.mem.readpos;
       if (!nbytes)
@@ -362,7 +688,6 @@ ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
         nbytes = length;
       memcpy (buffer, r->u.mem.buffer + r->u.mem.readpos, nbytes);
       *nread = nbytes;
-      r->nread += nbytes;
       r->u.mem.readpos += nbytes;
     }
   else if (r->type == READER_TYPE_FILE)
@@ -379,13 +704,7 @@ ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
         }
 
       n = fread (buffer, 1, length, r->u.file);
-      if (n)
-        {
-          r->nread += n;
-          *nread = n;
-        }
-      else
-        *nread = 0;
+      *nread = n;
       if (n < length)
         {
           if (ferror(r->u.file))
@@ -406,7 +725,6 @@ ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
           r->eof = 1;
           return gpg_error (GPG_ERR_EOF);
         }
-      r->nread += *nread;
     }
   else if (r->type == READER_TYPE_FD)
     {
@@ -423,10 +741,7 @@ ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
 
       n = read (r->u.fd, buffer, length);
       if (n > 0)
-        {
-          r->nread += n;
-          *nread = n;
-        }
+        *nread = n;
       else
         {
           *nread = 0;
@@ -449,6 +764,454 @@ ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
   return 0;
 }
 
+
+/* Values of the base64 decoding table besides 0 to 63.  */
+#define B64_SPACE 0x40
+#define B64_PAD   0x80
+#define B64_DASH  0x81
+#define B64_BAD   0xff
+
+/* Map the characters of base64 data to their values.  All classes
+   other than the 64 digits have one of the two high bits set so that
+   a group of 4 digits can be checked with one test.  */
+static const unsigned char asctobin[256] =
+  {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x40, 0x40, 0x40, 0x40, 0x40, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x40, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0x3e, 0xff, 0x81, 0xff, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+    0x3c, 0x3d, 0xff, 0xff, 0xff, 0x80, 0xff, 0xff,
+    0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+    0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+  };
+
+static const char begin_line[] = "-----BEGIN ";
+
+
+/* Store at R_P and R_N the raw input of the armor filter of R without
+   consuming it.  Memory sources are used directly.  */
+static gpg_error_t
+armor_input (ksba_reader_t r, const unsigned char **r_p, size_t *r_n)
+{
+  gpg_error_t err;
+  size_t nbytes;
+
+  if (READER_SOURCE_IS_MEM (r))
+    {
+      *r_p = r->u.mem.buffer + r->u.mem.readpos;
+      *r_n = r->u.mem.size - r->u.mem.readpos;
+      if (!*r_n)
+        {
+          r->eof = 1;
+          return gpg_error (GPG_ERR_EOF);
+        }
+      return 0;
+    }
+
+  if (r->armor.rawstart == r->armor.rawend)
+    {
+      if (!r->armor.raw)
+        {
+          r->armor.raw = xtrymalloc (ARMOR_RAW_SIZE);
+          if (!r->armor.raw)
+            return gpg_error_from_errno (errno);
+        }
+      r->armor.rawstart = r->armor.rawend = 0;
+      do
+        err = read_source (r, (char*)r->armor.raw, ARMOR_RAW_SIZE, &nbytes);
+      while (!err && !nbytes);
+      if (err)
+        return err;
+      r->armor.rawend = nbytes;
+    }
+  *r_p = r->armor.raw + r->armor.rawstart;
+  *r_n = r->armor.rawend - r->armor.rawstart;
+  return 0;
+}
+
+
+/* Mark N bytes of the input returned by armor_input as used.  */
+static void
+armor_consume (ksba_reader_t r, size_t n)
+{
+  if (READER_SOURCE_IS_MEM (r))
+    r->u.mem.readpos += n;
+  else
+    r->armor.rawstart += n;
+}
+
+
+/* Decide whether the data of R is armored.  All objects we parse are
+   a SEQUENCE; thus data starting with that tag is passed through.  */
+static gpg_error_t
+armor_detect (ksba_reader_t r)
+{
+  gpg_error_t err;
+  const unsigned char *p;
+  size_t n;
+
+  err = armor_input (r, &p, &n);
+  if (gpg_err_code (err) == GPG_ERR_EOF)
+    {
+      r->eof = 0;  /* Let the caller see the EOF.  */
+      return 0;
+    }
+  if (err)
+    return err;
+  reset_armor (r, *p == 0x30? ARMOR_BINARY : ARMOR_HEADER);
+  return 0;
+}
+
+
+/* Store the N decoded bytes from BUF at *DP if there is space up to
+   DEND; the rest is kept for the next read.  */
+static void
+armor_put (ksba_reader_t r, unsigned char **dp, unsigned char *dend,
+           const unsigned char *buf, int n)
+{
+  int i;
+
+  for (i=0; i < n && *dp < dend; i++)
+    *(*dp)++ = buf[i];
+  for (; i < n; i++)
+    r->armor.pend[r->armor.npend++] = buf[i];
+}
+
+
+/* Flush an incomplete base64 group of the armor filter of R.  */
+static gpg_error_t
+armor_flush (ksba_reader_t r, unsigned char **dp, unsigned char *dend)
+{
+  unsigned char buf[2];
+  unsigned int quad = r->armor.quad;
+
+  switch (r->armor.nquad)
+    {
+    case 0:
+      break;
+    case 2:
+      buf[0] = quad >> 4;
+      armor_put (r, dp, dend, buf, 1);
+      break;
+    case 3:
+      buf[0] = quad >> 10;
+      buf[1] = quad >> 2;
+      armor_put (r, dp, dend, buf, 2);
+      break;
+    default:
+      return gpg_error (GPG_ERR_INV_ARMOR);
+    }
+  r->armor.quad = 0;
+  r->armor.nquad = 0;
+  return 0;
+}
+
+
+/* Read up to LENGTH bytes of decoded data from the armored source of
+   R into BUFFER and store the number of bytes at NREAD.  Lines up to
+   and including the first line starting with "-----BEGIN " are
+   skipped, then base64 data is decoded until a line starting with a
+   dash.  After that line EOF is returned until ksba_reader_clear is
+   called, which continues with the next BEGIN line.  */
+static gpg_error_t
+read_armor (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
+{
+  gpg_error_t err = 0;
+  unsigned char *d = (unsigned char *)buffer;
+  unsigned char *dend = d + length;
+  const unsigned char *s, *p, *end;
+  unsigned char out[3];
+  unsigned int a, b, c, v;
+  size_t n;
+  int i;
+
+  *nread = 0;
+
+  if (r->armor.error)
+    return r->armor.error;
+
+  if (r->armor.npend && length)
+    {
+      n = r->armor.npend < length? r->armor.npend : length;
+      memcpy (d, r->armor.pend, n);
+      for (i=n; i < r->armor.npend; i++)
+        r->armor.pend[i-n] = r->armor.pend[i];
+      r->armor.npend -= n;
+      d += n;
+    }
+
+  while (d < dend && r->armor.state != ARMOR_END)
+    {
+      if (r->armor.state == ARMOR_BINARY)
+        {
+          /* Pass through what has been read to detect the format.  */
+          if (r->armor.rawstart == r->armor.rawend)
+            {
+              if (d == (unsigned char *)buffer)
+                return read_source (r, buffer, length, nread);
+              break;
+            }
+          n = r->armor.rawend - r->armor.rawstart;
+          if (n > dend - d)
+            n = dend - d;
+          memcpy (d, r->armor.raw + r->armor.rawstart, n);
+          r->armor.rawstart += n;
+          d += n;
+          continue;
+        }
+
+      err = armor_input (r, &s, &n);
+      if (gpg_err_code (err) == GPG_ERR_EOF)
+        {
+          /* A missing END line is not an error.  */
+          if (r->armor.state == ARMOR_BODY)
+            {
+              r->eof = 0;
+              err = armor_flush (r, &d, dend);
+              if (!err)
+                r->armor.state = ARMOR_END;
+            }
+          break;
+        }
+      if (err)
+        break;
+
+      for (p = s, end = s + n; p < end && d < dend; )
+        {
+          switch (r->armor.state)
+            {
+            case ARMOR_HEADER:
+              c = *p++;
+              if (c == '\n')
+                r->armor.lpos = 0;
+              else if (r->armor.lpos >= 0 && c == begin_line[r->armor.lpos])
+                {
+                  if (!begin_line[++r->armor.lpos])
+                    r->armor.state = ARMOR_BEGIN;
+                }
+              else
+                r->armor.lpos = -1;
+              break;
+
+            case ARMOR_BEGIN:
+            case ARMOR_TRAILER:
+              if (*p++ == '\n')
+                r->armor.state = (r->armor.state == ARMOR_BEGIN
+                                  ? ARMOR_BODY : ARMOR_END);
+              break;
+
+            case ARMOR_BODY:
+              /* Decode complete groups in one go; this covers all but
+                 the line ends.  */
+              if (!r->armor.nquad)
+                {
+                  while (end - p >= 4 && dend - d >= 3)
+                    {
+                      a = asctobin[p[0]];
+                      b = asctobin[p[1]];
+                      c = asctobin[p[2]];
+                      v = asctobin[p[3]];
+                      if ((a | b | c | v) & 0xc0)
+                        break;
+                      v |= (a << 18) | (b << 12) | (c << 6);
+                      d[0] = v >> 16;
+                      d[1] = v >> 8;
+                      d[2] = v;
+                      d += 3;
+                      p += 4;
+                    }
+                  if (p == end || d == dend)
+                    break;
+                }
+              v = asctobin[*p++];
+              if (v < 64)
+                {
+                  r->armor.quad = (r->armor.quad << 6) | v;
+                  if (++r->armor.nquad == 4)
+                    {
+                      out[0] = r->armor.quad >> 16;
+                      out[1] = r->armor.quad >> 8;
+                      out[2] = r->armor.quad;
+                      armor_put (r, &d, dend, out, 3);
+                      r->armor.quad = 0;
+                      r->armor.nquad = 0;
+                    }
+                }
+              else if (v == B64_SPACE)
+                ;
+              else if (v == B64_PAD)
+                err = armor_flush (r, &d, dend);
+              else if (v == B64_DASH)
+                {
+                  err = armor_flush (r, &d, dend);
+                  r->armor.state = ARMOR_TRAILER;
+                }
+              else
+                err = gpg_error (GPG_ERR_INV_ARMOR);
+              break;
+
+            default:
+              err = gpg_error (GPG_ERR_BUG);
+              break;
+            }
+          if (err || r->armor.state == ARMOR_END)
+            break;
+        }
+      armor_consume (r, p - s);
+      if (err)
+        break;
+    }
+
+  /* Errors are sticky so that they are returned after the data
+     decoded so far.  */
+  if (err && gpg_err_code (err) != GPG_ERR_EOF)
+    r->armor.error = err;
+  *nread = d - (unsigned char *)buffer;
+  if (*nread)
+    return 0;
+  if (err)
+    return err;
+  if (r->armor.state == ARMOR_END || r->eof)
+    return gpg_error (GPG_ERR_EOF);
+  return 0;
+}
+
+
+/* Read from the source of R through the armor filter if it is
+   enabled.  */
+static gpg_error_t
+read_data (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
+{
+  if (r->armor.state == ARMOR_OFF
+      || (r->armor.state == ARMOR_BINARY
+          && r->armor.rawstart == r->armor.rawend))
+    return read_source (r, buffer, length, nread);
+  return read_armor (r, buffer, length, nread);
+}
+
+
+/**
+ * ksba_reader_read:
+ * @r: Readder object
+ * @buffer: A buffer for returning the data
+ * @length: The length of this buffer
+ * @nread:  Number of bytes actually read.
+ *
+ * Read data from the current read position to the supplied @buffer,
+ * max. @length bytes are read and the actual number of bytes read are
+ * returned in @nread.  If there are no more bytes available %GPG_ERR_EOF is
+ * returned and @nread is set to 0.
+ *
+ * If a @buffer of NULL is specified, the function does only return
+ * the number of bytes available and does not move the read pointer.
+ * This does only work for objects initialized from memory; if the
+ * object is not capable of this it will return the error
+ * GPG_ERR_NOT_IMPLEMENTED
+ *
+ * Return value: 0 on success, GPG_ERR_EOF or another error code
+ **/
+gpg_error_t
+ksba_reader_read (ksba_reader_t r, char *buffer, size_t length, size_t *nread)
+{
+  gpg_error_t err;
+  size_t nbytes;
+
+  if (!r || !nread)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  if (r->armor.state == ARMOR_DETECT)
+    {
+      err = armor_detect (r);
+      if (err)
+        return err;
+    }
+
+  if (!buffer)
+    {
+      if (!READER_IS_MEM (r))
+        return gpg_error (GPG_ERR_NOT_IMPLEMENTED);
+      *nread = r->u.mem.size - r->u.mem.readpos;
+      if (r->unread.buf)
+        *nread += r->unread.length - r->unread.readpos;
+      return *nread? 0 : gpg_error (GPG_ERR_EOF);
+    }
+
+  *nread = 0;
+
+  if (r->unread.buf && r->unread.length)
+    {
+      nbytes = r->unread.length - r->unread.readpos;
+      if (!nbytes)
+        return gpg_error (GPG_ERR_BUG);
+
+      if (nbytes > length)
+        nbytes = length;
+      memcpy (buffer, r->unread.buf + r->unread.readpos, nbytes);
+      r->unread.readpos += nbytes;
+      if (r->unread.readpos == r->unread.length)
+        r->unread.readpos = r->unread.length = 0;
+      *nread = nbytes;
+      r->nread += nbytes;
+      return 0;
+    }
+
+  if (r->ahead.start == r->ahead.end
+      && r->ahead.size && length < r->ahead.size
+      && !READER_IS_MEM (r))
+    {
+      /* Refill the read-ahead buffer.  Larger requests are passed
+         directly to the source.  */
+      r->ahead.start = r->ahead.end = 0;
+      err = read_data (r, r->ahead.buf, r->ahead.size, &nbytes);
+      if (err)
+        return err;
+      r->ahead.end = nbytes;
+    }
+
+  if (r->ahead.start < r->ahead.end)
+    {
+      nbytes = r->ahead.end - r->ahead.start;
+      if (nbytes > length)
+        nbytes = length;
+      memcpy (buffer, r->ahead.buf + r->ahead.start, nbytes);
+      r->ahead.start += nbytes;
+      *nread = nbytes;
+      r->nread += nbytes;
+      return 0;
+    }
+
+  err = read_data (r, buffer, length, nread);
+  if (!err)
+    r->nread += *nread;
+  return err;
+}
+
+
 gpg_error_t
 ksba_reader_unread (ksba_reader_t r, const void *buffer, size_t count)
 {
@@ -462,25 +1225,295 @@ ksba_reader_unread (ksba_reader_t r, const void *buffer, size_t count)
   if (r->nread < count)
     return gpg_error (GPG_ERR_CONFLICT);
 
-  if (!r->unread.buf)
+  /* If the bytes are those just read from a memory reader we simply
+     move back the read position.  This keeps the memory contiguous
+     for _ksba_reader_borrow_mem.  */
+  if (READER_IS_MEM (r) && !r->unread.length
+      && count <= r->u.mem.readpos
+      && !memcmp (r->u.mem.buffer + r->u.mem.readpos - count, buffer, count))
     {
-      r->unread.size = count + 100;
-      r->unread.buf = xtrymalloc (r->unread.size);
-      if (!r->unread.buf)
-        return gpg_error (GPG_ERR_ENOMEM);
-      r->unread.length = count;
-      r->unread.readpos = 0;
-      memcpy (r->unread.buf, buffer, count);
+      r->u.mem.readpos -= count;
       r->nread -= count;
+      r->eof = 0;
+      return 0;
     }
-  else if (r->unread.length + count < r->unread.size)
+
+  /* Likewise for bytes just taken from the read-ahead buffer.  */
+  if (!READER_IS_MEM (r) && !r->unread.length
+      && count <= r->ahead.start
+      && !memcmp (r->ahead.buf + r->ahead.start - count, buffer, count))
     {
-      memcpy (r->unread.buf+r->unread.length, buffer, count);
-      r->unread.length += count;
+      r->ahead.start -= count;
       r->nread -= count;
+      return 0;
     }
+
+  /* Pushed back bytes go in front of those still pending.  */
+  if (count <= r->unread.readpos)
+    r->unread.readpos -= count;
   else
-    return gpg_error (GPG_ERR_NOT_IMPLEMENTED); /* fixme: easy to do */
+    {
+      size_t pending = r->unread.length - r->unread.readpos;
+
+      if (r->unread.size < pending + count)
+        {
+          size_t newsize = pending + count + 100;
+          unsigned char *newbuf;
+
+          newbuf = xtryrealloc (r->unread.buf, newsize);
+          if (!newbuf)
+            return gpg_error (GPG_ERR_ENOMEM);
+          r->unread.buf = newbuf;
+          r->unread.size = newsize;
+        }
+      if (pending)
+        memmove (r->unread.buf + count,
+                 r->unread.buf + r->unread.readpos, pending);
+      r->unread.readpos = 0;
+      r->unread.length = pending + count;
+    }
+  memcpy (r->unread.buf + r->unread.readpos, buffer, count);
+  r->nread -= count;
+
+  return 0;
+}
+
+
+/* If R has been set up with ksba_reader_set_mem_nocopy and there are
+   no unread bytes pending, return a pointer to the caller's memory at
+   the current read position and store the number of bytes available
+   from there at R_AVAIL.  Return NULL in all other cases.  */
+const unsigned char *
+_ksba_reader_borrow_mem (ksba_reader_t r, size_t *r_avail)
+{
+  if (r && r->armor.state == ARMOR_DETECT && armor_detect (r))
+    return NULL;
+  if (!r || r->type != READER_TYPE_MEM || !r->u.mem.borrowed
+      || r->unread.length || r->armor.state > ARMOR_BINARY)
+    return NULL;
+  if (r_avail)
+    *r_avail = r->u.mem.size - r->u.mem.readpos;
+  return r->u.mem.buffer + r->u.mem.readpos;
+}
+
+
+/* If the data of R is available in memory and there are no unread
+   bytes pending, return a pointer to the byte BACK bytes before the
+   current read position and store the number of bytes available from
+   there at R_AVAIL.  Return NULL in all other cases.  Unlike
+   _ksba_reader_borrow_mem this also works for copied and mapped
+   buffers; the pointer is thus only valid as long as R is neither
+   released nor set to a new source.  */
+const unsigned char *
+_ksba_reader_peek_mem (ksba_reader_t r, size_t back, size_t *r_avail)
+{
+  if (!r || !READER_IS_MEM (r) || r->unread.length
+      || r->u.mem.readpos < back)
+    return NULL;
+  *r_avail = r->u.mem.size - r->u.mem.readpos + back;
+  return r->u.mem.buffer + r->u.mem.readpos - back;
+}
 
+
+/* Skip over the next COUNT bytes of R.  For memory based readers this
+   is done without copying.  Returns 0 on success or GPG_ERR_EOF if
+   less than COUNT bytes are available.  */
+gpg_error_t
+_ksba_reader_skip (ksba_reader_t r, size_t count)
+{
+  gpg_error_t err;
+  char dummy[256];
+  size_t n, nread;
+
+  if (!r)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  while (count && r->unread.length)
+    {
+      n = count > DIM(dummy)? DIM(dummy) : count;
+      err = ksba_reader_read (r, dummy, n, &nread);
+      if (err)
+        return err;
+      count -= nread;
+    }
+
+  if (count && READER_IS_MEM (r))
+    {
+      n = r->u.mem.size - r->u.mem.readpos;
+      if (n > count)
+        n = count;
+      r->u.mem.readpos += n;
+      r->nread += n;
+      count -= n;
+      if (count)
+        {
+          r->eof = 1;
+          return gpg_error (GPG_ERR_EOF);
+        }
+    }
+
+  while (count)
+    {
+      n = count > DIM(dummy)? DIM(dummy) : count;
+      err = ksba_reader_read (r, dummy, n, &nread);
+      if (err)
+        return err;
+      count -= nread;
+    }
   return 0;
 }
+
+
+/* Return true if the data at P with length N may be the start of the
+   next object after a bad one in ksba_reader_split.  To avoid
+   returning objects from the body of the bad one, the objects up to
+   the end of the data or up to the next bad object must all be
+   SEQUENCEs with a definite length; this is not the case for the
+   inner SEQUENCEs of a certificate which are followed by its
+   signature.  */
+static int
+split_resync_p (const unsigned char *p, size_t n)
+{
+  struct tag_info ti;
+  const unsigned char *s;
+  size_t len;
+  int first = 1;
+
+  while (n)
+    {
+      s = p;
+      len = n;
+      if (_ksba_ber_parse_tl (&s, &len, &ti))
+        return !first;
+      if (!(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_SEQUENCE
+            && ti.is_constructed && !ti.ndef))
+        return 0;
+      if (ti.length > len)
+        return !first;
+      p = s + ti.length;
+      n = len - ti.length;
+      first = 0;
+    }
+  return 1;
+}
+
+
+/**
+ * ksba_reader_split:
+ * @r: Reader object
+ * @flags: 0 or KSBA_SPLIT_SKIP_BAD
+ * @r_bufs: Receives an array with the start of each object
+ * @r_lens: Receives an array with the length of each object
+ * @r_count: Receives the number of objects
+ *
+ * Locate the DER encoded objects which are concatenated in the
+ * remaining data of the memory reader @r; this is for example a
+ * bundle of certificates.  Only the tag and length of each object is
+ * parsed, the values are not looked at; thus for a reader set up
+ * with ksba_reader_set_path only the pages with the headers are read
+ * from the file.  Each object must be a SEQUENCE with a definite
+ * length.  With KSBA_SPLIT_SKIP_BAD objects with a bad header are
+ * skipped by looking for the next SEQUENCE which is followed only by
+ * further SEQUENCEs up to the end of the data or the next bad object;
+ * an object which extends beyond the end of the data ends the split.
+ * Without that flag an error is returned.  The arrays may be passed directly to
+ * ksba_cert_parse_batch and must be released with ksba_free.  They
+ * point into the memory of @r and are valid until @r is released or
+ * reset.  The read position of @r is not changed.
+ *
+ * Return value: 0 on success or an error code; GPG_ERR_NOT_SUPPORTED
+ * is returned if @r is not a memory reader.
+ **/
+gpg_error_t
+ksba_reader_split (ksba_reader_t r, unsigned int flags,
+                   const void ***r_bufs, size_t **r_lens, size_t *r_count)
+{
+  gpg_error_t err = 0;
+  struct tag_info ti;
+  const unsigned char *p, *s;
+  const void **bufs = NULL;
+  const void **newbufs;
+  size_t *lens = NULL;
+  size_t *newlens;
+  size_t avail, n, count = 0, size = 0;
+
+  if (!r || !r_bufs || !r_lens || !r_count)
+    return gpg_error (GPG_ERR_INV_VALUE);
+  *r_bufs = NULL;
+  *r_lens = NULL;
+  *r_count = 0;
+  if (!READER_IS_MEM (r) || r->unread.length)
+    return gpg_error (GPG_ERR_NOT_SUPPORTED);
+
+  p = r->u.mem.buffer + r->u.mem.readpos;
+  avail = r->u.mem.size - r->u.mem.readpos;
+  while (avail)
+    {
+      s = p;
+      n = avail;
+      err = _ksba_ber_parse_tl (&s, &n, &ti);
+      if (!err && !(ti.class == CLASS_UNIVERSAL && ti.tag == TYPE_SEQUENCE
+                    && ti.is_constructed && !ti.ndef))
+        err = gpg_error (GPG_ERR_INV_OBJ);
+      else if (!err && ti.length > n)
+        {
+          /* A bad length or a truncated object; we can't tell where
+             the next object starts.  */
+          if (!(flags & KSBA_SPLIT_SKIP_BAD))
+            {
+              err = gpg_error (GPG_ERR_BAD_BER);
+              goto leave;
+            }
+          break;
+        }
+      if (err)
+        {
+          if (!(flags & KSBA_SPLIT_SKIP_BAD))
+            goto leave;
+          err = 0;
+          for (s = p + 1; (s = memchr (s, 0x30, avail - (s - p))); s++)
+            if (split_resync_p (s, avail - (s - p)))
+              break;
+          if (!s)
+            break;
+          avail -= s - p;
+          p = s;
+          continue;
+        }
+
+      if (count == size)
+        {
+          size = size? size * 2 : 64;
+          newbufs = xtryrealloc (bufs, size * sizeof *bufs);
+          if (!newbufs)
+            {
+              err = gpg_error_from_errno (errno);
+              goto leave;
+            }
+          bufs = newbufs;
+          newlens = xtryrealloc (lens, size * sizeof *lens);
+          if (!newlens)
+            {
+              err = gpg_error_from_errno (errno);
+              goto leave;
+            }
+          lens = newlens;
+        }
+      n = ti.nhdr + ti.length;
+      bufs[count] = p;
+      lens[count] = n;
+      count++;
+      p += n;
+      avail -= n;
+    }
+
+  *r_bufs = bufs;
+  *r_lens = lens;
+  *r_count = count;
+  return 0;
+
+ leave:
+  xfree (bufs);
+  xfree (lens);
+  return err;
+}
@@ -38,9 +38,31 @@ enum reader_type {
   READER_TYPE_MEM,
   READER_TYPE_FD,
   READER_TYPE_FILE,
-  READER_TYPE_CB
+  READER_TYPE_CB,
+  READER_TYPE_MMAP
 };
 
+/* States of the armor filter.  */
+enum armor_state {
+  ARMOR_OFF = 0,   /* The filter is not used.  */
+  ARMOR_BINARY,    /* The data is not armored; it is passed through.  */
+  ARMOR_DETECT,    /* Nothing has been read yet.  */
+  ARMOR_HEADER,    /* Looking for the BEGIN line.  */
+  ARMOR_BEGIN,     /* Skipping the rest of the BEGIN line.  */
+  ARMOR_BODY,      /* Decoding the base64 data.  */
+  ARMOR_TRAILER,   /* Skipping the END line.  */
+  ARMOR_END        /* End of an object; EOF until ksba_reader_clear.  */
+};
+
+/* True if the source of reader R is a buffer at U.MEM.  */
+#define READER_SOURCE_IS_MEM(r) ((r)->type == READER_TYPE_MEM \
+                                 || (r)->type == READER_TYPE_MMAP)
+
+/* True if the data of reader R is available in memory at U.MEM.  This
+   is not the case for armored data.  */
+#define READER_IS_MEM(r) (READER_SOURCE_IS_MEM (r) \
+                          && (r)->armor.state <= ARMOR_BINARY)
+
 
 struct ksba_reader_s {
   int eof;
@@ -52,13 +74,32 @@ struct ksba_reader_s {
     size_t length;  /* used size */
     size_t readpos; /* offset where to start the next read */
   } unread;
+  struct {
+    unsigned char *buf;
+    size_t size;    /* allocated size; 0 if read-ahead is disabled */
+    size_t start;   /* offset of the next byte to return */
+    size_t end;     /* end of valid data */
+  } ahead;          /* read-ahead buffer for non-memory readers */
+  struct {
+    enum armor_state state;
+    int lpos;       /* Matched length of the BEGIN line or -1.  */
+    unsigned int quad;  /* Bits of an incomplete base64 group.  */
+    int nquad;      /* Number of characters in QUAD.  */
+    unsigned char pend[3]; /* Decoded bytes which did not fit.  */
+    int npend;
+    gpg_error_t error;  /* Decoding error; returned by ksba_reader_error.  */
+    unsigned char *raw; /* Input buffer for non-memory sources.  */
+    size_t rawstart;
+    size_t rawend;
+  } armor;          /* PEM/base64 filter  */
   enum reader_type type;
   union {
     struct {
       unsigned char *buffer;
       size_t size;
       size_t readpos;
-    } mem;   /* for READER_TYPE_MEM */
+      int borrowed;  /* BUFFER is owned by the caller.  */
+    } mem;   /* for READER_TYPE_MEM and READER_TYPE_MMAP */
     int fd;  /* for READER_TYPE_FD */
     FILE *file; /* for READER_TYPE_FILE */
     struct {
@@ -71,6 +112,42 @@ struct ksba_reader_s {
 };
 
 
+/*-- reader.c --*/
+const unsigned char *_ksba_reader_borrow_mem (ksba_reader_t r,
+                                              size_t *r_avail);
+const unsigned char *_ksba_reader_peek_mem (ksba_reader_t r, size_t back,
+                                            size_t *r_avail);
+gpg_error_t _ksba_reader_skip (ksba_reader_t r, size_t count);
+
+
+/* Return the next byte from R or -1 on EOF or error.  The common
+   cases are handled inline.  */
+static inline int
+_ksba_reader_read_byte (ksba_reader_t r)
+{
+  unsigned char buf;
+  size_t nread;
+  gpg_error_t err;
+
+  if (!r->unread.length)
+    {
+      if (r->ahead.start < r->ahead.end)
+        {
+          r->nread++;
+          return r->ahead.buf[r->ahead.start++];
+        }
+      if (READER_IS_MEM (r) && r->u.mem.readpos < r->u.mem.size)
+        {
+          r->nread++;
+          return r->u.mem.buffer[r->u.mem.readpos++];
+        }
+    }
+
+  do
+    err = ksba_reader_read (r, (char*)&buf, 1, &nread);
+  while (!err && !nread);
+  return err? -1: buf;
+}
 
 
 #endif /*READER_H*/
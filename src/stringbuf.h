@@ -75,7 +75,7 @@ put_stringbuf_mem (struct stringbuf *sb, const char *text, size_t n)
     {
       char *p;
 
-      sb->size += n + 100;
+      sb->size += n + sb->size;
       p = xtryrealloc (sb->buf, sb->size + 1);
       if (!p)
         {
@@ -106,7 +106,7 @@ put_stringbuf_mem_skip (struct stringbuf *sb, const char *text, size_t n,
   if (sb->len + n >= sb->size)
     {
       /* Note: we allocate too much here, but we don't care. */
-      sb->size += n + 100;
+      sb->size += n + sb->size;
       p = xtryrealloc (sb->buf, sb->size + 1);
       if ( !p)
         {
@@ -34,6 +34,9 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#endif
 
 #include "util.h"
 
@@ -223,6 +226,84 @@ ksba_free ( void *a )
 }
 
 
+#if !(defined(__GNUC__) && defined(__ATOMIC_ACQUIRE))
+/* Fallbacks for the atomic operations of util.h.  */
+#ifndef HAVE_W32_SYSTEM
+GPGRT_LOCK_DEFINE (atomic_lock);
+#endif
+
+int
+_ksba_atomic_add_int (int *p, int n)
+{
+#ifdef HAVE_W32_SYSTEM
+  return InterlockedExchangeAdd ((LONG volatile *)p, n) + n;
+#else
+  int value;
+
+  gpgrt_lock_lock (&atomic_lock);
+  value = (*p += n);
+  gpgrt_lock_unlock (&atomic_lock);
+  return value;
+#endif
+}
+
+int
+_ksba_atomic_load_int (int *p)
+{
+#ifdef HAVE_W32_SYSTEM
+  return InterlockedCompareExchange ((LONG volatile *)p, 0, 0);
+#else
+  int value;
+
+  gpgrt_lock_lock (&atomic_lock);
+  value = *p;
+  gpgrt_lock_unlock (&atomic_lock);
+  return value;
+#endif
+}
+
+void
+_ksba_atomic_store_int (int *p, int value)
+{
+#ifdef HAVE_W32_SYSTEM
+  InterlockedExchange ((LONG volatile *)p, value);
+#else
+  gpgrt_lock_lock (&atomic_lock);
+  *p = value;
+  gpgrt_lock_unlock (&atomic_lock);
+#endif
+}
+
+/* P is the address of a pointer.  */
+void *
+_ksba_atomic_load_ptr (void *p)
+{
+#ifdef HAVE_W32_SYSTEM
+  return InterlockedCompareExchangePointer ((PVOID volatile *)p, NULL, NULL);
+#else
+  void *value;
+
+  gpgrt_lock_lock (&atomic_lock);
+  value = *(void **)p;
+  gpgrt_lock_unlock (&atomic_lock);
+  return value;
+#endif
+}
+
+void
+_ksba_atomic_store_ptr (void *p, void *value)
+{
+#ifdef HAVE_W32_SYSTEM
+  InterlockedExchangePointer ((PVOID volatile *)p, value);
+#else
+  gpgrt_lock_lock (&atomic_lock);
+  *(void **)p = value;
+  gpgrt_lock_unlock (&atomic_lock);
+#endif
+}
+#endif /* No atomic builtins.  */
+
+
 static void
 out_of_core(void)
 {
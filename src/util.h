@@ -96,6 +96,32 @@ char *_ksba_xstrdup (const char *p);
     } while (0)
 
 
+/* Atomic access to an int or a pointer shared between threads.  The
+   increment and decrement return the new value.  Loads have acquire
+   and stores release semantics so that a lazily computed value can
+   be published by storing its pointer or a valid flag.  */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+# define atomic_inc_int(p)     __atomic_add_fetch ((p), 1, __ATOMIC_RELAXED)
+# define atomic_dec_int(p)     __atomic_sub_fetch ((p), 1, __ATOMIC_ACQ_REL)
+# define atomic_load_int(p)    __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+# define atomic_store_int(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+# define atomic_load_ptr(p)    __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+# define atomic_store_ptr(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#else
+int _ksba_atomic_add_int (int *p, int n);
+int _ksba_atomic_load_int (int *p);
+void _ksba_atomic_store_int (int *p, int value);
+void *_ksba_atomic_load_ptr (void *p);
+void _ksba_atomic_store_ptr (void *p, void *value);
+# define atomic_inc_int(p)     _ksba_atomic_add_int ((p), 1)
+# define atomic_dec_int(p)     _ksba_atomic_add_int ((p), -1)
+# define atomic_load_int(p)    _ksba_atomic_load_int ((p))
+# define atomic_store_int(p,v) _ksba_atomic_store_int ((p), (v))
+# define atomic_load_ptr(p)    _ksba_atomic_load_ptr ((p))
+# define atomic_store_ptr(p,v) _ksba_atomic_store_ptr ((p), (v))
+#endif
+
+
 #ifndef HAVE_STPCPY
 char *_ksba_stpcpy (char *a, const char *b);
 #define stpcpy(a,b) _ksba_stpcpy ((a), (b))
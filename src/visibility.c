@@ -119,6 +119,13 @@ ksba_cert_release (ksba_cert_t cert)
 }
 
 
+gpg_error_t
+ksba_cert_reset (ksba_cert_t cert)
+{
+  return _ksba_cert_reset (cert);
+}
+
+
 gpg_error_t
 ksba_cert_set_user_data (ksba_cert_t cert, const char *key,
                          const void *data, size_t datalen)
@@ -152,6 +159,15 @@ ksba_cert_init_from_mem (ksba_cert_t cert,
 }
 
 
+gpg_error_t
+ksba_cert_parse_batch (const void **bufs, const size_t *lens, size_t n,
+                       ksba_cert_t *out, gpg_error_t *errs,
+                       unsigned int nthreads)
+{
+  return _ksba_cert_parse_batch (bufs, lens, n, out, errs, nthreads);
+}
+
+
 const unsigned char *
 ksba_cert_get_image (ksba_cert_t cert, size_t *r_length)
 {
@@ -171,6 +187,14 @@ ksba_cert_hash (ksba_cert_t cert,
 }
 
 
+gpg_error_t
+ksba_cert_get_digest (ksba_cert_t cert, int what, const char *oid,
+                      const unsigned char **r_digest, size_t *r_length)
+{
+  return _ksba_cert_get_digest (cert, what, oid, r_digest, r_length);
+}
+
+
 const char *
 ksba_cert_get_digest_algo (ksba_cert_t cert)
 {
@@ -207,6 +231,13 @@ ksba_cert_get_subject (ksba_cert_t cert, int idx)
 }
 
 
+gpg_error_t
+ksba_cert_get_dn (ksba_cert_t cert, int what, const char **r_dn)
+{
+  return _ksba_cert_get_dn (cert, what, r_dn);
+}
+
+
 ksba_sexp_t
 ksba_cert_get_public_key (ksba_cert_t cert)
 {
@@ -457,6 +488,13 @@ ksba_cms_set_hash_function (ksba_cms_t cms,
 }
 
 
+gpg_error_t
+ksba_cms_set_hash_pipeline (ksba_cms_t cms, size_t bufsize)
+{
+  return _ksba_cms_set_hash_pipeline (cms, bufsize);
+}
+
+
 gpg_error_t
 ksba_cms_hash_signed_attrs (ksba_cms_t cms, int idx)
 {
@@ -647,6 +685,14 @@ ksba_crl_get_item (ksba_crl_t crl,
 }
 
 
+gpg_error_t
+ksba_crl_get_items (ksba_crl_t crl, struct ksba_crl_entry_s *entries,
+                    size_t nentries, size_t *r_count)
+{
+  return _ksba_crl_get_items (crl, entries, nentries, r_count);
+}
+
+
 ksba_sexp_t
 ksba_crl_get_sig_val (ksba_crl_t crl)
 {
@@ -661,6 +707,36 @@ ksba_crl_parse (ksba_crl_t crl, ksba_stop_reason_t *r_stopreason)
 }
 
 
+gpg_error_t
+ksba_crl_set_serial_index (ksba_crl_t crl, int enable)
+{
+  return _ksba_crl_set_serial_index (crl, enable);
+}
+
+
+gpg_error_t
+ksba_crl_set_parallel (ksba_crl_t crl, unsigned int nthreads)
+{
+  return _ksba_crl_set_parallel (crl, nthreads);
+}
+
+
+gpg_error_t
+ksba_crl_set_hash_pipeline (ksba_crl_t crl, size_t bufsize)
+{
+  return _ksba_crl_set_hash_pipeline (crl, bufsize);
+}
+
+
+gpg_error_t
+ksba_crl_lookup_serial (ksba_crl_t crl, ksba_const_sexp_t serial,
+                        ksba_isotime_t r_revocation_date,
+                        ksba_crl_reason_t *r_reason)
+{
+  return _ksba_crl_lookup_serial (crl, serial, r_revocation_date, r_reason);
+}
+
+
 
 
 /*-- ocsp.c --*/
@@ -751,6 +827,13 @@ ksba_ocsp_build_request (ksba_ocsp_t ocsp,
 
 
 
+gpg_error_t
+ksba_ocsp_set_response_check (ksba_ocsp_t ocsp, unsigned int flags)
+{
+  return _ksba_ocsp_set_response_check (ocsp, flags);
+}
+
+
 gpg_error_t
 ksba_ocsp_parse_response (ksba_ocsp_t ocsp,
                           const unsigned char *msg, size_t msglen,
@@ -946,6 +1029,13 @@ ksba_reader_release (ksba_reader_t r)
 }
 
 
+gpg_error_t
+ksba_reader_reset (ksba_reader_t r)
+{
+  return _ksba_reader_reset (r);
+}
+
+
 gpg_error_t
 ksba_reader_clear (ksba_reader_t r,
                    unsigned char **buffer, size_t *buflen)
@@ -970,6 +1060,43 @@ ksba_reader_set_mem (ksba_reader_t r,
 }
 
 
+gpg_error_t
+ksba_reader_set_mem_nocopy (ksba_reader_t r,
+                            const void *buffer, size_t length)
+{
+  return _ksba_reader_set_mem_nocopy (r, buffer, length);
+}
+
+
+gpg_error_t
+ksba_reader_set_readahead (ksba_reader_t r, size_t size)
+{
+  return _ksba_reader_set_readahead (r, size);
+}
+
+
+gpg_error_t
+ksba_reader_set_armor (ksba_reader_t r, int mode)
+{
+  return _ksba_reader_set_armor (r, mode);
+}
+
+
+gpg_error_t
+ksba_reader_split (ksba_reader_t r, unsigned int flags,
+                   const void ***r_bufs, size_t **r_lens, size_t *r_count)
+{
+  return _ksba_reader_split (r, flags, r_bufs, r_lens, r_count);
+}
+
+
+gpg_error_t
+ksba_reader_set_path (ksba_reader_t r, const char *fname)
+{
+  return _ksba_reader_set_path (r, fname);
+}
+
+
 gpg_error_t
 ksba_reader_set_fd (ksba_reader_t r, int fd)
 {
@@ -1317,3 +1444,67 @@ ksba_der_builder_get (ksba_der_t d, unsigned char **r_obj, size_t *r_objlen)
 {
   return _ksba_der_builder_get (d, r_obj, r_objlen);
 }
+
+
+
+/*-- certstore.c --*/
+gpg_error_t
+ksba_certstore_new (ksba_certstore_t *r_store)
+{
+  return _ksba_certstore_new (r_store);
+}
+
+
+void
+ksba_certstore_release (ksba_certstore_t store)
+{
+  _ksba_certstore_release (store);
+}
+
+
+gpg_error_t
+ksba_certstore_add (ksba_certstore_t store, ksba_cert_t cert)
+{
+  return _ksba_certstore_add (store, cert);
+}
+
+
+gpg_error_t
+ksba_certstore_find_issuer (ksba_certstore_t store, ksba_cert_t cert,
+                            int idx, ksba_cert_t *r_issuer)
+{
+  return _ksba_certstore_find_issuer (store, cert, idx, r_issuer);
+}
+
+
+gpg_error_t
+ksba_certstore_find_keyid (ksba_certstore_t store, ksba_const_sexp_t keyid,
+                           int idx, ksba_cert_t *r_cert)
+{
+  return _ksba_certstore_find_keyid (store, keyid, idx, r_cert);
+}
+
+
+gpg_error_t
+ksba_certstore_find_serial (ksba_certstore_t store, const char *issuer,
+                            ksba_const_sexp_t serial, ksba_cert_t *r_cert)
+{
+  return _ksba_certstore_find_serial (store, issuer, serial, r_cert);
+}
+
+
+gpg_error_t
+ksba_certstore_find_fpr (ksba_certstore_t store,
+                         const unsigned char *fpr, size_t fprlen,
+                         ksba_cert_t *r_cert)
+{
+  return _ksba_certstore_find_fpr (store, fpr, fprlen, r_cert);
+}
+
+
+gpg_error_t
+ksba_certstore_build_chain (ksba_certstore_t store, ksba_cert_t cert, int idx,
+                            ksba_cert_t **r_chain, int *r_length)
+{
+  return _ksba_certstore_build_chain (store, cert, idx, r_chain, r_length);
+}
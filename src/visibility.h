@@ -58,14 +58,18 @@
 #define ksba_cert_get_serial               _ksba_cert_get_serial
 #define ksba_cert_get_sig_val              _ksba_cert_get_sig_val
 #define ksba_cert_get_subject              _ksba_cert_get_subject
+#define ksba_cert_get_dn                   _ksba_cert_get_dn
 #define ksba_cert_get_validity             _ksba_cert_get_validity
 #define ksba_cert_hash                     _ksba_cert_hash
+#define ksba_cert_get_digest               _ksba_cert_get_digest
 #define ksba_cert_init_from_mem            _ksba_cert_init_from_mem
 #define ksba_cert_is_ca                    _ksba_cert_is_ca
 #define ksba_cert_new                      _ksba_cert_new
+#define ksba_cert_parse_batch              _ksba_cert_parse_batch
 #define ksba_cert_read_der                 _ksba_cert_read_der
 #define ksba_cert_ref                      _ksba_cert_ref
 #define ksba_cert_release                  _ksba_cert_release
+#define ksba_cert_reset                    _ksba_cert_reset
 #define ksba_cert_get_authority_info_access \
                                            _ksba_cert_get_authority_info_access
 #define ksba_cert_get_subject_info_access  _ksba_cert_get_subject_info_access
@@ -113,6 +117,7 @@
 #define ksba_cms_set_content_type          _ksba_cms_set_content_type
 #define ksba_cms_set_enc_val               _ksba_cms_set_enc_val
 #define ksba_cms_set_hash_function         _ksba_cms_set_hash_function
+#define ksba_cms_set_hash_pipeline         _ksba_cms_set_hash_pipeline
 #define ksba_cms_set_message_digest        _ksba_cms_set_message_digest
 #define ksba_cms_set_reader_writer         _ksba_cms_set_reader_writer
 #define ksba_cms_set_sig_val               _ksba_cms_set_sig_val
@@ -122,10 +127,15 @@
 #define ksba_crl_get_digest_algo           _ksba_crl_get_digest_algo
 #define ksba_crl_get_issuer                _ksba_crl_get_issuer
 #define ksba_crl_get_item                  _ksba_crl_get_item
+#define ksba_crl_get_items                 _ksba_crl_get_items
 #define ksba_crl_get_sig_val               _ksba_crl_get_sig_val
 #define ksba_crl_get_update_times          _ksba_crl_get_update_times
 #define ksba_crl_new                       _ksba_crl_new
 #define ksba_crl_parse                     _ksba_crl_parse
+#define ksba_crl_set_serial_index          _ksba_crl_set_serial_index
+#define ksba_crl_lookup_serial             _ksba_crl_lookup_serial
+#define ksba_crl_set_parallel              _ksba_crl_set_parallel
+#define ksba_crl_set_hash_pipeline         _ksba_crl_set_hash_pipeline
 #define ksba_crl_release                   _ksba_crl_release
 #define ksba_crl_set_hash_function         _ksba_crl_set_hash_function
 #define ksba_crl_set_reader                _ksba_crl_set_reader
@@ -150,6 +160,7 @@
 #define ksba_ocsp_hash_request             _ksba_ocsp_hash_request
 #define ksba_ocsp_hash_response            _ksba_ocsp_hash_response
 #define ksba_ocsp_new                      _ksba_ocsp_new
+#define ksba_ocsp_set_response_check       _ksba_ocsp_set_response_check
 #define ksba_ocsp_parse_response           _ksba_ocsp_parse_response
 #define ksba_ocsp_prepare_request          _ksba_ocsp_prepare_request
 #define ksba_ocsp_release                  _ksba_ocsp_release
@@ -171,10 +182,16 @@
 #define ksba_reader_new                    _ksba_reader_new
 #define ksba_reader_read                   _ksba_reader_read
 #define ksba_reader_release                _ksba_reader_release
+#define ksba_reader_reset                  _ksba_reader_reset
 #define ksba_reader_set_cb                 _ksba_reader_set_cb
 #define ksba_reader_set_fd                 _ksba_reader_set_fd
 #define ksba_reader_set_file               _ksba_reader_set_file
 #define ksba_reader_set_mem                _ksba_reader_set_mem
+#define ksba_reader_set_mem_nocopy         _ksba_reader_set_mem_nocopy
+#define ksba_reader_set_readahead          _ksba_reader_set_readahead
+#define ksba_reader_set_armor              _ksba_reader_set_armor
+#define ksba_reader_split                  _ksba_reader_split
+#define ksba_reader_set_path               _ksba_reader_set_path
 #define ksba_reader_tell                   _ksba_reader_tell
 #define ksba_reader_unread                 _ksba_reader_unread
 
@@ -205,6 +222,15 @@
 #define ksba_der_add_end                   _ksba_der_add_end
 #define ksba_der_builder_get               _ksba_der_builder_get
 
+#define ksba_certstore_new                 _ksba_certstore_new
+#define ksba_certstore_release             _ksba_certstore_release
+#define ksba_certstore_add                 _ksba_certstore_add
+#define ksba_certstore_find_issuer         _ksba_certstore_find_issuer
+#define ksba_certstore_find_keyid          _ksba_certstore_find_keyid
+#define ksba_certstore_find_serial         _ksba_certstore_find_serial
+#define ksba_certstore_find_fpr            _ksba_certstore_find_fpr
+#define ksba_certstore_build_chain         _ksba_certstore_build_chain
+
 
 /* Include the main header file to map the public symbols to the
    internal underscore prefixed symbols.  */
@@ -266,14 +292,18 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_cert_get_serial
 #undef ksba_cert_get_sig_val
 #undef ksba_cert_get_subject
+#undef ksba_cert_get_dn
 #undef ksba_cert_get_validity
 #undef ksba_cert_hash
+#undef ksba_cert_get_digest
 #undef ksba_cert_init_from_mem
 #undef ksba_cert_is_ca
 #undef ksba_cert_new
+#undef ksba_cert_parse_batch
 #undef ksba_cert_read_der
 #undef ksba_cert_ref
 #undef ksba_cert_release
+#undef ksba_cert_reset
 #undef ksba_cert_get_authority_info_access
 #undef ksba_cert_get_subject_info_access
 #undef ksba_cert_get_subj_key_id
@@ -320,6 +350,7 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_cms_set_content_type
 #undef ksba_cms_set_enc_val
 #undef ksba_cms_set_hash_function
+#undef ksba_cms_set_hash_pipeline
 #undef ksba_cms_set_message_digest
 #undef ksba_cms_set_reader_writer
 #undef ksba_cms_set_sig_val
@@ -329,10 +360,15 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_crl_get_digest_algo
 #undef ksba_crl_get_issuer
 #undef ksba_crl_get_item
+#undef ksba_crl_get_items
 #undef ksba_crl_get_sig_val
 #undef ksba_crl_get_update_times
 #undef ksba_crl_new
 #undef ksba_crl_parse
+#undef ksba_crl_set_serial_index
+#undef ksba_crl_lookup_serial
+#undef ksba_crl_set_parallel
+#undef ksba_crl_set_hash_pipeline
 #undef ksba_crl_release
 #undef ksba_crl_set_hash_function
 #undef ksba_crl_set_reader
@@ -357,6 +393,7 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_ocsp_hash_request
 #undef ksba_ocsp_hash_response
 #undef ksba_ocsp_new
+#undef ksba_ocsp_set_response_check
 #undef ksba_ocsp_parse_response
 #undef ksba_ocsp_prepare_request
 #undef ksba_ocsp_release
@@ -378,10 +415,16 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_reader_new
 #undef ksba_reader_read
 #undef ksba_reader_release
+#undef ksba_reader_reset
 #undef ksba_reader_set_cb
 #undef ksba_reader_set_fd
 #undef ksba_reader_set_file
 #undef ksba_reader_set_mem
+#undef ksba_reader_set_mem_nocopy
+#undef ksba_reader_set_readahead
+#undef ksba_reader_set_armor
+#undef ksba_reader_split
+#undef ksba_reader_set_path
 #undef ksba_reader_tell
 #undef ksba_reader_unread
 
@@ -412,6 +455,15 @@ int ksba_asn_delete_structure (void *dummy);
 #undef ksba_der_add_end
 #undef ksba_der_builder_get
 
+#undef ksba_certstore_new
+#undef ksba_certstore_release
+#undef ksba_certstore_add
+#undef ksba_certstore_find_issuer
+#undef ksba_certstore_find_keyid
+#undef ksba_certstore_find_serial
+#undef ksba_certstore_find_fpr
+#undef ksba_certstore_build_chain
+
 
 
 /* Mark all symbols.  */
@@ -442,14 +494,18 @@ MARK_VISIBLE (ksba_cert_get_public_key)
 MARK_VISIBLE (ksba_cert_get_serial)
 MARK_VISIBLE (ksba_cert_get_sig_val)
 MARK_VISIBLE (ksba_cert_get_subject)
+MARK_VISIBLE (ksba_cert_get_dn)
 MARK_VISIBLE (ksba_cert_get_validity)
 MARK_VISIBLE (ksba_cert_hash)
+MARK_VISIBLE (ksba_cert_get_digest)
 MARK_VISIBLE (ksba_cert_init_from_mem)
 MARK_VISIBLE (ksba_cert_is_ca)
 MARK_VISIBLE (ksba_cert_new)
+MARK_VISIBLE (ksba_cert_parse_batch)
 MARK_VISIBLE (ksba_cert_read_der)
 MARK_VISIBLE (ksba_cert_ref)
 MARK_VISIBLE (ksba_cert_release)
+MARK_VISIBLE (ksba_cert_reset)
 MARK_VISIBLE (ksba_cert_get_authority_info_access)
 MARK_VISIBLE (ksba_cert_get_subject_info_access)
 MARK_VISIBLE (ksba_cert_get_subj_key_id)
@@ -496,6 +552,7 @@ MARK_VISIBLE (ksba_cms_set_content_enc_algo)
 MARK_VISIBLE (ksba_cms_set_content_type)
 MARK_VISIBLE (ksba_cms_set_enc_val)
 MARK_VISIBLE (ksba_cms_set_hash_function)
+MARK_VISIBLE (ksba_cms_set_hash_pipeline)
 MARK_VISIBLE (ksba_cms_set_message_digest)
 MARK_VISIBLE (ksba_cms_set_reader_writer)
 MARK_VISIBLE (ksba_cms_set_sig_val)
@@ -505,10 +562,15 @@ MARK_VISIBLE (ksba_cms_add_smime_capability)
 MARK_VISIBLE (ksba_crl_get_digest_algo)
 MARK_VISIBLE (ksba_crl_get_issuer)
 MARK_VISIBLE (ksba_crl_get_item)
+MARK_VISIBLE (ksba_crl_get_items)
 MARK_VISIBLE (ksba_crl_get_sig_val)
 MARK_VISIBLE (ksba_crl_get_update_times)
 MARK_VISIBLE (ksba_crl_new)
 MARK_VISIBLE (ksba_crl_parse)
+MARK_VISIBLE (ksba_crl_set_serial_index)
+MARK_VISIBLE (ksba_crl_lookup_serial)
+MARK_VISIBLE (ksba_crl_set_parallel)
+MARK_VISIBLE (ksba_crl_set_hash_pipeline)
 MARK_VISIBLE (ksba_crl_release)
 MARK_VISIBLE (ksba_crl_set_hash_function)
 MARK_VISIBLE (ksba_crl_set_reader)
@@ -533,6 +595,7 @@ MARK_VISIBLE (ksba_ocsp_get_status)
 MARK_VISIBLE (ksba_ocsp_hash_request)
 MARK_VISIBLE (ksba_ocsp_hash_response)
 MARK_VISIBLE (ksba_ocsp_new)
+MARK_VISIBLE (ksba_ocsp_set_response_check)
 MARK_VISIBLE (ksba_ocsp_parse_response)
 MARK_VISIBLE (ksba_ocsp_prepare_request)
 MARK_VISIBLE (ksba_ocsp_release)
@@ -554,10 +617,16 @@ MARK_VISIBLE (ksba_reader_error)
 MARK_VISIBLE (ksba_reader_new)
 MARK_VISIBLE (ksba_reader_read)
 MARK_VISIBLE (ksba_reader_release)
+MARK_VISIBLE (ksba_reader_reset)
 MARK_VISIBLE (ksba_reader_set_cb)
 MARK_VISIBLE (ksba_reader_set_fd)
 MARK_VISIBLE (ksba_reader_set_file)
 MARK_VISIBLE (ksba_reader_set_mem)
+MARK_VISIBLE (ksba_reader_set_mem_nocopy)
+MARK_VISIBLE (ksba_reader_set_readahead)
+MARK_VISIBLE (ksba_reader_set_armor)
+MARK_VISIBLE (ksba_reader_split)
+MARK_VISIBLE (ksba_reader_set_path)
 MARK_VISIBLE (ksba_reader_tell)
 MARK_VISIBLE (ksba_reader_unread)
 
@@ -588,6 +657,15 @@ MARK_VISIBLE (ksba_der_add_tag)
 MARK_VISIBLE (ksba_der_add_end)
 MARK_VISIBLE (ksba_der_builder_get)
 
+MARK_VISIBLE (ksba_certstore_new)
+MARK_VISIBLE (ksba_certstore_release)
+MARK_VISIBLE (ksba_certstore_add)
+MARK_VISIBLE (ksba_certstore_find_issuer)
+MARK_VISIBLE (ksba_certstore_find_keyid)
+MARK_VISIBLE (ksba_certstore_find_serial)
+MARK_VISIBLE (ksba_certstore_find_fpr)
+MARK_VISIBLE (ksba_certstore_build_chain)
+
 
 #  undef MARK_VISIBLE
 #endif /*_KSBA_INCLUDED_BY_VISIBILITY_C*/
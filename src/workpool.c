@@ -0,0 +1,291 @@
+/* workpool.c - A simple pool of worker threads
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The pool runs a function for each index of a range of items.  The
+   range is split evenly among the threads; a thread which has done
+   its part takes over half of the remaining items of another thread.
+   The calling thread works as one of the threads.  Without support
+   for threads all items are processed by the caller.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# ifdef HAVE_PTHREAD
+#  include <pthread.h>
+# endif
+# ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+# endif
+#endif
+
+#include "util.h"
+#include "workpool.h"
+
+#if defined(HAVE_W32_SYSTEM) || defined(HAVE_PTHREAD)
+# define USE_THREADS 1
+#endif
+
+
+struct pool_s;
+
+/* The state of one thread.  */
+struct worker_s
+{
+  gpgrt_lock_t lock;   /* Protects NEXT and END.  */
+  size_t next;         /* The next item to process.  */
+  size_t end;          /* The end of the items of this thread.  */
+  struct pool_s *pool;
+#ifdef HAVE_W32_SYSTEM
+  HANDLE thread;
+#elif defined(HAVE_PTHREAD)
+  pthread_t thread;
+#endif
+  int running;         /* A thread has been started.  */
+  char pad[64];        /* Don't share cache lines with other threads.  */
+};
+
+struct pool_s
+{
+  workpool_fnc_t fnc;
+  void *opaque;
+  unsigned int nworkers;
+  struct worker_s *workers;
+};
+
+
+/* Return the number of online processors or 1 if that is not
+   known.  */
+unsigned int
+_ksba_workpool_ncpus (void)
+{
+#ifdef HAVE_W32_SYSTEM
+  SYSTEM_INFO si;
+
+  GetSystemInfo (&si);
+  if (si.dwNumberOfProcessors > 0)
+    return si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (n > 0)
+    return n > UINT_MAX? UINT_MAX : (unsigned int)n;
+#endif
+  return 1;
+}
+
+
+/* Take the next item of worker W and store its index at R_IDX.
+   Returns false if W has nothing left.  */
+static int
+take_item (struct worker_s *w, size_t *r_idx)
+{
+  int okay = 0;
+
+  gpgrt_lock_lock (&w->lock);
+  if (w->next < w->end)
+    {
+      *r_idx = w->next++;
+      okay = 1;
+    }
+  gpgrt_lock_unlock (&w->lock);
+  return okay;
+}
+
+
+/* Move the upper half of the items of another worker to the idle
+   worker W.  Returns false if no worker has any items left.  */
+static int
+steal_items (struct worker_s *w)
+{
+  struct pool_s *pool = w->pool;
+  struct worker_s *victim;
+  unsigned int self = w - pool->workers;
+  unsigned int i;
+  size_t n, start, end;
+
+  for (i=1; i < pool->nworkers; i++)
+    {
+      victim = pool->workers + (self + i) % pool->nworkers;
+      gpgrt_lock_lock (&victim->lock);
+      n = victim->end - victim->next;
+      if (n)
+        {
+          start = victim->end - (n + 1) / 2;
+          end = victim->end;
+          victim->end = start;
+        }
+      gpgrt_lock_unlock (&victim->lock);
+      if (n)
+        {
+          gpgrt_lock_lock (&w->lock);
+          w->next = start;
+          w->end = end;
+          gpgrt_lock_unlock (&w->lock);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+
+static void
+worker_main (struct worker_s *w)
+{
+  struct pool_s *pool = w->pool;
+  size_t idx;
+
+  for (;;)
+    {
+      if (take_item (w, &idx))
+        pool->fnc (pool->opaque, idx);
+      else if (!steal_items (w))
+        break;
+    }
+}
+
+
+#ifdef HAVE_W32_SYSTEM
+static DWORD WINAPI
+thread_main (void *arg)
+{
+  worker_main (arg);
+  return 0;
+}
+#elif defined(HAVE_PTHREAD)
+static void *
+thread_main (void *arg)
+{
+  worker_main (arg);
+  return NULL;
+}
+#endif
+
+
+/* Start a thread for worker W.  On failure the items of W are taken
+   over by the other workers.  */
+static void
+start_thread (struct worker_s *w)
+{
+#ifdef HAVE_W32_SYSTEM
+  w->thread = CreateThread (NULL, 0, thread_main, w, 0, NULL);
+  w->running = !!w->thread;
+#elif defined(HAVE_PTHREAD)
+  w->running = !pthread_create (&w->thread, NULL, thread_main, w);
+#else
+  (void)w;
+#endif
+}
+
+
+static void
+join_thread (struct worker_s *w)
+{
+  if (!w->running)
+    return;
+#ifdef HAVE_W32_SYSTEM
+  WaitForSingleObject (w->thread, INFINITE);
+  CloseHandle (w->thread);
+#elif defined(HAVE_PTHREAD)
+  pthread_join (w->thread, NULL);
+#endif
+  w->running = 0;
+}
+
+
+/* Call FNC with OPAQUE and each index from 0 to NITEMS-1 using up to
+   NTHREADS threads including the calling thread.  If NTHREADS is 0
+   the number of processors is used.  The function returns after all
+   items have been processed.  FNC may be called concurrently and in
+   any order; it must not depend on the order of the items.  */
+gpg_error_t
+_ksba_workpool_run (size_t nitems, unsigned int nthreads,
+                    workpool_fnc_t fnc, void *opaque)
+{
+  struct pool_s pool;
+  struct worker_s *w;
+  unsigned int i;
+  size_t idx;
+
+  if (!fnc)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  if (!nthreads)
+    nthreads = _ksba_workpool_ncpus ();
+  if (nthreads > WORKPOOL_MAX_THREADS)
+    nthreads = WORKPOOL_MAX_THREADS;
+  if (nthreads > nitems)
+    nthreads = nitems;
+
+#ifdef USE_THREADS
+  if (nthreads > 1)
+    pool.workers = xtrycalloc (nthreads, sizeof *pool.workers);
+  else
+    pool.workers = NULL;
+#else
+  pool.workers = NULL;
+#endif
+  if (!pool.workers)
+    {
+      /* Either a single thread is requested or we are out of core;
+         we can still do all the work here.  */
+      for (idx=0; idx < nitems; idx++)
+        fnc (opaque, idx);
+      return 0;
+    }
+
+  pool.fnc = fnc;
+  pool.opaque = opaque;
+  pool.nworkers = nthreads;
+  for (i=0; i < nthreads; i++)
+    {
+      w = pool.workers + i;
+      gpgrt_lock_init (&w->lock);
+      w->next = nitems / nthreads * i;
+      w->end = i + 1 < nthreads? nitems / nthreads * (i + 1) : nitems;
+      w->pool = &pool;
+    }
+
+  /* Worker 0 is the calling thread.  */
+  for (i=1; i < nthreads; i++)
+    start_thread (pool.workers + i);
+  worker_main (pool.workers);
+  for (i=1; i < nthreads; i++)
+    join_thread (pool.workers + i);
+
+  for (i=0; i < nthreads; i++)
+    gpgrt_lock_destroy (&pool.workers[i].lock);
+  xfree (pool.workers);
+  return 0;
+}
@@ -0,0 +1,47 @@
+/* workpool.h - A simple pool of worker threads
+ * Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of either
+ *
+ *   - the GNU Lesser General Public License as published by the Free
+ *     Software Foundation; either version 3 of the License, or (at
+ *     your option) any later version.
+ *
+ * or
+ *
+ *   - the GNU General Public License as published by the Free
+ *     Software Foundation; either version 2 of the License, or (at
+ *     your option) any later version.
+ *
+ * or both in parallel, as here.
+ *
+ * KSBA is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copies of the GNU General Public License
+ * and the GNU Lesser General Public License along with this program;
+ * if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H 1
+
+/* The largest number of threads used by _ksba_workpool_run.  */
+#define WORKPOOL_MAX_THREADS  64
+
+/* The function called for each item.  */
+typedef void (*workpool_fnc_t) (void *opaque, size_t idx);
+
+
+/*-- workpool.c --*/
+unsigned int _ksba_workpool_ncpus (void);
+gpg_error_t _ksba_workpool_run (size_t nitems, unsigned int nthreads,
+                                workpool_fnc_t fnc, void *opaque);
+
+
+#endif /*WORKPOOL_H*/
@@ -0,0 +1,1301 @@
+/* benchmark.c - Simple throughput measurements for KSBA
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This program is not run by "make check".  Use it like
+
+     ./benchmark [--iterations N] [--allocs] cert cert-nocopy cert-reuse
+                 batch pem getters crl crl-index crl-parallel
+                 crl-pipeline decoder seqof store
+
+   to get a rough figure of how many objects per second the library
+   is able to process.  With --allocs the number of memory allocations
+   done by the library per object is printed as well.  The "decoder"
+   benchmark compares the generated decoders with the interpreter.
+   "cert-reuse" parses into one certificate object which is reset
+   after each certificate.  "batch" parses all certificates with one
+   call of ksba_cert_parse_batch using 1, 2, 4 and 8 threads.  "pem"
+   parses the certificates from PEM armor.  "seqof"
+   parses certificates with up to 10000 elements in a SET OF and a
+   SEQUENCE OF.  "store" fills a certificate store with 100 times
+   ITERATIONS copies of a certificate with different serial numbers,
+   looks up their issuer and builds their certification paths.
+   "crl-index" parses a generated CRL with 100 times ITERATIONS
+   entries, also in batches, and looks up all serial numbers in the
+   CRL's index.  "crl-parallel" builds the index of a CRL with 2500
+   times ITERATIONS entries using 1, 2, 4 and 8 threads.
+   "crl-pipeline" parses a CRL with 500 times ITERATIONS entries and
+   hashes it with and without a separate hashing thread.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+#include "../src/ksba.h"
+#include "t-common.h"
+
+#define PGM "benchmark"
+
+#define DIM(v) (sizeof(v)/sizeof((v)[0]))
+
+static int verbose;
+static int count_allocs;
+static unsigned int iterations = 2000;
+static unsigned long n_allocs;
+
+/* The sample certificates used for the "cert" benchmark; this is the
+   same list as used by cert-basic.  */
+static const char *cert_files[] = {
+  "cert_dfn_pca01.der",
+  "cert_dfn_pca15.der",
+  "cert_g10code_test1.der",
+  "authority.crt",
+  "betsy.crt",
+  "bull.crt",
+  "ov-ocsp-server.crt",
+  "ov-userrev.crt",
+  "ov-root-ca-cert.crt",
+  "ov-serverrev.crt",
+  "ov-user.crt",
+  "ov-server.crt",
+  "ov2-root-ca-cert.crt",
+  "ov2-ocsp-server.crt",
+  "ov2-user.crt",
+  "ov2-userrev.crt",
+  "secp256r1-sha384_cert.crt",
+  "secp256r1-sha512_cert.crt",
+  "secp384r1-sha512_cert.crt",
+  "openssl-secp256r1ca.cert.crt",
+  "ed25519-rfc8410.crt",
+  "ed25519-ossl-1.crt",
+  "ed448-ossl-1.crt",
+  NULL
+};
+
+/* The sample signatures used for the "cms" benchmark.  */
+static const char *cms_files[] = {
+  "rsa-sample1.p7s",
+  "ecdsa-sample1.p7s",
+  "detached-sig.cms",
+  NULL
+};
+
+
+/* A file read into memory.  */
+struct sample_s
+{
+  unsigned char *buf;
+  size_t len;
+};
+
+
+/* Return the wall clock time in seconds.  */
+static double
+get_time (void)
+{
+#ifdef _WIN32
+  return GetTickCount () / 1000.0;
+#else
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+
+/* Read the file FNAME from the samples directory into SAMPLE.  */
+static void
+read_sample (const char *fname, struct sample_s *sample)
+{
+  char *path;
+  FILE *fp;
+  long n;
+
+  path = xmalloc (strlen ("samples/") + strlen (fname) + 1);
+  strcpy (path, "samples/");
+  strcat (path, fname);
+  fname = path;
+  path = prepend_srcdir (fname);
+  xfree ((char*)fname);
+
+  fp = fopen (path, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, PGM ": can't open `%s': %s\n", path, strerror (errno));
+      exit (1);
+    }
+  if (fseek (fp, 0, SEEK_END) || (n = ftell (fp)) < 0
+      || fseek (fp, 0, SEEK_SET))
+    {
+      fprintf (stderr, PGM ": can't seek `%s': %s\n", path, strerror (errno));
+      exit (1);
+    }
+  sample->len = n;
+  sample->buf = xmalloc (n? n : 1);
+  if (n && fread (sample->buf, n, 1, fp) != 1)
+    {
+      fprintf (stderr, PGM ": error reading `%s'\n", path);
+      exit (1);
+    }
+  fclose (fp);
+  xfree (path);
+}
+
+
+static void *
+counting_malloc (size_t n)
+{
+  n_allocs++;
+  return malloc (n);
+}
+
+static void *
+counting_realloc (void *p, size_t n)
+{
+  n_allocs++;
+  return realloc (p, n);
+}
+
+
+static void
+print_rate (const char *what, unsigned long count, double elapsed)
+{
+  if (elapsed <= 0)
+    elapsed = 0.000001;
+  printf ("%-24s %10lu in %8.3fs  %12.0f/s",
+          what, count, elapsed, count / elapsed);
+  if (count_allocs && count)
+    printf ("  %8.1f allocs", (double)n_allocs / count);
+  putchar ('\n');
+  n_allocs = 0;
+}
+
+
+/* Parse all sample certificates ITERATIONS times from memory.  With
+   NOCOPY set the certificates are read from a non-copying memory
+   reader so that they reference the sample buffers.  With REUSE set
+   a single certificate object is used and reset for each
+   certificate.  */
+static void
+bench_cert (int nocopy, int reuse)
+{
+  struct sample_s samples[DIM (cert_files)];
+  ksba_cert_t cert = NULL;
+  ksba_reader_t reader = NULL;
+  gpg_error_t err;
+  unsigned int iter;
+  unsigned long count = 0;
+  double start;
+  int i, nsamples;
+  const char *what;
+
+  for (nsamples=0; cert_files[nsamples]; nsamples++)
+    read_sample (cert_files[nsamples], samples + nsamples);
+
+  if (reuse)
+    {
+      err = ksba_cert_new (&cert);
+      fail_if_err (err);
+    }
+
+  if (nocopy)
+    {
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+    }
+
+  n_allocs = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        if (reuse)
+          err = ksba_cert_reset (cert);
+        else
+          err = ksba_cert_new (&cert);
+        fail_if_err (err);
+        if (nocopy)
+          {
+            err = ksba_reader_set_mem_nocopy (reader,
+                                              samples[i].buf, samples[i].len);
+            fail_if_err (err);
+            err = ksba_cert_read_der (cert, reader);
+          }
+        else
+          err = ksba_cert_init_from_mem (cert, samples[i].buf, samples[i].len);
+        fail_if_err2 (cert_files[i], err);
+        if (nocopy)
+          ksba_reader_reset (reader);
+        if (!reuse)
+          ksba_cert_release (cert);
+        count++;
+      }
+  if (nocopy && reuse)
+    what = "cert reuse (nocopy)";
+  else if (nocopy)
+    what = "cert parse (nocopy)";
+  else if (reuse)
+    what = "cert reuse";
+  else
+    what = "cert parse";
+  print_rate (what, count, get_time () - start);
+
+  if (reuse)
+    ksba_cert_release (cert);
+  ksba_reader_release (reader);
+
+  for (i=0; i < nsamples; i++)
+    xfree (samples[i].buf);
+}
+
+
+/* Parse all sample certificates ITERATIONS times with one call to
+   ksba_cert_parse_batch using 1, 2, 4 and 8 threads.  The time to
+   release the certificates is not included.  */
+static void
+bench_batch (void)
+{
+  static unsigned int nthreads[] = { 1, 2, 4, 8 };
+  struct sample_s samples[DIM (cert_files)];
+  const void **bufs;
+  size_t *lens;
+  ksba_cert_t *certs;
+  gpg_error_t err;
+  size_t n, idx;
+  double start, elapsed, base = 0;
+  int i, nsamples, saved_count_allocs;
+  char what[40];
+
+  for (nsamples=0; cert_files[nsamples]; nsamples++)
+    read_sample (cert_files[nsamples], samples + nsamples);
+
+  n = (size_t)iterations * nsamples;
+  bufs = xmalloc (n * sizeof *bufs);
+  lens = xmalloc (n * sizeof *lens);
+  certs = xmalloc (n * sizeof *certs);
+  for (idx=0; idx < n; idx++)
+    {
+      bufs[idx] = samples[idx % nsamples].buf;
+      lens[idx] = samples[idx % nsamples].len;
+    }
+
+  /* The allocation counter is not thread-safe.  */
+  saved_count_allocs = count_allocs;
+  count_allocs = 0;
+
+  /* A first untimed run so that all runs find the heap populated.  */
+  err = ksba_cert_parse_batch (bufs, lens, n, certs, NULL, 1);
+  fail_if_err (err);
+  for (idx=0; idx < n; idx++)
+    ksba_cert_release (certs[idx]);
+
+  for (i=0; i < DIM (nthreads); i++)
+    {
+      start = get_time ();
+      err = ksba_cert_parse_batch (bufs, lens, n, certs, NULL, nthreads[i]);
+      elapsed = get_time () - start;
+      fail_if_err (err);
+      snprintf (what, sizeof what, "cert batch (%u thread%s)",
+                nthreads[i], nthreads[i] == 1? "":"s");
+      print_rate (what, n, elapsed);
+      if (!i)
+        base = elapsed;
+      else if (elapsed > 0)
+        printf ("%-24s %10.2fx\n", "  speedup", base / elapsed);
+      for (idx=0; idx < n; idx++)
+        ksba_cert_release (certs[idx]);
+    }
+  count_allocs = saved_count_allocs;
+
+  xfree (certs);
+  xfree (lens);
+  xfree (bufs);
+  for (i=0; i < nsamples; i++)
+    xfree (samples[i].buf);
+}
+
+
+/* Return a malloced PEM armored copy of SAMPLE with the length
+   stored at R_LEN.  */
+static unsigned char *
+make_pem (const struct sample_s *sample, size_t *r_len)
+{
+  static const char b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const unsigned char *s = sample->buf;
+  size_t i, n = sample->len;
+  unsigned int v;
+  char *buf, *p;
+
+  buf = xmalloc (100 + n * 2);
+  p = buf + sprintf (buf, "-----BEGIN CERTIFICATE-----\n");
+  for (i=0; i < n; i += 3)
+    {
+      v = (s[i] << 16) | ((i+1 < n? s[i+1]:0) << 8) | (i+2 < n? s[i+2]:0);
+      *p++ = b64[(v >> 18) & 63];
+      *p++ = b64[(v >> 12) & 63];
+      *p++ = i+1 < n? b64[(v >> 6) & 63] : '=';
+      *p++ = i+2 < n? b64[v & 63] : '=';
+      if (!((i + 3) % 48) || i + 3 >= n)
+        *p++ = '\n';
+    }
+  p += sprintf (p, "-----END CERTIFICATE-----\n");
+  *r_len = p - buf;
+  return (unsigned char *)buf;
+}
+
+
+/* Parse all sample certificates ITERATIONS times from PEM armored
+   memory buffers using the armor filter of the reader.  */
+static void
+bench_pem (void)
+{
+  struct sample_s samples[DIM (cert_files)];
+  ksba_cert_t cert;
+  ksba_reader_t reader;
+  gpg_error_t err;
+  unsigned int iter;
+  unsigned long count = 0;
+  double start;
+  int i, nsamples;
+
+  for (nsamples=0; cert_files[nsamples]; nsamples++)
+    {
+      struct sample_s der;
+
+      read_sample (cert_files[nsamples], &der);
+      samples[nsamples].buf = make_pem (&der, &samples[nsamples].len);
+      xfree (der.buf);
+    }
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+
+  n_allocs = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        err = ksba_cert_new (&cert);
+        fail_if_err (err);
+        err = ksba_reader_set_mem_nocopy (reader,
+                                          samples[i].buf, samples[i].len);
+        fail_if_err (err);
+        err = ksba_reader_set_armor (reader, 1);
+        fail_if_err (err);
+        err = ksba_cert_read_der (cert, reader);
+        fail_if_err2 (cert_files[i], err);
+        ksba_reader_reset (reader);
+        ksba_cert_release (cert);
+        count++;
+      }
+  print_rate ("cert parse (pem)", count, get_time () - start);
+
+  ksba_reader_release (reader);
+  for (i=0; i < nsamples; i++)
+    xfree (samples[i].buf);
+}
+
+
+/* Call the common certificate accessors ITERATIONS times on all
+   sample certificates.  */
+static void
+bench_getters (void)
+{
+  struct sample_s samples[DIM (cert_files)];
+  ksba_cert_t certs[DIM (cert_files)];
+  ksba_isotime_t t;
+  gpg_error_t err;
+  unsigned int iter;
+  unsigned long count = 0;
+  double start;
+  int i, nsamples;
+
+  for (nsamples=0; cert_files[nsamples]; nsamples++)
+    {
+      read_sample (cert_files[nsamples], samples + nsamples);
+      err = ksba_cert_new (certs + nsamples);
+      fail_if_err (err);
+      err = ksba_cert_init_from_mem (certs[nsamples],
+                                     samples[nsamples].buf,
+                                     samples[nsamples].len);
+      fail_if_err2 (cert_files[nsamples], err);
+    }
+
+  n_allocs = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        ksba_free (ksba_cert_get_serial (certs[i]));
+        ksba_free (ksba_cert_get_issuer (certs[i], 0));
+        ksba_free (ksba_cert_get_subject (certs[i], 0));
+        ksba_cert_get_validity (certs[i], 0, t);
+        ksba_cert_get_validity (certs[i], 1, t);
+        ksba_free (ksba_cert_get_public_key (certs[i]));
+        ksba_cert_get_digest_algo (certs[i]);
+        count++;
+      }
+  print_rate ("cert getters", count, get_time () - start);
+
+  /* The queries done for each certificate during path validation.  */
+  count = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        int ca, pathlen;
+        unsigned int usage;
+        char *string;
+        ksba_sexp_t keyid;
+
+        ksba_cert_is_ca (certs[i], &ca, &pathlen);
+        ksba_cert_get_key_usage (certs[i], &usage);
+        if (!ksba_cert_get_ext_key_usages (certs[i], &string))
+          ksba_free (string);
+        if (!ksba_cert_get_subj_key_id (certs[i], NULL, &keyid))
+          ksba_free (keyid);
+        count++;
+      }
+  print_rate ("cert extension getters", count, get_time () - start);
+
+  /* The names as used for logging and lookups.  */
+  count = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        const char *name;
+
+        ksba_cert_get_dn (certs[i], 0, &name);
+        ksba_cert_get_dn (certs[i], 1, &name);
+        count++;
+      }
+  print_rate ("cert name getters", count, get_time () - start);
+
+  for (i=0; i < nsamples; i++)
+    {
+      ksba_cert_release (certs[i]);
+      xfree (samples[i].buf);
+    }
+}
+
+
+/* Fill a certificate store with copies of a leaf certificate which
+   differ in their serial numbers and look up the issuer, the serial
+   number and the certification path of each copy.  */
+static void
+bench_store (void)
+{
+  struct sample_s leaf, root;
+  ksba_cert_t cert, *certs, *chain;
+  int chainlen;
+  ksba_certstore_t store;
+  ksba_sexp_t serial;
+  const unsigned char *s;
+  unsigned long i, n, found;
+  size_t len, off;
+  char *issuer;
+  double start;
+  gpg_error_t err;
+
+  read_sample ("betsy.crt", &leaf);
+  read_sample ("authority.crt", &root);
+
+  /* Locate the serial number; we patch its last 3 bytes.  */
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, leaf.buf, leaf.len);
+  fail_if_err (err);
+  serial = ksba_cert_get_serial (cert);
+  issuer = ksba_cert_get_issuer (cert, 0);
+  ksba_cert_release (cert);
+  s = serial + 1;
+  len = strtoul ((const char *)s, (char **)&s, 10);
+  s++;
+  if (len < 3)
+    fail ("serial number too short");
+  for (off=0; off + len <= leaf.len; off++)
+    if (!memcmp (leaf.buf + off, s, len))
+      break;
+  if (off + len > leaf.len)
+    fail ("serial number not found");
+  off += len - 3;
+  ksba_free (serial);
+
+  n = iterations * 100UL;
+  certs = xmalloc (n * sizeof *certs);
+  for (i=0; i < n; i++)
+    {
+      leaf.buf[off]   = i >> 16;
+      leaf.buf[off+1] = i >> 8;
+      leaf.buf[off+2] = i;
+      err = ksba_cert_new (certs + i);
+      fail_if_err (err);
+      err = ksba_cert_init_from_mem (certs[i], leaf.buf, leaf.len);
+      fail_if_err (err);
+    }
+
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, root.buf, root.len);
+  fail_if_err (err);
+  err = ksba_certstore_add (store, cert);
+  fail_if_err (err);
+  ksba_cert_release (cert);
+
+  start = get_time ();
+  for (i=0; i < n; i++)
+    {
+      err = ksba_certstore_add (store, certs[i]);
+      fail_if_err (err);
+    }
+  print_rate ("store add", n, get_time () - start);
+
+  found = 0;
+  start = get_time ();
+  for (i=0; i < n; i++)
+    if (!ksba_certstore_find_issuer (store, certs[i], 0, &cert))
+      {
+        found++;
+        ksba_cert_release (cert);
+      }
+  print_rate ("store find issuer", n, get_time () - start);
+  if (found != n)
+    fail ("issuer not found");
+
+  found = 0;
+  start = get_time ();
+  for (i=0; i < n; i++)
+    {
+      serial = ksba_cert_get_serial (certs[i]);
+      if (!ksba_certstore_find_serial (store, issuer, serial, &cert))
+        {
+          found++;
+          ksba_cert_release (cert);
+        }
+      ksba_free (serial);
+    }
+  print_rate ("store find serial", n, get_time () - start);
+  if (found != n)
+    fail ("serial not found");
+
+  found = 0;
+  start = get_time ();
+  for (i=0; i < n; i++)
+    if (!ksba_certstore_build_chain (store, certs[i], 0, &chain, &chainlen))
+      {
+        found++;
+        while (chainlen--)
+          ksba_cert_release (chain[chainlen]);
+        ksba_free (chain);
+      }
+  print_rate ("store build chain", n, get_time () - start);
+  if (found != n)
+    fail ("chain not found");
+
+  ksba_certstore_release (store);
+  for (i=0; i < n; i++)
+    ksba_cert_release (certs[i]);
+  xfree (certs);
+  xfree (issuer);
+  xfree (leaf.buf);
+  xfree (root.buf);
+}
+
+
+/* Callback reader over a sample; this is how data arriving from a
+   pipe or socket is usually fed into the library.  */
+struct cb_parm_s
+{
+  const struct sample_s *sample;
+  size_t pos;
+  unsigned long ncalls;
+};
+
+static int
+cb_reader (void *cb_value, char *buffer, size_t count, size_t *r_nread)
+{
+  struct cb_parm_s *parm = cb_value;
+
+  parm->ncalls++;
+  if (parm->pos == parm->sample->len)
+    {
+      *r_nread = 0;
+      return gpg_error (GPG_ERR_EOF);
+    }
+  if (count > parm->sample->len - parm->pos)
+    count = parm->sample->len - parm->pos;
+  memcpy (buffer, parm->sample->buf + parm->pos, count);
+  parm->pos += count;
+  *r_nread = count;
+  return 0;
+}
+
+
+/* Parse the sample CRL ITERATIONS times from a callback reader with
+   a read-ahead buffer of READAHEAD bytes.  With USE_PATH set the
+   sample is instead read from a file reader created by
+   ksba_reader_set_path.  */
+static void
+bench_crl (size_t readahead, int use_path)
+{
+  char *path = NULL;
+  struct sample_s sample;
+  struct cb_parm_s parm;
+  ksba_reader_t reader;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  gpg_error_t err;
+  unsigned int iter;
+  unsigned long count = 0;
+  unsigned long ncalls = 0;
+  double start;
+  char what[40];
+
+  read_sample ("crl_testpki_testpca.der", &sample);
+  if (use_path)
+    path = prepend_srcdir ("samples/crl_testpki_testpca.der");
+
+  n_allocs = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    {
+      memset (&parm, 0, sizeof parm);
+      parm.sample = &sample;
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+      if (use_path)
+        err = ksba_reader_set_path (reader, path);
+      else
+        err = ksba_reader_set_cb (reader, cb_reader, &parm);
+      fail_if_err (err);
+      err = ksba_reader_set_readahead (reader, readahead);
+      fail_if_err (err);
+      err = ksba_crl_new (&crl);
+      fail_if_err (err);
+      err = ksba_crl_set_reader (crl, reader);
+      fail_if_err (err);
+      do
+        {
+          err = ksba_crl_parse (crl, &stopreason);
+          fail_if_err (err);
+        }
+      while (stopreason != KSBA_SR_READY);
+      ksba_crl_release (crl);
+      ksba_reader_release (reader);
+      ncalls += parm.ncalls;
+      count++;
+    }
+  if (use_path)
+    snprintf (what, sizeof what, "crl parse (path)");
+  else
+    snprintf (what, sizeof what, "crl parse (ahead %lu)",
+              (unsigned long)readahead);
+  print_rate (what, count, get_time () - start);
+  if (verbose && count && !use_path)
+    printf ("%-24s %10.1f callbacks per CRL\n", "", (double)ncalls / count);
+
+  xfree (sample.buf);
+  xfree (path);
+}
+
+
+/* Parse a CRL with 100 times ITERATIONS entries.  Once while fetching
+   each entry with ksba_crl_get_item, once while fetching 256 entries
+   at a time with ksba_crl_get_items and once while letting the parser
+   build its serial index, which is then queried for each serial
+   number.  */
+static void
+bench_crl_index (void)
+{
+  unsigned char *der;
+  size_t derlen;
+  ksba_reader_t reader;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  ksba_sexp_t serial;
+  ksba_isotime_t rdate;
+  ksba_crl_reason_t reason;
+  struct ksba_crl_entry_s entries[256];
+  size_t nentries;
+  unsigned char sexp[8];
+  unsigned long i, n, count;
+  double start;
+  gpg_error_t err;
+  int mode, use_index;
+
+  n = iterations * 100UL;
+  der = make_test_crl (n, 1, &derlen);
+
+  for (mode=0; mode < 3; mode++)
+    {
+      use_index = (mode == 2);
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+      err = ksba_reader_set_mem_nocopy (reader, der, derlen);
+      fail_if_err (err);
+      err = ksba_crl_new (&crl);
+      fail_if_err (err);
+      err = ksba_crl_set_reader (crl, reader);
+      fail_if_err (err);
+      err = ksba_crl_set_serial_index (crl, use_index);
+      fail_if_err (err);
+
+      n_allocs = 0;
+      count = 0;
+      start = get_time ();
+      do
+        {
+          err = ksba_crl_parse (crl, &stopreason);
+          fail_if_err (err);
+          if (mode == 1 && stopreason == KSBA_SR_BEGIN_ITEMS)
+            {
+              do
+                {
+                  err = ksba_crl_get_items (crl, entries, DIM (entries),
+                                            &nentries);
+                  fail_if_err (err);
+                  count += nentries;
+                }
+              while (nentries == DIM (entries));
+            }
+          else if (stopreason == KSBA_SR_GOT_ITEM)
+            {
+              if (!mode)
+                {
+                  err = ksba_crl_get_item (crl, &serial, rdate, &reason);
+                  fail_if_err (err);
+                  ksba_free (serial);
+                }
+              count++;
+            }
+        }
+      while (stopreason != KSBA_SR_READY);
+      print_rate (mode == 2? "crl entries (index)" :
+                  mode == 1? "crl entries (get_items)" :
+                  /*      */ "crl entries (get_item)",
+                  count, get_time () - start);
+      if (count != n)
+        fail ("wrong number of CRL entries");
+
+      if (use_index)
+        {
+          memcpy (sexp, "(4:", 3);
+          sexp[7] = ')';
+          count = 0;
+          start = get_time ();
+          for (i=0; i < n; i++)
+            {
+              /* Every other lookup is for a serial number which is
+                 not listed.  */
+              sexp[3] = ((i & 1)? 0x20 : 0x40) | ((i >> 24) & 0x3f);
+              sexp[4] = i >> 16;
+              sexp[5] = i >> 8;
+              sexp[6] = i;
+              if (!ksba_crl_lookup_serial (crl, sexp, rdate, &reason))
+                count++;
+            }
+          print_rate ("crl lookup serial", n, get_time () - start);
+          if (count != (n + 1) / 2)
+            fail ("serial number lookup failed");
+        }
+
+      ksba_crl_release (crl);
+      ksba_reader_release (reader);
+    }
+  xfree (der);
+}
+
+
+static void
+dummy_hash_fnc (void *arg, const void *buffer, size_t length)
+{
+  (void)arg;
+  (void)buffer;
+  (void)length;
+}
+
+
+/* A hash function which costs about as much as a real one.  */
+static void
+checksum_hash_fnc (void *arg, const void *buffer, size_t length)
+{
+  unsigned int *sum = arg;
+  const unsigned char *p = buffer;
+  unsigned int h = *sum;
+
+  for (; length; length--)
+    h = (h ^ *p++) * 16777619;
+  *sum = h;
+}
+
+
+/* Parse a CRL with 500 times ITERATIONS entries while hashing it.
+   Once with the hash function called by the parser and then with
+   hashing threads using blocks of 64k and of 1M.  */
+static void
+bench_crl_pipeline (void)
+{
+  static size_t bufsizes[] = { 0, 65536, 1024*1024 };
+  unsigned char *der;
+  size_t derlen;
+  ksba_reader_t reader;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  struct ksba_crl_entry_s entries[256];
+  size_t nentries;
+  unsigned int sum, firstsum = 0;
+  unsigned long n, count;
+  double start;
+  gpg_error_t err;
+  char what[40];
+  int i;
+
+  n = iterations * 500UL;
+  der = make_test_crl (n, 1, &derlen);
+
+  for (i=0; i < DIM (bufsizes); i++)
+    {
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+      err = ksba_reader_set_mem_nocopy (reader, der, derlen);
+      fail_if_err (err);
+      err = ksba_crl_new (&crl);
+      fail_if_err (err);
+      err = ksba_crl_set_reader (crl, reader);
+      fail_if_err (err);
+      sum = 0;
+      ksba_crl_set_hash_function (crl, checksum_hash_fnc, &sum);
+      if (bufsizes[i])
+        {
+          err = ksba_crl_set_hash_pipeline (crl, bufsizes[i]);
+          fail_if_err (err);
+        }
+
+      count = 0;
+      start = get_time ();
+      do
+        {
+          err = ksba_crl_parse (crl, &stopreason);
+          fail_if_err (err);
+          if (stopreason == KSBA_SR_BEGIN_ITEMS)
+            {
+              do
+                {
+                  err = ksba_crl_get_items (crl, entries, DIM (entries),
+                                            &nentries);
+                  fail_if_err (err);
+                  count += nentries;
+                }
+              while (nentries == DIM (entries));
+            }
+        }
+      while (stopreason != KSBA_SR_READY);
+      if (bufsizes[i])
+        snprintf (what, sizeof what, "crl hashed (%luk pipe)",
+                  (unsigned long)bufsizes[i] / 1024);
+      else
+        snprintf (what, sizeof what, "crl hashed (no pipe)");
+      print_rate (what, count, get_time () - start);
+      if (count != n)
+        fail ("wrong number of CRL entries");
+      if (!i)
+        firstsum = sum;
+      else if (sum != firstsum)
+        fail ("different data hashed");
+
+      ksba_crl_release (crl);
+      ksba_reader_release (reader);
+    }
+  xfree (der);
+}
+
+
+/* Build the serial index of a CRL with 2500 times ITERATIONS entries
+   using ksba_crl_set_parallel with 1, 2, 4 and 8 threads.  */
+static void
+bench_crl_parallel (void)
+{
+  static unsigned int nthreads[] = { 1, 2, 4, 8 };
+  unsigned char *der;
+  size_t derlen;
+  ksba_reader_t reader;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  ksba_isotime_t rdate;
+  ksba_crl_reason_t reason;
+  unsigned char sexp[8];
+  unsigned long n;
+  double start, elapsed, base = 0;
+  gpg_error_t err;
+  char what[40];
+  int i;
+
+  n = iterations * 2500UL;
+  der = make_test_crl (n, 1, &derlen);
+
+  for (i=0; i < DIM (nthreads); i++)
+    {
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+      err = ksba_reader_set_mem_nocopy (reader, der, derlen);
+      fail_if_err (err);
+      err = ksba_crl_new (&crl);
+      fail_if_err (err);
+      err = ksba_crl_set_reader (crl, reader);
+      fail_if_err (err);
+      ksba_crl_set_hash_function (crl, dummy_hash_fnc, NULL);
+      err = ksba_crl_set_parallel (crl, nthreads[i]);
+      fail_if_err (err);
+
+      start = get_time ();
+      do
+        {
+          err = ksba_crl_parse (crl, &stopreason);
+          fail_if_err (err);
+        }
+      while (stopreason != KSBA_SR_READY);
+      elapsed = get_time () - start;
+      snprintf (what, sizeof what, "crl index (%u thread%s)",
+                nthreads[i], nthreads[i] == 1? "":"s");
+      print_rate (what, n, elapsed);
+      if (!i)
+        base = elapsed;
+      else if (elapsed > 0)
+        printf ("%-24s %10.2fx\n", "  speedup", base / elapsed);
+
+      /* The last entry is in the index.  */
+      memcpy (sexp, "(4:", 3);
+      sexp[3] = 0x40 | (((n - 1) >> 24) & 0x3f);
+      sexp[4] = (n - 1) >> 16;
+      sexp[5] = (n - 1) >> 8;
+      sexp[6] = (n - 1);
+      sexp[7] = ')';
+      if (n && ksba_crl_lookup_serial (crl, sexp, rdate, &reason))
+        fail ("serial number lookup failed");
+
+      ksba_crl_release (crl);
+      ksba_reader_release (reader);
+    }
+  xfree (der);
+}
+
+static int
+dummy_writer_cb (void *cb_value, const void *buffer, size_t count)
+{
+  (void)cb_value;
+  (void)buffer;
+  (void)count;
+  return 0;
+}
+
+
+/* Parse all sample signatures ITERATIONS times from memory.  */
+static void
+bench_cms (void)
+{
+  struct sample_s samples[DIM (cms_files)];
+  ksba_reader_t reader;
+  ksba_writer_t writer;
+  ksba_cms_t cms;
+  ksba_stop_reason_t stopreason;
+  gpg_error_t err;
+  unsigned int iter;
+  unsigned long count = 0;
+  double start;
+  int i, nsamples;
+
+  for (nsamples=0; cms_files[nsamples]; nsamples++)
+    read_sample (cms_files[nsamples], samples + nsamples);
+
+  err = ksba_writer_new (&writer);
+  fail_if_err (err);
+  err = ksba_writer_set_cb (writer, dummy_writer_cb, NULL);
+  fail_if_err (err);
+
+  n_allocs = 0;
+  start = get_time ();
+  for (iter=0; iter < iterations; iter++)
+    for (i=0; i < nsamples; i++)
+      {
+        err = ksba_reader_new (&reader);
+        fail_if_err (err);
+        err = ksba_reader_set_mem (reader, samples[i].buf, samples[i].len);
+        fail_if_err (err);
+        err = ksba_cms_new (&cms);
+        fail_if_err (err);
+        err = ksba_cms_set_reader_writer (cms, reader, writer);
+        fail_if_err (err);
+        ksba_cms_set_hash_function (cms, dummy_hash_fnc, NULL);
+        do
+          {
+            err = ksba_cms_parse (cms, &stopreason);
+            fail_if_err2 (cms_files[i], err);
+          }
+        while (stopreason != KSBA_SR_READY);
+        ksba_cms_release (cms);
+        ksba_reader_release (reader);
+        count++;
+      }
+  print_rate ("cms parse", count, get_time () - start);
+
+  ksba_writer_release (writer);
+  for (i=0; i < nsamples; i++)
+    xfree (samples[i].buf);
+}
+
+
+/* Build a certificate with a subject made up of a single RDN with
+   NELEM attributes and with NELEM extensions.  The caller must free
+   the returned object.  */
+static void
+make_seqof_cert (unsigned int nelem, unsigned char **r_der, size_t *r_derlen)
+{
+  static char key[65];
+  ksba_der_t d;
+  gpg_error_t err;
+  unsigned int i;
+
+  d = ksba_der_builder_new (10 * nelem + 64);
+  if (!d)
+    fail ("out of core");
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* Certificate */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* tbsCertificate */
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 0);
+  ksba_der_add_int (d, "\x02", 1, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_int (d, "\x01", 1, 0);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.11");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* issuer */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SET);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "2.5.4.3");
+  ksba_der_add_val (d, 0, KSBA_TYPE_PRINTABLE_STRING, "Benchmark", 9);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* validity */
+  ksba_der_add_val (d, 0, KSBA_TYPE_UTC_TIME, "210101000000Z", 13);
+  ksba_der_add_val (d, 0, KSBA_TYPE_UTC_TIME, "310101000000Z", 13);
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* subject */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SET);
+  for (i=0; i < nelem; i++)
+    {
+      ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+      ksba_der_add_oid (d, "2.5.4.11");
+      ksba_der_add_val (d, 0, KSBA_TYPE_PRINTABLE_STRING, "Unit", 4);
+      ksba_der_add_end (d);
+    }
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);  /* subjectPublicKeyInfo */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.1");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_bts (d, key, sizeof key, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 3);  /* extensions */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  for (i=0; i < nelem; i++)
+    {
+      ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+      ksba_der_add_oid (d, "1.3.6.1.4.1.11591.2.99");
+      ksba_der_add_val (d, 0, KSBA_TYPE_OCTET_STRING, "\x05\x00", 2);
+      ksba_der_add_end (d);
+    }
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);  /* End of tbsCertificate.  */
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.11");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_bts (d, key, sizeof key, 0);
+  ksba_der_add_end (d);
+
+  err = ksba_der_builder_get (d, r_der, r_derlen);
+  fail_if_err (err);
+  ksba_der_release (d);
+}
+
+
+/* Parse certificates with large SET OF and SEQUENCE OF values.  The
+   number of elements parsed in each run is about the same; thus the
+   rates should not depend on the size of the certificates.  */
+static void
+bench_seqof (void)
+{
+  static unsigned int sizes[] = { 100, 1000, 10000 };
+  unsigned char *der;
+  size_t derlen;
+  ksba_cert_t cert;
+  gpg_error_t err;
+  unsigned int n, reps;
+  unsigned long count;
+  double start;
+  char what[40];
+  int i;
+
+  for (i=0; i < DIM (sizes); i++)
+    {
+      make_seqof_cert (sizes[i], &der, &derlen);
+      reps = iterations * 10 / sizes[i];
+      if (!reps)
+        reps = 1;
+
+      n_allocs = 0;
+      start = get_time ();
+      for (count=0, n=0; n < reps; n++)
+        {
+          err = ksba_cert_new (&cert);
+          fail_if_err (err);
+          err = ksba_cert_init_from_mem (cert, der, derlen);
+          fail_if_err (err);
+          ksba_cert_release (cert);
+          count += 2 * sizes[i];
+        }
+      snprintf (what, sizeof what, "seqof %u (elements)", sizes[i]);
+      print_rate (what, count, get_time () - start);
+      ksba_free (der);
+    }
+}
+
+
+/* Run the parser benchmarks once with the generated decoders and
+   once with the interpreter.  */
+static void
+bench_decoder (void)
+{
+  int i;
+
+  for (i=0; i < 2; i++)
+    {
+      printf ("%s:\n", i? "interpreter" : "generated decoders");
+      putenv (i? "KSBA_NO_GENERATED_DECODER=1"
+                : "KSBA_NO_GENERATED_DECODER=");
+      bench_cert (0, 0);
+      bench_cms ();
+      bench_crl (0, 0);
+    }
+  putenv ("KSBA_NO_GENERATED_DECODER=");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int any = 0;
+
+  if (argc)
+    {
+      argc--; argv++;
+    }
+
+  while (argc && **argv == '-')
+    {
+      if (!strcmp (*argv, "--verbose"))
+        {
+          verbose = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--allocs"))
+        {
+          count_allocs = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--iterations") && argc > 1)
+        {
+          iterations = strtoul (argv[1], NULL, 10);
+          argc -= 2; argv += 2;
+        }
+      else
+        {
+          fprintf (stderr, "usage: " PGM " [--iterations N] [--allocs]"
+                   " [cert|cert-nocopy|cert-reuse|batch|pem|getters|crl"
+                   "|crl-index|crl-parallel|crl-pipeline|decoder|seqof"
+                   "|store]\n");
+          exit (1);
+        }
+    }
+
+  if (count_allocs)
+    ksba_set_malloc_hooks (counting_malloc, counting_realloc, free);
+
+  for (; argc; argc--, argv++)
+    {
+      if (!strcmp (*argv, "cert"))
+        bench_cert (0, 0);
+      else if (!strcmp (*argv, "cert-nocopy"))
+        bench_cert (1, 0);
+      else if (!strcmp (*argv, "cert-reuse"))
+        {
+          bench_cert (0, 1);
+          bench_cert (1, 1);
+        }
+      else if (!strcmp (*argv, "batch"))
+        bench_batch ();
+      else if (!strcmp (*argv, "pem"))
+        bench_pem ();
+      else if (!strcmp (*argv, "getters"))
+        bench_getters ();
+      else if (!strcmp (*argv, "crl"))
+        {
+          bench_crl (0, 0);
+          bench_crl (8192, 0);
+          bench_crl (0, 1);
+        }
+      else if (!strcmp (*argv, "crl-index"))
+        bench_crl_index ();
+      else if (!strcmp (*argv, "crl-parallel"))
+        bench_crl_parallel ();
+      else if (!strcmp (*argv, "crl-pipeline"))
+        bench_crl_pipeline ();
+      else if (!strcmp (*argv, "decoder"))
+        bench_decoder ();
+      else if (!strcmp (*argv, "seqof"))
+        bench_seqof ();
+      else if (!strcmp (*argv, "store"))
+        bench_store ();
+      else
+        {
+          fprintf (stderr, PGM ": unknown benchmark `%s'\n", *argv);
+          exit (1);
+        }
+      any = 1;
+    }
+
+  if (!any)
+    bench_cert (0, 0);
+
+  return 0;
+}
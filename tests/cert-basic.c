@@ -35,6 +35,7 @@
 #endif
 
 #define digitp(p)   (*(p) >= '0' && *(p) <= '9')
+#define DIM(v)      (sizeof(v)/sizeof((v)[0]))
 
 #define fail_if_err(a) do { if(a) {                                       \
                               fprintf (stderr, "%s:%d: KSBA error: %s\n", \
@@ -290,6 +291,32 @@ list_extensions (ksba_cert_t cert)
         fputs (" decipherOnly", stdout);
       putchar ('\n');
     }
+
+  /* The decoded constraints and key usage are cached; a second query
+     must return the same.  */
+  {
+    gpg_error_t err2;
+    int is_ca2, pathlen2;
+    unsigned int usage2;
+
+    err = ksba_cert_is_ca (cert, &is_ca, &pathlen);
+    err2 = ksba_cert_is_ca (cert, &is_ca2, &pathlen2);
+    if (err != err2 || is_ca != is_ca2 || pathlen != pathlen2)
+      {
+        fprintf (stderr, "%s:%d: ksba_cert_is_ca not repeatable\n",
+                 __FILE__, __LINE__);
+        errorcount++;
+      }
+    err = ksba_cert_get_key_usage (cert, &usage);
+    err2 = ksba_cert_get_key_usage (cert, &usage2);
+    if (err != err2 || usage != usage2)
+      {
+        fprintf (stderr, "%s:%d: ksba_cert_get_key_usage not repeatable\n",
+                 __FILE__, __LINE__);
+        errorcount++;
+      }
+  }
+
   err = ksba_cert_get_ext_key_usages (cert, &string);
   if (gpg_err_code (err) == GPG_ERR_NO_DATA)
     {
@@ -440,7 +467,7 @@ one_file (const char *fname)
   ksba_isotime_t t;
   int idx;
   ksba_sexp_t sexp;
-  const char *oid, *s;
+  const char *oid, *s, *s2;
 
   fp = fopen (fname, "rb");
   if (!fp)
@@ -477,6 +504,20 @@ one_file (const char *fname)
 
   for (idx=0;(dn = ksba_cert_get_issuer (cert, idx));idx++)
     {
+      if (!idx)
+        {
+          /* The cached name is the same and stays at its place.  */
+          err = ksba_cert_get_dn (cert, 0, &s);
+          fail_if_err2 (fname, err);
+          err = ksba_cert_get_dn (cert, 0, &s2);
+          fail_if_err2 (fname, err);
+          if (strcmp (s, dn) || s != s2)
+            {
+              fprintf (stderr, "%s:%d: ksba_cert_get_dn returned a "
+                       "different issuer\n", __FILE__, __LINE__);
+              errorcount++;
+            }
+        }
       if (!quiet)
         {
           fputs (idx?"         aka: ":"  issuer....: ", stdout);
@@ -488,6 +529,20 @@ one_file (const char *fname)
 
   for (idx=0;(dn = ksba_cert_get_subject (cert, idx));idx++)
     {
+      if (!idx)
+        {
+          /* The cached name is the same and stays at its place.  */
+          err = ksba_cert_get_dn (cert, 1, &s);
+          fail_if_err2 (fname, err);
+          err = ksba_cert_get_dn (cert, 1, &s2);
+          fail_if_err2 (fname, err);
+          if (strcmp (s, dn) || s != s2)
+            {
+              fprintf (stderr, "%s:%d: ksba_cert_get_dn returned a "
+                       "different subject\n", __FILE__, __LINE__);
+              errorcount++;
+            }
+        }
       if (!quiet)
         {
           fputs (idx?"         aka: ":"  subject...: ", stdout);
@@ -636,6 +691,320 @@ one_file (const char *fname)
 
 
 
+/* Read the file FNAME into a malloced buffer and store its length at
+   R_LENGTH.  */
+static unsigned char *
+read_file (const char *fname, size_t *r_length)
+{
+  FILE *fp;
+  long n;
+  unsigned char *buf;
+
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  if (fseek (fp, 0, SEEK_END) || (n = ftell (fp)) < 0
+      || fseek (fp, 0, SEEK_SET))
+    {
+      fprintf (stderr, "%s:%d: can't seek `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  buf = xmalloc (n? n : 1);
+  if (n && fread (buf, n, 1, fp) != 1)
+    {
+      fprintf (stderr, "%s:%d: error reading `%s'\n",
+               __FILE__, __LINE__, fname);
+      exit (1);
+    }
+  fclose (fp);
+  *r_length = n;
+  return buf;
+}
+
+
+/* Parse NFILES certificates from FNAMES several times with
+   ksba_cert_parse_batch and compare the result to a parse of the
+   single certificates.  A truncated certificate is put in the middle
+   to check the error reporting.  */
+static void
+test_parse_batch (char **fnames, int nfiles)
+{
+  enum { COPIES = 7 };
+  gpg_error_t err;
+  const void **bufs;
+  size_t *lens;
+  ksba_cert_t *certs;
+  ksba_cert_t cert;
+  gpg_error_t *errs;
+  unsigned char **images;
+  size_t *imagelens;
+  const unsigned char *image;
+  size_t n, length, bad, idx;
+  unsigned int nthreads;
+  int i;
+
+  images = xmalloc (nfiles * sizeof *images);
+  imagelens = xmalloc (nfiles * sizeof *imagelens);
+  for (i=0; i < nfiles; i++)
+    images[i] = read_file (fnames[i], imagelens + i);
+
+  n = nfiles * COPIES + 1;
+  bufs = xmalloc (n * sizeof *bufs);
+  lens = xmalloc (n * sizeof *lens);
+  certs = xmalloc (n * sizeof *certs);
+  errs = xmalloc (n * sizeof *errs);
+  bad = n / 2;
+  for (idx=0; idx < n; idx++)
+    {
+      i = (idx < bad? idx : idx - 1) % nfiles;
+      bufs[idx] = images[i];
+      lens[idx] = idx == bad? imagelens[i] / 2 : imagelens[i];
+    }
+
+  for (nthreads=0; nthreads <= 4; nthreads++)
+    {
+      memset (certs, 0, n * sizeof *certs);
+      err = ksba_cert_parse_batch (bufs, lens, n, certs, errs, nthreads);
+      /* The truncated certificate is the only one failing.  */
+      if (!err || err != errs[bad])
+        {
+          fprintf (stderr, "%s:%d: ksba_cert_parse_batch returned: %s\n",
+                   __FILE__, __LINE__, gpg_strerror (err));
+          errorcount++;
+        }
+      for (idx=0; idx < n; idx++)
+        {
+          if (idx == bad)
+            {
+              if (certs[idx] || !errs[idx])
+                {
+                  fprintf (stderr, "%s:%d: truncated certificate accepted\n",
+                           __FILE__, __LINE__);
+                  errorcount++;
+                }
+              continue;
+            }
+          if (!certs[idx] || errs[idx])
+            {
+              fprintf (stderr, "%s:%d: certificate %u failed: %s\n",
+                       __FILE__, __LINE__, (unsigned int)idx,
+                       gpg_strerror (errs[idx]));
+              errorcount++;
+              continue;
+            }
+          /* Compare with the image from a single parse.  */
+          err = ksba_cert_new (&cert);
+          fail_if_err (err);
+          err = ksba_cert_init_from_mem (cert, bufs[idx], lens[idx]);
+          fail_if_err (err);
+          image = ksba_cert_get_image (certs[idx], &length);
+          if (!image || length != lens[idx]
+              || memcmp (image, ksba_cert_get_image (cert, NULL), length))
+            {
+              fprintf (stderr, "%s:%d: certificate %u differs\n",
+                       __FILE__, __LINE__, (unsigned int)idx);
+              errorcount++;
+            }
+          ksba_cert_release (cert);
+          ksba_cert_release (certs[idx]);
+        }
+    }
+
+  /* Without an error array only the first error is returned.  */
+  err = ksba_cert_parse_batch (bufs, lens, bad, certs, NULL, 2);
+  fail_if_err (err);
+  for (idx=0; idx < bad; idx++)
+    ksba_cert_release (certs[idx]);
+
+  xfree (errs);
+  xfree (certs);
+  xfree (lens);
+  xfree (bufs);
+  for (i=0; i < nfiles; i++)
+    xfree (images[i]);
+  xfree (imagelens);
+  xfree (images);
+}
+
+
+static gpg_error_t
+my_hash_buffer (void *arg, const char *oid,
+                const void *buffer, size_t length, size_t resultsize,
+                unsigned char *result, size_t *resultlen)
+{
+  int *counter = arg;
+
+  if (oid && strcmp (oid, "1.3.14.3.2.26"))
+    return gpg_error (GPG_ERR_NOT_SUPPORTED); /* We only support SHA-1. */
+  if (resultsize < 20)
+    return gpg_error (GPG_ERR_BUFFER_TOO_SHORT);
+  sha1_hash_buffer (result, buffer, length);
+  *resultlen = 20;
+  ++*counter;
+  return 0;
+}
+
+
+/* Check that ksba_cert_get_digest returns the SHA-1 fingerprint of
+   the certificate in FNAME and that it is computed only once.  */
+static void
+test_get_digest (const char *fname)
+{
+  gpg_error_t err;
+  ksba_cert_t cert;
+  unsigned char *image;
+  size_t imagelen;
+  char fpr[20];
+  const unsigned char *digest, *digest2;
+  size_t digestlen, digestlen2;
+  int counter = 0;
+
+  image = read_file (fname, &imagelen);
+  sha1_hash_buffer (fpr, (char *)image, imagelen);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, image, imagelen);
+  fail_if_err (err);
+
+  err = ksba_cert_get_digest (cert, 0, NULL, &digest, &digestlen);
+  if (gpg_err_code (err) != GPG_ERR_CONFIGURATION)
+    {
+      fprintf (stderr, "%s:%d: ksba_cert_get_digest w/o hash function: %s\n",
+               __FILE__, __LINE__, gpg_strerror (err));
+      errorcount++;
+    }
+
+  ksba_set_hash_buffer_function (my_hash_buffer, &counter);
+  err = ksba_cert_get_digest (cert, 0, NULL, &digest, &digestlen);
+  fail_if_err (err);
+  if (digestlen != 20 || memcmp (digest, fpr, 20))
+    {
+      fprintf (stderr, "%s:%d: wrong fingerprint\n", __FILE__, __LINE__);
+      errorcount++;
+    }
+  err = ksba_cert_get_digest (cert, 0, NULL, &digest2, &digestlen2);
+  fail_if_err (err);
+  if (digest2 != digest || digestlen2 != digestlen || counter != 1)
+    {
+      fprintf (stderr, "%s:%d: fingerprint not cached\n", __FILE__, __LINE__);
+      errorcount++;
+    }
+
+  /* The to-be-signed part has its own digest.  */
+  err = ksba_cert_get_digest (cert, 1, "1.3.14.3.2.26", &digest2, &digestlen2);
+  fail_if_err (err);
+  if (digestlen2 != 20 || !memcmp (digest2, fpr, 20) || counter != 2)
+    {
+      fprintf (stderr, "%s:%d: wrong TBS digest\n", __FILE__, __LINE__);
+      errorcount++;
+    }
+
+  /* Errors are not cached.  */
+  err = ksba_cert_get_digest (cert, 0, "2.16.840.1.101.3.4.2.1",
+                              &digest2, &digestlen2);
+  if (gpg_err_code (err) != GPG_ERR_NOT_SUPPORTED)
+    {
+      fprintf (stderr, "%s:%d: ksba_cert_get_digest with SHA-256: %s\n",
+               __FILE__, __LINE__, gpg_strerror (err));
+      errorcount++;
+    }
+  err = ksba_cert_get_digest (cert, 0, "2.16.840.1.101.3.4.2.1",
+                              &digest2, &digestlen2);
+  if (gpg_err_code (err) != GPG_ERR_NOT_SUPPORTED)
+    {
+      fprintf (stderr, "%s:%d: ksba_cert_get_digest with SHA-256: %s\n",
+               __FILE__, __LINE__, gpg_strerror (err));
+      errorcount++;
+    }
+
+  /* A reset drops the digests.  */
+  err = ksba_cert_reset (cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, image, imagelen);
+  fail_if_err (err);
+  err = ksba_cert_get_digest (cert, 0, NULL, &digest, &digestlen);
+  fail_if_err (err);
+  if (digestlen != 20 || memcmp (digest, fpr, 20) || counter != 3)
+    {
+      fprintf (stderr, "%s:%d: wrong fingerprint after reset\n",
+               __FILE__, __LINE__);
+      errorcount++;
+    }
+
+  ksba_set_hash_buffer_function (NULL, NULL);
+  ksba_cert_release (cert);
+  xfree (image);
+}
+
+
+/* The extension OIDs of the sample ov-server.crt are patched so that
+   the issuerAltName OID ends in a continuation byte.  ksba_cert_get_extension decodes
+   that to the regular OID and thus the extension must also be found
+   by ksba_cert_get_issuer.  */
+static void
+test_malformed_extn_oid (void)
+{
+  static const char oid_ian[] = "\x06\x03\x55\x1d\x12";
+  gpg_error_t err;
+  ksba_cert_t cert;
+  unsigned char *image;
+  size_t imagelen, n;
+  const char *oid;
+  char *fname, *expected, *name;
+  int idx, found;
+
+  fname = prepend_srcdir ("samples/ov-server.crt");
+  image = read_file (fname, &imagelen);
+  xfree (fname);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, image, imagelen);
+  fail_if_err (err);
+  expected = ksba_cert_get_issuer (cert, 1);
+  if (!expected)
+    fail ("sample certificate has no issuerAltName");
+  ksba_cert_release (cert);
+
+  for (n=0; n + sizeof oid_ian - 1 <= imagelen; n++)
+    if (!memcmp (image + n, oid_ian, sizeof oid_ian - 1))
+      break;
+  if (n + sizeof oid_ian - 1 > imagelen)
+    fail ("issuerAltName OID not found");
+  image[n + 4] |= 0x80;
+
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, image, imagelen);
+  fail_if_err (err);
+  for (found=idx=0; !(err=ksba_cert_get_extension (cert, idx, &oid, NULL,
+                                                    NULL, NULL)); idx++)
+    if (!strcmp (oid, "2.5.29.18"))
+      found = 1;
+  if (!found)
+    {
+      fprintf (stderr, "%s:%d: patched OID not listed\n", __FILE__, __LINE__);
+      errorcount++;
+    }
+  name = ksba_cert_get_issuer (cert, 1);
+  if (!name || strcmp (name, expected))
+    {
+      fprintf (stderr, "%s:%d: issuerAltName with patched OID not found\n",
+               __FILE__, __LINE__);
+      errorcount++;
+    }
+
+  ksba_free (name);
+  ksba_free (expected);
+  ksba_cert_release (cert);
+  xfree (image);
+}
+
+
 int
 main (int argc, char **argv)
 {
@@ -690,6 +1059,7 @@ main (int argc, char **argv)
         NULL
       };
       int idx;
+      char *fnames[DIM (files)];
 
       if (!verbose)
         quiet = 1;
@@ -703,8 +1073,14 @@ main (int argc, char **argv)
           strcat (fname, "/samples/");
           strcat (fname, files[idx]);
           one_file (fname);
-          ksba_free (fname);
+          fnames[idx] = fname;
         }
+
+      test_parse_batch (fnames, idx);
+      test_get_digest (fnames[0]);
+      test_malformed_extn_oid ();
+      while (idx)
+        ksba_free (fnames[--idx]);
     }
 
   return !!errorcount;
@@ -0,0 +1,192 @@
+/* crlgen.c - Generate synthetic CRLs for the tests
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The CRLs built here are only used to exercise the parser and for
+   the benchmarks; they have no valid signature.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/ksba.h"
+
+
+/* Store the tag TAG and the length LEN at P and return the number
+   of bytes written.  With P being NULL only that number is returned.  */
+static size_t
+put_tl (unsigned char *p, int tag, size_t len)
+{
+  size_t n, i;
+
+  if (len < 128)
+    n = 0;
+  else if (len < 256)
+    n = 1;
+  else if (len < 65536)
+    n = 2;
+  else if (len < 16777216)
+    n = 3;
+  else
+    n = 4;
+  if (p)
+    {
+      p[0] = tag;
+      if (!n)
+        p[1] = len;
+      else
+        {
+          p[1] = 0x80 | n;
+          for (i=0; i < n; i++)
+            p[2+i] = len >> (8 * (n - 1 - i));
+        }
+    }
+  return 2 + n;
+}
+
+
+/* Store the entry number I at P and return its length.  See
+   make_test_crl for the description of UNIFORM.  */
+static size_t
+put_entry (unsigned char *p, unsigned long i, int uniform)
+{
+  static const unsigned char reason[] = {       /* crlReason */
+    0x30, 0x0a, 0x06, 0x03, 0x55, 0x1d, 0x15, 0x04, 0x03, 0x0a, 0x01
+  };
+  static const unsigned char invdate[] = {      /* invalidityDate */
+    0x30, 0x18, 0x06, 0x03, 0x55, 0x1d, 0x18, 0x04, 0x11, 0x18, 0x0f,
+    '2', '0', '2', '1', '0', '5', '0', '1', '0', '0', '0', '0', '0', '0', 'Z'
+  };
+  unsigned char *start = p;
+  size_t n, j, ext;
+  int with_reason, with_invdate;
+
+  p += 2;
+  if (uniform)
+    {
+      p += put_tl (p, 0x02, 4);
+      *p++ = 0x40 | ((i >> 24) & 0x3f);
+      *p++ = i >> 16;
+      *p++ = i >> 8;
+      *p++ = i;
+    }
+  else
+    {
+      n = 1 + i % 20;
+      p += put_tl (p, 0x02, n);
+      *p++ = 1 + i % 127;  /* Unique for all serials of this length.  */
+      for (j=1; j < n; j++)
+        *p++ = i >> (8 * (j % 2));
+    }
+
+  p += put_tl (p, 0x17, 13);
+  if (uniform)
+    memcpy (p, "210615123000Z", 13);
+  else
+    sprintf ((char *)p, "21061512%02d%02dZ",
+             (int)((i / 60) % 60), (int)(i % 60));
+  p += 13;
+
+  with_reason = uniform || (i % 3);
+  with_invdate = !uniform && !(i % 5);
+  ext = (with_reason? sizeof reason + 1 : 0)
+        + (with_invdate? sizeof invdate : 0);
+  if (ext)
+    {
+      p += put_tl (p, 0x30, ext);
+      if (with_reason)
+        {
+          memcpy (p, reason, sizeof reason);
+          p += sizeof reason;
+          *p++ = uniform? 1 /* keyCompromise */ : i % 7;
+        }
+      if (with_invdate)
+        {
+          memcpy (p, invdate, sizeof invdate);
+          p += sizeof invdate;
+        }
+    }
+  put_tl (start, 0x30, p - start - 2);
+  return p - start;
+}
+
+
+/* Build a CRL with NENTRIES revoked certificates and return it in a
+   buffer allocated with ksba_malloc; its length is stored at R_LEN.
+   If UNIFORM is set, all entries have the same size: a 4 byte serial
+   number, a revocation date and the reason keyCompromise.  Otherwise
+   the serial numbers have 1 to 20 bytes and some entries have a
+   reason code and some an invalidityDate extension.  */
+unsigned char *
+make_test_crl (unsigned long nentries, int uniform, size_t *r_len)
+{
+  static const unsigned char head[] = {
+    0x02, 0x01, 0x01,                           /* version */
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48,   /* signature */
+    0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00,
+    0x30, 0x0f, 0x31, 0x0d, 0x30, 0x0b, 0x06,   /* issuer */
+    0x03, 0x55, 0x04, 0x03, 0x13, 0x04, 'T', 'e', 's', 't',
+    0x17, 0x0d, '2', '1', '0', '1', '0', '1',   /* thisUpdate */
+    '0', '0', '0', '0', '0', '0', 'Z',
+    0x17, 0x0d, '3', '1', '0', '1', '0', '1',   /* nextUpdate */
+    '0', '0', '0', '0', '0', '0', 'Z'
+  };
+  static const unsigned char tail[] = {
+    0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48,   /* signatureAlgorithm */
+    0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00,
+    0x03, 0x05, 0x00, 1, 2, 3, 4                /* signatureValue */
+  };
+  unsigned char *entries, *der, *p;
+  size_t seqlen, tbslen, crllen;
+  unsigned long i;
+
+  /* No entry takes more than 100 bytes.  */
+  entries = ksba_malloc (nentries? nentries * 100 : 1);
+  if (!entries)
+    {
+      fprintf (stderr, "out of core\n");
+      exit (1);
+    }
+  for (seqlen=0, i=0; i < nentries; i++)
+    seqlen += put_entry (entries + seqlen, i, uniform);
+
+  tbslen = sizeof head + (nentries? put_tl (NULL, 0x30, seqlen) + seqlen : 0);
+  crllen = put_tl (NULL, 0x30, tbslen) + tbslen + sizeof tail;
+  *r_len = put_tl (NULL, 0x30, crllen) + crllen;
+  der = p = ksba_malloc (*r_len);
+  if (!der)
+    {
+      fprintf (stderr, "out of core\n");
+      exit (1);
+    }
+
+  p += put_tl (p, 0x30, crllen);
+  p += put_tl (p, 0x30, tbslen);
+  memcpy (p, head, sizeof head);
+  p += sizeof head;
+  if (nentries)
+    {
+      p += put_tl (p, 0x30, seqlen);
+      memcpy (p, entries, seqlen);
+      p += seqlen;
+    }
+  memcpy (p, tail, sizeof tail);
+  ksba_free (entries);
+  return der;
+}
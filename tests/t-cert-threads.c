@@ -0,0 +1,332 @@
+/* t-cert-threads.c - Share certificates between threads
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Many threads query the same freshly read certificate so that they
+   race for filling its caches and change its reference counter.  Run
+   this under a thread sanitizer to make sure it is race free.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#elif defined(HAVE_PTHREAD)
+# include <pthread.h>
+#endif
+
+#include "../src/ksba.h"
+
+#define PGM "t-cert-threads"
+
+#include "t-common.h"
+
+#define NTHREADS   8
+#define ROUNDS     20
+#define ITERATIONS 50
+
+
+static int verbose;
+static int errorcount;
+
+static const char *cert_files[] = {
+  "authority.crt",
+  "ov-root-ca-cert.crt",
+  "cert_g10code_test1.der",
+  "secp256r1-sha384_cert.crt",
+  NULL
+};
+
+
+/* What a thread learned about the certificate.  */
+struct result_s
+{
+  ksba_cert_t cert;
+  const char *algo;
+  int ca, pathlen;
+  unsigned int usage;
+  gpg_error_t usage_err;
+  const unsigned char *digest;
+  size_t digestlen;
+  int nextns;
+  int failed;
+};
+
+
+static gpg_error_t
+my_hash_buffer (void *arg, const char *oid,
+                const void *buffer, size_t length, size_t resultsize,
+                unsigned char *result, size_t *resultlen)
+{
+  (void)arg;
+
+  if (oid && strcmp (oid, "1.3.14.3.2.26"))
+    return gpg_error (GPG_ERR_NOT_SUPPORTED); /* We only support SHA-1. */
+  if (resultsize < 20)
+    return gpg_error (GPG_ERR_BUFFER_TOO_SHORT);
+  sha1_hash_buffer (result, buffer, length);
+  *resultlen = 20;
+  return 0;
+}
+
+
+static void *
+read_file (const char *name, size_t *r_length)
+{
+  char *fname, *p;
+  FILE *fp;
+  char *buf;
+  size_t len;
+
+  fname = xmalloc (strlen ("samples/") + strlen (name) + 1);
+  strcpy (fname, "samples/");
+  strcat (fname, name);
+  p = prepend_srcdir (fname);
+  xfree (fname);
+  fname = p;
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  buf = xmalloc (65536);
+  len = fread (buf, 1, 65536, fp);
+  if (!len || !feof (fp))
+    fail ("error reading sample file");
+  fclose (fp);
+  xfree (fname);
+  *r_length = len;
+  return buf;
+}
+
+
+/* Query the certificate of RES like an application would do.  */
+static void
+query_cert (struct result_s *res, int first)
+{
+  gpg_error_t err, usage_err;
+  ksba_cert_t cert;
+  const char *algo, *oid;
+  int ca, pathlen, idx;
+  unsigned int usage;
+  const unsigned char *digest;
+  size_t digestlen;
+  ksba_sexp_t keyid;
+  char *subject;
+  const char *dn;
+
+  cert = res->cert;
+  ksba_cert_ref (cert);
+
+  algo = ksba_cert_get_digest_algo (cert);
+  err = ksba_cert_is_ca (cert, &ca, &pathlen);
+  if (err)
+    ca = pathlen = -2;
+  usage_err = ksba_cert_get_key_usage (cert, &usage);
+  err = ksba_cert_get_digest (cert, 0, NULL, &digest, &digestlen);
+  if (err)
+    digest = NULL;
+  for (idx=0; !ksba_cert_get_extension (cert, idx, &oid, NULL, NULL, NULL);
+       idx++)
+    ;
+  if (!ksba_cert_get_subj_key_id (cert, NULL, &keyid))
+    ksba_free (keyid);
+  subject = ksba_cert_get_subject (cert, 0);
+  if (!subject || ksba_cert_get_dn (cert, 1, &dn) || strcmp (dn, subject))
+    res->failed = 1;
+  xfree (subject);
+
+  if (first)
+    {
+      res->algo = algo;
+      res->ca = ca;
+      res->pathlen = pathlen;
+      res->usage = usage;
+      res->usage_err = usage_err;
+      res->digest = digest;
+      res->digestlen = digestlen;
+      res->nextns = idx;
+    }
+  else if (algo != res->algo || ca != res->ca || pathlen != res->pathlen
+           || usage != res->usage || usage_err != res->usage_err
+           || digest != res->digest
+           || idx != res->nextns)
+    res->failed = 1;
+
+  ksba_cert_release (cert);
+}
+
+
+#ifdef HAVE_W32_SYSTEM
+static DWORD WINAPI
+thread_main (void *arg)
+#else
+static void *
+thread_main (void *arg)
+#endif
+{
+  struct result_s *res = arg;
+  int i;
+
+  for (i=0; i < ITERATIONS; i++)
+    query_cert (res, !i);
+  return 0;
+}
+
+
+/* Run the queries on CERT using NTHREADS threads and store what they
+   found in RESULTS.  Without support for threads they are run one
+   after the other.  */
+static void
+run_threads (ksba_cert_t cert, struct result_s *results)
+{
+  int i;
+#ifdef HAVE_W32_SYSTEM
+  HANDLE threads[NTHREADS];
+#elif defined(HAVE_PTHREAD)
+  pthread_t threads[NTHREADS];
+#endif
+
+  for (i=0; i < NTHREADS; i++)
+    {
+      memset (results + i, 0, sizeof *results);
+      results[i].cert = cert;
+    }
+  for (i=0; i < NTHREADS; i++)
+    {
+#ifdef HAVE_W32_SYSTEM
+      threads[i] = CreateThread (NULL, 0, thread_main, results + i, 0, NULL);
+      if (!threads[i])
+        fail ("error creating thread");
+#elif defined(HAVE_PTHREAD)
+      if (pthread_create (threads + i, NULL, thread_main, results + i))
+        fail ("error creating thread");
+#else
+      thread_main (results + i);
+#endif
+    }
+  for (i=0; i < NTHREADS; i++)
+    {
+#ifdef HAVE_W32_SYSTEM
+      WaitForSingleObject (threads[i], INFINITE);
+      CloseHandle (threads[i]);
+#elif defined(HAVE_PTHREAD)
+      pthread_join (threads[i], NULL);
+#endif
+    }
+}
+
+
+static void
+test_shared_cert (const char *name)
+{
+  gpg_error_t err;
+  void *buf;
+  size_t buflen;
+  ksba_cert_t cert;
+  struct result_s results[NTHREADS];
+  int round, i;
+
+  buf = read_file (name, &buflen);
+  for (round=0; round < ROUNDS; round++)
+    {
+      /* A new object for each round so that the threads race for
+         filling the caches.  */
+      err = ksba_cert_new (&cert);
+      fail_if_err (err);
+      err = ksba_cert_init_from_mem (cert, buf, buflen);
+      fail_if_err2 (name, err);
+
+      run_threads (cert, results);
+
+      for (i=0; i < NTHREADS; i++)
+        {
+          if (results[i].failed)
+            {
+              fprintf (stderr, "%s: thread %d got inconsistent results\n",
+                       name, i);
+              errorcount++;
+            }
+          /* The cached values are returned by the same pointers.  */
+          if (results[i].algo != results[0].algo
+              || results[i].digest != results[0].digest
+              || results[i].ca != results[0].ca
+              || results[i].pathlen != results[0].pathlen
+              || results[i].usage != results[0].usage
+              || results[i].usage_err != results[0].usage_err
+              || results[i].nextns != results[0].nextns)
+            {
+              fprintf (stderr, "%s: threads 0 and %d disagree\n", name, i);
+              errorcount++;
+            }
+        }
+      if (!results[0].algo || !results[0].digest)
+        {
+          fprintf (stderr, "%s: digest or algorithm missing\n", name);
+          errorcount++;
+        }
+      if (verbose && !round)
+        printf ("%s: %d threads: algo=%s ca=%d pathlen=%d extensions=%d\n",
+                name, NTHREADS, results[0].algo? results[0].algo : "?",
+                results[0].ca, results[0].pathlen, results[0].nextns);
+
+      /* All references taken by the threads have been released.  */
+      err = ksba_cert_reset (cert);
+      if (err)
+        {
+          fprintf (stderr, "%s: reference counter is off\n", name);
+          errorcount++;
+        }
+      ksba_cert_release (cert);
+    }
+  xfree (buf);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int i;
+
+  if (argc)
+    {
+      argc--;  argv++;
+    }
+
+  if (argc && !strcmp (*argv, "--verbose"))
+    {
+      verbose = 1;
+      argc--; argv++;
+    }
+
+  if (argc)
+    {
+      fputs ("usage: "PGM" [--verbose]\n", stderr);
+      return 1;
+    }
+
+  ksba_set_hash_buffer_function (my_hash_buffer, NULL);
+  for (i=0; cert_files[i]; i++)
+    test_shared_cert (cert_files[i]);
+
+  return !!errorcount;
+}
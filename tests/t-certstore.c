@@ -0,0 +1,736 @@
+/* t-certstore.c - Test the certificate store
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "../src/ksba.h"
+
+#define PGM "t-certstore"
+
+#include "t-common.h"
+
+#define DIM(v) (sizeof(v)/sizeof((v)[0]))
+
+
+static int verbose;
+static int errorcount;
+
+static const char *cert_files[] = {
+  "cert_dfn_pca01.der",
+  "cert_dfn_pca15.der",
+  "cert_g10code_test1.der",
+  "authority.crt",
+  "betsy.crt",
+  "bull.crt",
+  "ov-ocsp-server.crt",
+  "ov-userrev.crt",
+  "ov-root-ca-cert.crt",
+  "ov-serverrev.crt",
+  "ov-user.crt",
+  "ov-server.crt",
+  "ov2-root-ca-cert.crt",
+  "ov2-ocsp-server.crt",
+  "ov2-user.crt",
+  "ov2-userrev.crt",
+  "secp256r1-sha384_cert.crt",
+  "secp256r1-sha512_cert.crt",
+  "secp384r1-sha512_cert.crt",
+  "openssl-secp256r1ca.cert.crt",
+  "ed25519-rfc8410.crt",
+  "ed25519-ossl-1.crt",
+  "ed448-ossl-1.crt",
+  NULL
+};
+
+
+#define error(a) do { fprintf (stderr, "%s:%d: %s\n",                 \
+                               __FILE__, __LINE__, (a));               \
+                      errorcount++; } while (0)
+
+
+static ksba_cert_t
+read_cert (const char *name)
+{
+  gpg_error_t err;
+  char *fname, *p;
+  FILE *fp;
+  ksba_reader_t r;
+  ksba_cert_t cert;
+
+  fname = xmalloc (strlen ("samples/") + strlen (name) + 1);
+  strcpy (fname, "samples/");
+  strcat (fname, name);
+  p = prepend_srcdir (fname);
+  xfree (fname);
+  fname = p;
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  err = ksba_reader_new (&r);
+  fail_if_err (err);
+  err = ksba_reader_set_file (r, fp);
+  fail_if_err (err);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_read_der (cert, r);
+  fail_if_err2 (fname, err);
+  ksba_reader_release (r);
+  fclose (fp);
+  xfree (fname);
+  return cert;
+}
+
+
+static int
+same_cert (ksba_cert_t a, ksba_cert_t b)
+{
+  const unsigned char *ia, *ib;
+  size_t na, nb;
+
+  ia = ksba_cert_get_image (a, &na);
+  ib = ksba_cert_get_image (b, &nb);
+  return ia && ib && na == nb && !memcmp (ia, ib, na);
+}
+
+
+static gpg_error_t
+my_hash_buffer (void *arg, const char *oid,
+                const void *buffer, size_t length, size_t resultsize,
+                unsigned char *result, size_t *resultlen)
+{
+  (void)arg;
+
+  if (oid && strcmp (oid, "1.3.14.3.2.26"))
+    return gpg_error (GPG_ERR_NOT_SUPPORTED); /* We only support SHA-1. */
+  if (resultsize < 20)
+    return gpg_error (GPG_ERR_BUFFER_TOO_SHORT);
+  sha1_hash_buffer (result, buffer, length);
+  *resultlen = 20;
+  return 0;
+}
+
+
+/* Add all sample certificates to a store and compare the lookups with
+   a linear search.  */
+static void
+test_lookups (void)
+{
+  gpg_error_t err;
+  ksba_certstore_t store;
+  ksba_cert_t certs[DIM (cert_files)];
+  ksba_cert_t cert, dup;
+  int ncerts, i, j, idx, count;
+  char *issuer, *name;
+  ksba_sexp_t keyid, serial;
+  const unsigned char *image;
+  size_t imagelen;
+  char fpr[20];
+
+  for (ncerts=0; cert_files[ncerts]; ncerts++)
+    certs[ncerts] = read_cert (cert_files[ncerts]);
+
+  ksba_set_hash_buffer_function (my_hash_buffer, NULL);
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  for (i=0; i < ncerts; i++)
+    {
+      err = ksba_certstore_add (store, certs[i]);
+      fail_if_err2 (cert_files[i], err);
+    }
+
+  /* Adding a copy of a certificate is detected.  */
+  dup = read_cert (cert_files[0]);
+  err = ksba_certstore_add (store, dup);
+  if (gpg_err_code (err) != GPG_ERR_DUP_VALUE)
+    error ("duplicate not detected");
+  ksba_cert_release (dup);
+
+  for (i=0; i < ncerts; i++)
+    {
+      /* All candidates for the issuer have the issuer's name as
+         subject and there are as many as a linear search finds.  */
+      issuer = ksba_cert_get_issuer (certs[i], 0);
+      for (idx=0; !(err = ksba_certstore_find_issuer (store, certs[i],
+                                                      idx, &cert)); idx++)
+        {
+          name = ksba_cert_get_subject (cert, 0);
+          if (!name || strcmp (name, issuer))
+            error ("wrong issuer found");
+          xfree (name);
+          ksba_cert_release (cert);
+        }
+      if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+        fail_if_err (err);
+      for (count=j=0; j < ncerts; j++)
+        {
+          name = ksba_cert_get_subject (certs[j], 0);
+          if (!strcmp (name, issuer))
+            count++;
+          xfree (name);
+        }
+      if (count != idx)
+        error ("number of issuers does not match");
+      if (verbose)
+        printf ("%s: %d issuer(s)\n", cert_files[i], idx);
+
+      /* The serial number and the issuer identify the certificate.  */
+      serial = ksba_cert_get_serial (certs[i]);
+      err = ksba_certstore_find_serial (store, issuer, serial, &cert);
+      fail_if_err2 (cert_files[i], err);
+      if (!same_cert (cert, certs[i]))
+        error ("wrong certificate found by serial number");
+      ksba_cert_release (cert);
+      err = ksba_certstore_find_serial (store, "CN=Nobody", serial, &cert);
+      if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+        error ("certificate with wrong issuer found by serial number");
+      ksba_free (serial);
+      xfree (issuer);
+
+      /* The key identifier finds the certificate itself.  */
+      err = ksba_cert_get_subj_key_id (certs[i], NULL, &keyid);
+      if (!err)
+        {
+          for (idx=0; !(err = ksba_certstore_find_keyid (store, keyid,
+                                                         idx, &cert)); idx++)
+            {
+              j = same_cert (cert, certs[i]);
+              ksba_cert_release (cert);
+              if (j)
+                break;
+            }
+          if (err)
+            error ("certificate not found by key identifier");
+          ksba_free (keyid);
+        }
+      else if (gpg_err_code (err) != GPG_ERR_NO_DATA)
+        fail_if_err2 (cert_files[i], err);
+
+      /* And so does the fingerprint.  */
+      image = ksba_cert_get_image (certs[i], &imagelen);
+      sha1_hash_buffer (fpr, (const char *)image, imagelen);
+      err = ksba_certstore_find_fpr (store, (unsigned char *)fpr, 20, &cert);
+      fail_if_err2 (cert_files[i], err);
+      if (!same_cert (cert, certs[i]))
+        error ("wrong certificate found by fingerprint");
+      ksba_cert_release (cert);
+    }
+
+  /* The store holds its own references; FPR is still the fingerprint
+     of the last certificate.  */
+  for (i=0; i < ncerts; i++)
+    ksba_cert_release (certs[i]);
+  err = ksba_certstore_find_fpr (store, (unsigned char *)fpr, 20, &cert);
+  fail_if_err (err);
+  if (!ksba_cert_get_image (cert, NULL))
+    error ("certificate released by the store's owner");
+  ksba_cert_release (cert);
+
+  memset (fpr, 0, sizeof fpr);
+  err = ksba_certstore_find_fpr (store, (unsigned char *)fpr, 20, &cert);
+  if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+    error ("unknown fingerprint found");
+  ksba_certstore_release (store);
+  ksba_set_hash_buffer_function (NULL, NULL);
+}
+
+
+/* Release the LENGTH certificates of CHAIN and CHAIN itself.  */
+static void
+release_chain (ksba_cert_t *chain, int length)
+{
+  int i;
+
+  for (i=0; i < length; i++)
+    ksba_cert_release (chain[i]);
+  ksba_free (chain);
+}
+
+
+/* Build the chains of all sample certificates and check that they
+   link up to a self-issued root.  */
+static void
+test_chains (void)
+{
+  gpg_error_t err;
+  ksba_certstore_t store;
+  ksba_cert_t certs[DIM (cert_files)];
+  ksba_cert_t *chain, *chain2;
+  int length, length2;
+  int ncerts, i, j, idx;
+  char *issuer, *subject;
+  int must_have_chain;
+
+  for (ncerts=0; cert_files[ncerts]; ncerts++)
+    certs[ncerts] = read_cert (cert_files[ncerts]);
+
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  for (i=0; i < ncerts; i++)
+    {
+      err = ksba_certstore_add (store, certs[i]);
+      fail_if_err2 (cert_files[i], err);
+    }
+
+  for (i=0; i < ncerts; i++)
+    {
+      must_have_chain = (!strcmp (cert_files[i], "betsy.crt")
+                         || !strcmp (cert_files[i], "ov-user.crt")
+                         || !strcmp (cert_files[i], "ov2-user.crt"));
+      for (idx=0; !(err = ksba_certstore_build_chain (store, certs[i], idx,
+                                                      &chain, &length));
+           idx++)
+        {
+          if (verbose)
+            printf ("%s: chain %d has %d certificate(s)\n",
+                    cert_files[i], idx, length);
+          if (length < 1)
+            error ("empty chain returned");
+          issuer = ksba_cert_get_issuer (certs[i], 0);
+          for (j=0; j < length; j++)
+            {
+              subject = ksba_cert_get_subject (chain[j], 0);
+              if (!subject || strcmp (subject, issuer))
+                error ("chain does not link up");
+              xfree (subject);
+              xfree (issuer);
+              issuer = ksba_cert_get_issuer (chain[j], 0);
+            }
+          subject = ksba_cert_get_subject (chain[length-1], 0);
+          if (!subject || strcmp (subject, issuer))
+            error ("chain does not end at a root certificate");
+          xfree (subject);
+          xfree (issuer);
+
+          /* The memoized paths yield the same result.  */
+          err = ksba_certstore_build_chain (store, certs[i], idx,
+                                            &chain2, &length2);
+          fail_if_err (err);
+          if (length2 != length)
+            error ("chain changed");
+          else
+            for (j=0; j < length; j++)
+              if (!same_cert (chain[j], chain2[j]))
+                error ("chain changed");
+          release_chain (chain2, length2);
+          release_chain (chain, length);
+        }
+      if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+        fail_if_err2 (cert_files[i], err);
+      if (must_have_chain && !idx)
+        {
+          fprintf (stderr, "%s: no chain found\n", cert_files[i]);
+          error ("chain not found");
+        }
+    }
+
+  ksba_certstore_release (store);
+  for (i=0; i < ncerts; i++)
+    ksba_cert_release (certs[i]);
+}
+
+
+/* Add the name "CN=NAME" to D.  */
+static void
+add_name (ksba_der_t d, const char *name)
+{
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SET);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "2.5.4.3");
+  ksba_der_add_val (d, 0, KSBA_TYPE_UTF8_STRING, name, strlen (name));
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+}
+
+
+/* Add the extension OID with the value built by EXTN to D and
+   release EXTN.  */
+static void
+add_extension (ksba_der_t d, const char *oid, ksba_der_t extn)
+{
+  gpg_error_t err;
+  unsigned char *der;
+  size_t derlen;
+
+  err = ksba_der_builder_get (extn, &der, &derlen);
+  fail_if_err (err);
+  ksba_der_release (extn);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, oid);
+  ksba_der_add_val (d, 0, KSBA_TYPE_OCTET_STRING, der, derlen);
+  ksba_der_add_end (d);
+  xfree (der);
+}
+
+
+/* Create a certificate for SUBJECT issued by ISSUER.  PATHLEN is -2
+   for an end entity certificate, -1 for a CA certificate without a
+   pathLenConstraint or the pathLenConstraint.  SKID and AKID are the
+   subject and the authority key identifiers or NULL.  The signature
+   is not valid.  */
+static ksba_cert_t
+make_cert (const char *subject, const char *issuer, int pathlen,
+           const char *skid, const char *akid)
+{
+  static unsigned int serialno;
+  gpg_error_t err;
+  ksba_der_t d, extn;
+  ksba_cert_t cert;
+  unsigned char serial[4], *der;
+  size_t derlen;
+  unsigned char value;
+
+  serialno++;
+  serial[0] = serialno >> 24;
+  serial[1] = serialno >> 16;
+  serial[2] = serialno >> 8;
+  serial[3] = serialno;
+
+  d = ksba_der_builder_new (0);
+  if (!d)
+    fail ("out of core");
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);   /* tbsCertificate */
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 0);
+  ksba_der_add_int (d, "\x02", 1, 0);           /* v3 */
+  ksba_der_add_end (d);
+  ksba_der_add_int (d, serial, sizeof serial, 1);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.11");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  add_name (d, issuer);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_val (d, 0, KSBA_TYPE_UTC_TIME, "210101000000Z", 13);
+  ksba_der_add_val (d, 0, KSBA_TYPE_UTC_TIME, "310101000000Z", 13);
+  ksba_der_add_end (d);
+  add_name (d, subject);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.1");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_bts (d, "\x30\x06\x02\x01\x03\x02\x01\x03", 8, 0);
+  ksba_der_add_end (d);
+
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 3);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  if (pathlen > -2)
+    {
+      extn = ksba_der_builder_new (0);
+      ksba_der_add_tag (extn, 0, KSBA_TYPE_SEQUENCE);
+      ksba_der_add_val (extn, 0, KSBA_TYPE_BOOLEAN, "\xff", 1);
+      if (pathlen >= 0)
+        {
+          value = pathlen;
+          ksba_der_add_int (extn, &value, 1, 1);
+        }
+      ksba_der_add_end (extn);
+      add_extension (d, "2.5.29.19", extn);
+    }
+  if (skid)
+    {
+      extn = ksba_der_builder_new (0);
+      ksba_der_add_val (extn, 0, KSBA_TYPE_OCTET_STRING, skid, strlen (skid));
+      add_extension (d, "2.5.29.14", extn);
+    }
+  if (akid)
+    {
+      extn = ksba_der_builder_new (0);
+      ksba_der_add_tag (extn, 0, KSBA_TYPE_SEQUENCE);
+      ksba_der_add_val (extn, KSBA_CLASS_CONTEXT, 0, akid, strlen (akid));
+      ksba_der_add_end (extn);
+      add_extension (d, "2.5.29.35", extn);
+    }
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);  /* End of tbsCertificate.  */
+
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.11");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_bts (d, "\x01\x02\x03\x04", 4, 0);
+  ksba_der_add_end (d);
+
+  err = ksba_der_builder_get (d, &der, &derlen);
+  fail_if_err (err);
+  ksba_der_release (d);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, der, derlen);
+  fail_if_err (err);
+  xfree (der);
+  return cert;
+}
+
+
+/* Add CERT to STORE and release our reference.  */
+static void
+add_cert (ksba_certstore_t store, ksba_cert_t cert)
+{
+  gpg_error_t err;
+
+  err = ksba_certstore_add (store, cert);
+  fail_if_err (err);
+  ksba_cert_release (cert);
+}
+
+
+/* Return the number of chains for CERT in STORE and check that no
+   certificate appears twice in a chain.  If R_CHAIN is not NULL the
+   first chain is stored there.  */
+static int
+count_chains (ksba_certstore_t store, ksba_cert_t cert,
+              ksba_cert_t **r_chain, int *r_length)
+{
+  gpg_error_t err;
+  ksba_cert_t *chain;
+  int length, idx, i, j;
+
+  for (idx=0; !(err = ksba_certstore_build_chain (store, cert, idx,
+                                                  &chain, &length)); idx++)
+    {
+      for (i=0; i < length; i++)
+        {
+          if (same_cert (chain[i], cert))
+            error ("certificate is its own issuer");
+          for (j=i+1; j < length; j++)
+            if (same_cert (chain[i], chain[j]))
+              error ("loop in chain");
+        }
+      if (!idx && r_chain)
+        {
+          *r_chain = chain;
+          *r_length = length;
+        }
+      else
+        release_chain (chain, length);
+    }
+  if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+    fail_if_err (err);
+  return idx;
+}
+
+
+/* Check that the chains for a leaf below a mesh of NNAMES CAs, which
+   are all cross-certified with each other, are found quickly.  */
+static void
+test_cross_certified (int nnames)
+{
+  gpg_error_t err;
+  ksba_certstore_t store;
+  ksba_cert_t leaf, *chain;
+  char subject[20], issuer[20], skid[20], akid[20];
+  int i, j, n, length, count;
+
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  for (i=0; i < nnames; i++)
+    for (j=0; j < nnames; j++)
+      if (i != j)
+        {
+          snprintf (subject, sizeof subject, "CA %d", i);
+          snprintf (issuer, sizeof issuer, "CA %d", j);
+          snprintf (skid, sizeof skid, "key %d", i);
+          snprintf (akid, sizeof akid, "key %d", j);
+          add_cert (store, make_cert (subject, issuer, -1, skid, akid));
+        }
+  leaf = make_cert ("Leaf", "CA 0", -2, NULL, "key 0");
+
+  /* Without a root there is no chain.  With many CAs the search is
+     spread over several calls.  */
+  for (n=0; (err = ksba_certstore_build_chain (store, leaf, 0,
+                                               &chain, &length)); n++)
+    {
+      if (gpg_err_code (err) == GPG_ERR_NOT_FOUND)
+        break;
+      if (gpg_err_code (err) != GPG_ERR_LIMIT_REACHED || n > 100)
+        fail_if_err (err);
+    }
+  if (!err)
+    error ("chain without a root found");
+  if (verbose)
+    printf ("mesh of %d CAs: no chain after %d interrupted call(s)\n",
+            nnames, n);
+
+  /* Now add a root for the last CA.  */
+  snprintf (subject, sizeof subject, "CA %d", nnames - 1);
+  snprintf (skid, sizeof skid, "key %d", nnames - 1);
+  add_cert (store, make_cert (subject, subject, -1, skid, NULL));
+  count = 0;
+  for (n=0; n < 100; n++)
+    {
+      err = ksba_certstore_build_chain (store, leaf, 0, &chain, &length);
+      if (gpg_err_code (err) != GPG_ERR_LIMIT_REACHED)
+        break;
+    }
+  fail_if_err (err);
+  release_chain (chain, length);
+  count = count_chains (store, leaf, NULL, NULL);
+  if (!count)
+    error ("no chain to the root of the mesh");
+  if (verbose)
+    printf ("mesh of %d CAs: %d chain(s)\n", nnames, count);
+
+  ksba_cert_release (leaf);
+  ksba_certstore_release (store);
+}
+
+
+/* Check that the pathLenConstraint prunes chains.  */
+static void
+test_path_length (void)
+{
+  gpg_error_t err;
+  ksba_certstore_t store;
+  ksba_cert_t leaf, leaf2, *chain;
+  int length;
+
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  add_cert (store, make_cert ("Root", "Root", -1, "root", NULL));
+  add_cert (store, make_cert ("Sub", "Root", 0, "sub", "root"));
+  add_cert (store, make_cert ("Sub 2", "Sub", -1, "sub2", "sub"));
+  leaf = make_cert ("Leaf", "Sub 2", -2, NULL, "sub2");
+  leaf2 = make_cert ("Leaf 2", "Sub", -2, NULL, "sub");
+
+  /* "Sub" does not allow another CA below it.  */
+  if (count_chains (store, leaf, NULL, NULL))
+    error ("pathLenConstraint of 0 ignored");
+  if (count_chains (store, leaf2, &chain, &length) != 1)
+    error ("chain with pathLenConstraint of 0 not found");
+  else
+    {
+      if (length != 2)
+        error ("wrong chain length");
+      release_chain (chain, length);
+    }
+
+  /* A new certificate for "Sub" with a larger limit.  */
+  add_cert (store, make_cert ("Sub", "Root", 1, "sub", "root"));
+  if (count_chains (store, leaf, &chain, &length) != 1)
+    error ("chain with pathLenConstraint of 1 not found");
+  else
+    {
+      if (length != 3)
+        error ("wrong chain length");
+      release_chain (chain, length);
+    }
+  if (count_chains (store, leaf2, NULL, NULL) != 2)
+    error ("wrong number of chains with two issuers");
+
+  ksba_cert_release (leaf2);
+  ksba_cert_release (leaf);
+  ksba_certstore_release (store);
+}
+
+
+/* Check that an authorityKeyIdentifier selects the issuer.  */
+static void
+test_key_ids (void)
+{
+  gpg_error_t err;
+  ksba_certstore_t store;
+  ksba_cert_t leaf, *chain;
+  ksba_sexp_t keyid;
+  int length;
+
+  err = ksba_certstore_new (&store);
+  fail_if_err (err);
+  add_cert (store, make_cert ("Root", "Root", -1, "old key", NULL));
+  add_cert (store, make_cert ("Root", "Root", -1, "new key", NULL));
+  add_cert (store, make_cert ("Root", "Root", -1, NULL, NULL));
+
+  /* A matching key identifier or none at all.  */
+  leaf = make_cert ("Leaf", "Root", -2, NULL, "new key");
+  if (count_chains (store, leaf, &chain, &length) != 2)
+    error ("wrong number of chains with an authorityKeyIdentifier");
+  else
+    {
+      err = ksba_cert_get_subj_key_id (chain[0], NULL, &keyid);
+      if (!err)
+        {
+          if (strcmp ((char *)keyid, "(7:new key)"))
+            error ("issuer with wrong key identifier");
+          ksba_free (keyid);
+        }
+      else if (gpg_err_code (err) != GPG_ERR_NO_DATA)
+        fail_if_err (err);
+      release_chain (chain, length);
+    }
+  ksba_cert_release (leaf);
+
+  /* An unknown key identifier.  */
+  leaf = make_cert ("Leaf", "Root", -2, NULL, "other key");
+  if (count_chains (store, leaf, NULL, NULL) != 1)
+    error ("issuer with mismatching key identifier used");
+  ksba_cert_release (leaf);
+
+  /* Without one all roots are candidates.  */
+  leaf = make_cert ("Leaf", "Root", -2, NULL, NULL);
+  if (count_chains (store, leaf, NULL, NULL) != 3)
+    error ("wrong number of chains without an authorityKeyIdentifier");
+  ksba_cert_release (leaf);
+
+  ksba_certstore_release (store);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc)
+    {
+      argc--;  argv++;
+    }
+
+  if (argc && !strcmp (*argv, "--verbose"))
+    {
+      verbose = 1;
+      argc--; argv++;
+    }
+
+  if (!argc)
+    {
+      test_lookups ();
+      test_chains ();
+      test_cross_certified (5);
+      test_cross_certified (6);
+      test_cross_certified (40);
+      test_path_length ();
+      test_key_ids ();
+    }
+  else
+    {
+      fputs ("usage: "PGM" [--verbose]\n", stderr);
+      return 1;
+    }
+
+  return !!errorcount;
+}
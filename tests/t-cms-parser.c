@@ -33,12 +33,22 @@ static int quiet;
 static int verbose;
 
 
-void
-dummy_hash_fnc (void *arg, const void *buffer, size_t length)
+/* A cheap checksum of the hashed data to compare runs with and
+   without a hashing thread.  */
+struct checksum_s
 {
-  (void)arg;
-  (void)buffer;
-  (void)length;
+  unsigned long sum;
+  size_t length;
+};
+
+static void
+checksum_hash_fnc (void *arg, const void *buffer, size_t length)
+{
+  struct checksum_s *c = arg;
+  const unsigned char *p = buffer;
+
+  for (c->length += length; length; length--)
+    c->sum = (c->sum ^ *p++) * 16777619;
 }
 
 static int
@@ -52,8 +62,11 @@ dummy_writer_cb (void *cb_value, const void *buffer, size_t count)
 
 
 
+/* Parse the CMS object in FNAME.  If PIPELINE is not 0 the content
+   is hashed by a separate thread in blocks of that size.  The
+   checksum of the hashed data is stored at CHECKSUM.  */
 static void
-one_file (const char *fname)
+one_file (const char *fname, size_t pipeline, struct checksum_s *checksum)
 {
   gpg_error_t err;
   FILE *fp;
@@ -68,6 +81,7 @@ one_file (const char *fname)
   ksba_sexp_t p;
   char *dn;
   int idx;
+  ksba_isotime_t t;
 
   if (!quiet)
     printf ("*** checking `%s' ***\n", fname);
@@ -144,7 +158,13 @@ one_file (const char *fname)
     if (!quiet)
       printf("Detached signature\n");
 
-  ksba_cms_set_hash_function (cms, dummy_hash_fnc, NULL);
+  memset (checksum, 0, sizeof *checksum);
+  ksba_cms_set_hash_function (cms, checksum_hash_fnc, checksum);
+  if (pipeline)
+    {
+      err = ksba_cms_set_hash_pipeline (cms, pipeline);
+      fail_if_err (err);
+    }
 
   do
     {
@@ -229,6 +249,11 @@ one_file (const char *fname)
             }
           ksba_free (dn);
 
+          err = ksba_cms_get_signing_time (cms, idx, t);
+          fail_if_err2 (fname, err);
+          if (!quiet && *t)
+            printf ("signer %d - signing time: %s\n", idx, t);
+
           err = ksba_cms_get_sigattr_oids (cms, idx,
                                            "1.2.840.113549.1.9.3",&dn);
           if (err && err != -1)
@@ -280,6 +305,8 @@ one_file (const char *fname)
 int
 main (int argc, char **argv)
 {
+  struct checksum_s c1, c2;
+
   if (argc)
     {
       argc--; argv++;
@@ -293,7 +320,7 @@ main (int argc, char **argv)
   if (argc)
     {
       for (; argc; argc--, argv++)
-        one_file (*argv);
+        one_file (*argv, 0, &c1);
     }
   else
     {
@@ -315,7 +342,14 @@ main (int argc, char **argv)
       for (idx=0; testfiles[idx]; idx++)
         {
           fname = prepend_srcdir (testfiles[idx]);
-          one_file (fname);
+          one_file (fname, 0, &c1);
+          /* Hashing in a separate thread does not change the data.  */
+          one_file (fname, 64, &c2);
+          if (c1.sum != c2.sum || c1.length != c2.length)
+            fail ("different data hashed with a hashing thread");
+          if (verbose)
+            printf ("%s: %lu bytes hashed\n",
+                    testfiles[idx], (unsigned long)c1.length);
           free(fname);
         }
     }
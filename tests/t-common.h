@@ -20,6 +20,10 @@
 /*-- sha1.c --*/
 void sha1_hash_buffer (char *outbuf, const char *buffer, size_t length);
 
+/*-- crlgen.c --*/
+unsigned char *make_test_crl (unsigned long nentries, int uniform,
+                              size_t *r_len);
+
 
 
 #define digitp(p)   (*(p) >= '0' && *(p) <= '9')
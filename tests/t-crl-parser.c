@@ -35,6 +35,8 @@
 #include "oidtranstbl.h"
 
 
+#define DIM(v) (sizeof(v)/sizeof((v)[0]))
+
 static int quiet;
 static int verbose;
 
@@ -355,6 +357,509 @@ one_file (const char *fname)
 }
 
 
+/* Parse the CRL in FNAME with the serial index enabled and check that
+   each entry can be looked up as soon as it has been returned.  */
+static void
+check_index (const char *fname)
+{
+  /* A serial number which is too long to be listed.  */
+  static const char unknown[] = "(21:\x7f\xff\xff\xff\xff"
+    "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"
+    "\xff\xff\xff\xff)";
+  gpg_error_t err;
+  FILE *fp;
+  ksba_reader_t r;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  ksba_sexp_t serial;
+  ksba_isotime_t rdate, rdate2;
+  ksba_crl_reason_t reason, reason2;
+  int count = 0;
+
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  err = ksba_reader_new (&r);
+  fail_if_err (err);
+  err = ksba_reader_set_file (r, fp);
+  fail_if_err (err);
+  err = ksba_crl_new (&crl);
+  fail_if_err (err);
+  err = ksba_crl_set_reader (crl, r);
+  fail_if_err (err);
+  err = ksba_crl_set_serial_index (crl, 1);
+  fail_if_err (err);
+
+  do
+    {
+      err = ksba_crl_parse (crl, &stopreason);
+      fail_if_err2 (fname, err);
+      if (stopreason != KSBA_SR_GOT_ITEM)
+        continue;
+      err = ksba_crl_get_item (crl, &serial, rdate, &reason);
+      fail_if_err2 (fname, err);
+      err = ksba_crl_lookup_serial (crl, serial, rdate2, &reason2);
+      fail_if_err2 (fname, err);
+      if (strcmp (rdate, rdate2) || reason != reason2)
+        fail ("serial index mismatch");
+      xfree (serial);
+      count++;
+    }
+  while (stopreason != KSBA_SR_READY);
+
+  err = ksba_crl_lookup_serial (crl, (ksba_const_sexp_t)unknown, NULL, NULL);
+  if (gpg_err_code (err) != GPG_ERR_NOT_FOUND)
+    fail ("unknown serial number found in the index");
+  if (verbose)
+    printf ("%s: %d entries found in the index\n", fname, count);
+
+  ksba_crl_release (crl);
+  ksba_reader_release (r);
+  fclose (fp);
+}
+
+
+
+
+/* Data collected while parsing a CRL.  */
+struct collect_s
+{
+  char **entries;    /* One string per entry.  */
+  int nentries;
+  unsigned char *hashed;  /* The data passed to the hash function.  */
+  size_t hashedlen;
+};
+
+
+static void
+collect_hash (void *arg, const void *buffer, size_t length)
+{
+  struct collect_s *c = arg;
+
+  c->hashed = realloc (c->hashed, c->hashedlen + length + 1);
+  if (!c->hashed)
+    fail ("out of core");
+  memcpy (c->hashed + c->hashedlen, buffer, length);
+  c->hashedlen += length;
+}
+
+
+static void
+collect_entry (struct collect_s *c, const unsigned char *serial, size_t n,
+               const char *rdate, ksba_crl_reason_t reason)
+{
+  char *p;
+  size_t i;
+
+  p = xmalloc (2 * n + 40);
+  for (i=0; i < n; i++)
+    sprintf (p + 2*i, "%02X", serial[i]);
+  sprintf (p + 2*n, "/%s/%x", rdate, reason);
+  c->entries = realloc (c->entries, (c->nentries + 1) * sizeof *c->entries);
+  if (!c->entries)
+    fail ("out of core");
+  c->entries[c->nentries++] = p;
+}
+
+
+/* Read the file FNAME into a malloced buffer and store its length at
+   R_LENGTH.  */
+static unsigned char *
+read_file (const char *fname, size_t *r_length)
+{
+  FILE *fp;
+  unsigned char *buf;
+  size_t len;
+
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  buf = xmalloc (65536);
+  len = fread (buf, 1, 65536, fp);
+  if (!len || !feof (fp))
+    fail ("error reading CRL");
+  fclose (fp);
+  *r_length = len;
+  return buf;
+}
+
+
+/* Parse the CRL in FNAME and collect its entries and the hashed data
+   into C.  If BATCH is not 0 ksba_crl_get_items is used to get BATCH
+   entries at once.  With USE_MEM set the CRL is parsed from memory.
+   If PIPELINE is not 0 the data is hashed by a separate thread in
+   blocks of that size.  */
+static void
+collect_crl (const char *fname, int batch, int use_mem, size_t pipeline,
+             struct collect_s *c)
+{
+  gpg_error_t err;
+  FILE *fp = NULL;
+  ksba_reader_t r;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  struct ksba_crl_entry_s entries[8];
+  size_t count, i;
+  unsigned char *buffer = NULL;
+  size_t buflen;
+
+  memset (c, 0, sizeof *c);
+  err = ksba_reader_new (&r);
+  fail_if_err (err);
+  if (use_mem)
+    {
+      buffer = read_file (fname, &buflen);
+      err = ksba_reader_set_mem (r, buffer, buflen);
+    }
+  else
+    {
+      fp = fopen (fname, "rb");
+      if (!fp)
+        {
+          fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+                   __FILE__, __LINE__, fname, strerror (errno));
+          exit (1);
+        }
+      err = ksba_reader_set_file (r, fp);
+    }
+  fail_if_err (err);
+  err = ksba_crl_new (&crl);
+  fail_if_err (err);
+  err = ksba_crl_set_reader (crl, r);
+  fail_if_err (err);
+  ksba_crl_set_hash_function (crl, collect_hash, c);
+  if (pipeline)
+    {
+      err = ksba_crl_set_hash_pipeline (crl, pipeline);
+      fail_if_err (err);
+    }
+
+  err = ksba_crl_get_items (crl, entries, batch, &count);
+  if (gpg_err_code (err) != GPG_ERR_INV_STATE)
+    fail ("batch retrieval not rejected before BEGIN_ITEMS");
+
+  do
+    {
+      err = ksba_crl_parse (crl, &stopreason);
+      fail_if_err2 (fname, err);
+      if (stopreason == KSBA_SR_GOT_ITEM)
+        {
+          ksba_sexp_t serial;
+          ksba_isotime_t rdate;
+          ksba_crl_reason_t reason;
+          const unsigned char *s;
+          unsigned long n;
+
+          err = ksba_crl_get_item (crl, &serial, rdate, &reason);
+          fail_if_err2 (fname, err);
+          n = strtoul ((const char *)serial + 1, (char **)&s, 10);
+          collect_entry (c, s + 1, n, rdate, reason);
+          xfree (serial);
+        }
+      if (batch && (stopreason == KSBA_SR_BEGIN_ITEMS
+                    || stopreason == KSBA_SR_GOT_ITEM))
+        {
+          do
+            {
+              err = ksba_crl_get_items (crl, entries, batch, &count);
+              fail_if_err2 (fname, err);
+              for (i=0; i < count; i++)
+                collect_entry (c, entries[i].serial, entries[i].serial_len,
+                               entries[i].revocation_date, entries[i].reason);
+            }
+          while (count == batch);
+        }
+    }
+  while (stopreason != KSBA_SR_READY);
+
+  ksba_crl_release (crl);
+  ksba_reader_release (r);
+  if (fp)
+    fclose (fp);
+  xfree (buffer);
+}
+
+
+static void
+release_collect (struct collect_s *c)
+{
+  int i;
+
+  for (i=0; i < c->nentries; i++)
+    xfree (c->entries[i]);
+  free (c->entries);
+  free (c->hashed);
+}
+
+
+/* Fail if C1 and C2 differ.  */
+static void
+compare_collect (struct collect_s *c1, struct collect_s *c2)
+{
+  int i;
+
+  if (c1->nentries != c2->nentries)
+    fail ("different number of entries returned");
+  for (i=0; i < c1->nentries; i++)
+    if (strcmp (c1->entries[i], c2->entries[i]))
+      fail ("different entry returned");
+  if (c1->hashedlen != c2->hashedlen
+      || memcmp (c1->hashed, c2->hashed, c1->hashedlen))
+    fail ("different data hashed");
+}
+
+
+/* Check that ksba_crl_get_items, parsing from memory and hashing in
+   a separate thread return the same entries as ksba_crl_get_item
+   with a file reader and do not change the hashed data.  */
+static void
+check_batch (const char *fname)
+{
+  struct collect_s c1, c2;
+  int batch, use_mem;
+
+  collect_crl (fname, 0, 0, 0, &c1);
+  for (use_mem=0; use_mem < 2; use_mem++)
+    {
+      for (batch=0; batch <= 8; batch = batch? 2*batch : 1)
+        {
+          collect_crl (fname, batch, use_mem, 0, &c2);
+          compare_collect (&c1, &c2);
+          release_collect (&c2);
+        }
+      /* Small blocks so that the buffers are switched often.  */
+      collect_crl (fname, 0, use_mem, 64, &c2);
+      compare_collect (&c1, &c2);
+      release_collect (&c2);
+      collect_crl (fname, 4, use_mem, 0x10000, &c2);
+      compare_collect (&c1, &c2);
+      release_collect (&c2);
+    }
+  if (verbose)
+    printf ("%s: %d entries checked\n", fname, c1.nentries);
+  release_collect (&c1);
+}
+
+
+/* A reader callback which returns the data in small pieces.  */
+struct cb_parm_s
+{
+  const unsigned char *buffer;
+  size_t length;
+};
+
+static int
+read_cb (void *cb_value, char *buffer, size_t count, size_t *r_nread)
+{
+  struct cb_parm_s *parm = cb_value;
+
+  if (!parm->length)
+    return -1;  /* EOF */
+  if (count > parm->length)
+    count = parm->length;
+  if (count > 1000)
+    count = 1000;
+  memcpy (buffer, parm->buffer, count);
+  parm->buffer += count;
+  parm->length -= count;
+  *r_nread = count;
+  return 0;
+}
+
+/* Parse the CRL in BUFFER of length BUFLEN with ksba_crl_set_parallel
+   using NTHREADS threads.  With USE_CB set, the data is passed by a
+   callback so that it is not available in memory.  The hashed data is
+   stored in C; the CRL object and its reader are returned for
+   lookups.  */
+static ksba_crl_t
+index_crl (const unsigned char *buffer, size_t buflen, int nthreads,
+           int use_cb, ksba_reader_t *r_reader, struct collect_s *c)
+{
+  gpg_error_t err;
+  ksba_reader_t r;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  struct cb_parm_s parm;
+  int nitems = 0;
+
+  memset (c, 0, sizeof *c);
+  parm.buffer = buffer;
+  parm.length = buflen;
+  err = ksba_reader_new (&r);
+  fail_if_err (err);
+  if (use_cb)
+    err = ksba_reader_set_cb (r, read_cb, &parm);
+  else
+    err = ksba_reader_set_mem (r, buffer, buflen);
+  fail_if_err (err);
+  err = ksba_crl_new (&crl);
+  fail_if_err (err);
+  err = ksba_crl_set_reader (crl, r);
+  fail_if_err (err);
+  ksba_crl_set_hash_function (crl, collect_hash, c);
+  err = ksba_crl_set_parallel (crl, nthreads);
+  fail_if_err (err);
+
+  do
+    {
+      err = ksba_crl_parse (crl, &stopreason);
+      fail_if_err (err);
+      if (stopreason == KSBA_SR_GOT_ITEM)
+        nitems++;
+    }
+  while (stopreason != KSBA_SR_READY);
+  if (nitems)
+    fail ("entries returned in parallel mode");
+
+  if (gpg_err_code (ksba_crl_set_parallel (crl, 1)) != GPG_ERR_CONFLICT)
+    fail ("parallel mode not rejected after parsing");
+
+  *r_reader = r;
+  return crl;
+}
+
+
+/* Check that the index built by ksba_crl_set_parallel matches the
+   entries returned by the regular parser and that the same data is
+   hashed.  */
+static void
+check_parallel (const unsigned char *buffer, size_t buflen, const char *desc)
+{
+  static const int nthreads[] = { 1, 2, 4, 0 };
+  gpg_error_t err;
+  ksba_reader_t r0, r1;
+  ksba_crl_t crl, pcrl;
+  struct collect_s c0, c1;
+  ksba_stop_reason_t stopreason;
+  ksba_sexp_t serial;
+  ksba_isotime_t rdate, rdate2;
+  ksba_crl_reason_t reason, reason2;
+  int i, use_cb, nentries;
+
+  for (use_cb=0; use_cb < 2; use_cb++)
+    for (i=0; i < (int)DIM (nthreads); i++)
+      {
+        pcrl = index_crl (buffer, buflen, nthreads[i], use_cb, &r1, &c1);
+
+        /* Parse again and look up each entry in the parallel index.  */
+        err = ksba_reader_new (&r0);
+        fail_if_err (err);
+        err = ksba_reader_set_mem (r0, buffer, buflen);
+        fail_if_err (err);
+        err = ksba_crl_new (&crl);
+        fail_if_err (err);
+        err = ksba_crl_set_reader (crl, r0);
+        fail_if_err (err);
+        memset (&c0, 0, sizeof c0);
+        ksba_crl_set_hash_function (crl, collect_hash, &c0);
+        nentries = 0;
+        do
+          {
+            err = ksba_crl_parse (crl, &stopreason);
+            fail_if_err (err);
+            if (stopreason != KSBA_SR_GOT_ITEM)
+              continue;
+            err = ksba_crl_get_item (crl, &serial, rdate, &reason);
+            fail_if_err (err);
+            err = ksba_crl_lookup_serial (pcrl, serial, rdate2, &reason2);
+            fail_if_err2 (desc, err);
+            if (strcmp (rdate, rdate2) || reason != reason2)
+              fail ("parallel index differs");
+            xfree (serial);
+            nentries++;
+          }
+        while (stopreason != KSBA_SR_READY);
+
+        if (c0.hashedlen != c1.hashedlen
+            || memcmp (c0.hashed, c1.hashed, c0.hashedlen))
+          fail ("different data hashed in parallel mode");
+        if (verbose)
+          printf ("%s: %d entries checked with %d threads%s\n", desc,
+                  nentries, nthreads[i], use_cb? " (callback)" : "");
+
+        ksba_crl_release (crl);
+        ksba_reader_release (r0);
+        release_collect (&c0);
+        ksba_crl_release (pcrl);
+        ksba_reader_release (r1);
+        release_collect (&c1);
+      }
+}
+
+
+/* The reason codes of a CRL with a crlReason OID which ends in a
+   continuation byte must be the same as with the correct OID because
+   both are decoded to 2.5.29.21.  */
+static void
+check_malformed_reason_oid (void)
+{
+  gpg_error_t err;
+  ksba_reader_t r;
+  ksba_crl_t crl;
+  ksba_stop_reason_t stopreason;
+  ksba_sexp_t serial;
+  ksba_isotime_t rdate;
+  ksba_crl_reason_t reason;
+  ksba_crl_reason_t expected[6];
+  unsigned char *buffer;
+  size_t buflen, n;
+  int pass, nentries;
+
+  buffer = make_test_crl (DIM (expected), 0, &buflen);
+  for (pass=0; pass < 2; pass++)
+    {
+      err = ksba_reader_new (&r);
+      fail_if_err (err);
+      err = ksba_reader_set_mem (r, buffer, buflen);
+      fail_if_err (err);
+      err = ksba_crl_new (&crl);
+      fail_if_err (err);
+      err = ksba_crl_set_reader (crl, r);
+      fail_if_err (err);
+
+      nentries = 0;
+      do
+        {
+          err = ksba_crl_parse (crl, &stopreason);
+          fail_if_err (err);
+          if (stopreason != KSBA_SR_GOT_ITEM)
+            continue;
+          err = ksba_crl_get_item (crl, &serial, rdate, &reason);
+          fail_if_err (err);
+          xfree (serial);
+          if (nentries >= DIM (expected))
+            fail ("too many entries");
+          if (!pass)
+            expected[nentries] = reason;
+          else if (reason != expected[nentries])
+            fail ("reason of malformed crlReason OID differs");
+          nentries++;
+        }
+      while (stopreason != KSBA_SR_READY);
+      if (nentries != DIM (expected))
+        fail ("wrong number of entries");
+
+      ksba_crl_release (crl);
+      ksba_reader_release (r);
+
+      /* Set the continuation bit in the last byte of all crlReason
+         OIDs for the second pass.  */
+      for (n=0; n + 5 <= buflen; n++)
+        if (!memcmp (buffer + n, "\x06\x03\x55\x1d\x15", 5))
+          buffer[n + 4] |= 0x80;
+    }
+  if (!expected[1] || !expected[2])
+    fail ("no reason codes in the generated CRL");
+  xfree (buffer);
+}
 
 
 int
@@ -387,6 +892,8 @@ main (int argc, char **argv)
         NULL
       };
       int idx;
+      unsigned char *buffer;
+      size_t buflen;
 
       if (!verbose)
         quiet = 1;
@@ -400,8 +907,20 @@ main (int argc, char **argv)
           strcat (fname, "/samples/");
           strcat (fname, files[idx]);
           one_file (fname);
+          check_index (fname);
+          check_batch (fname);
+          buffer = read_file (fname, &buflen);
+          check_parallel (buffer, buflen, fname);
+          xfree (buffer);
           xfree (fname);
         }
+
+      /* Enough entries for several chunks.  */
+      buffer = make_test_crl (1000, 0, &buflen);
+      check_parallel (buffer, buflen, "generated CRL");
+      xfree (buffer);
+
+      check_malformed_reason_oid ();
     }
 
   return 0;
@@ -0,0 +1,321 @@
+/* t-der-scan.c - Test the scanner for the DER framing
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The scanner is internal to the library; thus this test is linked
+   with der-scan.c directly.  */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/ksba.h"
+#include "../src/der-scan.h"
+
+#define PGM "t-der-scan"
+
+
+static int verbose;
+static int errorcount;
+
+
+/* Check BUFFER of LENGTH with and without DER_SCAN_STRICT and compare
+   the error codes with LAX and STRICT.  If the check fails, the
+   offset of the error must be LAXOFF or STRICTOFF.  */
+static void
+check_one (int lineno, const void *buffer, size_t length,
+           gpg_err_code_t lax, size_t laxoff,
+           gpg_err_code_t strict, size_t strictoff)
+{
+  gpg_error_t err;
+  size_t off;
+  int mode;
+
+  for (mode=0; mode < 2; mode++)
+    {
+      gpg_err_code_t expected = mode? strict : lax;
+      size_t erroff = mode? strictoff : laxoff;
+
+      off = (size_t)-1;
+      err = _ksba_der_validate (buffer, length,
+                                mode? DER_SCAN_STRICT : 0, &off);
+      if (gpg_err_code (err) != expected)
+        {
+          fprintf (stderr, PGM ":%d: %s mode: expected `%s', got `%s'\n",
+                   lineno, mode? "strict":"lax",
+                   gpg_strerror (expected), gpg_strerror (err));
+          errorcount++;
+        }
+      else if (err && off != erroff && expected != GPG_ERR_NO_DATA)
+        {
+          fprintf (stderr, PGM ":%d: %s mode: error at offset %lu"
+                   " instead of %lu\n", lineno, mode? "strict":"lax",
+                   (unsigned long)off, (unsigned long)erroff);
+          errorcount++;
+        }
+      else if (verbose)
+        printf ("line %d: %s mode: %s\n", lineno, mode? "strict":"lax",
+                gpg_strerror (err));
+    }
+}
+
+#define CHECK(s, lax, laxoff, strict, strictoff)                     \
+  check_one (__LINE__, (s), sizeof (s) - 1, (lax), (laxoff),        \
+             (strict), (strictoff))
+
+
+static void
+test_framing (void)
+{
+  /* Valid DER.  */
+  CHECK ("\x30\x07\x02\x01\x01\x04\x02\x61\x62", 0, 0, 0, 0);
+  CHECK ("\x02\x01\x01\x05\x00", 0, 0, 0, 0);
+  CHECK ("\x30\x00", 0, 0, 0, 0);
+  check_one (__LINE__, "", 0, GPG_ERR_NO_DATA, 0, GPG_ERR_NO_DATA, 0);
+
+  /* Truncated lengths and values.  */
+  CHECK ("\x30\x05\x02\x01\x01",
+         GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+  CHECK ("\x30\x03\x02\x05\x01",
+         GPG_ERR_BAD_BER, 2, GPG_ERR_BAD_BER, 2);
+  CHECK ("\x30\x82\x01", GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+  CHECK ("\x30", GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+  CHECK ("\x02\x01\x01\x02", GPG_ERR_BAD_BER, 3, GPG_ERR_BAD_BER, 3);
+
+  /* Indefinite lengths.  */
+  CHECK ("\x30\x80\x02\x01\x01\x00\x00",
+         0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x30\x80\x30\x80\x00\x00\x00\x00",
+         0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x30\x80\x02\x01\x01",         /* Missing end tag.  */
+         GPG_ERR_BAD_BER, 5, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x04\x80\x61\x00\x00",         /* Primitive.  */
+         GPG_ERR_BAD_BER, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+
+  /* Over-long length encodings.  */
+  CHECK ("\x02\x81\x01\x05", 0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x02\x82\x00\x01\x05", 0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x30\x04\x02\x81\x01\x05", 0, 0, GPG_ERR_NOT_DER_ENCODED, 2);
+  CHECK ("\x02\xff\x01", GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+  CHECK ("\x02\x89\x01\x01\x01\x01\x01\x01\x01\x01\x01",
+         GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+  CHECK ("\x02\x84\x7f\xff\xff\xff\x00",
+         GPG_ERR_BAD_BER, 0, GPG_ERR_BAD_BER, 0);
+
+  /* Other encodings which are BER but not DER.  */
+  CHECK ("\x24\x03\x04\x01\x61", 0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x9f\x05\x00", 0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+  CHECK ("\x9f\x80\x21\x00", 0, 0, GPG_ERR_NOT_DER_ENCODED, 0);
+}
+
+
+/* Check that DER_SCAN_MAX_DEPTH nested values are accepted but not
+   one more.  */
+static void
+test_depth (void)
+{
+  unsigned char buffer[4 * (DER_SCAN_MAX_DEPTH + 1) + 3];
+  size_t length;
+  int depth, i;
+  gpg_error_t err;
+
+  for (depth = DER_SCAN_MAX_DEPTH - 1; depth <= DER_SCAN_MAX_DEPTH + 1;
+       depth++)
+    {
+      /* Nested sequences with indefinite length around an INTEGER.  */
+      length = 4 * depth + 3;
+      for (i=0; i < depth; i++)
+        {
+          buffer[2*i] = 0x30;
+          buffer[2*i+1] = 0x80;
+        }
+      memcpy (buffer + 2*depth, "\x02\x01\x01", 3);
+      memset (buffer + 2*depth + 3, 0, 2*depth);
+
+      err = _ksba_der_validate (buffer, length, 0, NULL);
+      if (depth <= DER_SCAN_MAX_DEPTH && err)
+        {
+          fprintf (stderr, PGM ": depth %d rejected: %s\n",
+                   depth, gpg_strerror (err));
+          errorcount++;
+        }
+      else if (depth > DER_SCAN_MAX_DEPTH
+               && gpg_err_code (err) != GPG_ERR_BAD_BER)
+        {
+          fprintf (stderr, PGM ": depth %d not rejected\n", depth);
+          errorcount++;
+        }
+    }
+}
+
+
+/* Compare the item IDX of SCAN with the expected values.  */
+static void
+check_item (int lineno, der_scan_t scan, int idx, size_t off,
+            unsigned long tag, int cons, size_t len, int depth, int next)
+{
+  struct der_scan_item_s *item;
+
+  if (idx < 0 || idx >= scan->nitems)
+    {
+      fprintf (stderr, PGM ":%d: no item %d\n", lineno, idx);
+      errorcount++;
+      return;
+    }
+  item = scan->items + idx;
+  if (item->off != off || item->tag != tag || item->cons != cons
+      || item->len != len || item->depth != depth || item->next != next)
+    {
+      fprintf (stderr, PGM ":%d: item %d: off=%lu tag=%lu cons=%d len=%lu"
+               " depth=%d next=%d\n", lineno, idx,
+               (unsigned long)item->off, item->tag, item->cons,
+               (unsigned long)item->len, item->depth, item->next);
+      errorcount++;
+    }
+}
+
+#define CHECK_ITEM(scan, idx, off, tag, cons, len, depth, next)        \
+  check_item (__LINE__, (scan), (idx), (off), (tag), (cons), (len),   \
+              (depth), (next))
+
+#define CHECK_CHILD(scan, idx, n, expected)                              \
+  do {                                                                  \
+    if (_ksba_der_scan_child ((scan), (idx), (n)) != (expected))        \
+      {                                                                 \
+        fprintf (stderr, PGM ":%d: wrong child %d of item %d\n",        \
+                 __LINE__, (n), (idx));                                 \
+        errorcount++;                                                   \
+      }                                                                 \
+  } while (0)
+
+
+/* Check the index returned by _ksba_der_scan.  */
+static void
+test_index (void)
+{
+  /* SEQUENCE { INTEGER, SEQUENCE { OCTET STRING, NULL }, OCTET STRING }
+     followed by a NULL.  */
+  static const unsigned char der[] =
+    "\x30\x0d\x02\x01\x01\x30\x05\x04\x01\x61\x05\x00\x04\x01\x62"
+    "\x05\x00";
+  static const unsigned char ber[] = "\x30\x80\x02\x01\x01\x00\x00";
+  gpg_error_t err;
+  der_scan_t scan;
+
+  err = _ksba_der_scan (der, sizeof der - 1, -1, DER_SCAN_STRICT, &scan);
+  if (err)
+    {
+      fprintf (stderr, PGM ": scan failed: %s\n", gpg_strerror (err));
+      errorcount++;
+      return;
+    }
+  if (scan->nitems != 7)
+    {
+      fprintf (stderr, PGM ": %d items instead of 7\n", scan->nitems);
+      errorcount++;
+    }
+  CHECK_ITEM (scan, 0,  0, 16, 1, 13, 0, 6);
+  CHECK_ITEM (scan, 1,  2,  2, 0,  1, 1, 2);
+  CHECK_ITEM (scan, 2,  5, 16, 1,  5, 1, 5);
+  CHECK_ITEM (scan, 3,  7,  4, 0,  1, 2, 4);
+  CHECK_ITEM (scan, 4, 10,  5, 0,  0, 2, 5);
+  CHECK_ITEM (scan, 5, 12,  4, 0,  1, 1, 6);
+  CHECK_ITEM (scan, 6, 15,  5, 0,  0, 0, 7);
+  CHECK_CHILD (scan, 0, 0, 1);
+  CHECK_CHILD (scan, 0, 1, 2);
+  CHECK_CHILD (scan, 0, 2, 5);
+  CHECK_CHILD (scan, 0, 3, -1);
+  CHECK_CHILD (scan, 2, 1, 4);
+  CHECK_CHILD (scan, 2, 2, -1);
+  CHECK_CHILD (scan, 1, 0, -1);
+  CHECK_CHILD (scan, 6, 0, -1);
+  CHECK_CHILD (scan, 7, 0, -1);
+  _ksba_der_scan_release (scan);
+
+  /* Only the top level objects and their children.  */
+  err = _ksba_der_scan (der, sizeof der - 1, 1, 0, &scan);
+  if (err)
+    {
+      fprintf (stderr, PGM ": scan failed: %s\n", gpg_strerror (err));
+      errorcount++;
+      return;
+    }
+  if (scan->nitems != 5)
+    {
+      fprintf (stderr, PGM ": %d items instead of 5\n", scan->nitems);
+      errorcount++;
+    }
+  CHECK_ITEM (scan, 2,  5, 16, 1,  5, 1, 3);
+  CHECK_ITEM (scan, 3, 12,  4, 0,  1, 1, 4);
+  CHECK_CHILD (scan, 0, 2, 3);
+  CHECK_CHILD (scan, 2, 0, -1);
+  _ksba_der_scan_release (scan);
+
+  /* The length of an indefinite length value is that of its
+     content.  */
+  err = _ksba_der_scan (ber, sizeof ber - 1, -1, 0, &scan);
+  if (err)
+    {
+      fprintf (stderr, PGM ": scan failed: %s\n", gpg_strerror (err));
+      errorcount++;
+      return;
+    }
+  CHECK_ITEM (scan, 0, 0, 16, 1, 3, 0, 2);
+  if (!scan->items[0].ndef)
+    {
+      fprintf (stderr, PGM ": indefinite length not flagged\n");
+      errorcount++;
+    }
+  _ksba_der_scan_release (scan);
+
+  /* No index on error.  */
+  scan = (der_scan_t)1;
+  err = _ksba_der_scan (ber, sizeof ber - 1, -1, DER_SCAN_STRICT, &scan);
+  if (gpg_err_code (err) != GPG_ERR_NOT_DER_ENCODED || scan)
+    {
+      fprintf (stderr, PGM ": bad result for a failed scan\n");
+      errorcount++;
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc)
+    {
+      argc--;  argv++;
+    }
+  if (argc && !strcmp (*argv, "--verbose"))
+    {
+      verbose = 1;
+      argc--; argv++;
+    }
+  if (argc)
+    {
+      fputs ("usage: "PGM" [--verbose]\n", stderr);
+      return 1;
+    }
+
+  test_framing ();
+  test_depth ();
+  test_index ();
+
+  return !!errorcount;
+}
@@ -0,0 +1,271 @@
+/* t-ocsp-response.c - Tests for parsing OCSP responses
+ *      Copyright (C) 2021 g10 Code GmbH
+ *
+ * This file is part of KSBA.
+ *
+ * KSBA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KSBA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "../src/ksba.h"
+
+#define PGM "t-ocsp-response"
+
+#include "t-common.h"
+
+
+static int verbose;
+
+
+/* Read the sample certificate NAME into a new buffer and return it;
+   its length is stored at R_LEN.  */
+static unsigned char *
+read_sample (const char *name, size_t *r_len)
+{
+  char *fname;
+  FILE *fp;
+  unsigned char *buf;
+  size_t size = 0, n;
+
+  fname = prepend_srcdir (name);
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: can't open `%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+  buf = xmalloc (8192);
+  while ((n = fread (buf + size, 1, 8192 - size, fp)))
+    size += n;
+  if (ferror (fp) || !feof (fp))
+    fail ("error reading the sample");
+  fclose (fp);
+  xfree (fname);
+  *r_len = size;
+  return buf;
+}
+
+
+/* Build an OCSP response with the two certificates CERT1 and CERT2.
+   If PRODUCED_AT is not NULL it is used as the DER encoded producedAt
+   field.  If EXTRA is not NULL it is appended to the
+   BasicOCSPResponse.  */
+static unsigned char *
+build_response (const unsigned char *cert1, size_t cert1len,
+                const unsigned char *cert2, size_t cert2len,
+                const char *produced_at, size_t produced_at_len,
+                const char *extra, size_t extralen, size_t *r_len)
+{
+  static const char keyid[20] = "0123456789abcdefghij";
+  static const char time[] = "20211017120000Z";
+  gpg_error_t err;
+  ksba_der_t d;
+  unsigned char *basic, *der;
+  size_t basiclen;
+
+  /* The BasicOCSPResponse with an empty list of responses.  */
+  d = ksba_der_builder_new (0);
+  if (!d)
+    fail ("error creating new DER builder");
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 2);
+  ksba_der_add_val (d, 0, KSBA_TYPE_OCTET_STRING, keyid, sizeof keyid);
+  ksba_der_add_end (d);
+  if (produced_at)
+    ksba_der_add_der (d, produced_at, produced_at_len);
+  else
+    ksba_der_add_val (d, 0, KSBA_TYPE_GENERALIZED_TIME, time, strlen (time));
+  ksba_der_add_der (d, "\x30\x00", 2);  /* responses */
+  ksba_der_add_end (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.2.840.113549.1.1.11");
+  ksba_der_add_ptr (d, 0, KSBA_TYPE_NULL, NULL, 0);
+  ksba_der_add_end (d);
+  ksba_der_add_bts (d, keyid, sizeof keyid, 0);
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 0);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_der (d, cert1, cert1len);
+  ksba_der_add_der (d, cert2, cert2len);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  if (extra)
+    ksba_der_add_der (d, extra, extralen);
+  ksba_der_add_end (d);
+  err = ksba_der_builder_get (d, &basic, &basiclen);
+  fail_if_err (err);
+
+  /* The OCSPResponse.  */
+  ksba_der_builder_reset (d);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_val (d, 0, KSBA_TYPE_ENUMERATED, "", 1);
+  ksba_der_add_tag (d, KSBA_CLASS_CONTEXT, 0);
+  ksba_der_add_tag (d, 0, KSBA_TYPE_SEQUENCE);
+  ksba_der_add_oid (d, "1.3.6.1.5.5.7.48.1.1");
+  ksba_der_add_val (d, 0, KSBA_TYPE_OCTET_STRING, basic, basiclen);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  ksba_der_add_end (d);
+  err = ksba_der_builder_get (d, &der, r_len);
+  fail_if_err (err);
+
+  xfree (basic);
+  ksba_der_release (d);
+  return der;
+}
+
+
+/* Parse RESPONSE with the checks in FLAGS and compare the result
+   with EXPECTED.  On success the certificates CERT1 and CERT2 must
+   have been found.  */
+static void
+check_response (int lineno, ksba_ocsp_t ocsp, unsigned int flags,
+                const unsigned char *response, size_t responselen,
+                gpg_err_code_t expected,
+                const unsigned char *cert1, size_t cert1len,
+                const unsigned char *cert2, size_t cert2len)
+{
+  gpg_error_t err;
+  ksba_ocsp_response_status_t status;
+  ksba_cert_t cert;
+  const unsigned char *image;
+  size_t imagelen;
+  int idx;
+
+  err = ksba_ocsp_set_response_check (ocsp, flags);
+  fail_if_err (err);
+  err = ksba_ocsp_parse_response (ocsp, response, responselen, &status);
+  if (gpg_err_code (err) != expected)
+    {
+      fprintf (stderr, PGM ":%d: flags %u: expected `%s', got `%s'\n",
+               lineno, flags, gpg_strerror (expected), gpg_strerror (err));
+      exit (1);
+    }
+  if (verbose)
+    printf ("line %d: flags %u: %s\n", lineno, flags, gpg_strerror (err));
+  if (err)
+    return;
+
+  if (status != KSBA_OCSP_RSPSTATUS_SUCCESS)
+    fail ("wrong response status");
+  for (idx=0; (cert = ksba_ocsp_get_cert (ocsp, idx)); idx++)
+    {
+      image = ksba_cert_get_image (cert, &imagelen);
+      if (idx > 1
+          || (!idx && (imagelen != cert1len || memcmp (image, cert1, imagelen)))
+          || (idx && (imagelen != cert2len || memcmp (image, cert2, imagelen))))
+        fail ("wrong certificate in the response");
+      ksba_cert_release (cert);
+    }
+  if (idx != 2)
+    fail ("wrong number of certificates in the response");
+}
+
+#define CHECK(flags, response, expected)                                \
+  check_response (__LINE__, ocsp, (flags), (response), responselen,     \
+                  (expected), cert1, cert1len, cert2, cert2len)
+
+
+static void
+test_response_check (void)
+{
+  /* producedAt with a length which is not minimal.  */
+  static const char produced_at[] = "\x18\x81\x0f" "20211017120000Z";
+  /* A truncated object after the certificates.  */
+  static const char extra[] = "\xa1\x05\x00";
+  gpg_error_t err;
+  ksba_ocsp_t ocsp;
+  ksba_cert_t cert, issuer;
+  unsigned char *cert1, *cert2, *response;
+  size_t cert1len, cert2len, responselen;
+
+  cert1 = read_sample ("samples/ov-server.crt", &cert1len);
+  cert2 = read_sample ("samples/ov-root-ca-cert.crt", &cert2len);
+
+  /* A request is required to parse a response.  */
+  err = ksba_ocsp_new (&ocsp);
+  fail_if_err (err);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (cert, cert1, cert1len);
+  fail_if_err (err);
+  err = ksba_cert_new (&issuer);
+  fail_if_err (err);
+  err = ksba_cert_init_from_mem (issuer, cert2, cert2len);
+  fail_if_err (err);
+  err = ksba_ocsp_add_target (ocsp, cert, issuer);
+  fail_if_err (err);
+  ksba_cert_release (cert);
+  ksba_cert_release (issuer);
+
+  err = ksba_ocsp_set_response_check (ocsp, 4);
+  if (gpg_err_code (err) != GPG_ERR_INV_VALUE)
+    fail ("invalid flag not detected");
+
+  response = build_response (cert1, cert1len, cert2, cert2len,
+                             NULL, 0, NULL, 0, &responselen);
+  CHECK (0, response, 0);
+  CHECK (KSBA_OCSP_CHECK_FRAMING, response, 0);
+  CHECK (KSBA_OCSP_CHECK_DER, response, 0);
+  xfree (response);
+
+  response = build_response (cert1, cert1len, cert2, cert2len,
+                             produced_at, sizeof produced_at - 1,
+                             NULL, 0, &responselen);
+  CHECK (0, response, 0);
+  CHECK (KSBA_OCSP_CHECK_FRAMING, response, 0);
+  CHECK (KSBA_OCSP_CHECK_DER, response, GPG_ERR_NOT_DER_ENCODED);
+  xfree (response);
+
+  response = build_response (cert1, cert1len, cert2, cert2len,
+                             NULL, 0, extra, sizeof extra - 1, &responselen);
+  CHECK (0, response, 0);
+  CHECK (KSBA_OCSP_CHECK_FRAMING, response, GPG_ERR_BAD_BER);
+  xfree (response);
+
+  /* Only certificates are allowed in the list.  */
+  response = build_response (cert1, cert1len, (unsigned char *)"\x02\x01\x01",
+                             3, NULL, 0, NULL, 0, &responselen);
+  CHECK (0, response, GPG_ERR_INV_OBJ);
+  xfree (response);
+
+  ksba_ocsp_release (ocsp);
+  xfree (cert1);
+  xfree (cert2);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc)
+    {
+      argc--; argv++;
+    }
+  if (argc && !strcmp (*argv, "--verbose"))
+    {
+      verbose = 1;
+      argc--; argv++;
+    }
+
+  test_response_check ();
+
+  return 0;
+}
@@ -184,6 +184,651 @@ test_mem(const char* path)
   close (fd);
 }
 
+/* Read two concatenated copies of the certificate at PATH from a
+   non-copying memory reader and check that the certificates reference
+   the caller's buffer.  */
+void
+test_mem_nocopy (const char* path)
+{
+  int fd = open (path, O_RDONLY);
+  gpg_error_t err = 0;
+  ksba_reader_t reader;
+  ksba_cert_t cert[2], extra;
+  const unsigned char *image;
+  unsigned char *mem = NULL;
+  ksba_sexp_t serial;
+  size_t imagelen;
+  ssize_t ret = 0;
+  size_t p = 0;
+  struct stat st;
+  int i;
+
+  if (fd < 0)
+    {
+      perror ("open() failed");
+      exit (1);
+    }
+
+  if (fstat (fd, &st))
+    {
+      fprintf (stderr, "fstat() failed: %s\n", strerror (errno));
+      exit (1);
+    }
+
+  mem = xmalloc (2 * st.st_size);
+
+  while (p < st.st_size && (ret = read(fd, mem + p, st.st_size - p)))
+    {
+      if (ret < 0)
+        {
+          fprintf (stderr, "read() failed: %s\n", strerror (errno));
+          exit (1);
+        }
+      p += ret;
+    }
+  memcpy (mem + st.st_size, mem, st.st_size);
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_reader_set_mem_nocopy (reader, mem, 2 * st.st_size);
+  fail_if_err (err);
+
+  for (i=0; i < 2; i++)
+    {
+      err = ksba_cert_new (&cert[i]);
+      fail_if_err (err);
+      err = ksba_cert_read_der (cert[i], reader);
+      fail_if_err2 (path, err);
+    }
+
+  /* There is no third certificate.  */
+  err = ksba_cert_new (&extra);
+  fail_if_err (err);
+  err = ksba_cert_read_der (extra, reader);
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    fail ("reading past the end did not return EOF");
+  ksba_cert_release (extra);
+
+  /* The certificates may outlive the reader.  */
+  ksba_reader_release (reader);
+
+  for (i=0; i < 2; i++)
+    {
+      image = ksba_cert_get_image (cert[i], &imagelen);
+      if (!image)
+        fail ("ksba_cert_get_image failed");
+      if (imagelen != st.st_size)
+        fail ("image length mismatch");
+      if (image != mem + i * st.st_size)
+        fail ("image does not reference the caller's buffer");
+      serial = ksba_cert_get_serial (cert[i]);
+      if (!serial)
+        fail ("ksba_cert_get_serial failed");
+      ksba_free (serial);
+      ksba_cert_release (cert[i]);
+    }
+
+  xfree (mem);
+  close (fd);
+}
+
+void
+test_path (const char* path)
+{
+  gpg_error_t err;
+  ksba_reader_t reader;
+  ksba_cert_t cert;
+  struct stat st;
+  size_t nread;
+
+  if (stat (path, &st))
+    {
+      fprintf (stderr, "stat() failed: %s\n", strerror (errno));
+      exit (1);
+    }
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_reader_set_path (reader, path);
+  fail_if_err2 (path, err);
+
+  /* A mapped file tells how many bytes are available.  */
+  err = ksba_reader_read (reader, NULL, 0, &nread);
+  fail_if_err (err);
+  if (nread != st.st_size)
+    fail ("wrong number of available bytes");
+
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_read_der (cert, reader);
+  fail_if_err2 (path, err);
+  if (ksba_reader_tell (reader) != st.st_size)
+    fail ("wrong read position after the certificate");
+
+  err = ksba_reader_read (reader, NULL, 0, &nread);
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    fail ("EOF not detected");
+
+  ksba_cert_release (cert);
+  ksba_reader_release (reader);
+
+  /* Directories can't be used.  */
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  if (!ksba_reader_set_path (reader, "."))
+    fail ("ksba_reader_set_path accepted a directory");
+  ksba_reader_release (reader);
+}
+
+
+/* Parse the certificate at PATH several times using the same reader
+   and certificate object.  */
+void
+test_reset (const char* path)
+{
+  gpg_error_t err;
+  ksba_reader_t reader;
+  ksba_cert_t cert;
+  const unsigned char *image;
+  unsigned char *copy = NULL;
+  size_t imagelen, copylen = 0;
+  int i;
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+
+  for (i=0; i < 3; i++)
+    {
+      err = ksba_reader_set_path (reader, path);
+      fail_if_err2 (path, err);
+      err = ksba_cert_read_der (cert, reader);
+      fail_if_err2 (path, err);
+      image = ksba_cert_get_image (cert, &imagelen);
+      if (!image)
+        fail ("ksba_cert_get_image failed");
+      if (!copy)
+        {
+          copy = xmalloc (imagelen);
+          memcpy (copy, image, imagelen);
+          copylen = imagelen;
+        }
+      else if (imagelen != copylen || memcmp (image, copy, imagelen))
+        fail ("image mismatch after reset");
+
+      /* Without a reset the objects can't be used again.  */
+      if (!ksba_reader_set_path (reader, path))
+        fail ("ksba_reader_set_path accepted a used reader");
+      if (!ksba_cert_init_from_mem (cert, copy, copylen))
+        fail ("ksba_cert_init_from_mem accepted a used certificate");
+
+      err = ksba_reader_reset (reader);
+      fail_if_err (err);
+      if (ksba_reader_tell (reader))
+        fail ("read position not cleared by ksba_reader_reset");
+      err = ksba_cert_reset (cert);
+      fail_if_err (err);
+      if (ksba_cert_get_image (cert, NULL))
+        fail ("image not cleared by ksba_cert_reset");
+
+      err = ksba_cert_init_from_mem (cert, copy, copylen);
+      fail_if_err2 (path, err);
+      err = ksba_cert_reset (cert);
+      fail_if_err (err);
+    }
+
+  /* A shared object can't be reset.  */
+  ksba_cert_ref (cert);
+  if (gpg_err_code (ksba_cert_reset (cert)) != GPG_ERR_CONFLICT)
+    fail ("ksba_cert_reset did not detect a shared certificate");
+  ksba_cert_release (cert);
+
+  ksba_cert_release (cert);
+  ksba_reader_release (reader);
+  xfree (copy);
+}
+
+
+/* State for the callback reader used by test_readahead.  */
+struct cb_parm_s
+{
+  const unsigned char *buf;
+  size_t len;
+  size_t pos;
+  size_t maxcount;  /* Return at most this many bytes if not 0.  */
+  unsigned int ncalls;
+};
+
+static int
+cb_reader (void *cb_value, char *buffer, size_t count, size_t *r_nread)
+{
+  struct cb_parm_s *parm = cb_value;
+
+  parm->ncalls++;
+  if (parm->pos == parm->len)
+    {
+      *r_nread = 0;
+      return gpg_error (GPG_ERR_EOF);
+    }
+  if (parm->maxcount && count > parm->maxcount)
+    count = parm->maxcount;
+  if (count > parm->len - parm->pos)
+    count = parm->len - parm->pos;
+  memcpy (buffer, parm->buf + parm->pos, count);
+  parm->pos += count;
+  *r_nread = count;
+  return 0;
+}
+
+
+/* Read the certificate at PATH followed by some trailing bytes from
+   a callback reader with read-ahead enabled and check that the read
+   position, unread and EOF work as without read-ahead.  */
+void
+test_readahead (const char* path)
+{
+  static const char trailer[] = "trailing garbage";
+  int fd = open (path, O_RDONLY);
+  gpg_error_t err;
+  ksba_reader_t reader;
+  ksba_cert_t cert;
+  struct cb_parm_s parm;
+  unsigned char *mem, *rest;
+  size_t restlen, nread;
+  ssize_t ret = 0;
+  size_t p = 0;
+  char buf[4];
+  struct stat st;
+
+  if (fd < 0)
+    {
+      perror ("open() failed");
+      exit (1);
+    }
+
+  if (fstat (fd, &st))
+    {
+      fprintf (stderr, "fstat() failed: %s\n", strerror (errno));
+      exit (1);
+    }
+
+  mem = xmalloc (st.st_size + strlen (trailer));
+  while (p < st.st_size && (ret = read(fd, mem + p, st.st_size - p)))
+    {
+      if (ret < 0)
+        {
+          fprintf (stderr, "read() failed: %s\n", strerror (errno));
+          exit (1);
+        }
+      p += ret;
+    }
+  memcpy (mem + st.st_size, trailer, strlen (trailer));
+
+  memset (&parm, 0, sizeof parm);
+  parm.buf = mem;
+  parm.len = st.st_size + strlen (trailer);
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_reader_set_cb (reader, cb_reader, &parm);
+  fail_if_err (err);
+  err = ksba_reader_set_readahead (reader, 4096);
+  fail_if_err (err);
+
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_read_der (cert, reader);
+  fail_if_err2 (path, err);
+  ksba_cert_release (cert);
+
+  if (ksba_reader_tell (reader) != st.st_size)
+    fail ("wrong read position after the certificate");
+  if (parm.ncalls > 1 + st.st_size / 4096)
+    fail ("read-ahead buffer not used");
+
+  /* Read a few bytes, push them back and read them again.  */
+  err = ksba_reader_read (reader, buf, 4, &nread);
+  fail_if_err (err);
+  if (nread != 4 || memcmp (buf, trailer, 4))
+    fail ("wrong data after the certificate");
+  err = ksba_reader_unread (reader, buf, 4);
+  fail_if_err (err);
+  if (ksba_reader_tell (reader) != st.st_size)
+    fail ("wrong read position after unread");
+  err = ksba_reader_read (reader, buf, 4, &nread);
+  fail_if_err (err);
+  if (nread != 4 || memcmp (buf, trailer, 4))
+    fail ("wrong data after unread");
+
+  /* The rest of the buffered data is returned by ksba_reader_clear.  */
+  err = ksba_reader_clear (reader, &rest, &restlen);
+  fail_if_err (err);
+  if (restlen != strlen (trailer) - 4 || memcmp (rest, trailer+4, restlen))
+    fail ("ksba_reader_clear did not return the buffered data");
+  ksba_free (rest);
+
+  err = ksba_reader_read (reader, buf, 1, &nread);
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    fail ("EOF not detected");
+
+  ksba_reader_release (reader);
+  xfree (mem);
+  close (fd);
+}
+
+
+/* Append the PEM armored form of DER with DERLEN to the buffer at
+   *BUFP which has the length *LENP.  Lines have LINELEN characters
+   and end with EOL.  */
+static void
+append_pem (char **bufp, size_t *lenp, const unsigned char *der,
+            size_t derlen, int linelen, const char *eol)
+{
+  static const char b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char *p;
+  size_t i;
+  int col = 0;
+  unsigned int v;
+
+  *bufp = realloc (*bufp, *lenp + 100 + derlen * 2);
+  if (!*bufp)
+    {
+      fprintf (stderr, "out of core\n");
+      exit (1);
+    }
+  p = *bufp + *lenp;
+  p += sprintf (p, "-----BEGIN CERTIFICATE-----%s", eol);
+  for (i=0; i < derlen; i += 3)
+    {
+      v = der[i] << 16;
+      if (i + 1 < derlen)
+        v |= der[i+1] << 8;
+      if (i + 2 < derlen)
+        v |= der[i+2];
+      *p++ = b64[(v >> 18) & 63];
+      *p++ = b64[(v >> 12) & 63];
+      *p++ = i + 1 < derlen? b64[(v >> 6) & 63] : '=';
+      *p++ = i + 2 < derlen? b64[v & 63] : '=';
+      col += 4;
+      if (col >= linelen || i + 3 >= derlen)
+        {
+          p += sprintf (p, "%s", eol);
+          col = 0;
+        }
+    }
+  p += sprintf (p, "-----END CERTIFICATE-----%s", eol);
+  *lenp = p - *bufp;
+}
+
+
+/* Read the certificate and its image from READER and compare it to
+   DER with DERLEN.  */
+static void
+check_armored_cert (ksba_reader_t reader, const unsigned char *der,
+                    size_t derlen)
+{
+  gpg_error_t err;
+  ksba_cert_t cert;
+  const unsigned char *image;
+  size_t imagelen;
+
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_read_der (cert, reader);
+  fail_if_err (err);
+  image = ksba_cert_get_image (cert, &imagelen);
+  if (!image || imagelen != derlen || memcmp (image, der, derlen))
+    fail ("armored certificate does not match");
+  ksba_cert_release (cert);
+}
+
+
+/* Read a bundle of two PEM armored certificates and the plain
+   certificate at PATH through the armor filter.  */
+void
+test_armor (const char* path)
+{
+  static const char junk[] = "Subject: some text\n";
+  gpg_error_t err;
+  ksba_reader_t reader;
+  ksba_cert_t cert;
+  struct cb_parm_s parm;
+  unsigned char *der;
+  char *pem = NULL;
+  size_t derlen, pemlen = 0;
+  int fd, pass;
+  ssize_t ret;
+  struct stat st;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st))
+    {
+      perror ("open() failed");
+      exit (1);
+    }
+  der = xmalloc (st.st_size);
+  for (derlen = 0; derlen < st.st_size; derlen += ret)
+    if ((ret = read (fd, der + derlen, st.st_size - derlen)) <= 0)
+      {
+        fprintf (stderr, "read() failed: %s\n", strerror (errno));
+        exit (1);
+      }
+  close (fd);
+
+  pem = malloc (sizeof junk);
+  strcpy (pem, junk);
+  pemlen = strlen (junk);
+  append_pem (&pem, &pemlen, der, derlen, 64, "\n");
+  append_pem (&pem, &pemlen, der, derlen - 1, 76, "\r\n");
+
+  /* Pass 0 reads from memory and pass 1 from a callback returning
+     only a few bytes per call.  */
+  for (pass=0; pass < 2; pass++)
+    {
+      err = ksba_reader_new (&reader);
+      fail_if_err (err);
+      if (!pass)
+        err = ksba_reader_set_mem (reader, pem, pemlen);
+      else
+        {
+          memset (&parm, 0, sizeof parm);
+          parm.buf = (unsigned char *)pem;
+          parm.len = pemlen;
+          parm.maxcount = 7;
+          err = ksba_reader_set_cb (reader, cb_reader, &parm);
+        }
+      fail_if_err (err);
+      err = ksba_reader_set_armor (reader, 1);
+      fail_if_err (err);
+
+      check_armored_cert (reader, der, derlen);
+      if (ksba_reader_tell (reader) != derlen)
+        fail ("wrong read position after the armored certificate");
+
+      /* The second certificate is truncated.  */
+      err = ksba_reader_clear (reader, NULL, NULL);
+      fail_if_err (err);
+      err = ksba_cert_new (&cert);
+      fail_if_err (err);
+      err = ksba_cert_read_der (cert, reader);
+      if (!err)
+        fail ("truncated armored certificate not detected");
+      ksba_cert_release (cert);
+
+      ksba_reader_release (reader);
+    }
+
+  /* Plain DER data is passed through unchanged.  */
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_reader_set_mem_nocopy (reader, der, derlen);
+  fail_if_err (err);
+  err = ksba_reader_set_armor (reader, 1);
+  fail_if_err (err);
+  check_armored_cert (reader, der, derlen);
+  ksba_reader_release (reader);
+
+  /* Bad characters in the base64 data are an error.  */
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  pemlen = strlen (junk);
+  append_pem (&pem, &pemlen, der, derlen, 64, "\n");
+  pem[pemlen - 40] = '*';
+  err = ksba_reader_set_mem (reader, pem, pemlen);
+  fail_if_err (err);
+  err = ksba_reader_set_armor (reader, 1);
+  fail_if_err (err);
+  err = ksba_cert_new (&cert);
+  fail_if_err (err);
+  err = ksba_cert_read_der (cert, reader);
+  if (gpg_err_code (err) != GPG_ERR_INV_ARMOR)
+    fail ("bad base64 character not detected");
+  ksba_cert_release (cert);
+  ksba_reader_release (reader);
+
+  free (pem);
+  xfree (der);
+}
+
+
+/* Split a buffer with three copies of the certificate at PATH and
+   some junk into the certificates.  */
+void
+test_split (const char* path)
+{
+  static const unsigned char junk[] = { 0x04, 0x02, 'a', 'b', 'x', 'y' };
+  gpg_error_t err;
+  ksba_reader_t reader;
+  ksba_cert_t certs[3];
+  unsigned char *der, *buf;
+  const void **bufs;
+  size_t *lens;
+  size_t derlen, buflen, count;
+  int fd, i;
+  ssize_t ret;
+  struct stat st;
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0 || fstat (fd, &st))
+    {
+      perror ("open() failed");
+      exit (1);
+    }
+  der = xmalloc (st.st_size);
+  for (derlen = 0; derlen < st.st_size; derlen += ret)
+    if ((ret = read (fd, der + derlen, st.st_size - derlen)) <= 0)
+      {
+        fprintf (stderr, "read() failed: %s\n", strerror (errno));
+        exit (1);
+      }
+  close (fd);
+
+  buf = xmalloc (3 * derlen + sizeof junk);
+  memcpy (buf, der, derlen);
+  memcpy (buf + derlen, der, derlen);
+  memcpy (buf + 2 * derlen, junk, sizeof junk);
+  memcpy (buf + 2 * derlen + sizeof junk, der, derlen);
+  buflen = 3 * derlen + sizeof junk;
+
+  err = ksba_reader_new (&reader);
+  fail_if_err (err);
+  err = ksba_reader_set_mem_nocopy (reader, buf, buflen);
+  fail_if_err (err);
+
+  /* Without the flag the junk is an error.  */
+  err = ksba_reader_split (reader, 0, &bufs, &lens, &count);
+  if (gpg_err_code (err) != GPG_ERR_INV_OBJ)
+    fail ("junk between the objects not detected");
+
+  err = ksba_reader_split (reader, KSBA_SPLIT_SKIP_BAD, &bufs, &lens, &count);
+  fail_if_err (err);
+  if (count != 3)
+    fail ("wrong number of objects");
+  for (i=0; i < count; i++)
+    if (lens[i] != derlen || memcmp (bufs[i], der, derlen))
+      fail ("wrong object boundaries");
+  err = ksba_cert_parse_batch (bufs, lens, count, certs, NULL, 0);
+  fail_if_err (err);
+  for (i=0; i < count; i++)
+    ksba_cert_release (certs[i]);
+  ksba_free (bufs);
+  ksba_free (lens);
+
+  /* A truncated object is an error.  */
+  ksba_reader_reset (reader);
+  err = ksba_reader_set_mem_nocopy (reader, buf, 2 * derlen - 1);
+  fail_if_err (err);
+  err = ksba_reader_split (reader, 0, &bufs, &lens, &count);
+  if (gpg_err_code (err) != GPG_ERR_BAD_BER)
+    fail ("truncated object not detected");
+
+  /* With the flag a truncated object ends the split.  */
+  ksba_reader_reset (reader);
+  err = ksba_reader_set_mem_nocopy (reader, buf, 2 * derlen - 1);
+  fail_if_err (err);
+  err = ksba_reader_split (reader, KSBA_SPLIT_SKIP_BAD, &bufs, &lens, &count);
+  fail_if_err (err);
+  if (count != 1 || lens[0] != derlen || memcmp (bufs[0], der, derlen))
+    fail ("wrong objects before a truncated object");
+  ksba_free (bufs);
+  ksba_free (lens);
+
+  /* Corrupt the length of the middle object.  A length which is too
+     large ends the split; after a bad length encoding only the next
+     certificate is found and not the SEQUENCEs in the body of the
+     corrupted one.  */
+  if (der[0] == 0x30 && der[1] == 0x82)
+    {
+      memcpy (buf + 2 * derlen, der, derlen);
+      buflen = 3 * derlen;
+
+      buf[derlen + 2] = 0x7f;
+      ksba_reader_reset (reader);
+      err = ksba_reader_set_mem_nocopy (reader, buf, buflen);
+      fail_if_err (err);
+      err = ksba_reader_split (reader, KSBA_SPLIT_SKIP_BAD,
+                               &bufs, &lens, &count);
+      fail_if_err (err);
+      if (count != 1 || lens[0] != derlen || memcmp (bufs[0], der, derlen))
+        fail ("wrong objects before a too large length");
+      ksba_free (bufs);
+      ksba_free (lens);
+
+      buf[derlen + 2] = der[2];
+      buf[derlen + 1] = 0xff;
+      ksba_reader_reset (reader);
+      err = ksba_reader_set_mem_nocopy (reader, buf, buflen);
+      fail_if_err (err);
+      err = ksba_reader_split (reader, KSBA_SPLIT_SKIP_BAD,
+                               &bufs, &lens, &count);
+      fail_if_err (err);
+      if (count != 2)
+        fail ("wrong number of objects around a bad length");
+      for (i=0; i < count; i++)
+        if (lens[i] != derlen || memcmp (bufs[i], der, derlen))
+          fail ("inner object of a bad certificate returned");
+      ksba_free (bufs);
+      ksba_free (lens);
+    }
+
+  /* Mapped files work as well.  */
+  ksba_reader_reset (reader);
+  err = ksba_reader_set_path (reader, path);
+  fail_if_err (err);
+  err = ksba_reader_split (reader, 0, &bufs, &lens, &count);
+  fail_if_err (err);
+  if (count != 1 || lens[0] != derlen || memcmp (bufs[0], der, derlen))
+    fail ("wrong object in mapped file");
+  ksba_free (bufs);
+  ksba_free (lens);
+
+  ksba_reader_release (reader);
+  xfree (buf);
+  xfree (der);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -194,6 +839,12 @@ main (int argc, char **argv)
       test_fd (fname);
       test_file (fname);
       test_mem (fname);
+      test_mem_nocopy (fname);
+      test_path (fname);
+      test_reset (fname);
+      test_readahead (fname);
+      test_armor (fname);
+      test_split (fname);
       free(fname);
     }
   else
@@ -204,6 +855,12 @@ main (int argc, char **argv)
           test_fd (argv[i]);
           test_file (argv[i]);
           test_mem (argv[i]);
+          test_mem_nocopy (argv[i]);
+          test_path (argv[i]);
+          test_reset (argv[i]);
+          test_readahead (argv[i]);
+          test_armor (argv[i]);
+          test_split (argv[i]);
         }
     }
 